@@ -0,0 +1,96 @@
+"""
+Measures how many Measurements messages a second the database can store, writing each in its own transaction against
+queueing them to be written in batches.  Run it on the machine the server runs on, with --db pointing at the same disk,
+e.g.
+
+    python benchmark_ingest.py --messages 2000 --db /home/ttgo/benchmark.db
+"""
+import argparse
+import logging
+import os
+import time
+import database
+
+
+def make_messages(num_messages: int, num_sensors: int):
+    """
+    The samples of [num_messages] Measurements from [num_sensors] sensors, two minutes apart
+    """
+    start = 1622548800
+    return [("sensor{}".format(i % num_sensors), start + 120 * (i // num_sensors),
+             {field: float(i + j) for j, field in enumerate(database.MEASUREMENT_SERIES)})
+            for i in range(num_messages)]
+
+
+def open_empty(db_path: str, **kwargs) -> database.Database:
+    for suffix in ["", "-wal", "-shm"]:
+        if os.path.exists(db_path + suffix):
+            os.remove(db_path + suffix)
+    db = database.Database(**kwargs)
+    if not db.open(db_path):
+        raise Exception("Couldn't open {}".format(db_path))
+    return db
+
+
+def run_per_message(db_path: str, messages) -> float:
+    db = open_empty(db_path)
+    start = time.perf_counter()
+    for message in messages:
+        db.write_samples([message])
+    elapsed_s = time.perf_counter() - start
+    db.close()
+    return elapsed_s
+
+
+def run_queued(db_path: str, messages, max_batch_size: int, flush_interval_s: float) -> float:
+    db = open_empty(db_path, max_batch_size=max_batch_size,
+                    flush_interval_s=flush_interval_s)
+    start = time.perf_counter()
+    for message in messages:
+        db.queue_samples([message])
+    # only done once everything is on disk
+    db.close()
+    return time.perf_counter() - start
+
+
+def check_stored(db_path: str, num_messages: int):
+    db = database.Database()
+    db.open(db_path)
+    num_rows = sum(len(db.get_data(topic)) for topic in db.get_topics())
+    db.close()
+    if num_rows != num_messages * len(database.MEASUREMENT_SERIES):
+        raise Exception("Expected {} values, found {}".format(
+            num_messages * len(database.MEASUREMENT_SERIES), num_rows))
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.WARNING)
+
+    argparser = argparse.ArgumentParser()
+    argparser.add_argument("--messages", type=int, default=2000,
+                           help="The number of Measurements messages to store")
+    argparser.add_argument("--sensors", type=int, default=10,
+                           help="The number of sensors the messages come from")
+    argparser.add_argument("--db", dest="db_path", type=str, default="benchmark_ingest.db",
+                           help="Where to put the database, it is deleted first")
+    argparser.add_argument("--batch-size", dest="max_batch_size", type=int, default=database.DEFAULT_MAX_BATCH_SIZE,
+                           help="Messages written per transaction when queued")
+    argparser.add_argument("--flush-interval-s", type=float, default=database.DEFAULT_FLUSH_INTERVAL_S,
+                           help="The longest a queued row waits to be written")
+    argparser.add_argument("--skip-per-message", action="store_true",
+                           help="Don't time writing each message in its own transaction, which is slow on an SD card")
+    args = argparser.parse_args()
+
+    messages = make_messages(args.messages, args.sensors)
+    results = []
+    if not args.skip_per_message:
+        results.append(("per message", run_per_message(args.db_path, messages)))
+        check_stored(args.db_path, args.messages)
+    results.append(("queued", run_queued(args.db_path, messages,
+                   args.max_batch_size, args.flush_interval_s)))
+    check_stored(args.db_path, args.messages)
+
+    print("{:<12}{:>12}{:>16}".format("ingest", "time (s)", "messages/s"))
+    for name, elapsed_s in results:
+        print("{:<12}{:>12.2f}{:>16.0f}".format(
+            name, elapsed_s, args.messages / elapsed_s))
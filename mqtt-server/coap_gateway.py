@@ -0,0 +1,309 @@
+"""
+A CoAP (RFC 7252) gateway for devices that send their batches over UDP (see src/udp_transport.h) rather than MQTT.
+Each confirmable POST to sensors/<sensor_name>[/...] carries a sequence of messages, each prefixed by its length as
+a varint, and each is republished to the broker on the topic given by the path.  The server can't tell them from
+messages published over MQTT.
+"""
+import argparse
+import logging
+import socket
+import threading
+import time
+from collections import OrderedDict
+
+import paho.mqtt.client as mqtt
+
+
+DEFAULT_MQTT_BROKER = "localhost"
+DEFAULT_COAP_PORT = 5683
+TOPIC_ROOT = "sensors"
+
+COAP_VERSION = 1
+TYPE_CONFIRMABLE = 0
+TYPE_NON_CONFIRMABLE = 1
+TYPE_ACKNOWLEDGEMENT = 2
+TYPE_RESET = 3
+
+CODE_EMPTY = 0x00
+CODE_POST = 0x02
+CODE_CHANGED = 0x44             # 2.04
+CODE_BAD_REQUEST = 0x80         # 4.00
+CODE_FORBIDDEN = 0x83           # 4.03
+CODE_METHOD_NOT_ALLOWED = 0x85  # 4.05
+
+OPTION_URI_PATH = 11
+PAYLOAD_MARKER = 0xFF
+
+# how long a message id is remembered, to spot retransmissions (EXCHANGE_LIFETIME in RFC 7252)
+EXCHANGE_LIFETIME_S = 247
+MAX_REMEMBERED_EXCHANGES = 1024
+
+
+class CoapMessage:
+    def __init__(self, message_type: int, code: int, message_id: int, token: bytes = b"",
+                 options: list = None, payload: bytes = b"") -> None:
+        self.message_type = message_type
+        self.code = code
+        self.message_id = message_id
+        self.token = token
+        self.options = options if options is not None else []
+        self.payload = payload
+
+    def uri_path(self) -> str:
+        return "/".join(value.decode("utf-8") for number, value in self.options if number == OPTION_URI_PATH)
+
+
+def read_extended(data: bytes, offset: int, value: int):
+    """
+    Read the option delta or length whose header nibble is [value], extended by the bytes at [offset] if need be.
+    Returns the value and the offset after it
+    """
+    if value < 13:
+        return value, offset
+    if value == 13:
+        return data[offset] + 13, offset + 1
+    if value == 14:
+        return int.from_bytes(data[offset:offset + 2], "big") + 269, offset + 2
+    raise ValueError("reserved option nibble")
+
+
+def parse_message(data: bytes) -> CoapMessage:
+    """
+    Parse a CoAP datagram, raising ValueError if it is malformed
+    """
+    if len(data) < 4 or data[0] >> 6 != COAP_VERSION:
+        raise ValueError("not a CoAP message")
+    token_length = data[0] & 0x0F
+    if token_length > 8 or len(data) < 4 + token_length:
+        raise ValueError("bad token length")
+    message = CoapMessage(message_type=(data[0] >> 4) & 0x03,
+                          code=data[1],
+                          message_id=int.from_bytes(data[2:4], "big"),
+                          token=bytes(data[4:4 + token_length]))
+
+    offset = 4 + token_length
+    option_number = 0
+    try:
+        while offset < len(data):
+            header = data[offset]
+            if header == PAYLOAD_MARKER:
+                message.payload = bytes(data[offset + 1:])
+                if len(message.payload) == 0:
+                    raise ValueError("payload marker without a payload")
+                break
+            delta, offset = read_extended(data, offset + 1, header >> 4)
+            length, offset = read_extended(data, offset, header & 0x0F)
+            if offset + length > len(data):
+                raise ValueError("truncated option")
+            option_number += delta
+            message.options.append(
+                (option_number, bytes(data[offset:offset + length])))
+            offset += length
+    except IndexError:
+        raise ValueError("truncated option")
+    return message
+
+
+def encode_extended(value: int):
+    """
+    Returns the header nibble and extended bytes of an option delta or length
+    """
+    if value < 13:
+        return value, b""
+    if value < 269:
+        return 13, bytes([value - 13])
+    return 14, (value - 269).to_bytes(2, "big")
+
+
+def encode_message(message: CoapMessage) -> bytes:
+    data = bytearray([COAP_VERSION << 6 | message.message_type << 4 | len(message.token),
+                      message.code]) + message.message_id.to_bytes(2, "big") + message.token
+    option_number = 0
+    for number, value in sorted(message.options, key=lambda option: option[0]):
+        delta_nibble, delta_bytes = encode_extended(number - option_number)
+        length_nibble, length_bytes = encode_extended(len(value))
+        data += bytes([delta_nibble << 4 | length_nibble]) + \
+            delta_bytes + length_bytes + value
+        option_number = number
+    if message.payload:
+        data += bytes([PAYLOAD_MARKER]) + message.payload
+    return bytes(data)
+
+
+def make_post(message_id: int, token: bytes, topic: str, payload: bytes) -> CoapMessage:
+    """
+    A confirmable POST of [payload] to [topic], as the devices send them
+    """
+    options = [(OPTION_URI_PATH, segment.encode("utf-8"))
+               for segment in topic.split("/") if segment]
+    return CoapMessage(TYPE_CONFIRMABLE, CODE_POST, message_id, token, options, payload)
+
+
+def split_records(payload: bytes) -> list:
+    """
+    Split a payload into the messages it carries, each prefixed by its length as a varint.
+    Raises ValueError if it is truncated
+    """
+    records = []
+    offset = 0
+    while offset < len(payload):
+        length = 0
+        shift = 0
+        while True:
+            if offset >= len(payload) or shift > 28:
+                raise ValueError("truncated record length")
+            byte = payload[offset]
+            offset += 1
+            length |= (byte & 0x7F) << shift
+            shift += 7
+            if byte & 0x80 == 0:
+                break
+        if offset + length > len(payload):
+            raise ValueError("truncated record")
+        records.append(payload[offset:offset + length])
+        offset += length
+    return records
+
+
+def join_records(messages: list) -> bytes:
+    payload = bytearray()
+    for message in messages:
+        length = len(message)
+        while True:
+            byte = length & 0x7F
+            length >>= 7
+            payload.append(byte | (0x80 if length else 0))
+            if not length:
+                break
+        payload += message
+    return bytes(payload)
+
+
+class CoapGateway:
+    """
+    Republishes the messages posted by devices, through [publish](topic, payload).
+    Retransmissions of a request that has already been handled are acknowledged again but not republished
+    """
+
+    def __init__(self, publish) -> None:
+        self.__publish = publish
+        self.__exchanges = OrderedDict()
+        self.__socket = None
+        self.__stopped = threading.Event()
+
+    def handle_datagram(self, data: bytes, address) -> bytes:
+        """
+        Handle a datagram from [address], returning the datagram to send back (or None)
+        """
+        try:
+            request = parse_message(data)
+        except ValueError as e:
+            logging.warning("Bad CoAP datagram from {}: {}".format(address, e))
+            return None
+
+        if request.message_type not in (TYPE_CONFIRMABLE, TYPE_NON_CONFIRMABLE):
+            # nothing is ever sent that could be acknowledged or reset
+            return None
+
+        # a retransmission, because our acknowledgement was lost
+        now = time.monotonic()
+        self.__forget_old_exchanges(now)
+        exchange = (address, request.message_id)
+        if exchange in self.__exchanges:
+            return self.__exchanges[exchange][1]
+
+        code = self.__handle_request(request, address)
+        response = None
+        if request.message_type == TYPE_CONFIRMABLE:
+            response = encode_message(CoapMessage(
+                TYPE_ACKNOWLEDGEMENT, code, request.message_id, request.token))
+        self.__exchanges[exchange] = (now, response)
+        return response
+
+    def __handle_request(self, request: CoapMessage, address) -> int:
+        if request.code != CODE_POST:
+            return CODE_METHOD_NOT_ALLOWED
+        topic = request.uri_path()
+        if topic.split("/")[0] != TOPIC_ROOT or len(topic.split("/")) < 2:
+            logging.warning("CoAP post from {} to {} refused".format(address, topic))
+            return CODE_FORBIDDEN
+        try:
+            records = split_records(request.payload)
+        except ValueError as e:
+            logging.warning("Bad CoAP payload from {}: {}".format(address, e))
+            return CODE_BAD_REQUEST
+
+        for record in records:
+            self.__publish(topic, record)
+        logging.debug("Republished {} messages from {} on {}".format(
+            len(records), address, topic))
+        return CODE_CHANGED
+
+    def __forget_old_exchanges(self, now: float):
+        while self.__exchanges:
+            exchange, (received, _) = next(iter(self.__exchanges.items()))
+            if now - received < EXCHANGE_LIFETIME_S and len(self.__exchanges) < MAX_REMEMBERED_EXCHANGES:
+                break
+            del self.__exchanges[exchange]
+
+    def bind(self, host: str, port: int):
+        """
+        Open the UDP socket, returning the address it is bound to (port 0 picks a free port)
+        """
+        self.__socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.__socket.bind((host, port))
+        # so that close() is noticed
+        self.__socket.settimeout(0.2)
+        return self.__socket.getsockname()
+
+    def serve_forever(self):
+        """
+        Handle datagrams until close() is called
+        """
+        while not self.__stopped.is_set():
+            try:
+                data, address = self.__socket.recvfrom(2048)
+            except socket.timeout:
+                continue
+            except OSError:
+                # closed
+                return
+            response = self.handle_datagram(data, address)
+            if response is not None:
+                self.__socket.sendto(response, address)
+
+    def close(self):
+        self.__stopped.set()
+        if self.__socket is not None:
+            self.__socket.close()
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.INFO,
+                        format='%(asctime)s  %(levelname)s: %(message)s')
+
+    argparser = argparse.ArgumentParser(
+        description="Republish the messages posted over CoAP by the devices to the MQTT broker")
+    argparser.add_argument("--broker", dest="mqtt_broker",
+                           help="The MQTT broker URI", type=str, default=DEFAULT_MQTT_BROKER)
+    argparser.add_argument("--bind", dest="bind_host",
+                           help="The address to listen on", type=str, default="0.0.0.0")
+    argparser.add_argument("--port", dest="coap_port",
+                           help="The UDP port to listen on", type=int, default=DEFAULT_COAP_PORT)
+    args = argparser.parse_args()
+
+    client = mqtt.Client("CoapGateway")
+    client.connect(args.mqtt_broker)
+    client.loop_start()
+
+    gateway = CoapGateway(
+        lambda topic, payload: client.publish(topic, payload, qos=1))
+    logging.info("CoAP gateway listening on {}".format(
+        gateway.bind(args.bind_host, args.coap_port)))
+    try:
+        gateway.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    gateway.close()
+    client.loop_stop()
+    client.disconnect()
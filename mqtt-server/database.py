@@ -1,22 +1,113 @@
 import sqlite3
 import logging
-from sqlite3.dbapi2 import IntegrityError
 import threading
 from datetime import datetime
-import struct
+import rollups
+
+
+# queued samples are written in one transaction once this many are waiting, or after FLUSH_INTERVAL_S
+DEFAULT_MAX_BATCH_SIZE = 100
+DEFAULT_FLUSH_INTERVAL_S = 1.0
+# queue_samples() waits for the writer thread once this many are waiting, rather than queueing without limit
+DEFAULT_MAX_QUEUED = 10000
+
+# the series that can be stored for a sensor, each a column of the measurements table: the fields of Measurements,
+# and the statistics of each channel of WindowAggregates (named as in window_aggregates.aggregates_to_dict)
+MEASUREMENT_SERIES = ["lux", "humidity",
+                      "temperature_C", "soil", "salt", "battery_mV"]
+AGGREGATE_SERIES = ["{}_{}".format(channel, statistic)
+                    for channel in ["lux", "soil", "salt"]
+                    for statistic in ["min", "max", "mean", "stddev"]]
+SERIES = MEASUREMENT_SERIES + AGGREGATE_SERIES
+
+SENSORS_TOPIC_ROOT = "sensors"
+
+
+def series_topic(sensor_name: str, series: str) -> str:
+    """
+    The topic a series is listed under by get_topics(), sensors/<sensor_name>/<series>
+    """
+    return "{}/{}/{}".format(SENSORS_TOPIC_ROOT, sensor_name, series)
+
+
+def split_series_topic(topic: str):
+    """
+    The sensor name and series of a topic made by series_topic(), or (None, None) if it isn't one
+    """
+    parts = topic.split("/")
+    if len(parts) != 3 or parts[0] != SENSORS_TOPIC_ROOT or parts[2] not in SERIES:
+        return None, None
+    return parts[1], parts[2]
+
+
+def to_epoch(time) -> int:
+    """
+    [time] as seconds since the epoch, from a (naive, local) datetime or a number
+    """
+    if isinstance(time, datetime):
+        return int(time.timestamp())
+    return int(time)
+
+
+def series_query(sensor_name: str, series: str, datetime_from=None, datetime_to=None, limit=None):
+    """
+    The SQL (and its parameters) for Database.get_data().  The sensor id is looked up first, so that the rest is a
+    range scan of the measurements primary key, newest first, that stops after [limit] rows.
+    """
+    if series not in SERIES:
+        raise Exception("{} isn't a series that can be stored".format(series))
+
+    # the series is one of SERIES, so safe to put in the query
+    sql = "SELECT `timestamp`, `{0}` FROM `measurements` " \
+        "WHERE `sensor_id` == (SELECT `id` FROM `sensors` WHERE `name` == ?) AND `{0}` IS NOT NULL".format(series)
+    parameters = [sensor_name]
+    if datetime_from is not None:
+        sql += " AND `timestamp` >= ?"
+        parameters.append(to_epoch(datetime_from))
+    if datetime_to is not None:
+        sql += " AND `timestamp` <= ?"
+        parameters.append(to_epoch(datetime_to))
+    sql += " ORDER BY `timestamp` DESC"
+    if limit is not None:
+        sql += " LIMIT ?"
+        parameters.append(int(limit))
+    return sql, tuple(parameters)
 
 
 class Database:
 
-    __BYTES_DB_FORMAT_STRING = '-'
-    __UTF8_DB_FORMAT_STRING = 'utf8'
+    # one row per sample, where a series a sample doesn't have is NULL (e.g. fields compressed away on the device)
+    __INSERT_SAMPLE_SQL = "INSERT INTO `measurements` (`sensor_id`, `timestamp`, {}) VALUES (?, ?, {}) " \
+        "ON CONFLICT (`sensor_id`, `timestamp`) DO UPDATE SET {};".format(
+            ", ".join("`{}`".format(series) for series in SERIES),
+            ", ".join("?" for _ in SERIES),
+            # a second message for the same time (the aggregates of the window a measurement closes) fills in the rest
+            ", ".join("`{0}` = COALESCE(excluded.`{0}`, `{0}`)".format(series) for series in SERIES))
 
-    def __init__(self):
+    def __init__(self, max_batch_size: int = DEFAULT_MAX_BATCH_SIZE, flush_interval_s: float = DEFAULT_FLUSH_INTERVAL_S,
+                 max_queued: int = DEFAULT_MAX_QUEUED):
         self.__open = False
         self.__connection = None
         self.__cursor = None
         self.__db_lock = threading.Lock()
 
+        # topics already in the topics table, so they aren't inserted again with every sample, and the ids of sensors
+        # already looked up
+        self.__known_topics = set()
+        self.__sensor_ids = {}
+
+        # sensor name to how many times its samples (or rollups) have changed, for caches of what is read from them
+        self.__generations = {}
+
+        # rows waiting for the writer thread (see queue_samples)
+        self.__max_batch_size = max_batch_size
+        self.__flush_interval_s = flush_interval_s
+        self.__max_queued = max(max_queued, max_batch_size)
+        self.__queue = []
+        self.__queue_condition = threading.Condition()
+        self.__writer_thread = None
+        self.__stopping = False
+
     def open(self, filename):
         return self.__open_connection_and_setup_schema(filename)
 
@@ -29,6 +120,11 @@ class Database:
                 self.__connection = sqlite3.connect(
                     filename, check_same_thread=False)
                 self.__cursor = self.__connection.cursor()
+
+                # with a write ahead log a commit appends to the log rather than rewriting pages of the database, and
+                # NORMAL only syncs it at checkpoints, so a power cut can lose the last few batches but never corrupts
+                self.__cursor.execute("PRAGMA journal_mode=WAL")
+                self.__cursor.execute("PRAGMA synchronous=NORMAL")
                 self.__open = True
         except Exception as e:
             logging.error(
@@ -36,6 +132,7 @@ class Database:
             return False
 
         self.__setup_schema()
+        self.__start_writer()
         return True
 
     def __setup_schema(self):
@@ -43,32 +140,71 @@ class Database:
             raise Exception("Database wasn't open")
 
         with self.__db_lock:
-            # create the events table
-            # (a table of all observed messages, ever)
+            # create the topics table
+            # (a table of all observed series, ever, as sensors/<sensor_name>/<series>)
             self.__cursor.execute(
-                "CREATE TABLE IF NOT EXISTS events("
+                "CREATE TABLE IF NOT EXISTS topics("
                 "id INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,"
-                "topic TEXT NOT NULL,"
-                "timestamp DATETIME NOT NULL,"
-                "recieve_timestamp DATETIME DEFAULT CURRENT_TIMESTAMP NOT NULL,"
-                "data BLOB,"
-                "format_string STRING"
+                "name TEXT UNIQUE NOT NULL"
                 ");")
             self.__connection.commit()
 
-            # create the topics table
-            # (a table of all observed topics, ever)
+            # create the sensors table
+            # (the registry of sensor names, and the MAC address of the device each name is assigned to)
             self.__cursor.execute(
-                "CREATE TABLE IF NOT EXISTS topics("
+                "CREATE TABLE IF NOT EXISTS sensors("
                 "id INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,"
-                "name TEXT UNIQUE NOT NULL"
+                "name TEXT UNIQUE NOT NULL,"
+                "mac TEXT UNIQUE,"
+                "created DATETIME DEFAULT CURRENT_TIMESTAMP NOT NULL"
                 ");")
             self.__connection.commit()
 
-    def close(self, wait_for_write=False):
+            # create the measurements table
+            # (a row per sample of each sensor, clustered by sensor and time so a series is read by a range scan)
+            self.__cursor.execute(
+                "CREATE TABLE IF NOT EXISTS measurements("
+                "sensor_id INTEGER NOT NULL REFERENCES sensors(id),"
+                "timestamp INTEGER NOT NULL,"
+                + "".join("{} REAL,".format(series) for series in SERIES) +
+                "PRIMARY KEY (sensor_id, timestamp)"
+                ") WITHOUT ROWID;")
+            self.__connection.commit()
+
+            # create the rollup tables, and fill them for databases written before they existed
+            if rollups.create_tables(self.__cursor):
+                self.__cursor.execute("SELECT COUNT(*) FROM `measurements`")
+                if self.__cursor.fetchone()[0] > 0:
+                    logging.info("Building the rollups of the measurements")
+                    rollups.rebuild(self.__cursor, SERIES)
+            self.__connection.commit()
+
+            # databases written by older versions of the server kept a row per value in an events table
+            self.__cursor.execute(
+                "SELECT COUNT(*) FROM `sqlite_master` WHERE `type` == 'table' AND `name` == 'events'")
+            if self.__cursor.fetchone()[0] > 0:
+                logging.warning(
+                    "The database has an events table from an older version of the server, its measurements "
+                    "aren't shown unless they are moved over with migrate_database.py")
+
+            # make sure sensors that were named before the registry existed are in it
+            self.__cursor.execute("SELECT `name` FROM `topics`")
+            for topic in self.__cursor.fetchall():
+                parts = topic[0].split('/')
+                if len(parts) > 1:
+                    self.__cursor.execute(
+                        "INSERT OR IGNORE INTO `sensors` (`name`) VALUES (?)", (parts[1],))
+            self.__connection.commit()
+
+            self.__cursor.execute("SELECT `name` FROM `topics`")
+            self.__known_topics = set(row[0] for row in self.__cursor.fetchall())
+
+    def close(self, wait_for_write=True):
         """
         Close the database
+        @param wait_for_write if True, the samples still queued are written first, otherwise they are dropped
         """
+        self.__stop_writer(wait_for_write)
         self.__close()
 
     def __close(self):
@@ -88,7 +224,7 @@ class Database:
         """
         try:
             with self.__db_lock:
-                sql = "SELECT * FROM 'topics' ORDER BY 'name' ASC"
+                sql = "SELECT * FROM `topics` ORDER BY `name` ASC"
                 self.__cursor.execute(sql)
                 topics = self.__cursor.fetchall()
                 if topics is None or len(topics) == 0:
@@ -99,90 +235,379 @@ class Database:
                 "Exception when trying to get topics list: {}".format(e))
             return []
 
-    def get_data(self, topic, datetime_from=None, datetime_to=None):
+    def get_sensor_names(self):
         """
-        Get all the data from the databaes for the given [topic] betwteen times
-        [datetime_from] and [datetime_to].
-        @param topic the topic string
-        @param datetime_from the earliest time to get data from.  If None, returns data from (and including) the earliest recording of the database
-        @param datetime_fo the latest time to get data from.  If None, returns data up until (and including) the most recent recording
-        @returns a list of the data points
+        Return a list of the names in the sensor registry
         """
         try:
             with self.__db_lock:
-                time_column = "timestamp"
-                sql = "SELECT `{}`, `data`, `format_string` FROM `events` WHERE `topic` == ? ORDER BY `{}` ASC".format(
-                    time_column, time_column)
-                self.__cursor.execute(sql, (topic,))
-                data = self.__cursor.fetchall()
-                if data is None or len(data) == 0:
-                    return []
-
-                # first column holds the datetime, second is the data (bytes), third is the format string, fourth is the timestamp
-                data_decoded = []
-                for d in data:
-                    timestamp = d[0]
-                    if d[2] == Database.__BYTES_DB_FORMAT_STRING:
-                        data = d[1]
-                    elif d[2] == Database.__UTF8_DB_FORMAT_STRING:
-                        data = d[1].decode('utf-8')
-                    else:
-                        data = struct.unpack(d[2], d[1])[0]
-                    data_decoded.append([timestamp, data])
-                return data_decoded
+                self.__cursor.execute(
+                    "SELECT `name` FROM `sensors` ORDER BY `id` ASC")
+                return [row[0] for row in self.__cursor.fetchall()]
         except Exception as e:
             logging.error(
-                "Exception when trying to get topics list: {}".format(e))
+                "Exception when trying to get sensor names: {}".format(e))
             return []
 
-    def write_message(self, topic: str, data, timestamp: datetime):
-        if isinstance(data, bytes) or isinstance(data, bytearray):
-            data_bytes = data
-            format_string = Database.__BYTES_DB_FORMAT_STRING
-        elif isinstance(data, float):
-            data_bytes = bytearray(struct.pack("f", data))
-            format_string = 'f'
-        elif isinstance(data, int):
-            data_bytes = bytearray(struct.pack("i", data))
-            format_string = 'i'
-        elif isinstance(data, str):
-            data_bytes = data.encode('utf-8')
-            format_string = Database.__UTF8_DB_FORMAT_STRING
-        else:
-            raise Exception("data must be bytes, bytearray, float or int.")
-        return self.__write_message(topic, data_bytes, format_string, timestamp)
-
-    def __write_message(self, topic, data: bytes, format_string: str, timestamp: datetime):
+    def add_sensor(self, name: str):
+        """
+        Make sure the sensor [name] is in the registry (e.g. for sensors named before the registry existed)
+        """
+        try:
+            with self.__db_lock:
+                self.__cursor.execute(
+                    "INSERT OR IGNORE INTO `sensors` (`name`) VALUES (?)", (name,))
+                self.__connection.commit()
+                return True
+        except Exception as e:
+            logging.error(
+                "Exception when adding sensor {}: {}".format(name, e))
+            return False
+
+    def next_sensor_name(self):
+        """
+        Return the next sensor name that isn't in the registry, without assigning it
+        """
+        with self.__db_lock:
+            return self.__next_sensor_name()
+
+    def register_sensor(self, mac: str):
+        """
+        Return the name assigned to the device with MAC address [mac], assigning it the next free name if it doesn't have one yet.
+        The lookup and assignment happen atomically, so devices registering at the same time always get different names.
+        @returns the sensor name, or None on error
+        """
         with self.__db_lock:
             try:
-                # insert the message
-                timestamp_str = timestamp.strftime("%Y-%m-%d %H:%M:%S")
-                sql = "INSERT INTO `events` (`topic`, `data`, `format_string`, `timestamp`) " \
-                    "VALUES (?, ?, ?, ?);"
                 self.__cursor.execute(
-                    sql, (topic, sqlite3.Binary(data), format_string, timestamp_str,))
+                    "SELECT `name` FROM `sensors` WHERE `mac` == ?", (mac,))
+                row = self.__cursor.fetchone()
+                if row is not None:
+                    return row[0]
+
+                name = self.__next_sensor_name()
+                self.__cursor.execute(
+                    "INSERT INTO `sensors` (`name`, `mac`) VALUES (?, ?)", (name, mac,))
                 self.__connection.commit()
+                return name
+            except Exception as e:
+                self.__connection.rollback()
+                logging.error(
+                    "Exception when registering sensor with MAC {}: {}".format(mac, e))
+                return None
+
+    def __next_sensor_name(self):
+        """
+        The lowest numbered sensor<n> name that isn't in the registry.  The database lock must be held.
+        """
+        self.__cursor.execute("SELECT `name` FROM `sensors`")
+        sensor_names = set(row[0] for row in self.__cursor.fetchall())
+        number = 0
+        while "sensor{}".format(number) in sensor_names:
+            number += 1
+        return "sensor{}".format(number)
+
+    def get_data(self, topic, datetime_from=None, datetime_to=None, limit=None):
+        """
+        Get all the data from the databaes for the given [topic] betwteen times
+        [datetime_from] and [datetime_to].
+        @param topic the topic string, sensors/<sensor_name>/<series>
+        @param datetime_from the earliest time to get data from, a datetime or seconds since the epoch.  If None, returns data from (and including) the earliest recording of the database
+        @param datetime_to the latest time to get data from, a datetime or seconds since the epoch.  If None, returns data up until (and including) the most recent recording
+        @param limit if not None, only the most recent [limit] data points in the range are returned
+        @returns a list of the data points in order of time, each [timestamp (seconds since the epoch), value]
+        """
+        sensor_name, series = split_series_topic(topic)
+        if series is None:
+            logging.error("There is no series for topic {}".format(topic))
+            return []
+        try:
+            sql, parameters = series_query(
+                sensor_name, series, datetime_from, datetime_to, limit)
+            with self.__db_lock:
+                self.__cursor.execute(sql, parameters)
+                data = [list(row) for row in self.__cursor.fetchall()]
+            # the most recent were taken first, for the limit
+            data.reverse()
+            return data
+        except Exception as e:
+            logging.error(
+                "Exception when trying to get data for {}: {}".format(topic, e))
+            return []
+
+    def get_series(self, topic, datetime_from=None, datetime_to=None, max_points=1000):
+        """
+        Get the data for [topic] between [datetime_from] and [datetime_to] (as for get_data()), at the finest
+        resolution that gives no more than [max_points] points: the samples themselves, or their hourly or daily
+        rollups (see rollups.py)
+        @returns the resolution ("raw", "hour" or "day"), and a list of the data points in order of time, each
+        [timestamp (seconds since the epoch, the start of the hour or day), mean, min, max]
+        """
+        sensor_name, series = split_series_topic(topic)
+        if series is None:
+            logging.error("There is no series for topic {}".format(topic))
+            return "raw", []
+        try:
+            with self.__db_lock:
+                self.__cursor.execute(
+                    "SELECT `id` FROM `sensors` WHERE `name` == ?", (sensor_name,))
+                row = self.__cursor.fetchone()
+                if row is None:
+                    return "raw", []
+                sensor_id = row[0]
+
+                def bucket_range(length_s):
+                    # the buckets that overlap the range
+                    conditions = "`sensor_id` == ? AND `series` == ?"
+                    parameters = [sensor_id, series]
+                    if datetime_from is not None:
+                        conditions += " AND `start` >= ?"
+                        parameters.append(rollups.bucket_start(
+                            to_epoch(datetime_from), length_s))
+                    if datetime_to is not None:
+                        conditions += " AND `start` <= ?"
+                        parameters.append(to_epoch(datetime_to))
+                    return conditions, parameters
+
+                # the hourly rollups count the values stored (what a raw read returns), give or take the hours at
+                # either end
+                num_buckets = {}
+                num_samples = 0
+                for resolution, length_s in rollups.RESOLUTIONS:
+                    conditions, parameters = bucket_range(length_s)
+                    self.__cursor.execute("SELECT COUNT(*), SUM(`count`) FROM `{}` WHERE {}".format(
+                        rollups.table_name(resolution), conditions), parameters)
+                    num_buckets[resolution], count = self.__cursor.fetchone()
+                    if resolution == rollups.RESOLUTIONS[0][0]:
+                        num_samples = count or 0
+                resolution = rollups.choose_resolution(
+                    num_samples, num_buckets, max_points)
 
+                if resolution == "raw":
+                    sql, parameters = series_query(
+                        sensor_name, series, datetime_from, datetime_to)
+                    self.__cursor.execute(sql, parameters)
+                    data = [[timestamp, value, value, value]
+                            for timestamp, value in self.__cursor.fetchall()]
+                    data.reverse()
+                    return resolution, data
+
+                conditions, parameters = bucket_range(
+                    dict(rollups.RESOLUTIONS)[resolution])
+                # the mean of the line joining the values, weighted by time, or of the values when they aren't joined
+                self.__cursor.execute("SELECT `start`, CASE WHEN `duration` > 0 THEN `integral` / `duration` "
+                                      "ELSE `sum` / `count` END, `min`, `max` FROM `{}` WHERE {} "
+                                      "ORDER BY `start` ASC".format(rollups.table_name(resolution), conditions),
+                                      parameters)
+                return resolution, [list(row) for row in self.__cursor.fetchall()]
+        except Exception as e:
+            logging.error(
+                "Exception when trying to get series for {}: {}".format(topic, e))
+            return "raw", []
+
+    def rebuild_rollups(self, sensor_name=None):
+        """
+        Recompute the rollups from the samples, of every sensor or just [sensor_name]
+        """
+        with self.__db_lock:
+            try:
+                with self.__connection:
+                    sensor_id = None if sensor_name is None else self.__sensor_id(
+                        sensor_name)
+                    rollups.rebuild(self.__cursor, SERIES, sensor_id)
+                return True
             except Exception as e:
+                self.__sensor_ids = {}
                 logging.error(
-                    "Exception when inserting row with topic {}: {}".format(topic, e))
+                    "Exception when rebuilding rollups: {}".format(e))
                 return False
 
+    def write_sample(self, sensor_name: str, timestamp: int, values: dict):
+        """
+        Write a single sample straight away, in a transaction of its own.  Use queue_samples() for anything
+        received from the sensors.
+        """
+        return self.write_samples([(sensor_name, timestamp, values)])
+
+    def write_samples(self, samples):
+        """
+        Write [samples] in one transaction, each (sensor name, timestamp in seconds since the epoch, dictionary of
+        series to value).  A sample for a sensor and time that is already stored adds its values to it.
+        @returns False if none of them were written
+        """
+        try:
+            rows = [self.__make_row(sensor_name, timestamp, values)
+                    for sensor_name, timestamp, values in samples]
+        except Exception as e:
+            logging.error("Exception when encoding samples: {}".format(e))
+            return False
+        return self.__write_rows(rows)
+
+    def queue_samples(self, samples):
+        """
+        Queue [samples] (as for write_samples()) to be written by the writer thread.  They are written in one
+        transaction with whatever else is queued, once max_batch_size are waiting or flush_interval_s has passed.
+        If max_queued are already waiting, this waits for the writer thread to take them, which holds back whatever
+        is receiving the samples when the disk can't keep up.
+        @returns False if they couldn't be encoded, and so weren't queued
+        """
+        try:
+            rows = [self.__make_row(sensor_name, timestamp, values)
+                    for sensor_name, timestamp, values in samples]
+        except Exception as e:
+            logging.error("Exception when encoding samples: {}".format(e))
+            return False
+
+        with self.__queue_condition:
+            while len(self.__queue) >= self.__max_queued and self.__writer_thread is not None \
+                    and not self.__stopping:
+                self.__queue_condition.wait()
+            self.__queue.extend(rows)
+            if len(self.__queue) >= self.__max_batch_size:
+                self.__queue_condition.notify_all()
+        return True
+
+    def flush(self):
+        """
+        Write everything queued now, rather than waiting for the writer thread
+        """
+        with self.__queue_condition:
+            rows = self.__queue
+            self.__queue = []
+        return len(rows) == 0 or self.__write_rows(rows)
+
+    def generation(self, sensor_name: str) -> int:
+        """
+        A number that changes whenever samples of [sensor_name] are written, so that what was read from them before
+        can be told apart from what would be read now
+        """
+        with self.__db_lock:
+            return self.__generations.get(sensor_name, 0)
+
+    def num_queued(self):
+        """
+        The number of samples queued but not yet written
+        """
+        with self.__queue_condition:
+            return len(self.__queue)
+
+    def __make_row(self, sensor_name: str, timestamp: int, values: dict):
+        unknown_series = set(values.keys()) - set(SERIES)
+        if len(unknown_series) > 0:
+            raise Exception("{} aren't series that can be stored".format(
+                ", ".join(sorted(unknown_series))))
+        return (sensor_name, int(timestamp)) + tuple(
+            None if values.get(series) is None else float(values[series]) for series in SERIES)
+
+    def __sensor_id(self, sensor_name: str):
+        """
+        The id of [sensor_name], adding it to the registry if it isn't there.  The database lock must be held.
+        """
+        sensor_id = self.__sensor_ids.get(sensor_name)
+        if sensor_id is None:
+            self.__cursor.execute(
+                "INSERT OR IGNORE INTO `sensors` (`name`) VALUES (?)", (sensor_name,))
+            self.__cursor.execute(
+                "SELECT `id` FROM `sensors` WHERE `name` == ?", (sensor_name,))
+            sensor_id = self.__cursor.fetchone()[0]
+            self.__sensor_ids[sensor_name] = sensor_id
+        return sensor_id
+
+    def __write_rows(self, rows):
+        """
+        Insert [rows] (made by __make_row), and any topics not seen before, in one transaction
+        """
+        with self.__db_lock:
+            if not self.__open:
+                logging.error(
+                    "Dropping {} samples, the database isn't open".format(len(rows)))
+                return False
+            new_topics = set(series_topic(row[0], series) for row in rows
+                             for series, value in zip(SERIES, row[2:]) if value is not None) - self.__known_topics
             try:
-                try:
-                    # insert the topic to keep a list of unique topics
-                    sql = "INSERT INTO 'topics' ('name') VALUES (?)"
-                    self.__cursor.execute(sql, (topic,))
-                    self.__connection.commit()
-
-                except IntegrityError as e:
-                    if "UNIQUE constraint failed" in e.args[0]:
-                        # this is fine, because if the topic already exists in the topics table, the unique constraint will fail as intended
-                        pass
-                    else:
-                        raise
+                # committed as a whole, or rolled back if anything fails
+                with self.__connection:
+                    sensor_ids = {sensor_name: self.__sensor_id(sensor_name)
+                                  for sensor_name in set(row[0] for row in rows)}
+                    rows = [(sensor_ids[row[0]],) + row[1:] for row in rows]
+                    rollup_changes = self.__rollup_changes(rows)
+                    self.__cursor.executemany(
+                        Database.__INSERT_SAMPLE_SQL, rows)
+                    self.__cursor.executemany("INSERT OR IGNORE INTO `topics` (`name`) VALUES (?)",
+                                              [(topic,) for topic in sorted(new_topics)])
+                    rollups.apply(self.__cursor, rollup_changes)
             except Exception as e:
-                logging.info(
-                    "Exception when inserting row with topic {}: {}".format(topic, e))
-                return True
+                # the ids of sensors added in the transaction went with it
+                self.__sensor_ids = {}
+                logging.error(
+                    "Exception when inserting {} rows: {}".format(len(rows), e))
+                return False
+            self.__known_topics |= new_topics
+            for sensor_name in sensor_ids:
+                self.__generations[sensor_name] = self.__generations.get(
+                    sensor_name, 0) + 1
             return True
+
+    def __rollup_changes(self, rows):
+        """
+        What writing [rows] (with sensor ids) will change in the rollups, worked out from what is stored before they
+        are written.  A value sent again (e.g. a retransmission) changes nothing.  The database lock must be held.
+        """
+        changes = rollups.RollupChanges()
+        stored = {}
+        for row in rows:
+            key = row[:2]
+            if key not in stored:
+                self.__cursor.execute("SELECT {} FROM `measurements` WHERE `sensor_id` == ? AND `timestamp` == ?".format(
+                    ", ".join("`{}`".format(series) for series in SERIES)), key)
+                existing = self.__cursor.fetchone()
+                stored[key] = [None] * \
+                    len(SERIES) if existing is None else list(existing)
+            values = stored[key]
+            for i, value in enumerate(row[2:]):
+                if value is None or value == values[i]:
+                    continue
+                if values[i] is None:
+                    changes.add(row[0], SERIES[i], row[1], value)
+                else:
+                    changes.replace(row[0], SERIES[i], row[1])
+                values[i] = value
+        return changes
+
+    def __start_writer(self):
+        self.__stopping = False
+        self.__writer_thread = threading.Thread(
+            target=self.__writer_loop, name="database-writer", daemon=True)
+        self.__writer_thread.start()
+
+    def __stop_writer(self, wait_for_write):
+        if self.__writer_thread is None:
+            return
+        with self.__queue_condition:
+            self.__stopping = True
+            if not wait_for_write:
+                if len(self.__queue) > 0:
+                    logging.warning(
+                        "Dropping {} queued samples".format(len(self.__queue)))
+                self.__queue = []
+            self.__queue_condition.notify_all()
+        self.__writer_thread.join()
+        self.__writer_thread = None
+
+    def __writer_loop(self):
+        """
+        Write what is queued, whenever a batch fills up or flush_interval_s has passed, until the database is closed
+        """
+        while True:
+            with self.__queue_condition:
+                if not self.__stopping and len(self.__queue) < self.__max_batch_size:
+                    self.__queue_condition.wait(self.__flush_interval_s)
+                rows = self.__queue
+                self.__queue = []
+                stopping = self.__stopping
+                # anything waiting to queue more can now
+                self.__queue_condition.notify_all()
+            if len(rows) > 0:
+                self.__write_rows(rows)
+            if stopping:
+                return
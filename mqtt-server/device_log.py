@@ -0,0 +1,130 @@
+import logging
+import struct
+
+
+# the names of the events in the order of TTGO_LOG_EVENTS in src/log_events.h (the index is the event id)
+EVENT_NAMES = [
+    "Boot",
+    "CpuFrequency",
+    "I2CInitStart",
+    "I2CInitFailed",
+    "BH1750InitFailed",
+    "I2CInitDone",
+    "WifiNoCredentials",
+    "WifiConnecting",
+    "WifiConnectTimeout",
+    "WifiConnectFailed",
+    "WifiConnected",
+    "RTCUpdated",
+    "RTCUpdateFailed",
+    "MeasurementStart",
+    "MeasurementFailed",
+    "MeasurementProgress",
+    "DHTReadRetry",
+    "DHTReadFailed",
+    "SensorNameRetrieved",
+    "SensorNameFailed",
+    "SensorNameSaveFailed",
+    "MQTTConnected",
+    "MQTTConnectFailed",
+    "EncodeFailed",
+    "MeasurementSent",
+    "DeepSleep",
+    "NVSInit",
+    "NVSError",
+    "NVSOpenFailed",
+    "NVSReadFailed",
+    "NVSWriteFailed",
+    "NVSCommitFailed",
+    "HTTPConnectFailed",
+    "HTTPStatus",
+    "HTTPShortRead",
+    "MDNSLookupFailed",
+    "MDNSResolved",
+    "ConfigLoaded",
+    "ConfigCommitted",
+    "SoilCounterFailed",
+    "I2CBusRecovered",
+    "I2CBusStuck",
+    "I2CDeviceReady",
+    "I2CDeviceNotReady",
+    "WakesSkipped",
+    "TransmitBackoff",
+    "TransmitSlotAlign",
+    "CoapGatewayNotFound",
+    "CoapRetransmit",
+    "CoapRejected",
+    "CoapSendFailed",
+    "TlsConnectFailed",
+    "TlsHandshake",
+    "TlsHandshakeFailed",
+    "TlsSessionNotSaved",
+    "HeapUse",
+    "RelayTransportFailed",
+    "RelaySendFailed",
+    "RelayStarted",
+    "RelayForwarded",
+    "RemoteConfigApplied",
+    "RemoteConfigRejected",
+]
+
+LEVEL_NAMES = ["NONE", "ERROR", "WARN", "INFO", "DEBUG"]
+
+# matches LogEntry in src/log.h
+ENTRY_FORMAT = "<IHBBii"
+ENTRY_SIZE = struct.calcsize(ENTRY_FORMAT)
+
+LOG_SUBTOPIC = "log"
+
+
+class LogEntry:
+    def __init__(self, time_ms: int, wake: int, level: int, event: int, arg0: int, arg1: int) -> None:
+        self.time_ms = time_ms
+        self.wake = wake
+        self.level = level
+        self.event = event
+        self.arg0 = arg0
+        self.arg1 = arg1
+
+    def event_name(self) -> str:
+        if self.event < len(EVENT_NAMES):
+            return EVENT_NAMES[self.event]
+        return "Unknown({})".format(self.event)
+
+    def level_name(self) -> str:
+        if self.level < len(LEVEL_NAMES):
+            return LEVEL_NAMES[self.level]
+        return "Unknown({})".format(self.level)
+
+    def __repr__(self) -> str:
+        return "[{}.{}] {} {} {} {}".format(self.wake, self.time_ms, self.level_name(),
+                                           self.event_name(), self.arg0, self.arg1)
+
+
+def is_log_topic(topic: str) -> bool:
+    """
+    Returns true if [topic] carries device log entries (sensors/<sensor_name>/log)
+    """
+    return topic.split("/")[-1] == LOG_SUBTOPIC
+
+
+def parse_log_entries(data: bytes):
+    """
+    Decode the raw log entries shipped by a device.  Any trailing partial entry is ignored.
+    @returns a list of LogEntry
+    """
+    num_entries = len(data) // ENTRY_SIZE
+    if num_entries * ENTRY_SIZE != len(data):
+        logging.warning("Device log length {} is not a multiple of {}".format(
+            len(data), ENTRY_SIZE))
+    return [LogEntry(*struct.unpack_from(ENTRY_FORMAT, data, i * ENTRY_SIZE)) for i in range(num_entries)]
+
+
+def log_device_entries(topic: str, data: bytes):
+    """
+    Write the log entries shipped by a device on [topic] into the server log
+    """
+    # topic is sensors/<sensor_name>/log
+    sensor_name = topic.split("/")[-2]
+    for entry in parse_log_entries(data):
+        logging.info("Device log {}: {}".format(sensor_name, entry))
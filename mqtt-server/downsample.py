@@ -0,0 +1,138 @@
+"""
+Downsampling of series to the number of points a chart can show, so that browsers (tablets in the greenhouse especially)
+aren't sent tens of thousands of points for a line a thousand pixels wide.  Two ways of picking the points:
+
+    lttb    Largest-Triangle-Three-Buckets, which keeps the points that most change the shape of the line
+    minmax  the lowest and highest point of each stretch of time, so no peak or trough is ever left out
+
+Both pick points from the series rather than making new ones, so a value shown was really measured.
+"""
+import threading
+from collections import OrderedDict
+import numpy as np
+
+
+METHODS = ["lttb", "minmax"]
+DEFAULT_METHOD = "lttb"
+
+# downsampled series kept by SeriesCache
+DEFAULT_CACHE_ENTRIES = 128
+
+
+def lttb(x: np.ndarray, y: np.ndarray, num_points: int) -> np.ndarray:
+    """
+    The indices (ascending) of the [num_points] points of ([x], [y]) picked by Largest-Triangle-Three-Buckets: the
+    first and last point, and from each of num_points - 2 buckets of the rest the point that makes the largest
+    triangle with the point picked from the bucket before and the average of the bucket after.  [x] must be ascending.
+    """
+    n = len(x)
+    if num_points >= n:
+        return np.arange(n)
+    if num_points < 3:
+        return np.array([0, n - 1][:num_points], dtype=np.int64)
+
+    # bucket i is [edges[i], edges[i + 1]), all of the points but the first and last between them
+    edges = np.floor(np.linspace(1, n - 1, num_points - 1)).astype(np.int64)
+    counts = np.diff(edges)
+    mean_x = np.add.reduceat(x[:n - 1], edges[:-1]) / counts
+    mean_y = np.add.reduceat(y[:n - 1], edges[:-1]) / counts
+    # the third point of each bucket's triangles, the average of the next bucket or the last point
+    next_x = np.append(mean_x[1:], x[-1])
+    next_y = np.append(mean_y[1:], y[-1])
+
+    selected = np.empty(num_points, dtype=np.int64)
+    selected[0] = 0
+    selected[-1] = n - 1
+    a = 0
+    # each bucket depends on the point picked from the one before, so only the bucket itself can be vectorised
+    for i in range(num_points - 2):
+        start, end = edges[i], edges[i + 1]
+        areas = np.abs((x[a] - next_x[i]) * (y[start:end] - y[a]) -
+                       (x[a] - x[start:end]) * (next_y[i] - y[a]))
+        a = start + int(np.argmax(areas))
+        selected[i + 1] = a
+    return selected
+
+
+def min_max(x: np.ndarray, y_min: np.ndarray, y_max: np.ndarray, num_points: int) -> np.ndarray:
+    """
+    The indices (ascending) of no more than [num_points] points of [x]: the first and last, and the points with the
+    lowest [y_min] and highest [y_max] in each of (num_points - 2) / 2 equal stretches of time.  For raw samples
+    [y_min] and [y_max] are both the values.  [x] must be ascending.
+    """
+    n = len(x)
+    if num_points >= n:
+        return np.arange(n)
+    num_buckets = max((num_points - 2) // 2, 1)
+    span = x[-1] - x[0]
+    if span <= 0:
+        buckets = np.zeros(n, dtype=np.int64)
+    else:
+        buckets = np.minimum(((x - x[0]) * num_buckets / span).astype(np.int64), num_buckets - 1)
+
+    def first_of_each_bucket(order):
+        # [order] sorts the points by bucket, then by what should come first in it
+        sorted_buckets = buckets[order]
+        return order[np.r_[0, np.flatnonzero(np.diff(sorted_buckets)) + 1]]
+
+    lowest = first_of_each_bucket(np.lexsort((y_min, buckets)))
+    highest = first_of_each_bucket(np.lexsort((-y_max, buckets)))
+    return np.unique(np.concatenate(([0, n - 1], lowest, highest)))
+
+
+def downsample(rows, num_points: int, method: str = DEFAULT_METHOD):
+    """
+    No more than [num_points] of [rows], as returned by Database.get_series() ([timestamp, mean, min, max] in order
+    of time), picked by [method] (one of METHODS)
+    """
+    if method not in METHODS:
+        raise ValueError("{} isn't a downsampling method".format(method))
+    if len(rows) <= num_points:
+        return rows
+
+    data = np.asarray(rows, dtype=np.float64)
+    if method == "lttb":
+        indices = lttb(data[:, 0], data[:, 1], num_points)
+    else:
+        indices = min_max(data[:, 0], data[:, 2], data[:, 3], num_points)
+    return [rows[i] for i in indices]
+
+
+class SeriesCache:
+    """
+    The most recently used downsampled series, each with the Database.generation() of its sensor it was made at, so
+    that a series is made again once the sensor has sent more samples.  Safe to use from the server's threads.
+    """
+
+    def __init__(self, max_entries: int = DEFAULT_CACHE_ENTRIES):
+        self.__max_entries = max_entries
+        # key to (generation, value), least recently used first
+        self.__entries = OrderedDict()
+        self.__lock = threading.Lock()
+        self.hits = 0
+        self.misses = 0
+
+    def get_or_make(self, key, generation: int, make):
+        """
+        The value cached for [key] at [generation], or if there isn't one, the value returned by [make]() (called
+        without holding the lock, so two threads asking at once may both make it)
+        """
+        with self.__lock:
+            entry = self.__entries.get(key)
+            if entry is not None and entry[0] == generation:
+                self.__entries.move_to_end(key)
+                self.hits += 1
+                return entry[1]
+            self.misses += 1
+
+        value = make()
+        with self.__lock:
+            self.__entries[key] = (generation, value)
+            self.__entries.move_to_end(key)
+            while len(self.__entries) > self.__max_entries:
+                self.__entries.popitem(last=False)
+        return value
+
+    def __len__(self):
+        with self.__lock:
+            return len(self.__entries)
@@ -0,0 +1,99 @@
+"""
+Loads the recent history of each series into the server's memory in the background, so that the relay and web server
+can start straight away rather than after reading the database.  A series asked for before the loader gets to it is
+loaded there and then (see ensure_loaded()).
+"""
+import logging
+import threading
+import time
+
+
+# how often the loader logs how far it has got
+PROGRESS_INTERVAL_S = 5.0
+
+
+class HistoryLoader:
+
+    def __init__(self, topics, load_function):
+        """
+        @param topics the topics to load, in order
+        @param load_function called with each topic to load it, once
+        """
+        self.__topics = list(topics)
+        self.__topic_set = set(self.__topics)
+        self.__load_function = load_function
+        self.__loaded = set()
+        # held while loading a topic, so that the loader and a request don't both load it
+        self.__load_lock = threading.Lock()
+        self.__thread = None
+        self.__stopping = False
+        self.__start_time = None
+        self.__end_time = None
+
+    def start(self):
+        self.__start_time = time.monotonic()
+        self.__thread = threading.Thread(
+            target=self.__loader_loop, name="history-loader", daemon=True)
+        self.__thread.start()
+
+    def stop(self):
+        self.__stopping = True
+        if self.__thread is not None:
+            self.__thread.join()
+            self.__thread = None
+
+    def wait(self, timeout_s=None):
+        """
+        Wait for the loader to finish
+        @returns True if it has
+        """
+        if self.__thread is not None:
+            self.__thread.join(timeout_s)
+        return self.__end_time is not None
+
+    def ensure_loaded(self, topic):
+        """
+        Load [topic] now, if it is one to load and hasn't been yet
+        """
+        if topic in self.__loaded or topic not in self.__topic_set:
+            return
+        self.__load(topic)
+
+    def progress(self) -> dict:
+        """
+        How many of the topics have been loaded, and for how long the loader has been running (or ran)
+        """
+        end_time = self.__end_time if self.__end_time is not None else time.monotonic()
+        return {
+            "loaded": len(self.__loaded),
+            "total": len(self.__topics),
+            "done": self.__end_time is not None,
+            "elapsed_s": 0.0 if self.__start_time is None else round(end_time - self.__start_time, 3),
+        }
+
+    def __load(self, topic):
+        with self.__load_lock:
+            if topic in self.__loaded:
+                return
+            try:
+                self.__load_function(topic)
+            except Exception as e:
+                logging.error(
+                    "Exception when loading the history of {}: {}".format(topic, e))
+            self.__loaded.add(topic)
+
+    def __loader_loop(self):
+        logging.info("Loading the history of {} series".format(
+            len(self.__topics)))
+        last_report = time.monotonic()
+        for i, topic in enumerate(self.__topics):
+            if self.__stopping:
+                return
+            self.__load(topic)
+            if time.monotonic() - last_report >= PROGRESS_INTERVAL_S:
+                last_report = time.monotonic()
+                logging.info("Loaded the history of {} of {} series".format(
+                    i + 1, len(self.__topics)))
+        self.__end_time = time.monotonic()
+        logging.info("Loaded the history of {} series in {:.1f} s".format(
+            len(self.__topics), self.__end_time - self.__start_time))
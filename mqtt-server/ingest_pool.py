@@ -0,0 +1,116 @@
+"""
+A fixed pool of threads that run the callbacks of the messages the relay receives (see mqtt_relay.py), rather than a
+thread per callback per message.  Each message goes to the worker its key (e.g. the sensor it came from) hashes to, so
+the messages of a sensor are handled one at a time, in the order they arrived.
+
+The queue of each worker is bounded.  Once it is full, submit() waits for the worker, which stops the MQTT client
+reading from the broker (which holds on to the messages) until the workers catch up after a burst.
+"""
+import logging
+import queue
+import threading
+import zlib
+
+
+DEFAULT_NUM_WORKERS = 4
+# messages waiting for each worker before submit() waits
+DEFAULT_MAX_QUEUED = 1000
+
+
+class IngestPool:
+
+    def __init__(self, num_workers: int = DEFAULT_NUM_WORKERS, max_queued: int = DEFAULT_MAX_QUEUED):
+        self.__queues = [queue.Queue(max_queued) for _ in range(num_workers)]
+        self.__max_queued = max_queued
+        self.__threads = []
+
+        self.__stats_lock = threading.Lock()
+        self.__num_handled = 0
+        self.__num_failed = 0
+        self.__num_waits = 0
+        self.__max_depth = 0
+
+    def start(self):
+        if len(self.__threads) > 0:
+            return
+        for i, work_queue in enumerate(self.__queues):
+            thread = threading.Thread(target=self.__worker_loop, args=(work_queue,),
+                                      name="ingest-{}".format(i), daemon=True)
+            thread.start()
+            self.__threads.append(thread)
+
+    def stop(self):
+        """
+        Handle everything already submitted, then stop the workers
+        """
+        for work_queue in self.__queues:
+            work_queue.put(None)
+        for thread in self.__threads:
+            thread.join()
+        self.__threads = []
+
+    def shard(self, key: str) -> int:
+        """
+        The worker that handles the messages with [key], the same every time the server runs
+        """
+        return zlib.crc32(key.encode()) % len(self.__queues)
+
+    def submit(self, key: str, function, *args):
+        """
+        Call [function](*args) on the worker for [key], after what was submitted for it before.  Waits while that
+        worker's queue is full.
+        """
+        work_queue = self.__queues[self.shard(key)]
+        try:
+            work_queue.put_nowait((function, args))
+        except queue.Full:
+            with self.__stats_lock:
+                self.__num_waits += 1
+            logging.info(
+                "Ingest worker {} has {} messages waiting, holding back".format(self.shard(key), self.__max_queued))
+            work_queue.put((function, args))
+
+        depth = work_queue.qsize()
+        with self.__stats_lock:
+            self.__max_depth = max(self.__max_depth, depth)
+
+    def wait_until_idle(self):
+        """
+        Wait for everything submitted to be handled
+        """
+        for work_queue in self.__queues:
+            work_queue.join()
+
+    def metrics(self) -> dict:
+        """
+        How many messages are waiting for each worker now, the most that have been waiting for one, how many have been
+        handled (and of those, failed), and how many times submit() had to wait
+        """
+        with self.__stats_lock:
+            return {
+                "queue_depths": [work_queue.qsize() for work_queue in self.__queues],
+                "max_queued": self.__max_queued,
+                "max_depth": self.__max_depth,
+                "handled": self.__num_handled,
+                "failed": self.__num_failed,
+                "waits": self.__num_waits,
+            }
+
+    def __worker_loop(self, work_queue: queue.Queue):
+        while True:
+            item = work_queue.get()
+            if item is None:
+                work_queue.task_done()
+                return
+            function, args = item
+            failed = False
+            try:
+                function(*args)
+            except Exception:
+                failed = True
+                logging.exception("Exception when handling a message")
+            with self.__stats_lock:
+                self.__num_handled += 1
+                if failed:
+                    self.__num_failed += 1
+            work_queue.task_done()
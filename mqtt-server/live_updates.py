@@ -0,0 +1,103 @@
+"""
+Pushes the samples the server receives to the dashboards that are open, as server-sent events (see /stream/ in
+server.py), so that they append them to their charts rather than polling for whole series.
+
+Publishing never waits for a dashboard: each has a queue of its own, and one that falls so far behind that its queue
+fills (a tablet that has gone to sleep, say) is sent a resync event instead of the samples it missed, and dropped.
+"""
+import logging
+import queue
+import threading
+
+
+# events waiting to be sent to a dashboard, beyond which it has fallen behind
+DEFAULT_MAX_QUEUED = 1000
+
+# how often a comment is sent while there is nothing else to, which stops proxies closing the connection and notices
+# dashboards that have gone away
+DEFAULT_KEEPALIVE_INTERVAL_S = 15.0
+
+# how long a dashboard's browser waits before connecting again if the connection drops
+RETRY_MS = 5000
+
+
+def format_event(event: str, data: str) -> str:
+    """
+    A server-sent event named [event], with [data] (which mustn't contain a newline, e.g. JSON from json.dumps())
+    """
+    return "event: {}\ndata: {}\n\n".format(event, data)
+
+
+class Subscription:
+    """
+    The events waiting to be sent to one dashboard
+    """
+
+    def __init__(self, max_queued: int):
+        self.queue = queue.Queue(max_queued)
+        self.overflowed = False
+
+    def offer(self, event: str):
+        if self.overflowed:
+            return
+        try:
+            self.queue.put_nowait(event)
+        except queue.Full:
+            self.overflowed = True
+
+
+class Broadcaster:
+    """
+    Hands each event published to every subscription, without blocking the publisher
+    """
+
+    def __init__(self, max_queued: int = DEFAULT_MAX_QUEUED,
+                 keepalive_interval_s: float = DEFAULT_KEEPALIVE_INTERVAL_S):
+        self.__max_queued = max_queued
+        self.__keepalive_interval_s = keepalive_interval_s
+        self.__subscriptions = set()
+        self.__lock = threading.Lock()
+
+    def subscribe(self) -> Subscription:
+        subscription = Subscription(self.__max_queued)
+        with self.__lock:
+            self.__subscriptions.add(subscription)
+        return subscription
+
+    def unsubscribe(self, subscription: Subscription):
+        with self.__lock:
+            self.__subscriptions.discard(subscription)
+
+    def num_subscribers(self) -> int:
+        with self.__lock:
+            return len(self.__subscriptions)
+
+    def publish(self, event: str, data: str):
+        """
+        Send [event] with [data] to every subscription.  Formatted once, however many there are.
+        """
+        text = format_event(event, data)
+        with self.__lock:
+            subscriptions = list(self.__subscriptions)
+        for subscription in subscriptions:
+            subscription.offer(text)
+
+    def events(self, subscription: Subscription):
+        """
+        The text of the stream of [subscription] (from subscribe()), to be returned as a text/event-stream response.
+        It is unsubscribed when the stream ends, or the response is closed because the dashboard went away.
+        """
+        try:
+            yield "retry: {}\n\n".format(RETRY_MS)
+            while True:
+                if subscription.overflowed:
+                    logging.info(
+                        "A dashboard fell behind, telling it to load its data again")
+                    yield format_event("resync", "{}")
+                    return
+                try:
+                    yield subscription.queue.get(timeout=self.__keepalive_interval_s)
+                except queue.Empty:
+                    yield ": keepalive\n\n"
+        finally:
+            self.unsubscribe(subscription)
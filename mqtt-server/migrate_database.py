@@ -0,0 +1,128 @@
+"""
+Moves the measurements of a database written by older versions of the server, which kept each value as its own row of
+the events table (a struct packed BLOB per topic), into the measurements table (a row per sample, see database.py).
+Stop the server first, then e.g.
+
+    python migrate_database.py databases/database.db
+
+The events table is dropped afterwards (unless --keep-events) and the file vacuumed, so take a copy of it first if it
+is the only one.  Running it again on a database that has been migrated does nothing.
+"""
+import argparse
+import logging
+import os
+import sqlite3
+import struct
+from datetime import datetime
+import database
+
+
+OLD_TIMESTAMP_FORMAT_STRING = "%Y-%m-%d %H:%M:%S"
+
+# how many events are read (and their samples written) at a time
+DEFAULT_CHUNK_SIZE = 10000
+
+
+def has_events_table(connection: sqlite3.Connection) -> bool:
+    return connection.execute(
+        "SELECT COUNT(*) FROM `sqlite_master` WHERE `type` == 'table' AND `name` == 'events'").fetchone()[0] > 0
+
+
+def event_to_value(data: bytes, format_string: str):
+    """
+    The value of an event, or None if it isn't a number (the old schema also stored strings and raw bytes)
+    """
+    if format_string not in ["f", "i"]:
+        return None
+    return struct.unpack(format_string, data)[0]
+
+
+def events_to_samples(events):
+    """
+    Group [events], each (topic, timestamp, data, format_string), into samples for Database.write_samples()
+    @returns the samples, and the number of events that couldn't be migrated
+    """
+    samples = {}
+    num_skipped = 0
+    for topic, timestamp_str, data, format_string in events:
+        sensor_name, series = database.split_series_topic(topic)
+        value = event_to_value(data, format_string)
+        if series is None or value is None:
+            num_skipped += 1
+            continue
+
+        # the old server stored the local time
+        timestamp = int(datetime.strptime(
+            timestamp_str, OLD_TIMESTAMP_FORMAT_STRING).timestamp())
+        samples.setdefault((sensor_name, timestamp), {})[series] = value
+    return [(sensor_name, timestamp, values) for (sensor_name, timestamp), values in samples.items()], num_skipped
+
+
+def migrate(db_path: str, keep_events: bool = False, chunk_size: int = DEFAULT_CHUNK_SIZE):
+    """
+    Move the events of the database at [db_path] into the measurements table
+    @returns the number of events migrated, and the number that couldn't be (which are dropped with the events table)
+    """
+    connection = sqlite3.connect(db_path)
+    if not has_events_table(connection):
+        connection.close()
+        logging.info("{} has no events table to migrate".format(db_path))
+        return 0, 0
+
+    # creates the measurements table alongside the events
+    db = database.Database()
+    if not db.open(db_path):
+        raise Exception("Couldn't open {}".format(db_path))
+
+    num_migrated = 0
+    num_skipped = 0
+    try:
+        cursor = connection.execute(
+            "SELECT `topic`, `timestamp`, `data`, `format_string` FROM `events` ORDER BY `id` ASC")
+        while True:
+            events = cursor.fetchmany(chunk_size)
+            if len(events) == 0:
+                break
+            samples, num_chunk_skipped = events_to_samples(events)
+            if not db.write_samples(samples):
+                raise Exception("Couldn't write the samples of events {} to {}".format(
+                    num_migrated + num_skipped, num_migrated + num_skipped + len(events)))
+            num_migrated += len(events) - num_chunk_skipped
+            num_skipped += num_chunk_skipped
+            logging.info("Migrated {} events".format(num_migrated))
+    finally:
+        db.close()
+
+    if not keep_events:
+        # the topics of the values that weren't migrated have nothing left to show
+        topics = [row[0] for row in connection.execute(
+            "SELECT `name` FROM `topics`").fetchall()]
+        connection.executemany("DELETE FROM `topics` WHERE `name` == ?",
+                               [(topic,) for topic in topics if database.split_series_topic(topic)[1] is None])
+        connection.execute("DROP TABLE `events`")
+        connection.commit()
+        connection.execute("VACUUM")
+    connection.close()
+    return num_migrated, num_skipped
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.INFO,
+                        format='%(asctime)s  %(levelname)s: %(message)s')
+
+    argparser = argparse.ArgumentParser()
+    argparser.add_argument("db_path", type=str,
+                           help="Path to the database file to migrate")
+    argparser.add_argument("--keep-events", action="store_true",
+                           help="Leave the events table in the database, rather than dropping it once migrated")
+    argparser.add_argument("--chunk-size", type=int, default=DEFAULT_CHUNK_SIZE,
+                           help="The number of events read at a time")
+    args = argparser.parse_args()
+
+    size_before = os.path.getsize(args.db_path)
+    num_migrated, num_skipped = migrate(
+        args.db_path, args.keep_events, args.chunk_size)
+    logging.info("Migrated {} values, {} that weren't sensor measurements were left out".format(
+        num_migrated, num_skipped))
+    logging.info("{} was {} bytes, and is now {} bytes".format(
+        args.db_path, size_before, os.path.getsize(args.db_path)))
@@ -1,6 +1,7 @@
 import paho.mqtt.client as mqtt
 import logging
 import threading
+import ingest_pool
 
 
 class MQTTRelay:
@@ -8,10 +9,15 @@ class MQTTRelay:
     def __init__(self, topic_filter='#',
                  mqtt_host="test.mosquitto.org",
                  mqt_host_port=1883,
-                 enable_logging=True):
+                 enable_logging=True,
+                 num_workers=ingest_pool.DEFAULT_NUM_WORKERS,
+                 max_queued=ingest_pool.DEFAULT_MAX_QUEUED,
+                 shard_key=None):
         """
         optionally set a topic filter as [topic_filter]
         by default subscribe to all messages ('#'), not recommended (https://www.hivemq.com/blog/mqtt-essentials-part-5-mqtt-topics-best-practices/)
+        The callbacks are run by [num_workers] threads (see ingest_pool.py), the messages of each topic (or each value
+        of [shard_key](topic), if given) by the same one, in order
         """
         super(MQTTRelay, self).__init__()
         
@@ -25,14 +31,20 @@ class MQTTRelay:
 
         self.__new_topic_callbacks = []
         self.__new_data_callbacks = []
+        self.__topic_callbacks = []
 
         self.__observed_topics = set()
 
+        self.__pool = ingest_pool.IngestPool(num_workers, max_queued)
+        self.__shard_key = shard_key if shard_key is not None else (lambda topic: topic)
+
     def get_observed_topics(self):
         self.__observed_topics
 
     def initialise(self):
 
+        self.start_workers()
+
         # connect to MQTT broker and subscribe to all messages
         self.__client = mqtt.Client("Server")
         self.__client.connect(self.__mqtt_host, port=self.__mqt_host_port)
@@ -42,6 +54,10 @@ class MQTTRelay:
             self.__client.enable_logger()
 
         self.__client.subscribe(self.__topic_filter)
+        for topic_filter, callback in self.__topic_callbacks:
+            self.__client.message_callback_add(
+                topic_filter, self.__make_topic_callback(callback))
+            self.__client.subscribe(topic_filter)
         self.__loop_thread = threading.Thread(
             target=self.__client.loop_forever)
         self.__loop_thread.start()
@@ -55,6 +71,32 @@ class MQTTRelay:
             self.__loop_thread.join()
             self.__loop_thread = None
         logging.info("MQTT thread stopped")
+        self.stop_workers()
+        logging.info("Ingest workers stopped")
+
+    def start_workers(self):
+        """
+        Start the threads that run the callbacks, done by initialise()
+        """
+        self.__pool.start()
+
+    def stop_workers(self):
+        """
+        Run the callbacks of what has been received, then stop the threads that run them, done by uninitialise()
+        """
+        self.__pool.stop()
+
+    def ingest_metrics(self) -> dict:
+        """
+        The depths of the queues of the threads running the callbacks, and what they have handled
+        """
+        return self.__pool.metrics()
+
+    def wait_until_idle(self):
+        """
+        Wait for the callbacks of every message received so far to have run
+        """
+        self.__pool.wait_until_idle()
 
     def register_new_data_callback(self, callback):
         self.__new_data_callbacks.append(callback)
@@ -62,17 +104,43 @@ class MQTTRelay:
     def register_new_topic_callback(self, callback):
         self.__new_topic_callbacks.append(callback)
 
+    def register_topic_callback(self, topic_filter, callback):
+        """
+        Subscribe to [topic_filter] in addition to the main topic filter, and call [callback](topic, payload) for each message on it.
+        Must be called before initialise()
+        """
+        self.__topic_callbacks.append((topic_filter, callback))
+
+    def publish(self, topic, payload, qos=0, retain=False):
+        """
+        Publish [payload] on [topic] using the relay's connection to the broker
+        """
+        return self.__client.publish(topic, payload, qos=qos, retain=retain)
+
+    def __make_topic_callback(self, callback):
+        def on_message(client, user_data, message):
+            self.__pool.submit(self.__shard_key(message.topic),
+                               callback, message.topic, message.payload)
+        return on_message
+
     def __on_message(self, client, user_data, message):
         logging.info("Message recieved. topic={}, qos={}, retain={}, length={}".format(
                      message.topic, message.qos, message.retain, len(message.payload)))
+        self.dispatch(message.topic, message.payload)
 
+    def dispatch(self, topic, payload):
+        """
+        Hand a message received on [topic] to the callbacks.  They are run by the workers, this waits only if the
+        worker for the topic has too many messages already.  Called by the MQTT client's thread, and by tests.
+        """
         init_num_topics = len(self.__observed_topics)
-        self.__observed_topics.add(message.topic)
+        self.__observed_topics.add(topic)
+        shard_key = self.__shard_key(topic)
 
         # if the number of observed topics just increased, notify that we got a new one
         if len(self.__observed_topics) > init_num_topics:
             for new_topic_callback in self.__new_topic_callbacks:
-                threading.Thread(target=new_topic_callback, args=(message.topic,)).start()
+                self.__pool.submit(shard_key, new_topic_callback, topic)
 
         for new_data_callback in self.__new_data_callbacks:
-            threading.Thread(target=new_data_callback, args=(message.topic, message.payload,)).start()
+            self.__pool.submit(shard_key, new_data_callback, topic, payload)
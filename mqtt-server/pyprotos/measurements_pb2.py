@@ -19,7 +19,7 @@ DESCRIPTOR = _descriptor.FileDescriptor(
   syntax='proto3',
   serialized_options=None,
   create_key=_descriptor._internal_create_key,
-  serialized_pb=b'\n\x12measurements.proto\x12\nttgo.proto\"\x87\x02\n\x0cMeasurements\x12\x12\n\nerror_code\x18\x01 \x01(\r\x12\x0b\n\x03lux\x18\x02 \x01(\x02\x12\x10\n\x08humidity\x18\x03 \x01(\x02\x12\x15\n\rtemperature_C\x18\x04 \x01(\x02\x12\x0c\n\x04soil\x18\x05 \x01(\x02\x12\x0c\n\x04salt\x18\x06 \x01(\x02\x12\x12\n\nbattery_mV\x18\x07 \x01(\x02\x12\x11\n\ttimestamp\x18\x08 \x01(\r\x12\x18\n\x10\x66w_version_major\x18\t \x01(\r\x12\x18\n\x10\x66w_version_minor\x18\n \x01(\r\x12\x18\n\x10\x66w_version_patch\x18\x0b \x01(\r\x12\x1c\n\x14num_dht_failed_reads\x18\x0c \x01(\rb\x06proto3'
+  serialized_pb=b'\n\x12measurements.proto\x12\nttgo.proto\"\xe9\x04\n\x0cMeasurements\x12\x12\n\nerror_code\x18\x01 \x01(\r\x12\x0b\n\x03lux\x18\x02 \x01(\x02\x12\x10\n\x08humidity\x18\x03 \x01(\x02\x12\x15\n\rtemperature_C\x18\x04 \x01(\x02\x12\x0c\n\x04soil\x18\x05 \x01(\x02\x12\x0c\n\x04salt\x18\x06 \x01(\x02\x12\x12\n\nbattery_mV\x18\x07 \x01(\x02\x12\x11\n\ttimestamp\x18\x08 \x01(\r\x12\x18\n\x10\x66w_version_major\x18\t \x01(\r\x12\x18\n\x10\x66w_version_minor\x18\n \x01(\r\x12\x18\n\x10\x66w_version_patch\x18\x0b \x01(\r\x12\x1c\n\x14num_dht_failed_reads\x18\x0c \x01(\r\x12\x12\n\nfield_mask\x18\r \x01(\r\x12\x19\n\x11\x62h1750_i2c_errors\x18\x0e \x01(\r\x12\x1a\n\x12i2c_bus_recoveries\x18\x0f \x01(\r\x12\x15\n\rtransmit_slot\x18\x10 \x01(\r\x12\x1a\n\x12num_transmit_slots\x18\x11 \x01(\r\x12\x16\n\x0e\x62\x61tch_period_s\x18\x12 \x01(\r\x12\x18\n\x10tls_handshake_ms\x18\x13 \x01(\r\x12\x13\n\x0btls_resumed\x18\x14 \x01(\x08\x12\x18\n\x10heap_allocations\x18\x15 \x01(\r\x12\x1b\n\x13heap_min_free_bytes\x18\x16 \x01(\r\x12\x1f\n\x17heap_largest_free_block\x18\x17 \x01(\r\x12\x16\n\x0e\x63onfig_version\x18\x18 \x01(\r\x12\x10\n\x08sequence\x18\x19 \x01(\r\x12\x19\n\x11previous_sequence\x18\x1a \x01(\r\"R\n\tAggregate\x12\r\n\x05\x63ount\x18\x01 \x01(\r\x12\x0b\n\x03min\x18\x02 \x01(\x02\x12\x0b\n\x03max\x18\x03 \x01(\x02\x12\x0c\n\x04mean\x18\x04 \x01(\x02\x12\x0e\n\x06stddev\x18\x05 \x01(\x02\"\xa7\x01\n\x10WindowAggregates\x12\x11\n\ttimestamp\x18\x01 \x01(\r\x12\x12\n\nduration_s\x18\x02 \x01(\r\x12\"\n\x03lux\x18\x03 \x01(\x0b\x32\x15.ttgo.proto.Aggregate\x12#\n\x04soil\x18\x04 \x01(\x0b\x32\x15.ttgo.proto.Aggregate\x12#\n\x04salt\x18\x05 \x01(\x0b\x32\x15.ttgo.proto.Aggregate\"\xab\x01\n\x0cRemoteConfig\x12\x0f\n\x07version\x18\x01 \x01(\r\x12#\n\x1btime_between_measurements_s\x18\x02 \x01(\r\x12\"\n\x1anum_measurements_per_batch\x18\x03 \x01(\r\x12\x1d\n\x15max_num_mqtt_attempts\x18\x04 \x01(\r\x12\"\n\x1atime_between_rtc_updates_s\x18\x05 \x01(\rb\x06proto3'
 )
 
 
@@ -117,6 +117,104 @@ _MEASUREMENTS = _descriptor.Descriptor(
       message_type=None, enum_type=None, containing_type=None,
       is_extension=False, extension_scope=None,
       serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='field_mask', full_name='ttgo.proto.Measurements.field_mask', index=12,
+      number=13, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='bh1750_i2c_errors', full_name='ttgo.proto.Measurements.bh1750_i2c_errors', index=13,
+      number=14, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='i2c_bus_recoveries', full_name='ttgo.proto.Measurements.i2c_bus_recoveries', index=14,
+      number=15, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='transmit_slot', full_name='ttgo.proto.Measurements.transmit_slot', index=15,
+      number=16, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='num_transmit_slots', full_name='ttgo.proto.Measurements.num_transmit_slots', index=16,
+      number=17, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='batch_period_s', full_name='ttgo.proto.Measurements.batch_period_s', index=17,
+      number=18, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='tls_handshake_ms', full_name='ttgo.proto.Measurements.tls_handshake_ms', index=18,
+      number=19, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='tls_resumed', full_name='ttgo.proto.Measurements.tls_resumed', index=19,
+      number=20, type=8, cpp_type=7, label=1,
+      has_default_value=False, default_value=False,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='heap_allocations', full_name='ttgo.proto.Measurements.heap_allocations', index=20,
+      number=21, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='heap_min_free_bytes', full_name='ttgo.proto.Measurements.heap_min_free_bytes', index=21,
+      number=22, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='heap_largest_free_block', full_name='ttgo.proto.Measurements.heap_largest_free_block', index=22,
+      number=23, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='config_version', full_name='ttgo.proto.Measurements.config_version', index=23,
+      number=24, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='sequence', full_name='ttgo.proto.Measurements.sequence', index=24,
+      number=25, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='previous_sequence', full_name='ttgo.proto.Measurements.previous_sequence', index=25,
+      number=26, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
   ],
   extensions=[
   ],
@@ -130,10 +228,193 @@ _MEASUREMENTS = _descriptor.Descriptor(
   oneofs=[
   ],
   serialized_start=35,
-  serialized_end=298,
+  serialized_end=652,
+)
+
+_AGGREGATE = _descriptor.Descriptor(
+  name='Aggregate',
+  full_name='ttgo.proto.Aggregate',
+  filename=None,
+  file=DESCRIPTOR,
+  containing_type=None,
+  create_key=_descriptor._internal_create_key,
+  fields=[
+    _descriptor.FieldDescriptor(
+      name='count', full_name='ttgo.proto.Aggregate.count', index=0,
+      number=1, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='min', full_name='ttgo.proto.Aggregate.min', index=1,
+      number=2, type=2, cpp_type=6, label=1,
+      has_default_value=False, default_value=float(0),
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='max', full_name='ttgo.proto.Aggregate.max', index=2,
+      number=3, type=2, cpp_type=6, label=1,
+      has_default_value=False, default_value=float(0),
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='mean', full_name='ttgo.proto.Aggregate.mean', index=3,
+      number=4, type=2, cpp_type=6, label=1,
+      has_default_value=False, default_value=float(0),
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='stddev', full_name='ttgo.proto.Aggregate.stddev', index=4,
+      number=5, type=2, cpp_type=6, label=1,
+      has_default_value=False, default_value=float(0),
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+  ],
+  extensions=[
+  ],
+  nested_types=[],
+  enum_types=[
+  ],
+  serialized_options=None,
+  is_extendable=False,
+  syntax='proto3',
+  extension_ranges=[],
+  oneofs=[
+  ],
+  serialized_start=654,
+  serialized_end=736,
+)
+
+_WINDOWAGGREGATES = _descriptor.Descriptor(
+  name='WindowAggregates',
+  full_name='ttgo.proto.WindowAggregates',
+  filename=None,
+  file=DESCRIPTOR,
+  containing_type=None,
+  create_key=_descriptor._internal_create_key,
+  fields=[
+    _descriptor.FieldDescriptor(
+      name='timestamp', full_name='ttgo.proto.WindowAggregates.timestamp', index=0,
+      number=1, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='duration_s', full_name='ttgo.proto.WindowAggregates.duration_s', index=1,
+      number=2, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='lux', full_name='ttgo.proto.WindowAggregates.lux', index=2,
+      number=3, type=11, cpp_type=10, label=1,
+      has_default_value=False, default_value=None,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='soil', full_name='ttgo.proto.WindowAggregates.soil', index=3,
+      number=4, type=11, cpp_type=10, label=1,
+      has_default_value=False, default_value=None,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='salt', full_name='ttgo.proto.WindowAggregates.salt', index=4,
+      number=5, type=11, cpp_type=10, label=1,
+      has_default_value=False, default_value=None,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+  ],
+  extensions=[
+  ],
+  nested_types=[],
+  enum_types=[
+  ],
+  serialized_options=None,
+  is_extendable=False,
+  syntax='proto3',
+  extension_ranges=[],
+  oneofs=[
+  ],
+  serialized_start=739,
+  serialized_end=906,
 )
 
+_REMOTECONFIG = _descriptor.Descriptor(
+  name='RemoteConfig',
+  full_name='ttgo.proto.RemoteConfig',
+  filename=None,
+  file=DESCRIPTOR,
+  containing_type=None,
+  create_key=_descriptor._internal_create_key,
+  fields=[
+    _descriptor.FieldDescriptor(
+      name='version', full_name='ttgo.proto.RemoteConfig.version', index=0,
+      number=1, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='time_between_measurements_s', full_name='ttgo.proto.RemoteConfig.time_between_measurements_s', index=1,
+      number=2, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='num_measurements_per_batch', full_name='ttgo.proto.RemoteConfig.num_measurements_per_batch', index=2,
+      number=3, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='max_num_mqtt_attempts', full_name='ttgo.proto.RemoteConfig.max_num_mqtt_attempts', index=3,
+      number=4, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+    _descriptor.FieldDescriptor(
+      name='time_between_rtc_updates_s', full_name='ttgo.proto.RemoteConfig.time_between_rtc_updates_s', index=4,
+      number=5, type=13, cpp_type=3, label=1,
+      has_default_value=False, default_value=0,
+      message_type=None, enum_type=None, containing_type=None,
+      is_extension=False, extension_scope=None,
+      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
+  ],
+  extensions=[
+  ],
+  nested_types=[],
+  enum_types=[
+  ],
+  serialized_options=None,
+  is_extendable=False,
+  syntax='proto3',
+  extension_ranges=[],
+  oneofs=[
+  ],
+  serialized_start=909,
+  serialized_end=1080,
+)
+
+_WINDOWAGGREGATES.fields_by_name['lux'].message_type = _AGGREGATE
+_WINDOWAGGREGATES.fields_by_name['soil'].message_type = _AGGREGATE
+_WINDOWAGGREGATES.fields_by_name['salt'].message_type = _AGGREGATE
 DESCRIPTOR.message_types_by_name['Measurements'] = _MEASUREMENTS
+DESCRIPTOR.message_types_by_name['Aggregate'] = _AGGREGATE
+DESCRIPTOR.message_types_by_name['WindowAggregates'] = _WINDOWAGGREGATES
+DESCRIPTOR.message_types_by_name['RemoteConfig'] = _REMOTECONFIG
 _sym_db.RegisterFileDescriptor(DESCRIPTOR)
 
 Measurements = _reflection.GeneratedProtocolMessageType('Measurements', (_message.Message,), {
@@ -143,5 +424,26 @@ Measurements = _reflection.GeneratedProtocolMessageType('Measurements', (_messag
   })
 _sym_db.RegisterMessage(Measurements)
 
+Aggregate = _reflection.GeneratedProtocolMessageType('Aggregate', (_message.Message,), {
+  'DESCRIPTOR' : _AGGREGATE,
+  '__module__' : 'measurements_pb2'
+  # @@protoc_insertion_point(class_scope:ttgo.proto.Aggregate)
+  })
+_sym_db.RegisterMessage(Aggregate)
+
+WindowAggregates = _reflection.GeneratedProtocolMessageType('WindowAggregates', (_message.Message,), {
+  'DESCRIPTOR' : _WINDOWAGGREGATES,
+  '__module__' : 'measurements_pb2'
+  # @@protoc_insertion_point(class_scope:ttgo.proto.WindowAggregates)
+  })
+_sym_db.RegisterMessage(WindowAggregates)
+
+RemoteConfig = _reflection.GeneratedProtocolMessageType('RemoteConfig', (_message.Message,), {
+  'DESCRIPTOR' : _REMOTECONFIG,
+  '__module__' : 'measurements_pb2'
+  # @@protoc_insertion_point(class_scope:ttgo.proto.RemoteConfig)
+  })
+_sym_db.RegisterMessage(RemoteConfig)
+
 
 # @@protoc_insertion_point(module_scope)
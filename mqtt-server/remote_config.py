@@ -0,0 +1,143 @@
+"""
+Runtime configuration of the devices.  A RemoteConfig is published (retained) on sensors/<sensor_name>/config, and
+each device applies it when it next connects to the broker, then reports the version it is running with in
+Measurements.config_version.  Publishing to only some of the sensors tries settings out on a few nodes first.
+"""
+import argparse
+import logging
+import threading
+
+import paho.mqtt.client as mqtt
+
+from pyprotos.measurements_pb2 import RemoteConfig
+
+
+CONFIG_SUBTOPIC = "config"
+DEFAULT_MQTT_BROKER = "localhost"
+
+# the settings and the ranges the firmware accepts (see applyRemoteConfig() in src/device_config.cpp).
+# A config with any setting out of range is rejected by the device as a whole.
+LIMITS = {
+    "time_between_measurements_s": (10, 24 * 60 * 60),
+    "num_measurements_per_batch": (1, 10),
+    "max_num_mqtt_attempts": (1, 20),
+    "time_between_rtc_updates_s": (60, 7 * 24 * 60 * 60),
+}
+
+
+def is_config_topic(topic: str) -> bool:
+    """
+    Returns true if [topic] carries a device's config (sensors/<sensor_name>/config)
+    """
+    return topic.split("/")[-1] == CONFIG_SUBTOPIC
+
+
+def config_topic(sensor_name: str) -> str:
+    return "sensors/{}/{}".format(sensor_name, CONFIG_SUBTOPIC)
+
+
+def make_config(version: int, **settings) -> RemoteConfig:
+    """
+    Make a config of [version] (which must differ from the last one the devices applied) changing [settings], the
+    others keep the value they have on the device.  Raises ValueError if anything is out of range.
+    """
+    if version <= 0:
+        raise ValueError("version must be positive")
+    config = RemoteConfig(version=version)
+    for name, value in settings.items():
+        if value is None:
+            continue
+        if name not in LIMITS:
+            raise ValueError("unknown setting {}".format(name))
+        low, high = LIMITS[name]
+        if not low <= value <= high:
+            raise ValueError("{} must be between {} and {}".format(name, low, high))
+        setattr(config, name, value)
+    return config
+
+
+def parse_config(data: bytes) -> RemoteConfig:
+    try:
+        config = RemoteConfig()
+        config.ParseFromString(data)
+        return config
+    except Exception as e:
+        logging.error("Error parsing remote config protobuf: {}".format(e))
+        return None
+
+
+class ConfigTracker:
+    """
+    Keeps track of the config version published for each sensor, and the version each one reports it is running with
+    """
+
+    def __init__(self) -> None:
+        self.__lock = threading.Lock()
+        self.__published = {}
+        self.__applied = {}
+
+    def observe_published(self, sensor_name: str, config: RemoteConfig):
+        with self.__lock:
+            if config is None or config.version == 0:
+                self.__published.pop(sensor_name, None)
+            else:
+                self.__published[sensor_name] = config
+
+    def observe_applied(self, sensor_name: str, version: int):
+        with self.__lock:
+            self.__applied[sensor_name] = version
+
+    def status(self) -> dict:
+        """
+        The published and applied config version of every sensor, and whether the sensor has picked up its config
+        """
+        with self.__lock:
+            status = {}
+            for sensor_name in sorted(set(self.__published) | set(self.__applied)):
+                published = self.__published.get(sensor_name)
+                applied = self.__applied.get(sensor_name)
+                status[sensor_name] = {
+                    "published_version": published.version if published is not None else None,
+                    "applied_version": applied,
+                    "up_to_date": published is None or published.version == applied,
+                }
+            return status
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.INFO,
+                        format='%(asctime)s  %(levelname)s: %(message)s')
+
+    argparser = argparse.ArgumentParser(
+        description="Publish a config for sensors to apply when they next connect")
+    argparser.add_argument("sensor_names", nargs="+",
+                           help="The sensors to configure")
+    argparser.add_argument("--broker", dest="mqtt_broker",
+                           help="The MQTT broker URI", type=str, default=DEFAULT_MQTT_BROKER)
+    argparser.add_argument("--version", type=int,
+                           help="The version of the config, reported back by the sensors once they have applied it")
+    argparser.add_argument("--clear", action="store_true",
+                           help="Remove the published config, the sensors keep the settings they have")
+    for name in LIMITS:
+        argparser.add_argument("--" + name.replace("_", "-"), dest=name, type=int,
+                               help="between {} and {}".format(*LIMITS[name]))
+    args = argparser.parse_args()
+
+    if args.clear:
+        payload = b""
+    else:
+        if args.version is None:
+            argparser.error("--version is required")
+        try:
+            payload = make_config(args.version, **{name: getattr(args, name) for name in LIMITS}).SerializeToString()
+        except ValueError as e:
+            argparser.error(str(e))
+
+    client = mqtt.Client("RemoteConfig")
+    client.connect(args.mqtt_broker)
+    client.loop_start()
+    for sensor_name in args.sensor_names:
+        client.publish(config_topic(sensor_name), payload, qos=1, retain=True).wait_for_publish()
+        logging.info("Published config for {}".format(sensor_name))
+    client.loop_stop()
+    client.disconnect()
@@ -0,0 +1,259 @@
+"""
+Hourly and daily rollups of every series of every sensor: the count, sum, min, max and last value in each hour and day
+(UTC), kept up to date as samples are written (see Database.write_samples()), so that charts over months don't have to
+read every sample.  To rebuild them from the samples, stop the server and run
+
+    python rollups.py databases/database.db
+
+Compressed devices (see field_mask) only send the values that the line joining them doesn't pass close enough to, so
+a plain mean of what is stored would lean towards wherever the series changed.  Each bucket also keeps the integral
+of that line over the part of the bucket it covers, and its mean is the integral over the time covered.
+"""
+import argparse
+import logging
+
+
+# (name, length in seconds), finest first
+RESOLUTIONS = [("hour", 60 * 60), ("day", 24 * 60 * 60)]
+
+# values of a series further apart than this are a gap (e.g. the device was off) rather than joined by a line.
+# compressed devices send every field at least once an hour by default (keyframes)
+MAX_INTERPOLATION_S = 2 * 60 * 60
+
+
+def table_name(resolution: str) -> str:
+    return "rollups_{}".format(resolution)
+
+
+def bucket_start(timestamp: int, length_s: int) -> int:
+    return timestamp - timestamp % length_s
+
+
+def create_tables(cursor):
+    """
+    Create the rollup tables if they don't exist, or replace them if they were made before the means were weighted
+    by time
+    @returns True if they didn't exist or were replaced, and so need to be built
+    """
+    cursor.execute("PRAGMA table_info(`{}`)".format(table_name(RESOLUTIONS[0][0])))
+    columns = [row[1] for row in cursor.fetchall()]
+    created = "integral" not in columns
+    if created and len(columns) > 0:
+        for resolution, _ in RESOLUTIONS:
+            cursor.execute("DROP TABLE IF EXISTS `{}`".format(table_name(resolution)))
+    for resolution, _ in RESOLUTIONS:
+        # a row per bucket of each series of each sensor, read by range scans like the measurements.
+        # count is the number of values stored, which is what reading the bucket raw returns
+        cursor.execute(
+            "CREATE TABLE IF NOT EXISTS {}("
+            "sensor_id INTEGER NOT NULL REFERENCES sensors(id),"
+            "series TEXT NOT NULL,"
+            "start INTEGER NOT NULL,"
+            "count INTEGER NOT NULL,"
+            "sum REAL NOT NULL,"
+            "min REAL NOT NULL,"
+            "max REAL NOT NULL,"
+            "last REAL NOT NULL,"
+            "last_timestamp INTEGER NOT NULL,"
+            "integral REAL NOT NULL DEFAULT 0,"
+            "duration REAL NOT NULL DEFAULT 0,"
+            "PRIMARY KEY (sensor_id, series, start)"
+            ") WITHOUT ROWID;".format(table_name(resolution)))
+    return created
+
+
+class RollupChanges:
+    """
+    What a batch of samples changes in the rollups.  Values that are new are folded into their buckets, but a value
+    that replaces one already stored can't be taken back out of a min or max, so its buckets are recomputed instead.
+    The line joining the values changes within MAX_INTERPOLATION_S of either, so its integral is recomputed in every
+    bucket that overlaps that.
+    """
+
+    def __init__(self):
+        # resolution to (sensor_id, series, start) to [count, sum, min, max, last, last_timestamp]
+        self.additions = {resolution: {} for resolution, _ in RESOLUTIONS}
+        # resolution to set of (sensor_id, series, start)
+        self.recomputes = {resolution: set() for resolution, _ in RESOLUTIONS}
+        # resolution to set of (sensor_id, series, start)
+        self.lines = {resolution: set() for resolution, _ in RESOLUTIONS}
+
+    def add(self, sensor_id: int, series: str, timestamp: int, value: float):
+        self.__change_line(sensor_id, series, timestamp)
+        for resolution, length_s in RESOLUTIONS:
+            key = (sensor_id, series, bucket_start(timestamp, length_s))
+            bucket = self.additions[resolution].get(key)
+            if bucket is None:
+                self.additions[resolution][key] = [
+                    1, value, value, value, value, timestamp]
+                continue
+            bucket[0] += 1
+            bucket[1] += value
+            bucket[2] = min(bucket[2], value)
+            bucket[3] = max(bucket[3], value)
+            if timestamp >= bucket[5]:
+                bucket[4] = value
+                bucket[5] = timestamp
+
+    def replace(self, sensor_id: int, series: str, timestamp: int):
+        self.__change_line(sensor_id, series, timestamp)
+        for resolution, length_s in RESOLUTIONS:
+            self.recomputes[resolution].add(
+                (sensor_id, series, bucket_start(timestamp, length_s)))
+
+    def __change_line(self, sensor_id: int, series: str, timestamp: int):
+        for resolution, length_s in RESOLUTIONS:
+            start = bucket_start(timestamp - MAX_INTERPOLATION_S, length_s)
+            while start <= timestamp + MAX_INTERPOLATION_S:
+                self.lines[resolution].add((sensor_id, series, start))
+                start += length_s
+
+    def is_empty(self) -> bool:
+        return not any(self.additions.values()) and not any(self.recomputes.values())
+
+
+def apply(cursor, changes: RollupChanges):
+    """
+    Update the rollups with [changes], after the samples they came from have been written (in the same transaction)
+    """
+    for resolution, length_s in RESOLUTIONS:
+        table = table_name(resolution)
+        cursor.executemany(
+            "INSERT INTO `{}` (`sensor_id`, `series`, `start`, `count`, `sum`, `min`, `max`, `last`, `last_timestamp`) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?) "
+            "ON CONFLICT (`sensor_id`, `series`, `start`) DO UPDATE SET "
+            "`count` = `count` + excluded.`count`, "
+            "`sum` = `sum` + excluded.`sum`, "
+            "`min` = MIN(`min`, excluded.`min`), "
+            "`max` = MAX(`max`, excluded.`max`), "
+            "`last` = CASE WHEN excluded.`last_timestamp` >= `last_timestamp` THEN excluded.`last` ELSE `last` END, "
+            "`last_timestamp` = MAX(`last_timestamp`, excluded.`last_timestamp`);".format(table),
+            [key + tuple(bucket) for key, bucket in changes.additions[resolution].items()])
+
+        for sensor_id, series, start in changes.recomputes[resolution]:
+            cursor.execute("DELETE FROM `{}` WHERE `sensor_id` == ? AND `series` == ? AND `start` == ?".format(table),
+                           (sensor_id, series, start))
+            cursor.execute(_rollup_select_sql(table, series, length_s) + " AND `sensor_id` == ? AND `timestamp` >= ? "
+                           "AND `timestamp` < ? GROUP BY `sensor_id`, `bucket`) AS `buckets`",
+                           (sensor_id, start, start + length_s))
+
+        # only the buckets that have values are kept, so one the line crosses without a value is left out
+        updates = []
+        for sensor_id, series, start in changes.lines[resolution]:
+            cursor.execute("SELECT `timestamp`, `{0}` FROM `measurements` WHERE `sensor_id` == ? "
+                           "AND `timestamp` >= ? AND `timestamp` < ? AND `{0}` IS NOT NULL "
+                           "ORDER BY `timestamp` ASC".format(series),
+                           (sensor_id, start - MAX_INTERPOLATION_S, start + length_s + MAX_INTERPOLATION_S))
+            integral, duration = line_integrals(cursor.fetchall(), length_s).get(start, (0.0, 0.0))
+            updates.append((integral, duration, sensor_id, series, start))
+        cursor.executemany("UPDATE `{}` SET `integral` = ?, `duration` = ? WHERE `sensor_id` == ? AND `series` == ? "
+                           "AND `start` == ?".format(table), updates)
+
+
+def rebuild(cursor, series_list, sensor_id=None):
+    """
+    Recompute the rollups of [series_list] from the samples, of every sensor or just [sensor_id]
+    """
+    for resolution, length_s in RESOLUTIONS:
+        table = table_name(resolution)
+        if sensor_id is None:
+            cursor.execute("DELETE FROM `{}`".format(table))
+        else:
+            cursor.execute("DELETE FROM `{}` WHERE `sensor_id` == ?".format(table), (sensor_id,))
+        for series in series_list:
+            sql = _rollup_select_sql(table, series, length_s)
+            if sensor_id is None:
+                cursor.execute(sql + " GROUP BY `sensor_id`, `bucket`) AS `buckets`")
+            else:
+                cursor.execute(sql + " AND `sensor_id` == ? GROUP BY `sensor_id`, `bucket`) AS `buckets`",
+                               (sensor_id,))
+
+    if sensor_id is None:
+        cursor.execute("SELECT DISTINCT `sensor_id` FROM `measurements`")
+        sensor_ids = [row[0] for row in cursor.fetchall()]
+    else:
+        sensor_ids = [sensor_id]
+    for series in series_list:
+        for line_sensor_id in sensor_ids:
+            cursor.execute("SELECT `timestamp`, `{0}` FROM `measurements` WHERE `sensor_id` == ? AND `{0}` IS NOT NULL "
+                           "ORDER BY `timestamp` ASC".format(series), (line_sensor_id,))
+            points = cursor.fetchall()
+            for resolution, length_s in RESOLUTIONS:
+                cursor.executemany("UPDATE `{}` SET `integral` = ?, `duration` = ? WHERE `sensor_id` == ? "
+                                   "AND `series` == ? AND `start` == ?".format(table_name(resolution)),
+                                   [(integral, duration, line_sensor_id, series, start)
+                                    for start, (integral, duration) in line_integrals(points, length_s).items()])
+
+
+def line_integrals(points, length_s: int) -> dict:
+    """
+    The integral of the line joining [points] in each bucket, leaving out the stretches longer than
+    MAX_INTERPOLATION_S
+    @param points (timestamp, value) in order of time
+    @returns bucket start to (integral in value seconds, seconds of the bucket covered)
+    """
+    buckets = {}
+    for (time0, value0), (time1, value1) in zip(points, points[1:]):
+        if time1 - time0 > MAX_INTERPOLATION_S:
+            continue
+        slope = (value1 - value0) / (time1 - time0)
+        start = time0
+        while start < time1:
+            end = min(bucket_start(start, length_s) + length_s, time1)
+            value_start = value0 + slope * (start - time0)
+            value_end = value0 + slope * (end - time0)
+            bucket = buckets.setdefault(bucket_start(start, length_s), [0.0, 0.0])
+            bucket[0] += (value_start + value_end) / 2 * (end - start)
+            bucket[1] += end - start
+            start = end
+    return {start: tuple(bucket) for start, bucket in buckets.items()}
+
+
+def _rollup_select_sql(table: str, series: str, length_s: int) -> str:
+    """
+    The start of an INSERT of the buckets of [series] from the samples, to be finished with more conditions on the
+    samples and the GROUP BY.  [series] is one of the columns of the measurements table, so safe to put in the query.
+    """
+    return "INSERT INTO `{0}` (`sensor_id`, `series`, `start`, `count`, `sum`, `min`, `max`, `last`, `last_timestamp`) " \
+        "SELECT `buckets`.`sensor_id`, '{1}', `buckets`.`bucket`, `buckets`.`count`, `buckets`.`sum`, " \
+        "`buckets`.`min`, `buckets`.`max`, " \
+        "(SELECT `{1}` FROM `measurements` WHERE `sensor_id` == `buckets`.`sensor_id` " \
+        "AND `timestamp` == `buckets`.`last_timestamp`), `buckets`.`last_timestamp` " \
+        "FROM (SELECT `sensor_id`, `timestamp` - `timestamp` % {2} AS `bucket`, COUNT(`{1}`) AS `count`, " \
+        "SUM(`{1}`) AS `sum`, MIN(`{1}`) AS `min`, MAX(`{1}`) AS `max`, MAX(`timestamp`) AS `last_timestamp` " \
+        "FROM `measurements` WHERE `{1}` IS NOT NULL".format(table, series, length_s)
+
+
+def choose_resolution(num_samples: int, num_buckets: dict, max_points: int) -> str:
+    """
+    The finest resolution that returns no more than [max_points] points, "raw" for the samples themselves
+    @param num_samples the number of samples in the range
+    @param num_buckets resolution to the number of buckets (that have samples) in the range
+    """
+    if num_samples <= max_points:
+        return "raw"
+    for resolution, _ in RESOLUTIONS:
+        if num_buckets[resolution] <= max_points:
+            return resolution
+    return RESOLUTIONS[-1][0]
+
+
+if __name__ == "__main__":
+    import database
+
+    logging.basicConfig(level=logging.INFO,
+                        format='%(asctime)s  %(levelname)s: %(message)s')
+
+    argparser = argparse.ArgumentParser()
+    argparser.add_argument("db_path", type=str,
+                           help="Path to the database file to rebuild the rollups of")
+    args = argparser.parse_args()
+
+    db = database.Database()
+    if not db.open(args.db_path):
+        raise SystemExit(1)
+    succeeded = db.rebuild_rollups()
+    db.close()
+    if succeeded:
+        logging.info("Rebuilt the rollups of {}".format(args.db_path))
+    raise SystemExit(0 if succeeded else 1)
@@ -0,0 +1,123 @@
+"""
+Keeps track of which samples of each sensor have arrived, from the sequence numbers the devices give their samples.
+
+Each message covers its own sequence number and, when the device knows it, every number since the message it recorded
+before (previous_sequence), because the samples in between were compressed away rather than lost.  What isn't covered
+between the lowest and highest number seen is a gap.  A message with previous_sequence 0 follows a restart of the
+device, which skips the numbers it had reserved but not used, so the gap before one is reported separately.  A message
+whose previous_sequence is its own number carries more fields of a sample already sent (held back by the compression
+until the next sample showed they were needed), so it is neither new nor a redelivery.
+
+A message whose number has already been covered is a redelivery if it is no newer than the newest message of the
+sensor.  Otherwise the device has started its numbering again (e.g. it lost what it had stored in NVS), and the
+numbers are tracked afresh from it.
+"""
+import threading
+
+
+# the most stretches of received samples kept for each sensor, past which the oldest gaps are forgotten
+MAX_INTERVALS = 1000
+
+
+class SensorSequences:
+    def __init__(self) -> None:
+        # sorted, disjoint and not adjacent [lowest, highest, after_restart] of the sequence numbers covered
+        self.intervals = []
+        self.received = 0
+        self.duplicates = 0
+        # the newest timestamp of the messages, and how many times the numbering has started again
+        self.newest_timestamp = 0
+        self.epochs = 1
+
+
+class SequenceTracker:
+
+    def __init__(self, max_intervals: int = MAX_INTERVALS) -> None:
+        self.__lock = threading.Lock()
+        self.__sensors = {}
+        self.__max_intervals = max_intervals
+
+    def observe(self, sensor_name: str, sequence: int, previous_sequence: int, timestamp: int) -> bool:
+        """
+        Record a message from [sensor_name], of a sample taken at epoch [timestamp]
+        @returns False if the message has been seen before (a redelivery), True otherwise
+        """
+        if sequence == 0:
+            # older firmware
+            return True
+        if previous_sequence == sequence:
+            # the rest of a sample, which is stored with the fields already sent (where a redelivery changes nothing)
+            return True
+
+        known_previous = 0 < previous_sequence < sequence
+        lowest = previous_sequence + 1 if known_previous else sequence
+        with self.__lock:
+            sensor = self.__sensors.setdefault(sensor_name, SensorSequences())
+            intervals = sensor.intervals
+
+            # the intervals that overlap or touch [lowest, sequence] are intervals[first:last]
+            first = len(intervals)
+            while first > 0 and intervals[first - 1][1] >= lowest - 1:
+                first -= 1
+            last = first
+            while last < len(intervals) and intervals[last][0] <= sequence + 1:
+                last += 1
+
+            merging = intervals[first:last]
+            if any(low <= sequence <= high for low, high, _ in merging):
+                if timestamp <= sensor.newest_timestamp:
+                    sensor.duplicates += 1
+                    return False
+                # a number used again for a new sample, so the device has started its numbering again
+                intervals.clear()
+                first = last = 0
+                merging = []
+                sensor.epochs += 1
+            sensor.received += 1
+            sensor.newest_timestamp = max(sensor.newest_timestamp, timestamp)
+
+            merged = [lowest, sequence, not known_previous]
+            for low, high, after_restart in merging:
+                if low < merged[0]:
+                    merged[0], merged[2] = low, after_restart
+                elif low == merged[0]:
+                    merged[2] = merged[2] and after_restart
+                merged[1] = max(merged[1], high)
+            intervals[first:last] = [merged]
+
+            if len(intervals) > self.__max_intervals:
+                # forget the oldest gap
+                intervals[1][0], intervals[1][2] = intervals[0][0], intervals[0][2]
+                del intervals[0]
+            return True
+
+    def gaps(self) -> dict:
+        """
+        The sequence numbers each sensor has sent (since it last started its numbering again), and the gaps in them:
+        "missing" counts the samples lost, and "after_restart" the numbers skipped by a restart of the device (which
+        may not have been used)
+        """
+        with self.__lock:
+            status = {}
+            for sensor_name in sorted(self.__sensors):
+                sensor = self.__sensors[sensor_name]
+                intervals = sensor.intervals
+                gaps = []
+                for (_, previous_high, _), (low, _, after_restart) in zip(intervals, intervals[1:]):
+                    gaps.append({
+                        "from": previous_high + 1,
+                        "to": low - 1,
+                        "count": low - previous_high - 1,
+                        "after_restart": after_restart,
+                    })
+                status[sensor_name] = {
+                    "lowest": intervals[0][0],
+                    "highest": intervals[-1][1],
+                    "received": sensor.received,
+                    "duplicates": sensor.duplicates,
+                    "epochs": sensor.epochs,
+                    "missing": sum(gap["count"] for gap in gaps if not gap["after_restart"]),
+                    "after_restart": sum(gap["count"] for gap in gaps if gap["after_restart"]),
+                    "gaps": gaps,
+                }
+            return status
@@ -0,0 +1,77 @@
+"""
+The most recent samples of a series, held by the server in memory: the timestamps (seconds since the epoch) as int64
+and the values as float32 (what the sensors send), in numpy arrays of a fixed capacity.
+
+Each sample is written twice, at its position in the ring and capacity further on, so that the samples held are
+always one contiguous stretch of the arrays.  That makes appending O(1) and lets readers have the series as slices,
+without copying or reordering it.
+"""
+import numpy as np
+
+
+class SeriesBuffer:
+
+    def __init__(self, capacity: int):
+        if capacity <= 0:
+            raise ValueError("capacity must be positive")
+        self.__capacity = capacity
+        self.__timestamps = np.zeros(2 * capacity, dtype=np.int64)
+        self.__values = np.zeros(2 * capacity, dtype=np.float32)
+        # where the next sample goes in the ring (0 to capacity - 1), and how many are held
+        self.__next = 0
+        self.__size = 0
+
+    def __len__(self):
+        return self.__size
+
+    def capacity(self) -> int:
+        return self.__capacity
+
+    def append(self, timestamp: int, value: float):
+        """
+        Add a sample, dropping the oldest if the buffer is full
+        """
+        i = self.__next
+        self.__timestamps[i] = self.__timestamps[i + self.__capacity] = timestamp
+        self.__values[i] = self.__values[i + self.__capacity] = value
+        self.__next = (i + 1) % self.__capacity
+        self.__size = min(self.__size + 1, self.__capacity)
+
+    def extend(self, timestamps, values):
+        """
+        Add samples, in order, as if by append() but vectorised
+        """
+        timestamps = np.asarray(timestamps, dtype=np.int64)[-self.__capacity:]
+        values = np.asarray(values, dtype=np.float32)[-self.__capacity:]
+        if len(timestamps) != len(values):
+            raise ValueError("{} timestamps, but {} values".format(len(timestamps), len(values)))
+        positions = (self.__next + np.arange(len(timestamps))) % self.__capacity
+        for offset in [0, self.__capacity]:
+            self.__timestamps[positions + offset] = timestamps
+            self.__values[positions + offset] = values
+        self.__next = (self.__next + len(timestamps)) % self.__capacity
+        self.__size = min(self.__size + len(timestamps), self.__capacity)
+
+    def __span(self):
+        # the samples held are [start, start + size) of the doubled arrays, oldest first
+        start = (self.__next - self.__size) % self.__capacity
+        return start, start + self.__size
+
+    def view(self):
+        """
+        The timestamps and values held, oldest first, as read-only slices of the buffer.  They change as samples
+        are appended, so only use them while nothing can append (e.g. with the lock that guards the buffer held).
+        """
+        start, end = self.__span()
+        timestamps = self.__timestamps[start:end]
+        values = self.__values[start:end]
+        timestamps.flags.writeable = False
+        values.flags.writeable = False
+        return timestamps, values
+
+    def snapshot(self):
+        """
+        Copies of the timestamps and values held, oldest first, to use after letting go of the lock
+        """
+        timestamps, values = self.view()
+        return timestamps.copy(), values.copy()
@@ -3,7 +3,7 @@ from flask import Flask
 from flask.json import JSONEncoder
 from flask import render_template, jsonify, request
 import bokeh.palettes
-from bokeh.models.sources import AjaxDataSource
+from bokeh.models.sources import ColumnDataSource
 from bokeh.models.formatters import DatetimeTickFormatter
 from bokeh.plotting import figure
 from bokeh.embed import components
@@ -16,18 +16,43 @@ from threading import Lock
 import os
 from datetime import datetime
 import json
+import numpy as np
 import logging
 import logging
 import database
+from database import series_topic
+import device_log
+import window_aggregates
+import transmit_slots
+import remote_config
+import sequence_gaps
+import downsample
+import live_updates
+from series_buffer import SeriesBuffer
+from history_loader import HistoryLoader
 
 
 DEFAULT_MQTT_BROKER = "ttgo-server.local"
 DEFAULT_FLASK_PORT = 1234
 DEFAULT_DB_PATH = os.path.join("databases", "database.db")
+# the most recent samples of each series held in memory
 MAX_DATA_LENGTH = 5000
+# the points of each line of the dashboard, and how many more than asked for are read to be downsampled from
+DASHBOARD_POINTS = 1000
+DOWNSAMPLE_READ_FACTOR = 10
+# the most points a line of an open dashboard keeps as samples are pushed to it, after which the oldest are dropped
+DASHBOARD_ROLLOVER = 5000
+REGISTRY_TOPIC_ROOT = "registry"
 g_topic_data = {}
 g_topic_data_lock = Lock()
 database = database.Database()
+g_slot_tracker = transmit_slots.SlotTracker()
+g_config_tracker = remote_config.ConfigTracker()
+g_sequence_tracker = sequence_gaps.SequenceTracker()
+g_series_cache = downsample.SeriesCache()
+g_broadcaster = live_updates.Broadcaster()
+g_history_loader = None
+g_relay = None
 
 
 def setup_logging():
@@ -57,10 +82,21 @@ class CustomJSONEncoder(JSONEncoder):
         return JSONEncoder.default(self, obj)
 
 
+def bokeh_times_ms(timestamps: np.ndarray) -> np.ndarray:
+    """
+    [timestamps] (seconds since the epoch) as CustomJSONEncoder gives datetimes to bokeh, the local time in
+    milliseconds since the epoch
+    """
+    hours, first_of_hour = np.unique(timestamps // 3600, return_inverse=True)
+    # the UTC offset of each hour, which changes with daylight saving time
+    offsets = np.array([(datetime.fromtimestamp(int(hour) * 3600) - datetime.utcfromtimestamp(int(hour) * 3600))
+                        .total_seconds() for hour in hours], dtype=np.float64)
+    return (timestamps + offsets[first_of_hour]) * 1000.0
+
+
 class SensorInstanceData:
     def __init__(self, sensor_name: str) -> None:
-        self.x_data = []
-        self.y_data = []
+        self.series = SeriesBuffer(MAX_DATA_LENGTH)
         self.sensor_name = sensor_name
 
     def __repr__(self) -> str:
@@ -96,6 +132,52 @@ def sensor_type_and_name_from_db_name(topic: str):
     return sensor_type_str, sensor_name_str
 
 
+def get_or_add_series(sensor_type_str: str, sensor_name: str) -> SensorInstanceData:
+    """
+    The in memory data of the series [sensor_type_str] of [sensor_name], added if there is none.  g_topic_data_lock must
+    be held.
+    """
+    if sensor_type_str in g_topic_data:
+        sensor_type: SensorType = g_topic_data[sensor_type_str]
+    else:
+        sensor_type = SensorType(sensor_type_str)
+        g_topic_data[sensor_type_str] = sensor_type
+    if sensor_name in sensor_type.series_data:
+        return sensor_type.series_data[sensor_name]
+    return sensor_type.add_series(sensor_name)
+
+
+def load_series_history(topic: str):
+    """
+    Read the most recent MAX_DATA_LENGTH samples of [topic] into memory, ahead of any received since the server started
+    """
+    data = np.asarray(database.get_data(topic, limit=MAX_DATA_LENGTH), dtype=np.float64).reshape(-1, 2)
+    timestamps = data[:, 0].astype(np.int64)
+    values = data[:, 1]
+    sensor_type_str, sensor_name_str = sensor_type_and_name_from_db_name(topic)
+
+    with g_topic_data_lock:
+        the_data = get_or_add_series(sensor_type_str, sensor_name_str)
+        received_timestamps, received_values = the_data.series.snapshot()
+        if len(received_timestamps) > 0:
+            # those are (or will be) in the database too
+            older = timestamps < received_timestamps[0]
+            timestamps = timestamps[older]
+            values = values[older]
+        series = SeriesBuffer(MAX_DATA_LENGTH)
+        series.extend(timestamps, values)
+        series.extend(received_timestamps, received_values)
+        the_data.series = series
+
+
+def sensor_shard_key(topic: str) -> str:
+    """
+    The messages of a sensor (sensors/<sensor_name>, and its log, aggregates etc. below it) are handled in order by
+    the same ingest worker, see ingest_pool.py
+    """
+    return "/".join(topic.split("/")[:2])
+
+
 def sensor_name_from_topic(topic: str):
     topic_parts = topic.split("/")
     sensor_name = topic_parts[-1]
@@ -106,6 +188,36 @@ def new_topic_callback(topic):
     # if a new topic comes in
     logging.info("New topic observed: {}".format(topic))
 
+    # make sure sensors named before the registry existed (or named by hand) are in it
+    if not device_log.is_log_topic(topic) and not window_aggregates.is_aggregates_topic(topic) \
+            and not transmit_slots.is_slot_topic(topic) and not remote_config.is_config_topic(topic):
+        database.add_sensor(sensor_name_from_topic(topic))
+
+
+def is_valid_mac(mac: str) -> bool:
+    return len(mac) == 12 and all(c in "0123456789abcdef" for c in mac)
+
+
+def make_registration_callback(relay: MQTTRelay):
+    """
+    Returns a callback that answers sensor name requests (on registry/<mac>) with the
+    name assigned to that MAC address (on registry/<mac>/name)
+    """
+    def registration_callback(topic, data: bytearray):
+        topic_parts = topic.split("/")
+        mac = topic_parts[-1].lower()
+        if len(topic_parts) != 2 or not is_valid_mac(mac):
+            logging.error("Invalid sensor name request on {}".format(topic))
+            return
+
+        sensor_name = database.register_sensor(mac)
+        if sensor_name is None:
+            return
+        logging.info("Sensor {} is named {}".format(mac, sensor_name))
+        relay.publish("{}/{}/name".format(REGISTRY_TOPIC_ROOT, mac),
+                      sensor_name, qos=1)
+    return registration_callback
+
 
 def parse_proto_to_dict(data: bytearray) -> Measurements:
     try:
@@ -117,17 +229,100 @@ def parse_proto_to_dict(data: bytearray) -> Measurements:
         return None
 
 
+def store_sensor_values(sensor_topic: str, timestamp_epoch: int, values: dict):
+    """
+    Write each of [values] (sensor type to value) of the sensor publishing on [sensor_topic]
+    into the database and local storage
+    """
+    sensor_name = sensor_name_from_topic(sensor_topic)
+    timestamp = datetime.fromtimestamp(timestamp_epoch)
+
+    # put in database, as one sample written with the rest of the batch by the database's writer thread
+    database.queue_samples([(sensor_name, timestamp_epoch, values)])
+
+    with g_topic_data_lock:
+
+        for sensor_type_str, value in values.items():
+            # update local storage, making space for this series if there is none
+            sensor_instance_data = get_or_add_series(
+                sensor_type_str, sensor_name)
+
+            # put the data points
+            sensor_instance_data.series.append(timestamp_epoch, value)
+
+    # and push them to the open dashboards, which append them to their lines
+    if g_broadcaster.num_subscribers() > 0:
+        g_broadcaster.publish("samples", json.dumps(
+            {"sensor": sensor_name, "x": timestamp, "values": values}, cls=CustomJSONEncoder))
+
+
+def new_aggregates_callback(topic, data: bytearray):
+    aggregates = window_aggregates.parse_window_aggregates(data)
+    if aggregates is None:
+        return
+    logging.info("New aggregates on topic {} : {}".format(
+        topic, "{}".format(aggregates).replace('\n', ', ')))
+
+    # stored against the end of the window, as series of the sensor (sensors/<sensor_name>/lux_mean etc.)
+    sensor_topic = topic[:-(len(window_aggregates.AGGREGATES_SUBTOPIC) + 1)]
+    store_sensor_values(sensor_topic, aggregates.timestamp,
+                        window_aggregates.aggregates_to_dict(aggregates))
+
+
+def observe_transmit_slot(topic: str, measurements: Measurements):
+    """
+    Record when the sensor transmitted, and if slots are being assigned and it is in the wrong one, publish
+    (retained, for it to pick up on its next connection) the slot it should move to
+    """
+    sensor_name = sensor_name_from_topic(topic)
+    new_slot = g_slot_tracker.observe(sensor_name, datetime.now().timestamp(), measurements.transmit_slot,
+                                      measurements.num_transmit_slots, measurements.batch_period_s)
+    if new_slot is None or g_relay is None:
+        return
+    logging.info("Moving sensor {} from transmit slot {} to {}".format(
+        sensor_name, measurements.transmit_slot, new_slot))
+    g_relay.publish(transmit_slots.slot_topic(topic),
+                    str(new_slot), qos=1, retain=True)
+
+
 def new_data_callback(topic, data: bytearray):
 
+    # devices ship their log alongside their measurements
+    if device_log.is_log_topic(topic):
+        device_log.log_device_entries(topic, data)
+        return
+
+    if window_aggregates.is_aggregates_topic(topic):
+        new_aggregates_callback(topic, data)
+        return
+
+    # slot assignments are published by this server
+    if transmit_slots.is_slot_topic(topic):
+        return
+
+    # configs are published (retained) for the devices, see remote_config.py
+    if remote_config.is_config_topic(topic):
+        g_config_tracker.observe_published(sensor_name_from_topic(topic[:-(len(remote_config.CONFIG_SUBTOPIC) + 1)]),
+                                           remote_config.parse_config(data))
+        return
+
     measurements = parse_proto_to_dict(data)
     measurements_log_str = "{}".format(measurements)
     measurements_log_str = measurements_log_str.replace('\n', ', ')
     logging.info("New data on topic {} : {}".format(
         topic, measurements_log_str))
 
-    # write each part into the database separately
-    timestamp_epoch = measurements.timestamp
-    timestamp = datetime.fromtimestamp(timestamp_epoch)
+    # a message sent again (e.g. after an acknowledgement was lost) is already stored
+    if not g_sequence_tracker.observe(sensor_name_from_topic(topic), measurements.sequence,
+                                      measurements.previous_sequence, measurements.timestamp):
+        logging.info("Ignoring sample {} on topic {}, which has already arrived".format(
+            measurements.sequence, topic))
+        return
+
+    if measurements.num_transmit_slots > 0:
+        observe_transmit_slot(topic, measurements)
+    g_config_tracker.observe_applied(sensor_name_from_topic(topic), measurements.config_version)
+
     measurements_dict = {
         "lux": measurements.lux,
         "humidity": measurements.humidity,
@@ -137,34 +332,15 @@ def new_data_callback(topic, data: bytearray):
         "battery_mV": measurements.battery_mV
     }
 
-    # write into database and update local storage
-    sensor_name = sensor_name_from_topic(topic)
-    with g_topic_data_lock:
-
-        for sensor_type_str, value in measurements_dict.items():
-            # put in database
-            topic_str = topic + "/" + sensor_type_str
-            database.write_message(
-                topic=topic_str, data=value, timestamp=timestamp)
-
-            # update local storage
-            # get or create space for this type of sensor data if there is none
-            if sensor_type_str in g_topic_data:
-                sensor_type: SensorType = g_topic_data[sensor_type_str]
-            else:
-                sensor_type = SensorType(sensor_type_str)
-                g_topic_data[sensor_type_str] = sensor_type
-
-            # get or create a series for this sensor if there is none
-            if sensor_name in sensor_type.series_data:
-                sensor_instance_data: SensorInstanceData = sensor_type.series_data[
-                    sensor_name]
-            else:
-                sensor_instance_data = sensor_type.add_series(sensor_name)
+    # compressed devices only send the fields that can't be interpolated from their neighbours.
+    # bit i of field_mask is set if the i'th field above is present, and 0 means all fields are present
+    field_mask = measurements.field_mask
+    if field_mask != 0:
+        measurements_dict = {sensor_type_str: value for i, (sensor_type_str, value)
+                             in enumerate(measurements_dict.items()) if field_mask & (1 << i)}
 
-            # put the data points
-            sensor_instance_data.x_data.append(timestamp)
-            sensor_instance_data.y_data.append(value)
+    # write into database and update local storage
+    store_sensor_values(topic, measurements.timestamp, measurements_dict)
 
 
 app = Flask(__name__)
@@ -178,40 +354,18 @@ def get_topics():
 
 def get_sensor_names():
     """
-    Returns a list of unique sensor names in the database
+    Returns a list of unique sensor names in the registry
     """
-
-    # each topic is sensors/<sensor_name>/.....
-    # so to get the observed sensors, just look for unique <sensor_names> in the topic list
-    sensor_names = []
-    topics = database.get_topics()
-    for topic in topics:
-        parts = topic.split('/')
-        if len(parts) <= 1:
-            logging.error(
-                "Unknown topic format in database, expected sensors/<sensor_name>/...: {}".format(topic))
-            continue
-        sensor_name = parts[1]
-        if sensor_name not in sensor_names:
-            sensor_names.append(sensor_name)
-    return sensor_names
+    return database.get_sensor_names()
 
 
 @app.route('/sensors/next/')
 def get_next_sensor():
     """
     Return json of the next available sensor name (i.e. one that doesn't exist yet)
+    Devices now get their name over MQTT (see make_registration_callback), this is only used by firmware built with TTGO_ENABLE_HTTP_NAMING
     """
-    sensor_names = get_sensor_names()
-
-    number = 0
-    while True:
-        candidate_name = "sensor{}".format(number)
-        if candidate_name in sensor_names:
-            # this name already exists so increment counter and try again
-            number += 1
-            continue
-        break
+    candidate_name = database.next_sensor_name()
 
     response = app.response_class(
         response=json.dumps(candidate_name),
@@ -236,42 +390,170 @@ def get_sensors():
     return response
 
 
-@app.route('/data/<sensor_type>/<sensor_name>/', methods=['POST'])
+@app.route('/slots/')
+def get_slots():
+    """
+    Return JSON of the transmit slot of each sensor, and which sensors were seen transmitting in each slot
+    """
+    return jsonify(g_slot_tracker.occupancy())
+
+
+@app.route('/gaps/')
+def get_gaps():
+    """
+    Return JSON of the samples each sensor has sent since the server started, by their sequence numbers, and the gaps
+    where samples went missing
+    """
+    return jsonify(g_sequence_tracker.gaps())
+
+
+@app.route('/ingest/')
+def get_ingest():
+    """
+    Return JSON of how far behind handling the messages from the sensors is: the messages waiting for each ingest
+    worker, and the samples waiting to be written to the database
+    """
+    metrics = g_relay.ingest_metrics() if g_relay is not None else {}
+    metrics["database_queued"] = database.num_queued()
+    return jsonify(metrics)
+
+
+@app.route('/history/')
+def get_history():
+    """
+    Return JSON of how far loading the history of the series into memory has got, which happens in the background
+    after the server starts
+    """
+    return jsonify(g_history_loader.progress() if g_history_loader is not None else {})
+
+
+@app.route('/config/')
+def get_config():
+    """
+    Return JSON of the config version published for each sensor, and the version it reports running with
+    """
+    return jsonify(g_config_tracker.status())
+
+
+def parse_time_arg(value: str) -> datetime:
+    """
+    A time given to the API, either in seconds since the epoch or as an ISO 8601 date and time (local time)
+    """
+    try:
+        return datetime.fromtimestamp(float(value))
+    except ValueError:
+        return datetime.fromisoformat(value)
+
+
+def get_downsampled_series(sensor_name: str, sensor_type: str, datetime_from, datetime_to, points: int,
+                           method: str = downsample.DEFAULT_METHOD):
+    """
+    The series [sensor_type] of [sensor_name] between [datetime_from] and [datetime_to] (either can be None), in no
+    more than [points] points picked by [method] (see downsample.py) from up to DOWNSAMPLE_READ_FACTOR times as many
+    read from the database.  Kept in g_series_cache until the sensor sends more samples.
+    @returns the resolution read (see Database.get_series()), and the [timestamp, mean, min, max] of each point
+    """
+    def make():
+        resolution, rows = database.get_series(series_topic(sensor_name, sensor_type), datetime_from, datetime_to,
+                                               points * DOWNSAMPLE_READ_FACTOR)
+        return resolution, downsample.downsample(rows, points, method)
+
+    return g_series_cache.get_or_make((sensor_name, sensor_type, datetime_from, datetime_to, points, method),
+                                      database.generation(sensor_name), make)
+
+
+@app.route('/data/<sensor_type>/<sensor_name>/', methods=['GET', 'POST'])
 def get_data(sensor_name, sensor_type):
-    global topic_data
+    """
+    Return JSON of the series [sensor_type] of [sensor_name], as x (times) and y (values).
+    With any of the query parameters from and to (seconds since the epoch, or ISO 8601), limit (the most recent
+    points to return) or points, the series is read from the database, otherwise it is the data held in memory.
+    Given points, the series is downsampled to no more than that many points (see get_downsampled_series()), by
+    the method given as downsample (lttb or minmax), with the min and max of each hour or day as y_min and y_max
+    """
+    if any(arg in request.args for arg in ["from", "to", "limit", "points"]):
+        try:
+            datetime_from = parse_time_arg(request.args["from"]) if "from" in request.args else None
+            datetime_to = parse_time_arg(request.args["to"]) if "to" in request.args else None
+            limit = int(request.args["limit"]) if "limit" in request.args else None
+            max_points = int(request.args["points"]) if "points" in request.args else None
+            if (limit is not None and limit <= 0) or (max_points is not None and max_points <= 0):
+                raise ValueError("limit and points must be positive")
+            method = request.args.get("downsample", downsample.DEFAULT_METHOD)
+            if method not in downsample.METHODS:
+                raise ValueError("downsample must be one of {}".format(", ".join(downsample.METHODS)))
+        except (ValueError, OverflowError, OSError) as e:
+            return jsonify(error="Bad query parameters: {}".format(e)), 400
+
+        if max_points is not None:
+            resolution, data = get_downsampled_series(
+                sensor_name, sensor_type, datetime_from, datetime_to, max_points, method)
+            return jsonify(x=[datetime.fromtimestamp(d[0]) for d in data], y=[d[1] for d in data],
+                           y_min=[d[2] for d in data], y_max=[d[3] for d in data], resolution=resolution)
+
+        data = database.get_data(series_topic(sensor_name, sensor_type), datetime_from, datetime_to, limit)
+        return jsonify(x=[datetime.fromtimestamp(d[0]) for d in data], y=[d[1] for d in data])
+
+    # the history of the series might not have been loaded yet
+    if g_history_loader is not None:
+        g_history_loader.ensure_loaded(series_topic(sensor_name, sensor_type))
+
+    # copied, so that the lock isn't held while they are serialised
+    timestamps = np.zeros(0, dtype=np.int64)
+    values = np.zeros(0, dtype=np.float32)
     with g_topic_data_lock:
         if sensor_type in g_topic_data:
             sensor_type_data: SensorType = g_topic_data[sensor_type]
             if sensor_name in sensor_type_data.series_data:
                 sensor_instance_data: SensorInstanceData = sensor_type_data.series_data[
                     sensor_name]
-                return jsonify(x=sensor_instance_data.x_data, y=sensor_instance_data.y_data)
-    return jsonify(x=[], y=[])
+                timestamps, values = sensor_instance_data.series.snapshot()
+    return jsonify(x=bokeh_times_ms(timestamps).tolist(), y=values.tolist())
+
+
+@app.route('/stream/')
+def stream_samples():
+    """
+    A stream of server-sent events: a samples event with the sensor, time (x) and values of each sample received,
+    or a resync event if the client falls too far behind to be sent them all (see live_updates.py)
+    """
+    subscription = g_broadcaster.subscribe()
+    return app.response_class(g_broadcaster.events(subscription), mimetype="text/event-stream",
+                              headers={"Cache-Control": "no-cache", "X-Accel-Buffering": "no"})
 
 
 @app.route('/dashboard/')
 def show_dashboard():
     global topic_data
-    plots = []
+    # only the list of series is taken under the lock, as reading their history would hold up storing samples
     with g_topic_data_lock:
-        for sensor_data in g_topic_data.values():
-            plots.append(make_ajax_plot(sensor_data))
-    dash = render_template('dashboard.html', plots=plots)
+        series = [(sensor_data.sensor_type, list(sensor_data.series_data))
+                  for sensor_data in g_topic_data.values()]
+    plots = [make_live_plot(sensor_type, sensor_names) for sensor_type, sensor_names in series]
+    dash = render_template('dashboard.html', plots=plots,
+                           rollover=DASHBOARD_ROLLOVER)
     return dash
 
 
-def make_ajax_plot(sensor_data: SensorType):
+def live_source_name(sensor_type: str, sensor_name: str) -> str:
+    """
+    The name of the data source of a line of the dashboard, which the samples pushed to it are appended to
+    """
+    return "{}/{}".format(sensor_type, sensor_name)
+
+
+def make_live_plot(sensor_type: str, sensor_instance_names: list):
 
     colours = bokeh.palettes.Category10[10]
     plot = figure(plot_height=300, sizing_mode='scale_width')
     i = 0
-    for sensor_instance_name, sensor_instance_data in sensor_data.series_data.items():
-        update_path = 'data/{}/{}'.format(sensor_data.sensor_type,
-                                          sensor_instance_name)
-        source = AjaxDataSource(data_url=request.url_root + update_path,
-                                polling_interval=30000, mode='replace')
-        source.data = dict(x=sensor_instance_data.x_data,
-                           y=sensor_instance_data.y_data)
+    # the history is downsampled, and samples received from now on are appended (see dashboard.html)
+    for sensor_instance_name in sensor_instance_names:
+        _, data = get_downsampled_series(sensor_instance_name, sensor_type, None, None,
+                                         DASHBOARD_POINTS)
+        source = ColumnDataSource(data=dict(x=[datetime.fromtimestamp(d[0]) for d in data],
+                                            y=[d[1] for d in data]),
+                                  name=live_source_name(sensor_type, sensor_instance_name))
         plot.line('x', 'y',
                   source=source,
                   line_width=4,
@@ -279,7 +561,7 @@ def make_ajax_plot(sensor_data: SensorType):
                   color=colours[i % 10])
         i += 1
 
-    plot.title.text = sensor_data.sensor_type
+    plot.title.text = sensor_type
     plot.title.text_font_size = '20px'
     plot.legend.location = "top_left"
     plot.legend.click_policy = "hide"
@@ -335,6 +617,8 @@ if __name__ == "__main__":
     argparser.add_argument("--broker", dest="mqtt_broker",
                            help="The MQTT broker URI", type=str, default=DEFAULT_MQTT_BROKER)
     argparser.add_argument("--no-relay", dest="no_relay", action="store_true")
+    argparser.add_argument("--assign-slots", dest="assign_slots", action="store_true",
+                           help="Move sensors whose transmissions clash into the least occupied transmit slots")
     args = argparser.parse_args()
 
     # make database instance
@@ -348,50 +632,41 @@ if __name__ == "__main__":
     db_path = os.path.join(database_path, database_name)
     logging.info("Connecting to database '{}'".format(db_path))
     database.open(db_path)
+    g_slot_tracker = transmit_slots.SlotTracker(
+        assign_slots=args.assign_slots)
 
-    # first off, get all existing data from the database
+    # every series is listed straight away, and the most recent data of each is loaded in the background while the
+    # relay and web server start
     topics = database.get_topics()
-    for topic in topics:
-        data = database.get_data(topic)
-
-        # sensor type is the last part in the topic
-        sensor_type_str, sensor_name_str = sensor_type_and_name_from_db_name(
-            topic)
-
-        with g_topic_data_lock:
-            if sensor_type_str in g_topic_data:
-                sensor_type: SensorType = g_topic_data[sensor_type_str]
-                the_data = sensor_type.add_series(sensor_name_str)
-            else:
-                sensor_type = SensorType(sensor_type_str)
-                the_data = sensor_type.add_series(sensor_name_str)
-                g_topic_data[sensor_type_str] = sensor_type
-
-        x_series_data = the_data.x_data
-        y_series_data = the_data.y_data
-        for d in data:
-            dt = datetime.strptime(d[0], '%Y-%m-%d %H:%M:%S')
-            x_series_data.append(dt)
-            y_series_data.append(d[1])
-            if len(x_series_data) > MAX_DATA_LENGTH:
-                x_series_data = x_series_data[1:]
-                y_series_data = y_series_data[1:]
+    with g_topic_data_lock:
+        for topic in topics:
+            sensor_type_str, sensor_name_str = sensor_type_and_name_from_db_name(
+                topic)
+            get_or_add_series(sensor_type_str, sensor_name_str)
+    g_history_loader = HistoryLoader(topics, load_series_history)
+    g_history_loader.start()
 
     # start the MQTT relay
     if not args.no_relay:
         relay = MQTTRelay(topic_filter="sensors/#",
-                        mqtt_host=args.mqtt_broker)
+                          mqtt_host=args.mqtt_broker,
+                          shard_key=sensor_shard_key)
         relay.register_new_topic_callback(new_topic_callback)
         relay.register_new_data_callback(new_data_callback)
+        relay.register_topic_callback(REGISTRY_TOPIC_ROOT + "/+",
+                                      make_registration_callback(relay))
         logging.info("Starting MQTT relay...")
         relay.initialise()
+        g_relay = relay
 
     logging.info("Starting Flask server...")
     start_flask_app_blocking = True
     if start_flask_app_blocking:
+        # threaded, as each open dashboard holds a request open for its stream
         app.run(port=args.flask_port,
                 debug=False,
                 use_reloader=False,
+                threaded=True,
                 host='0.0.0.0')
     else:
         threading.Thread(target=app.run, kwargs={
@@ -402,6 +677,7 @@ if __name__ == "__main__":
         logging.info("Flask server started...")
 
     # close things
+    g_history_loader.stop()
     if not args.no_relay:
         relay.uninitialise()
     database.close()
@@ -0,0 +1,4 @@
+#!/bin/bash
+
+source activate_venv.sh
+python coap_gateway.py
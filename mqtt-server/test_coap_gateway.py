@@ -0,0 +1,93 @@
+import socket
+import threading
+import coap_gateway
+from pyprotos.measurements_pb2 import Measurements
+
+
+# the same datagram is encoded by test/test_coap/test_main.cpp
+EXAMPLE_POST = bytes([0x44, 0x02, 0x12, 0x34,
+                      0x01, 0x02, 0x03, 0x04,
+                      0xB7]) + b"sensors" + bytes([0x02]) + b"s0" + bytes([0xFF, 0x02, 0x08, 0x01])
+
+
+def make_measurements(timestamp: int) -> bytes:
+    measurements = Measurements()
+    measurements.timestamp = timestamp
+    measurements.lux = 123.0
+    return measurements.SerializeToString()
+
+
+def test_parse_device_post():
+    message = coap_gateway.parse_message(EXAMPLE_POST)
+    assert message.message_type == coap_gateway.TYPE_CONFIRMABLE
+    assert message.code == coap_gateway.CODE_POST
+    assert message.message_id == 0x1234
+    assert message.token == bytes([1, 2, 3, 4])
+    assert message.uri_path() == "sensors/s0"
+    assert coap_gateway.split_records(message.payload) == [bytes([0x08, 0x01])]
+
+    # and back again
+    post = coap_gateway.make_post(0x1234, bytes([1, 2, 3, 4]), "sensors/s0",
+                                  coap_gateway.join_records([bytes([0x08, 0x01])]))
+    assert coap_gateway.encode_message(post) == EXAMPLE_POST
+
+
+def test_records_round_trip():
+    records = [b"", b"x" * 200, make_measurements(1600000000)]
+    assert coap_gateway.split_records(coap_gateway.join_records(records)) == records
+
+
+def test_rejects_bad_requests():
+    published = []
+    gateway = coap_gateway.CoapGateway(
+        lambda topic, payload: published.append((topic, payload)))
+    address = ("127.0.0.1", 5683)
+
+    def code_of(post):
+        return coap_gateway.parse_message(gateway.handle_datagram(coap_gateway.encode_message(post), address)).code
+
+    # only the sensors topics can be published to
+    assert code_of(coap_gateway.make_post(1, b"", "registry/0123456789ab", bytes([1, 0]))) \
+        == coap_gateway.CODE_FORBIDDEN
+    # the last record says it is longer than what is left
+    assert code_of(coap_gateway.make_post(2, b"", "sensors/s0", bytes([1, 0, 5, 0]))) \
+        == coap_gateway.CODE_BAD_REQUEST
+    assert published == []
+    # not CoAP at all
+    assert gateway.handle_datagram(b"\x00\x01", address) is None
+
+
+def test_republishes_on_localhost():
+    published = []
+    gateway = coap_gateway.CoapGateway(
+        lambda topic, payload: published.append((topic, payload)))
+    gateway_address = gateway.bind("127.0.0.1", 0)
+    thread = threading.Thread(target=gateway.serve_forever)
+    thread.start()
+
+    device = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    device.settimeout(2)
+    try:
+        batch = [make_measurements(1600000000 + i * 120) for i in range(5)]
+        post = coap_gateway.encode_message(coap_gateway.make_post(
+            7, b"\xaa\xbb\xcc\xdd", "sensors/sensor0", coap_gateway.join_records(batch)))
+
+        # a single round trip
+        device.sendto(post, gateway_address)
+        ack = coap_gateway.parse_message(device.recv(2048))
+        assert ack.message_type == coap_gateway.TYPE_ACKNOWLEDGEMENT
+        assert ack.code == coap_gateway.CODE_CHANGED
+        assert ack.message_id == 7
+        assert ack.token == b"\xaa\xbb\xcc\xdd"
+        assert published == [("sensors/sensor0", message)
+                             for message in batch]
+
+        # the device didn't get the acknowledgement and sends it again
+        device.sendto(post, gateway_address)
+        ack = coap_gateway.parse_message(device.recv(2048))
+        assert ack.code == coap_gateway.CODE_CHANGED
+        assert len(published) == len(batch)
+    finally:
+        device.close()
+        gateway.close()
+        thread.join()
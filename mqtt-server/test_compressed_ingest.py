@@ -0,0 +1,65 @@
+import os
+import server
+from pyprotos.measurements_pb2 import Measurements
+
+
+START = 1600000000
+FIELDS = ["lux", "humidity", "temperature_C", "soil", "salt", "battery_mV"]
+
+
+def open_empty(db_name: str):
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    assert server.database.open(db_name)
+
+
+def send(sensor_name: str, index: int, previous_sequence: int, fields: list, values: dict):
+    """
+    Deliver the message of sample [index] (a minute apart) carrying [fields] of [values], as a compressed device does
+    """
+    field_mask = sum(1 << FIELDS.index(field) for field in fields)
+    measurements = Measurements(timestamp=START + 60 * index, sequence=index, previous_sequence=previous_sequence,
+                                field_mask=field_mask, **values)
+    server.new_data_callback("sensors/{}".format(sensor_name), measurements.SerializeToString())
+
+
+def stored(sensor_name: str, field: str):
+    return server.database.get_data("sensors/{}/{}".format(sensor_name, field))
+
+
+def test_only_the_fields_sent_are_stored():
+    open_empty("test_only_the_fields_sent_are_stored.db")
+    values = {"lux": 10.0, "humidity": 50.0, "temperature_C": 20.0, "soil": 0.0, "salt": 40.0, "battery_mV": 4000.0}
+    send("sensor0", 1, 0, FIELDS, values)
+    # sample 2 only needs its lux
+    send("sensor0", 2, 1, ["lux"], dict(values, lux=20.0, humidity=51.0))
+    # sample 3 shows sample 2's humidity was needed after all, which comes in a message of its own
+    send("sensor0", 2, 2, ["humidity"], dict(values, lux=20.0, humidity=51.0))
+    send("sensor0", 3, 2, ["lux"], dict(values, lux=30.0, humidity=52.0))
+    # and a redelivery of the batch changes nothing
+    send("sensor0", 2, 1, ["lux"], dict(values, lux=20.0, humidity=51.0))
+    send("sensor0", 2, 2, ["humidity"], dict(values, lux=20.0, humidity=51.0))
+    server.database.flush()
+
+    assert stored("sensor0", "lux") == [[START + 60, 10.0], [START + 120, 20.0], [START + 180, 30.0]]
+    assert stored("sensor0", "humidity") == [[START + 60, 50.0], [START + 120, 51.0]]
+    # a value of 0 that was sent is stored, and the fields that weren't aren't stored as 0
+    assert stored("sensor0", "soil") == [[START + 60, 0.0]]
+    assert stored("sensor0", "battery_mV") == [[START + 60, 4000.0]]
+    server.database.close()
+
+
+def test_uncompressed_messages_store_every_field():
+    open_empty("test_uncompressed_messages_store_every_field.db")
+    values = {"lux": 10.0, "humidity": 50.0, "temperature_C": 20.0, "soil": 0.0, "salt": 40.0, "battery_mV": 4000.0}
+    send("sensor1", 1, 0, [], values)
+    server.database.flush()
+
+    for field in FIELDS:
+        assert stored("sensor1", field) == [[START + 60, values[field]]]
+    server.database.close()
+
+
+if __name__ == "__main__":
+    test_only_the_fields_sent_are_stored()
+    test_uncompressed_messages_store_every_field()
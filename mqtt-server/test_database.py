@@ -3,6 +3,9 @@ import time
 import logging
 import sys
 import os
+import threading
+import sqlite3
+from datetime import datetime
 
 
 # setup the logger
@@ -21,8 +24,8 @@ def test_write_to_database():
     db = database.Database()
     assert db.open("thisdoesntexist.db")
     assert db.is_open()
-    db.write_message("mytopic", "mydata_sync".encode('utf-8'))
-    db.write_message("mytopic_2", "mydata_sync".encode('utf-8'))
+    assert db.write_sample("sensor0", 1600000000, {"lux": 1.0})
+    assert db.write_sample("sensor1", 1600000000, {"lux": 2.0})
     db.close()
     assert not db.is_open()
 
@@ -35,14 +38,13 @@ def test_write_to_database_and_get_topics():
         os.remove(db_name)
     assert db.open(db_name)
     assert db.is_open()
-    db.write_message("b_topic", "mydata")
-    db.write_message("a_topic", "mydata")
+    db.write_sample("sensor1", 1600000000, {"soil": 10.0})
+    db.write_sample("sensor0", 1600000000, {"soil": 20.0, "lux": 1.0})
 
     # check that the topics are all present and ordered by the topic (alphabetical order)
     topics = db.get_topics()
-    assert len(topics) == 2
-    topics[0] == "a_topic"
-    topics[1] == "b_topic"
+    assert topics == ["sensors/sensor0/lux",
+                      "sensors/sensor0/soil", "sensors/sensor1/soil"]
 
     db.close()
     assert not db.is_open()
@@ -56,35 +58,243 @@ def test_write_to_database_and_get_data():
         os.remove(db_name)
     assert db.open(db_name)
     assert db.is_open()
-    db.write_message("f_topic", 1.0)
-    db.write_message("f_topic", 2.0)
-    db.write_message("f_topic", 3.0)
-    db.write_message("s_topic", "text")
+    db.write_sample("sensor0", 1600000000, {"lux": 1.0, "humidity": 50.0})
+    db.write_sample("sensor0", 1600000120, {"lux": 2.0})
+    db.write_sample("sensor0", 1600000240, {"lux": 3.0})
 
     # check that the topic was recorded
     topics = db.get_topics()
-    assert len(topics) == 2
-    topics[0] == "f_topic"
-    topics[1] == "s_topic"
-    
-    # also check that the data is correct (floats)
-    data = db.get_data("f_topic")
-    assert data is not None
-    assert len(data) == 3
-    assert data[0][1] == 1.0
-    assert data[1][1] == 2.0
-    assert data[2][1] == 3.0
-
-    # also check that the data is correct (string)
-    data = db.get_data("s_topic")
-    assert data is not None
-    assert len(data) == 1
-    assert data[0][1] == "text"
+    assert topics == ["sensors/sensor0/humidity", "sensors/sensor0/lux"]
+
+    # also check that the data is correct, and in order of time
+    data = db.get_data("sensors/sensor0/lux")
+    assert data == [[1600000000, 1.0], [1600000120, 2.0], [1600000240, 3.0]]
+
+    # series missing from a sample (compressed away on the device) aren't returned
+    data = db.get_data("sensors/sensor0/humidity")
+    assert data == [[1600000000, 50.0]]
+    assert db.get_data("sensors/sensor0/salt") == []
+    assert db.get_data("sensors/sensor1/lux") == []
+    assert db.get_data("mytopic") == []
 
     db.close()
     assert not db.is_open()
 
 
+def test_write_sample_merges_series_at_the_same_time():
+
+    db_name = "test_write_sample_merges_series_at_the_same_time.db"
+    db = database.Database()
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    assert db.open(db_name)
+
+    # the aggregates of the window a measurement closes arrive separately, with the same timestamp
+    assert db.write_sample("sensor0", 1600000000, {"lux": 1.0, "soil": 2.0})
+    assert db.write_sample("sensor0", 1600000000, {"lux_mean": 1.5})
+    assert db.write_sample("sensor0", 1600000000, {"soil": 3.0})
+    assert db.get_data("sensors/sensor0/lux") == [[1600000000, 1.0]]
+    assert db.get_data("sensors/sensor0/lux_mean") == [[1600000000, 1.5]]
+    assert db.get_data("sensors/sensor0/soil") == [[1600000000, 3.0]]
+
+    # one row per sample
+    db.close()
+    connection = sqlite3.connect(db_name)
+    assert connection.execute(
+        "SELECT COUNT(*) FROM `measurements`").fetchone()[0] == 1
+    connection.close()
+
+
+def test_write_sample_rejects_unknown_series():
+
+    db_name = "test_write_sample_rejects_unknown_series.db"
+    db = database.Database()
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    assert db.open(db_name)
+    assert not db.write_sample("sensor0", 1600000000, {"colour": 1.0})
+    assert not db.write_sample("sensor0", 1600000000, {"lux": "bright"})
+    assert db.get_topics() == []
+    db.close()
+
+
+def test_get_data_between_times():
+
+    db_name = "test_get_data_between_times.db"
+    db = database.Database()
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    assert db.open(db_name)
+    start = 1600000000
+    assert db.write_samples([("sensor0", start + 120 * i, {"lux": float(i)}) for i in range(10)] +
+                            [("sensor1", start + 120 * i, {"lux": 100.0 + i}) for i in range(10)])
+
+    def lux(**kwargs):
+        return [d[1] for d in db.get_data("sensors/sensor0/lux", **kwargs)]
+
+    # both ends are included
+    assert lux() == [float(i) for i in range(10)]
+    assert lux(datetime_from=start + 240) == [float(i) for i in range(2, 10)]
+    assert lux(datetime_to=start + 240) == [0.0, 1.0, 2.0]
+    assert lux(datetime_from=start + 200, datetime_to=start + 500) == [2.0, 3.0, 4.0]
+    assert lux(datetime_from=datetime.fromtimestamp(start + 1080)) == [9.0]
+    assert lux(datetime_from=start + 2000) == []
+
+    # the limit keeps the most recent, still in order of time
+    assert lux(limit=3) == [7.0, 8.0, 9.0]
+    assert lux(datetime_to=start + 600, limit=2) == [4.0, 5.0]
+    db.close()
+
+
+def test_get_data_query_plan():
+
+    db_name = "test_get_data_query_plan.db"
+    db = database.Database()
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    assert db.open(db_name)
+    assert db.write_samples([("sensor{}".format(i % 3), 1600000000 + 120 * i, {"lux": 1.0}) for i in range(30)])
+    db.close()
+
+    connection = sqlite3.connect(db_name)
+    connection.execute("ANALYZE")
+    for kwargs in [{}, {"datetime_from": 1600000000}, {"datetime_from": 1600000000, "datetime_to": 1600086400},
+                   {"datetime_to": 1600086400, "limit": 100}]:
+        sql, parameters = database.series_query("sensor0", "lux", **kwargs)
+        plan = [row[3] for row in connection.execute("EXPLAIN QUERY PLAN " + sql, parameters).fetchall()]
+
+        # the sensor is looked up by name, then its rows in the time range are read in order through the primary key
+        assert not any(step.startswith("SCAN") for step in plan), plan
+        assert not any("TEMP B-TREE" in step for step in plan), plan
+        measurements_steps = [step for step in plan if "measurements" in step]
+        assert len(measurements_steps) == 1 and "PRIMARY KEY" in measurements_steps[0], plan
+        if "datetime_from" in kwargs:
+            assert "timestamp>?" in measurements_steps[0], plan
+        if "datetime_to" in kwargs:
+            assert "timestamp<?" in measurements_steps[0], plan
+    connection.close()
+
+
+def test_register_sensor():
+
+    db_name = "test_register_sensor.db"
+    db = database.Database()
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    assert db.open(db_name)
+
+    # the same device always gets the same name, different devices get different names
+    assert db.register_sensor("a1b2c3d4e5f6") == "sensor0"
+    assert db.register_sensor("a1b2c3d4e5f7") == "sensor1"
+    assert db.register_sensor("a1b2c3d4e5f6") == "sensor0"
+    assert db.get_sensor_names() == ["sensor0", "sensor1"]
+    assert db.next_sensor_name() == "sensor2"
+
+    db.close()
+    assert not db.is_open()
+
+
+def test_register_sensor_skips_existing_names():
+
+    db_name = "test_register_sensor_skips_existing_names.db"
+    db = database.Database()
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    assert db.open(db_name)
+    db.write_sample("sensor0", 1600000000, {"lux": 1.0})
+    db.close()
+
+    # sensors seen before the registry existed are added to it when the database is opened
+    assert db.open(db_name)
+    assert db.get_sensor_names() == ["sensor0"]
+    assert db.add_sensor("sensor1")
+    assert db.register_sensor("a1b2c3d4e5f6") == "sensor2"
+
+    db.close()
+    assert not db.is_open()
+
+
+def test_register_sensor_concurrently():
+
+    db_name = "test_register_sensor_concurrently.db"
+    db = database.Database()
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    assert db.open(db_name)
+
+    # 20 devices being provisioned at once must all get different names
+    num_devices = 20
+    names = [None] * num_devices
+
+    def register(i):
+        names[i] = db.register_sensor("a1b2c3d4e5{:02x}".format(i))
+
+    threads = [threading.Thread(target=register, args=(i,))
+               for i in range(num_devices)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    assert None not in names
+    assert len(set(names)) == num_devices
+
+    db.close()
+    assert not db.is_open()
+
+
+def test_queue_samples():
+
+    db_name = "test_queue_samples.db"
+    db = database.Database(max_batch_size=4, flush_interval_s=60)
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    assert db.open(db_name)
+
+    # a full batch is written by the writer thread, without waiting for the flush interval
+    assert db.queue_samples([("sensor0", 1600000000 + 120 * i, {"lux": float(i)}) for i in range(4)])
+    for _ in range(100):
+        if db.num_queued() == 0 and len(db.get_data("sensors/sensor0/lux")) == 4:
+            break
+        time.sleep(0.01)
+    assert [d[1] for d in db.get_data("sensors/sensor0/lux")] == [0.0, 1.0, 2.0, 3.0]
+
+    # anything less waits, unless flushed
+    assert db.queue_samples([("sensor0", 1600000000, {"soil": 7})])
+    assert db.num_queued() == 1
+    assert db.flush()
+    assert db.num_queued() == 0
+    assert db.get_data("sensors/sensor0/soil") == [[1600000000, 7.0]]
+
+    # samples that can't be stored aren't queued
+    assert not db.queue_samples([("sensor0", 1600000000, {"lux": "bright"})])
+
+    # and what is left is written on closing
+    assert db.queue_samples([("sensor1", 1600000000, {"lux": 5.0})])
+    db.close()
+    assert db.open(db_name)
+    assert db.get_topics() == ["sensors/sensor0/lux", "sensors/sensor0/soil", "sensors/sensor1/lux"]
+    assert db.get_data("sensors/sensor1/lux") == [[1600000000, 5.0]]
+    db.close()
+
+
+def test_write_samples_uses_wal():
+
+    db_name = "test_write_samples_uses_wal.db"
+    db = database.Database()
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    assert db.open(db_name)
+    assert db.write_samples([("sensor0", 1600000000, {"lux": 1.0}), ("sensor0", 1600000120, {"lux": 2.0})])
+    db.close()
+
+    # the journal mode is stored in the database file
+    connection = sqlite3.connect(db_name)
+    assert connection.execute("PRAGMA journal_mode").fetchone()[0] == "wal"
+    assert connection.execute("SELECT COUNT(*) FROM `topics`").fetchone()[0] == 1
+    connection.close()
+
+
 if __name__ == "__main__":
     test_write_to_database()
     test_write_to_database_and_get_topics()
@@ -0,0 +1,39 @@
+import device_log
+import struct
+
+
+def test_parse_log_entries():
+    data = struct.pack("<IHBBii", 1234, 7, 3, 10, 0x0100A8C0, 2500)
+    data += struct.pack("<IHBBii", 5678, 8, 1, 22, -2, 5)
+
+    entries = device_log.parse_log_entries(data)
+    assert len(entries) == 2
+    assert entries[0].time_ms == 1234
+    assert entries[0].wake == 7
+    assert entries[0].level_name() == "INFO"
+    assert entries[0].event_name() == "WifiConnected"
+    assert entries[0].arg1 == 2500
+    assert entries[1].level_name() == "ERROR"
+    assert entries[1].event_name() == "MQTTConnectFailed"
+    assert entries[1].arg0 == -2
+
+
+def test_parse_log_entries_ignores_partial_entry():
+    data = struct.pack("<IHBBii", 1, 1, 1, 0, 0, 0) + b"\x00\x01"
+    entries = device_log.parse_log_entries(data)
+    assert len(entries) == 1
+
+
+def test_is_log_topic():
+    assert device_log.is_log_topic("sensors/sensor0/log")
+    assert not device_log.is_log_topic("sensors/sensor0")
+
+
+def test_event_names_match_firmware():
+    # the event names must stay in step with TTGO_LOG_EVENTS in src/log_events.h
+    import os
+    import re
+    header = os.path.join(os.path.dirname(__file__), "..", "src", "log_events.h")
+    with open(header) as f:
+        names = re.findall(r"^\s*X\((\w+)\)", f.read(), re.MULTILINE)
+    assert names == device_log.EVENT_NAMES
@@ -0,0 +1,123 @@
+import os
+import numpy as np
+import database
+import downsample
+
+
+def make_rows(y):
+    # raw samples two minutes apart, as Database.get_series() returns them
+    return [[1600000000 + 120 * i, float(value), float(value), float(value)] for i, value in enumerate(y)]
+
+
+def test_lttb_keeps_the_ends_and_the_peaks():
+    x = np.arange(10000, dtype=np.float64)
+    y = np.sin(x / 500.0)
+    y[1234] = 50.0
+    y[7777] = -50.0
+
+    indices = downsample.lttb(x, y, 200)
+    assert len(indices) == 200
+    assert indices[0] == 0 and indices[-1] == 9999
+    assert np.all(np.diff(indices) > 0)
+    assert 1234 in indices and 7777 in indices
+
+
+def test_lttb_returns_everything_when_there_is_room():
+    x = np.arange(10, dtype=np.float64)
+    assert list(downsample.lttb(x, x, 10)) == list(range(10))
+    assert list(downsample.lttb(x, x, 50)) == list(range(10))
+    assert list(downsample.lttb(x, x, 2)) == [0, 9]
+
+
+def test_min_max_keeps_the_extremes_of_each_bucket():
+    rng = np.random.default_rng(1)
+    x = np.arange(5000, dtype=np.float64)
+    y = rng.normal(size=5000)
+
+    indices = downsample.min_max(x, y, y, 102)
+    assert len(indices) <= 102
+    assert indices[0] == 0 and indices[-1] == 4999
+    assert np.all(np.diff(indices) > 0)
+    assert np.argmin(y) in indices and np.argmax(y) in indices
+    # 50 buckets of 100 points, each with its lowest and highest
+    for bucket in range(50):
+        assert bucket * 100 + np.argmin(y[bucket * 100:(bucket + 1) * 100]) in indices
+        assert bucket * 100 + np.argmax(y[bucket * 100:(bucket + 1) * 100]) in indices
+
+
+def test_downsample_rows():
+    rows = make_rows(np.cos(np.arange(3000) / 100.0))
+    for method in downsample.METHODS:
+        downsampled = downsample.downsample(rows, 100, method)
+        assert 0 < len(downsampled) <= 100
+        # the points are rows of the series, in order
+        assert all(row in rows for row in downsampled)
+        assert [row[0] for row in downsampled] == sorted(row[0] for row in downsampled)
+
+    # the extremes of rollups are kept by minmax, even where the means are flat
+    rows = [[3600 * i, 1.0, 1.0, 1.0] for i in range(1000)]
+    rows[321] = [3600 * 321, 1.0, -20.0, 30.0]
+    assert rows[321] in downsample.downsample(rows, 50, "minmax")
+
+    assert downsample.downsample(rows[:10], 100) == rows[:10]
+    try:
+        downsample.downsample(rows, 10, "average")
+        assert False
+    except ValueError:
+        pass
+
+
+def test_series_cache():
+    cache = downsample.SeriesCache(max_entries=2)
+    made = []
+
+    def make(value):
+        def make_value():
+            made.append(value)
+            return value
+        return make_value
+
+    assert cache.get_or_make("a", 0, make(1)) == 1
+    assert cache.get_or_make("a", 0, make(2)) == 1
+    assert cache.hits == 1 and cache.misses == 1
+
+    # made again at a new generation
+    assert cache.get_or_make("a", 1, make(3)) == 3
+
+    # the least recently used goes first
+    cache.get_or_make("b", 0, make(4))
+    cache.get_or_make("a", 1, make(5))
+    cache.get_or_make("c", 0, make(6))
+    assert len(cache) == 2
+    assert cache.get_or_make("a", 1, make(7)) == 3
+    assert cache.get_or_make("b", 0, make(8)) == 8
+    assert made == [1, 3, 4, 6, 8]
+
+
+def test_generation_changes_with_writes():
+    db_name = "test_generation_changes_with_writes.db"
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    db = database.Database()
+    assert db.open(db_name)
+
+    assert db.generation("sensor0") == 0
+    assert db.write_samples([("sensor0", 1600000000, {"lux": 1.0})])
+    generation = db.generation("sensor0")
+    assert generation != 0
+    assert db.generation("sensor1") == 0
+
+    assert db.write_samples([("sensor1", 1600000000, {"lux": 1.0})])
+    assert db.generation("sensor0") == generation
+    assert db.write_samples([("sensor0", 1600000120, {"lux": 2.0})])
+    assert db.generation("sensor0") != generation
+    db.close()
+
+
+if __name__ == "__main__":
+    test_lttb_keeps_the_ends_and_the_peaks()
+    test_lttb_returns_everything_when_there_is_room()
+    test_min_max_keeps_the_extremes_of_each_bucket()
+    test_downsample_rows()
+    test_series_cache()
+    test_generation_changes_with_writes()
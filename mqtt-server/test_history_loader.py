@@ -0,0 +1,67 @@
+import threading
+from history_loader import HistoryLoader
+
+
+def test_loads_every_topic_once_in_the_background():
+    topics = ["sensors/sensor{}/lux".format(i) for i in range(20)]
+    loaded = []
+    loader = HistoryLoader(topics, loaded.append)
+    assert loader.progress()["loaded"] == 0
+    assert not loader.progress()["done"]
+
+    loader.start()
+    assert loader.wait(5)
+    assert loaded == topics
+    progress = loader.progress()
+    assert progress["loaded"] == 20 and progress["total"] == 20 and progress["done"]
+
+    # already loaded, or not one of the topics
+    loader.ensure_loaded(topics[3])
+    loader.ensure_loaded("sensors/sensor99/lux")
+    assert loaded == topics
+
+
+def test_ensure_loaded_gets_ahead_of_the_loader():
+    topics = ["a", "b", "c"]
+    loaded = []
+    loading_a = threading.Event()
+    release = threading.Event()
+
+    def load(topic):
+        # the loader is held up on the first topic
+        if topic == "a":
+            loading_a.set()
+            release.wait(5)
+        loaded.append(topic)
+
+    loader = HistoryLoader(topics, load)
+    loader.start()
+    assert loading_a.wait(5)
+    # waits for the load in progress, then loads the one asked for
+    threading.Timer(0.1, release.set).start()
+    loader.ensure_loaded("c")
+    assert "c" in loaded
+    assert loader.wait(5)
+    assert sorted(loaded) == topics
+    assert loaded.count("c") == 1
+
+
+def test_failed_loads_dont_stop_the_loader():
+    loaded = []
+
+    def load(topic):
+        if topic == "b":
+            raise Exception("Couldn't read {}".format(topic))
+        loaded.append(topic)
+
+    loader = HistoryLoader(["a", "b", "c"], load)
+    loader.start()
+    assert loader.wait(5)
+    assert loaded == ["a", "c"]
+    assert loader.progress()["loaded"] == 3
+
+
+if __name__ == "__main__":
+    test_loads_every_topic_once_in_the_background()
+    test_ensure_loaded_gets_ahead_of_the_loader()
+    test_failed_loads_dont_stop_the_loader()
@@ -0,0 +1,150 @@
+import os
+import random
+import threading
+import time
+import database
+import ingest_pool
+import mqtt_relay
+from pyprotos.measurements_pb2 import Measurements
+
+
+def test_messages_of_a_key_are_handled_in_order():
+    pool = ingest_pool.IngestPool(num_workers=4, max_queued=50)
+    pool.start()
+    handled = {}
+    rng = random.Random(1)
+
+    def handle(key, i):
+        if rng.random() < 0.05:
+            time.sleep(0.001)
+        handled.setdefault(key, []).append(i)
+
+    for i in range(500):
+        for key in ["sensors/sensor{}".format(k) for k in range(8)]:
+            pool.submit(key, handle, key, i)
+    pool.stop()
+
+    assert len(handled) == 8
+    for key, order in handled.items():
+        assert order == list(range(500)), key
+    metrics = pool.metrics()
+    assert metrics["handled"] == 4000
+    assert metrics["failed"] == 0
+    assert metrics["queue_depths"] == [0, 0, 0, 0]
+    assert metrics["max_depth"] <= 50
+
+
+def test_full_queue_holds_back_submit():
+    pool = ingest_pool.IngestPool(num_workers=1, max_queued=5)
+    pool.start()
+    release = threading.Event()
+    handled = []
+
+    def handle(i):
+        release.wait()
+        handled.append(i)
+
+    def submit_all():
+        for i in range(20):
+            pool.submit("sensors/sensor0", handle, i)
+
+    submitter = threading.Thread(target=submit_all)
+    submitter.start()
+    time.sleep(0.2)
+    # one being handled, five waiting, and the submitter held back
+    assert submitter.is_alive()
+    assert pool.metrics()["queue_depths"] == [5]
+    assert pool.metrics()["waits"] >= 1
+
+    release.set()
+    submitter.join(5)
+    pool.stop()
+    assert handled == list(range(20))
+
+
+def test_failed_callbacks_dont_stop_a_worker():
+    pool = ingest_pool.IngestPool(num_workers=1)
+    pool.start()
+    handled = []
+
+    def handle(i):
+        if i % 2:
+            raise Exception("Bad message {}".format(i))
+        handled.append(i)
+
+    for i in range(10):
+        pool.submit("a", handle, i)
+    pool.stop()
+    assert handled == [0, 2, 4, 6, 8]
+    assert pool.metrics()["failed"] == 5
+
+
+def test_stress_replay_through_the_relay():
+    """
+    A burst like the one after an outage, with every sensor flushing its backlog at once, replayed through the relay
+    (without a broker) into the database the way the server stores it
+    """
+    num_sensors = 40
+    num_messages = 5000
+    db_name = "test_stress_replay_through_the_relay.db"
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    # small enough that the database holds back the workers, and they the relay
+    db = database.Database(max_batch_size=50, flush_interval_s=0.05, max_queued=200)
+    assert db.open(db_name)
+
+    relay = mqtt_relay.MQTTRelay(topic_filter="sensors/#", enable_logging=False, num_workers=4, max_queued=100,
+                                 shard_key=lambda topic: "/".join(topic.split("/")[:2]))
+    received = {}
+    new_topics = []
+
+    def new_data_callback(topic, payload):
+        measurements = Measurements()
+        measurements.ParseFromString(payload)
+        sensor_name = topic.split("/")[1]
+        received.setdefault(sensor_name, []).append(measurements.timestamp)
+        assert db.queue_samples([(sensor_name, measurements.timestamp, {"lux": measurements.lux})])
+
+    relay.register_new_data_callback(new_data_callback)
+    relay.register_new_topic_callback(new_topics.append)
+    relay.start_workers()
+
+    threads_before = threading.active_count()
+    max_threads = threads_before
+    start = time.perf_counter()
+    for i in range(num_messages):
+        measurements = Measurements()
+        measurements.timestamp = 1600000000 + 120 * (i // num_sensors)
+        measurements.lux = float(i)
+        relay.dispatch("sensors/sensor{}".format(i % num_sensors), measurements.SerializeToString())
+        if i % 100 == 0:
+            max_threads = max(max_threads, threading.active_count())
+    relay.wait_until_idle()
+    elapsed_s = time.perf_counter() - start
+    metrics = relay.ingest_metrics()
+    relay.stop_workers()
+    db.close()
+
+    # the workers, not a thread a message
+    assert max_threads <= threads_before
+    assert metrics["handled"] == num_messages + num_sensors
+    assert metrics["failed"] == 0
+    assert metrics["max_depth"] <= 100
+    assert len(new_topics) == num_sensors
+
+    # each sensor's messages were handled in the order they arrived, and all were stored
+    expected = [1600000000 + 120 * j for j in range(num_messages // num_sensors)]
+    assert len(received) == num_sensors
+    for sensor_name, timestamps in received.items():
+        assert timestamps == expected, sensor_name
+    assert db.open(db_name)
+    assert sum(len(db.get_data(topic)) for topic in db.get_topics()) == num_messages
+    db.close()
+    print("Replayed {} messages in {:.2f} s".format(num_messages, elapsed_s))
+
+
+if __name__ == "__main__":
+    test_messages_of_a_key_are_handled_in_order()
+    test_full_queue_holds_back_submit()
+    test_failed_callbacks_dont_stop_a_worker()
+    test_stress_replay_through_the_relay()
@@ -0,0 +1,79 @@
+import threading
+import time
+import live_updates
+
+
+def test_format_event():
+    assert live_updates.format_event("samples", '{"x": 1}') == 'event: samples\ndata: {"x": 1}\n\n'
+
+
+def test_publish_reaches_every_subscriber():
+    broadcaster = live_updates.Broadcaster()
+    subscriptions = [broadcaster.subscribe() for _ in range(3)]
+    streams = [broadcaster.events(subscription) for subscription in subscriptions]
+    assert broadcaster.num_subscribers() == 3
+
+    broadcaster.publish("samples", "1")
+    broadcaster.publish("samples", "2")
+    for stream in streams:
+        assert next(stream).startswith("retry: ")
+        assert next(stream) == "event: samples\ndata: 1\n\n"
+        assert next(stream) == "event: samples\ndata: 2\n\n"
+
+    # closing a stream (as flask does when the client goes away) unsubscribes it
+    streams[0].close()
+    assert broadcaster.num_subscribers() == 2
+    broadcaster.publish("samples", "3")
+    assert subscriptions[0].queue.empty()
+    assert next(streams[1]) == "event: samples\ndata: 3\n\n"
+
+
+def test_keepalive():
+    broadcaster = live_updates.Broadcaster(keepalive_interval_s=0.01)
+    stream = broadcaster.events(broadcaster.subscribe())
+    next(stream)
+    assert next(stream) == ": keepalive\n\n"
+
+
+def test_slow_subscriber_doesnt_block_publishing():
+    broadcaster = live_updates.Broadcaster(max_queued=10)
+    slow = broadcaster.subscribe()
+    slow_stream = broadcaster.events(slow)
+    next(slow_stream)
+    fast = broadcaster.subscribe()
+    fast_stream = broadcaster.events(fast)
+    next(fast_stream)
+
+    # the fast subscriber keeps up while the slow one reads nothing
+    received = []
+
+    def read_fast():
+        for _ in range(100):
+            received.append(next(fast_stream))
+
+    reader = threading.Thread(target=read_fast)
+    reader.start()
+    start = time.perf_counter()
+    for i in range(100):
+        broadcaster.publish("samples", str(i))
+        time.sleep(0.001)
+    assert time.perf_counter() - start < 5
+    reader.join(5)
+    assert received == [live_updates.format_event("samples", str(i)) for i in range(100)]
+
+    # the slow one is told to load everything again, rather than sent what it missed, and dropped
+    assert slow.overflowed
+    assert next(slow_stream) == live_updates.format_event("resync", "{}")
+    try:
+        next(slow_stream)
+        assert False
+    except StopIteration:
+        pass
+    assert broadcaster.num_subscribers() == 1
+
+
+if __name__ == "__main__":
+    test_format_event()
+    test_publish_reaches_every_subscriber()
+    test_keepalive()
+    test_slow_subscriber_doesnt_block_publishing()
@@ -0,0 +1,90 @@
+import os
+import sqlite3
+import struct
+from datetime import datetime
+import database
+import migrate_database
+
+
+def make_old_database(db_name: str, events):
+    """
+    A database as the old server wrote it, with [events] (topic, local time, value) in the events table
+    """
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    connection = sqlite3.connect(db_name)
+    connection.execute(
+        "CREATE TABLE events("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,"
+        "topic TEXT NOT NULL,"
+        "timestamp DATETIME NOT NULL,"
+        "recieve_timestamp DATETIME DEFAULT CURRENT_TIMESTAMP NOT NULL,"
+        "data BLOB,"
+        "format_string STRING"
+        ");")
+    connection.execute(
+        "CREATE TABLE topics(id INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, name TEXT UNIQUE NOT NULL);")
+    for topic, timestamp, value in events:
+        if isinstance(value, float):
+            data, format_string = struct.pack("f", value), "f"
+        elif isinstance(value, int):
+            data, format_string = struct.pack("i", value), "i"
+        else:
+            data, format_string = value.encode('utf-8'), "utf8"
+        connection.execute("INSERT INTO events (topic, timestamp, data, format_string) VALUES (?, ?, ?, ?)",
+                           (topic, timestamp.strftime("%Y-%m-%d %H:%M:%S"), data, format_string))
+        connection.execute(
+            "INSERT OR IGNORE INTO topics (name) VALUES (?)", (topic,))
+    connection.commit()
+    connection.close()
+
+
+def test_migrate_database():
+
+    db_name = "test_migrate_database.db"
+    first = datetime(2021, 6, 1, 12, 0, 0)
+    second = datetime(2021, 6, 1, 12, 2, 0)
+    make_old_database(db_name, [
+        ("sensors/sensor0/lux", first, 100.0),
+        ("sensors/sensor0/humidity", first, 50.0),
+        ("sensors/sensor0/soil", first, 3),
+        ("sensors/sensor1/lux", first, 200.0),
+        ("sensors/sensor0/lux", second, 110.0),
+        ("sensors/sensor0/lux_mean", second, 105.0),
+        ("mytopic", second, "text"),
+    ])
+
+    assert migrate_database.migrate(db_name, chunk_size=3) == (6, 1)
+
+    db = database.Database()
+    assert db.open(db_name)
+    assert db.get_topics() == ["sensors/sensor0/humidity", "sensors/sensor0/lux", "sensors/sensor0/lux_mean",
+                               "sensors/sensor0/soil", "sensors/sensor1/lux"]
+    assert db.get_data("sensors/sensor0/lux") == [
+        [int(first.timestamp()), 100.0], [int(second.timestamp()), 110.0]]
+    assert db.get_data("sensors/sensor0/soil") == [[int(first.timestamp()), 3.0]]
+    assert db.get_data("sensors/sensor1/lux") == [[int(first.timestamp()), 200.0]]
+    assert db.get_sensor_names() == ["sensor0", "sensor1"]
+    db.close()
+
+    # a row per sample, and the events are gone
+    connection = sqlite3.connect(db_name)
+    assert connection.execute(
+        "SELECT COUNT(*) FROM `measurements`").fetchone()[0] == 3
+    assert not migrate_database.has_events_table(connection)
+    connection.close()
+
+    # so there is nothing to do the second time
+    assert migrate_database.migrate(db_name) == (0, 0)
+
+
+def test_migrate_database_keeping_events():
+
+    db_name = "test_migrate_database_keeping_events.db"
+    make_old_database(db_name, [("sensors/sensor0/lux", datetime(2021, 6, 1, 12, 0, 0), 100.0)])
+    assert migrate_database.migrate(db_name, keep_events=True) == (1, 0)
+    connection = sqlite3.connect(db_name)
+    assert migrate_database.has_events_table(connection)
+    assert connection.execute(
+        "SELECT COUNT(*) FROM `measurements`").fetchone()[0] == 1
+    connection.close()
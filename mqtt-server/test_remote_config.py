@@ -0,0 +1,46 @@
+import pytest
+import remote_config
+
+
+def test_is_config_topic():
+    assert remote_config.is_config_topic("sensors/sensor0/config")
+    assert not remote_config.is_config_topic("sensors/sensor0")
+    assert remote_config.config_topic("sensor0") == "sensors/sensor0/config"
+
+
+def test_make_config_round_trip():
+    config = remote_config.make_config(3, time_between_measurements_s=300, num_measurements_per_batch=None)
+    parsed = remote_config.parse_config(config.SerializeToString())
+    assert parsed.version == 3
+    assert parsed.time_between_measurements_s == 300
+    # left at 0, so the device keeps what it has
+    assert parsed.num_measurements_per_batch == 0
+    assert parsed.max_num_mqtt_attempts == 0
+
+
+def test_make_config_rejects_out_of_range():
+    with pytest.raises(ValueError):
+        remote_config.make_config(1, num_measurements_per_batch=11)
+    with pytest.raises(ValueError):
+        remote_config.make_config(1, time_between_measurements_s=5)
+    with pytest.raises(ValueError):
+        remote_config.make_config(0, max_num_mqtt_attempts=3)
+    with pytest.raises(ValueError):
+        remote_config.make_config(1, batch_size=3)
+
+
+def test_tracker_status():
+    tracker = remote_config.ConfigTracker()
+    tracker.observe_published("sensor0", remote_config.make_config(2, max_num_mqtt_attempts=3))
+    tracker.observe_applied("sensor0", 1)
+    tracker.observe_applied("sensor1", 0)
+    status = tracker.status()
+    assert status["sensor0"] == {"published_version": 2, "applied_version": 1, "up_to_date": False}
+    assert status["sensor1"]["up_to_date"]
+
+    tracker.observe_applied("sensor0", 2)
+    assert tracker.status()["sensor0"]["up_to_date"]
+
+    # a cleared config (an empty retained message)
+    tracker.observe_published("sensor0", remote_config.parse_config(b""))
+    assert tracker.status()["sensor0"]["published_version"] is None
@@ -0,0 +1,195 @@
+import os
+import random
+import sqlite3
+import database
+import rollups
+
+
+def open_empty(db_name: str) -> database.Database:
+    if os.path.exists(db_name):
+        os.remove(db_name)
+    db = database.Database()
+    assert db.open(db_name)
+    return db
+
+
+def read_rollups(db_name: str):
+    connection = sqlite3.connect(db_name)
+    tables = {}
+    for resolution, _ in rollups.RESOLUTIONS:
+        rows = connection.execute("SELECT * FROM `{}` ORDER BY `sensor_id`, `series`, `start`".format(
+            rollups.table_name(resolution))).fetchall()
+        # the sums and integrals are added up in a different order by a rebuild
+        tables[resolution] = [row[:4] + (round(row[4], 6),) + row[5:9] + (round(row[9], 6),) + row[10:]
+                              for row in rows]
+    connection.close()
+    return tables
+
+
+def test_choose_resolution():
+    assert rollups.choose_resolution(100, {"hour": 10, "day": 1}, 100) == "raw"
+    assert rollups.choose_resolution(101, {"hour": 10, "day": 1}, 100) == "hour"
+    assert rollups.choose_resolution(5000, {"hour": 200, "day": 9}, 100) == "day"
+    assert rollups.choose_resolution(50000, {"hour": 2000, "day": 400}, 100) == "day"
+
+
+def test_rollups_follow_the_samples():
+
+    db_name = "test_rollups_follow_the_samples.db"
+    db = open_empty(db_name)
+    assert db.write_samples([("sensor0", 1600000000, {"lux": 10.0, "soil": 1.0}),
+                             ("sensor0", 1600000120, {"lux": 30.0}),
+                             ("sensor0", 1600000240, {"lux": 20.0})])
+    db.close()
+
+    hour = rollups.bucket_start(1600000000, 3600)
+    day = rollups.bucket_start(1600000000, 24 * 3600)
+    assert read_rollups(db_name) == {
+        "hour": [(1, "lux", hour, 3, 60.0, 10.0, 30.0, 20.0, 1600000240, 5400.0, 240.0),
+                 (1, "soil", hour, 1, 1.0, 1.0, 1.0, 1.0, 1600000000, 0.0, 0.0)],
+        "day": [(1, "lux", day, 3, 60.0, 10.0, 30.0, 20.0, 1600000240, 5400.0, 240.0),
+                (1, "soil", day, 1, 1.0, 1.0, 1.0, 1.0, 1600000000, 0.0, 0.0)]}
+
+    # a sample sent again isn't counted twice, and one that arrives late isn't the last
+    assert db.open(db_name)
+    assert db.write_samples([("sensor0", 1600000120, {"lux": 30.0}),
+                             ("sensor0", 1600000060, {"lux": 5.0})])
+    db.close()
+    assert read_rollups(db_name)["hour"][0] == (1, "lux", hour, 4, 65.0, 5.0, 30.0, 20.0, 1600000240, 4500.0, 240.0)
+
+    # a value that changes has its buckets recomputed
+    assert db.open(db_name)
+    assert db.write_sample("sensor0", 1600000120, {"lux": 15.0})
+    db.close()
+    assert read_rollups(db_name)["hour"][0] == (1, "lux", hour, 4, 50.0, 5.0, 20.0, 20.0, 1600000240, 3150.0, 240.0)
+
+
+def test_rollups_match_a_rebuild():
+
+    db_name = "test_rollups_match_a_rebuild.db"
+    db = open_empty(db_name)
+
+    # batches with repeats, changed values, series filled in later and samples out of order, over a few days
+    generator = random.Random(1)
+    for _ in range(20):
+        samples = []
+        for _ in range(50):
+            timestamp = 1600000000 + 120 * generator.randrange(2000)
+            values = {series: float(generator.randrange(100))
+                      for series in generator.sample(["lux", "humidity", "soil", "lux_mean"], 2)}
+            samples.append(("sensor{}".format(generator.randrange(3)), timestamp, values))
+        assert db.write_samples(samples)
+    db.close()
+    incremental = read_rollups(db_name)
+    assert len(incremental["hour"]) > 100
+
+    assert db.open(db_name)
+    assert db.rebuild_rollups()
+    db.close()
+    assert read_rollups(db_name) == incremental
+
+
+def test_rollups_are_built_for_older_databases():
+
+    db_name = "test_rollups_are_built_for_older_databases.db"
+    db = open_empty(db_name)
+    assert db.write_samples([("sensor0", 1600000000 + 120 * i, {"lux": float(i)}) for i in range(100)])
+    db.close()
+    expected = read_rollups(db_name)
+
+    connection = sqlite3.connect(db_name)
+    for resolution, _ in rollups.RESOLUTIONS:
+        connection.execute("DROP TABLE `{}`".format(rollups.table_name(resolution)))
+    connection.commit()
+    connection.close()
+
+    assert db.open(db_name)
+    db.close()
+    assert read_rollups(db_name) == expected
+
+    # and replaced when they were made before the means were weighted by time
+    connection = sqlite3.connect(db_name)
+    for resolution, _ in rollups.RESOLUTIONS:
+        connection.execute("ALTER TABLE `{}` DROP COLUMN `integral`".format(rollups.table_name(resolution)))
+        connection.execute("ALTER TABLE `{}` DROP COLUMN `duration`".format(rollups.table_name(resolution)))
+    connection.commit()
+    connection.close()
+
+    assert db.open(db_name)
+    db.close()
+    assert read_rollups(db_name) == expected
+
+
+def test_means_of_compressed_series_are_weighted_by_time():
+
+    db_name = "test_means_of_compressed_series_are_weighted_by_time.db"
+    db = open_empty(db_name)
+
+    # two hours of a sample every 2 minutes, starting at midnight UTC, which jump from 0 to 100 after 50 minutes
+    start = 1600041600
+    samples = [(start + 120 * i, 0.0 if i <= 25 else 100.0) for i in range(60)]
+    assert db.write_samples([("sensor0", timestamp, {"lux": value}) for timestamp, value in samples])
+    # and the same compressed, which keeps the ends of the jump and an hourly keyframe, in batches as it's sent
+    compressed = [samples[i] for i in [0, 25, 26, 30, 59]]
+    for batch in [compressed[:2], compressed[2:4], compressed[4:]]:
+        assert db.write_samples([("sensor1", timestamp, {"lux": value}) for timestamp, value in batch])
+
+    # 50 minutes at 0, 2 minutes halfway and 8 minutes at 100, rather than the mean of the values stored
+    for sensor_name in ["sensor0", "sensor1"]:
+        resolution, data = db.get_series("sensors/{}/lux".format(sensor_name), max_points=2)
+        assert resolution == "hour"
+        assert data == [[start, 15.0, 0.0, 100.0], [start + 3600, 100.0, 100.0, 100.0]]
+    assert db.get_series("sensors/sensor1/lux", max_points=5) == ("raw", [[t, v, v, v] for t, v in compressed])
+    day_mean = db.get_series("sensors/sensor1/lux", max_points=1)[1][0][1]
+    assert abs(day_mean - (50 * 120 + 100 * (3600 - 3120 + 3480)) / 7080) < 1e-9
+
+    # a value after a gap isn't joined to the ones before it
+    assert db.write_sample("sensor1", start + 5 * 3600, {"lux": 0.0})
+    resolution, data = db.get_series("sensors/sensor1/lux", max_points=3)
+    assert data == [[start, 15.0, 0.0, 100.0], [start + 3600, 100.0, 100.0, 100.0],
+                    [start + 5 * 3600, 0.0, 0.0, 0.0]]
+    db.close()
+
+    # which a rebuild agrees with
+    expected = read_rollups(db_name)
+    assert db.open(db_name)
+    assert db.rebuild_rollups()
+    db.close()
+    assert read_rollups(db_name) == expected
+
+
+def test_get_series_chooses_the_resolution():
+
+    db_name = "test_get_series_chooses_the_resolution.db"
+    db = open_empty(db_name)
+
+    # three days of a sample every 2 minutes, starting at midnight UTC
+    start = 1600041600
+    assert db.write_samples([("sensor0", start + 120 * i, {"lux": float(i % 30)}) for i in range(3 * 720)])
+
+    resolution, data = db.get_series("sensors/sensor0/lux", max_points=5000)
+    assert resolution == "raw"
+    assert len(data) == 3 * 720
+    assert data[1] == [start + 120, 1.0, 1.0, 1.0]
+
+    resolution, data = db.get_series("sensors/sensor0/lux", max_points=100)
+    assert resolution == "hour"
+    assert len(data) == 72
+    assert data[0] == [start, 14.5, 0.0, 29.0]
+
+    resolution, data = db.get_series("sensors/sensor0/lux", max_points=10)
+    assert resolution == "day"
+    assert [d[0] for d in data] == [start, start + 86400, start + 2 * 86400]
+
+    # only the buckets that overlap the range, which can then be shown raw
+    resolution, data = db.get_series("sensors/sensor0/lux", datetime_from=start + 3600 + 60,
+                                     datetime_to=start + 3 * 3600, max_points=100)
+    assert resolution == "raw"
+    assert data[0][0] == start + 3600 + 120 and data[-1][0] == start + 3 * 3600
+    resolution, data = db.get_series("sensors/sensor0/lux", datetime_from=start + 3600 + 60,
+                                     datetime_to=start + 3 * 3600, max_points=10)
+    assert resolution == "hour"
+    assert [d[0] for d in data] == [start + 3600, start + 2 * 3600, start + 3 * 3600]
+
+    assert db.get_series("sensors/sensor1/lux") == ("raw", [])
+    db.close()
@@ -0,0 +1,142 @@
+import random
+import sequence_gaps
+
+
+def time_of(sequence: int) -> int:
+    # samples a minute apart
+    return 1600000000 + 60 * sequence
+
+
+def test_compressed_samples_arent_gaps():
+    tracker = sequence_gaps.SequenceTracker()
+    # samples 2, 3 and 5 were compressed away on the device
+    assert tracker.observe("sensor0", 1, 0, time_of(1))
+    assert tracker.observe("sensor0", 4, 1, time_of(4))
+    assert tracker.observe("sensor0", 6, 4, time_of(6))
+    assert tracker.observe("sensor0", 7, 6, time_of(7))
+
+    status = tracker.gaps()["sensor0"]
+    assert status["lowest"] == 1 and status["highest"] == 7
+    assert status["received"] == 4
+    assert status["missing"] == 0
+    assert status["gaps"] == []
+
+
+def test_held_fields_of_a_sample_arent_redeliveries():
+    tracker = sequence_gaps.SequenceTracker()
+    assert tracker.observe("sensor0", 1, 0, time_of(1))
+    # sample 2 sends some of its fields, and the rest follow with sample 3 once it shows they're needed
+    assert tracker.observe("sensor0", 2, 1, time_of(2))
+    assert tracker.observe("sensor0", 2, 2, time_of(2))
+    assert tracker.observe("sensor0", 3, 2, time_of(3))
+
+    status = tracker.gaps()["sensor0"]
+    assert status["received"] == 3
+    assert status["duplicates"] == 0
+    assert status["missing"] == 0 and status["epochs"] == 1
+
+
+def test_lost_and_redelivered_messages():
+    tracker = sequence_gaps.SequenceTracker()
+    for sequence in range(1, 11):
+        assert tracker.observe("sensor0", sequence, sequence - 1, time_of(sequence))
+    # 11 to 15 were lost, and 16 to 20 arrive out of order
+    for sequence in [18, 16, 20, 17, 19]:
+        assert tracker.observe("sensor0", sequence, sequence - 1, time_of(sequence))
+
+    status = tracker.gaps()["sensor0"]
+    assert status["missing"] == 5
+    assert status["gaps"] == [{"from": 11, "to": 15, "count": 5, "after_restart": False}]
+
+    # a redelivery of what has already arrived is ignored
+    assert not tracker.observe("sensor0", 7, 6, time_of(7))
+    assert not tracker.observe("sensor0", 20, 19, time_of(20))
+    # but fills the gap when it was lost the first time
+    for sequence in range(11, 16):
+        assert tracker.observe("sensor0", sequence, sequence - 1, time_of(sequence))
+
+    status = tracker.gaps()["sensor0"]
+    assert status["received"] == 20
+    assert status["duplicates"] == 2
+    assert status["missing"] == 0 and status["gaps"] == []
+
+
+def test_gaps_after_restarts_are_counted_separately():
+    tracker = sequence_gaps.SequenceTracker()
+    for sequence in range(1, 6):
+        tracker.observe("sensor0", sequence, sequence - 1, time_of(sequence))
+    # the device lost power, and carried on from the end of the numbers it had reserved
+    tracker.observe("sensor0", 257, 0, time_of(257))
+    tracker.observe("sensor0", 258, 257, time_of(258))
+    # and another sensor older than sequence numbers
+    assert tracker.observe("sensor1", 0, 0, time_of(0))
+    assert tracker.observe("sensor1", 0, 0, time_of(0))
+
+    status = tracker.gaps()
+    assert "sensor1" not in status
+    assert status["sensor0"]["missing"] == 0
+    assert status["sensor0"]["after_restart"] == 251
+    assert status["sensor0"]["gaps"] == [{"from": 6, "to": 256, "count": 251, "after_restart": True}]
+
+
+def test_matches_a_set_of_received_samples():
+    rng = random.Random(1)
+    tracker = sequence_gaps.SequenceTracker()
+    # each message covers the samples after the one before it
+    sequences = sorted(rng.sample(range(1, 2000), 600))
+    messages = list(zip(sequences, [0] + sequences[:-1]))
+    delivered = [message for message in messages if rng.random() < 0.9]
+    delivered += rng.sample(delivered, 50)
+    rng.shuffle(delivered)
+
+    covered = set()
+    for sequence, previous_sequence in delivered:
+        assert tracker.observe("sensor0", sequence, previous_sequence, time_of(sequence)) == (sequence not in covered)
+        covered.update(range(previous_sequence + 1, sequence + 1))
+
+    status = tracker.gaps()["sensor0"]
+    missing = set(range(status["lowest"], status["highest"] + 1)) - covered
+    assert status["missing"] + status["after_restart"] == len(missing)
+    assert status["received"] == len(set(delivered))
+    assert status["duplicates"] == 50
+
+
+def test_oldest_gaps_are_forgotten():
+    tracker = sequence_gaps.SequenceTracker(max_intervals=3)
+    for sequence in range(1, 20, 2):
+        tracker.observe("sensor0", sequence, sequence - 1, time_of(sequence))
+    status = tracker.gaps()["sensor0"]
+    assert [gap["from"] for gap in status["gaps"]] == [16, 18]
+    assert status["lowest"] == 1 and status["highest"] == 19
+
+
+def test_numbering_started_again():
+    tracker = sequence_gaps.SequenceTracker()
+    for sequence in range(1, 101):
+        assert tracker.observe("sensor0", sequence, sequence - 1, time_of(sequence))
+
+    # the device lost its stored numbering, and starts again from 1 with new samples, which are all kept
+    for sequence in range(1, 11):
+        assert tracker.observe("sensor0", sequence, sequence - 1, time_of(100 + sequence))
+    # while a redelivery is still dropped
+    assert not tracker.observe("sensor0", 5, 4, time_of(105))
+
+    status = tracker.gaps()["sensor0"]
+    assert status["epochs"] == 2
+    assert status["lowest"] == 1 and status["highest"] == 10
+    assert status["missing"] == 0
+    assert status["duplicates"] == 1
+
+    # and again, where the first message after the restart went missing
+    assert tracker.observe("sensor0", 2, 1, time_of(200))
+    assert tracker.gaps()["sensor0"]["epochs"] == 3
+
+
+if __name__ == "__main__":
+    test_compressed_samples_arent_gaps()
+    test_held_fields_of_a_sample_arent_redeliveries()
+    test_lost_and_redelivered_messages()
+    test_gaps_after_restarts_are_counted_separately()
+    test_matches_a_set_of_received_samples()
+    test_oldest_gaps_are_forgotten()
+    test_numbering_started_again()
@@ -0,0 +1,69 @@
+import numpy as np
+from series_buffer import SeriesBuffer
+
+
+def test_append_keeps_the_most_recent():
+    buffer = SeriesBuffer(4)
+    assert len(buffer) == 0
+    timestamps, values = buffer.view()
+    assert len(timestamps) == 0 and len(values) == 0
+
+    for i in range(3):
+        buffer.append(1600000000 + i, i)
+    timestamps, values = buffer.view()
+    assert list(timestamps) == [1600000000, 1600000001, 1600000002]
+    assert list(values) == [0.0, 1.0, 2.0]
+
+    # past the capacity, the oldest are dropped
+    for i in range(3, 10):
+        buffer.append(1600000000 + i, i)
+        timestamps, values = buffer.view()
+        assert len(buffer) == 4
+        assert list(timestamps) == [1600000000 + j for j in range(i - 3, i + 1)]
+        assert list(values) == [float(j) for j in range(i - 3, i + 1)]
+    assert timestamps.dtype == np.int64
+    assert values.dtype == np.float32
+
+
+def test_view_is_a_read_only_slice():
+    buffer = SeriesBuffer(100)
+    for i in range(250):
+        buffer.append(i, i)
+    timestamps, values = buffer.view()
+    assert timestamps.base is not None and values.base is not None
+    assert not timestamps.flags.writeable and not values.flags.writeable
+    try:
+        values[0] = 1
+        assert False
+    except ValueError:
+        pass
+
+    # a snapshot doesn't change with what is appended after it
+    snapshot_timestamps, snapshot_values = buffer.snapshot()
+    buffer.append(250, 250)
+    assert list(snapshot_timestamps) == list(range(150, 250))
+    assert list(buffer.view()[0]) == list(range(151, 251))
+
+
+def test_extend_matches_append():
+    rng = np.random.default_rng(1)
+    for num_before, num_extended in [(0, 5), (3, 4), (7, 30), (2, 0), (0, 100)]:
+        appended = SeriesBuffer(8)
+        extended = SeriesBuffer(8)
+        for i in range(num_before):
+            appended.append(i, i)
+            extended.append(i, i)
+        timestamps = np.arange(num_before, num_before + num_extended)
+        values = rng.normal(size=num_extended)
+        for timestamp, value in zip(timestamps, values):
+            appended.append(timestamp, value)
+        extended.extend(timestamps, values)
+        assert len(appended) == len(extended)
+        assert np.array_equal(appended.view()[0], extended.view()[0])
+        assert np.array_equal(appended.view()[1], extended.view()[1])
+
+
+if __name__ == "__main__":
+    test_append_keeps_the_most_recent()
+    test_view_is_a_read_only_slice()
+    test_extend_matches_append()
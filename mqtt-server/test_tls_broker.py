@@ -0,0 +1,129 @@
+import os
+import shutil
+import socket
+import subprocess
+import time
+import pytest
+
+
+# checks that mosquitto, set up with mosquitto/mosquitto_tls.conf, resumes TLS sessions the way the devices need.
+# Needs mosquitto and openssl to be installed, it is skipped otherwise
+HERE = os.path.dirname(os.path.abspath(__file__))
+PSK_PORT = 18883
+ECDSA_PORT = 18884
+# the default batch period of the devices (5 measurements 2 minutes apart), which sessions must outlive to be resumed
+DEFAULT_BATCH_PERIOD_S = 5 * 2 * 60
+
+
+def wait_for_port(port: int, timeout_s: float = 5) -> bool:
+    end = time.time() + timeout_s
+    while time.time() < end:
+        try:
+            socket.create_connection(("127.0.0.1", port), timeout=0.5).close()
+            return True
+        except OSError:
+            time.sleep(0.1)
+    return False
+
+
+@pytest.fixture(scope="module")
+def broker(tmp_path_factory):
+    if shutil.which("mosquitto") is None or shutil.which("openssl") is None:
+        pytest.skip("mosquitto and openssl are needed")
+
+    tls_dir = str(tmp_path_factory.mktemp("tls"))
+    subprocess.run(["bash", os.path.join(HERE, "tls", "make_certs.sh"), tls_dir, "localhost"],
+                   check=True, capture_output=True)
+
+    # the real configuration, on ports that are free for the test
+    with open(os.path.join(HERE, "mosquitto", "mosquitto_tls.conf")) as f:
+        config = f.read()
+    config = config.replace("listener 1883", "listener 11883") \
+        .replace("listener 8883", "listener {}".format(PSK_PORT)) \
+        .replace("listener 8884", "listener {}".format(ECDSA_PORT)) \
+        .replace("tls/", tls_dir + "/")
+    config_path = os.path.join(tls_dir, "mosquitto.conf")
+    with open(config_path, "w") as f:
+        f.write(config)
+
+    process = subprocess.Popen(["mosquitto", "-c", config_path],
+                               stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        assert wait_for_port(PSK_PORT) and wait_for_port(ECDSA_PORT)
+        with open(os.path.join(tls_dir, "psk_file")) as f:
+            identity, psk = f.read().strip().split(":")
+        yield tls_dir, identity, psk
+    finally:
+        process.terminate()
+        process.wait()
+
+
+def s_client(port: int, arguments: list) -> str:
+    """
+    Returns what openssl s_client prints for a handshake with the broker, or None if it failed
+    """
+    result = subprocess.run(["openssl", "s_client", "-connect", "127.0.0.1:{}".format(port), "-tls1_2"] + arguments,
+                            input=b"", capture_output=True, timeout=10)
+    return result.stdout.decode() if result.returncode == 0 else None
+
+
+def handshake(port: int, arguments: list, session_file: str, resume: bool) -> str:
+    """
+    Returns whether openssl's handshake was "New" or "Reused", or "Failed"
+    """
+    session_argument = ["-sess_in" if resume else "-sess_out", session_file]
+    output = s_client(port, arguments + session_argument)
+    if output is None:
+        return "Failed"
+    for line in output.splitlines():
+        if line.startswith("New,") or line.startswith("Reused,"):
+            return line.split(",")[0]
+    return "Failed"
+
+
+def ticket_lifetime_s(port: int, arguments: list) -> int:
+    """
+    Returns the lifetime the broker gives the session ticket it issues, or None if it doesn't issue one
+    """
+    output = s_client(port, arguments) or ""
+    for line in output.splitlines():
+        # e.g. "    TLS session ticket lifetime hint: 7200 (seconds)"
+        if "session ticket lifetime hint:" in line:
+            return int(line.split(":")[1].split()[0])
+    return None
+
+
+def test_psk_session_resumes(broker):
+    tls_dir, identity, psk = broker
+    arguments = ["-psk_identity", identity, "-psk", psk,
+                 "-cipher", "PSK-AES128-GCM-SHA256"]
+    session_file = os.path.join(tls_dir, "psk_session.pem")
+    assert handshake(PSK_PORT, arguments, session_file, resume=False) == "New"
+    assert handshake(PSK_PORT, arguments, session_file, resume=True) == "Reused"
+
+
+def test_wrong_psk_is_refused(broker):
+    tls_dir, identity, psk = broker
+    arguments = ["-psk_identity", identity, "-psk", "00" * 16,
+                 "-cipher", "PSK-AES128-GCM-SHA256"]
+    assert handshake(PSK_PORT, arguments, os.path.join(
+        tls_dir, "bad_session.pem"), resume=False) == "Failed"
+
+
+def test_ecdsa_session_resumes(broker):
+    tls_dir, _, _ = broker
+    arguments = ["-CAfile", os.path.join(tls_dir, "ca.crt"), "-verify_return_error",
+                 "-cipher", "ECDHE-ECDSA-AES128-GCM-SHA256"]
+    session_file = os.path.join(tls_dir, "ecdsa_session.pem")
+    assert handshake(ECDSA_PORT, arguments, session_file, resume=False) == "New"
+    assert handshake(ECDSA_PORT, arguments, session_file, resume=True) == "Reused"
+
+
+def test_sessions_outlive_the_batch_period(broker):
+    tls_dir, identity, psk = broker
+    psk_arguments = ["-psk_identity", identity, "-psk", psk,
+                     "-cipher", "PSK-AES128-GCM-SHA256"]
+    ecdsa_arguments = ["-CAfile", os.path.join(tls_dir, "ca.crt"), "-verify_return_error",
+                       "-cipher", "ECDHE-ECDSA-AES128-GCM-SHA256"]
+    assert ticket_lifetime_s(PSK_PORT, psk_arguments) > DEFAULT_BATCH_PERIOD_S
+    assert ticket_lifetime_s(ECDSA_PORT, ecdsa_arguments) > DEFAULT_BATCH_PERIOD_S
@@ -0,0 +1,50 @@
+import transmit_slots
+
+
+PERIOD_S = 600
+
+
+def test_is_slot_topic():
+    assert transmit_slots.is_slot_topic("sensors/sensor0/slot")
+    assert not transmit_slots.is_slot_topic("sensors/sensor0")
+
+
+def test_observed_occupancy():
+    tracker = transmit_slots.SlotTracker()
+    # slots of 50s, so 1000 * 600 + 160 arrives in slot 3
+    assert tracker.observe("sensor0", 1000 * PERIOD_S + 160, 3, 12, PERIOD_S) is None
+    assert tracker.observe("sensor1", 1000 * PERIOD_S + 170, 7, 12, PERIOD_S) is None
+    assert tracker.observe("sensor2", 1000 * PERIOD_S + 10, 0, 12, PERIOD_S) is None
+
+    occupancy = tracker.occupancy()
+    assert occupancy["sensors"]["sensor0"]["observed_slot"] == 3
+    # sensor1 hasn't moved into its slot yet
+    assert occupancy["sensors"]["sensor1"]["slot"] == 7
+    assert occupancy["sensors"]["sensor1"]["observed_slot"] == 3
+    slots = occupancy["slots"]["12"]
+    assert slots[0] == ["sensor2"]
+    assert slots[3] == ["sensor0", "sensor1"]
+
+
+def test_ignores_sensors_without_slots():
+    tracker = transmit_slots.SlotTracker(assign_slots=True)
+    assert tracker.observe("sensor0", 1000, 0, 0, 0) is None
+    assert tracker.occupancy()["sensors"] == {}
+
+
+def test_assigns_least_occupied_slots():
+    tracker = transmit_slots.SlotTracker(assign_slots=True)
+    # the first to report a slot keeps it
+    assert tracker.observe("sensor0", 1000, 2, 4, PERIOD_S) is None
+    # a clash is moved to the lowest empty slot
+    assert tracker.observe("sensor1", 1000, 2, 4, PERIOD_S) == 0
+    assert tracker.observe("sensor2", 1000, 2, 4, PERIOD_S) == 1
+    # the assignment sticks, and isn't sent again once the sensor reports it
+    assert tracker.observe("sensor1", 2000, 2, 4, PERIOD_S) == 0
+    assert tracker.observe("sensor1", 3000, 0, 4, PERIOD_S) is None
+    # an empty slot is kept
+    assert tracker.observe("sensor3", 1000, 3, 4, PERIOD_S) is None
+    # all full, so a sensor already in one of the least occupied slots stays there
+    assert tracker.observe("sensor4", 1000, 3, 4, PERIOD_S) is None
+    # and a slot the sensor can't have is replaced by the lowest of them
+    assert tracker.observe("sensor5", 1000, 9, 4, PERIOD_S) == 0
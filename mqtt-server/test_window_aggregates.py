@@ -0,0 +1,38 @@
+import window_aggregates
+from pyprotos.measurements_pb2 import WindowAggregates
+
+
+def test_is_aggregates_topic():
+    assert window_aggregates.is_aggregates_topic("sensors/sensor0/aggregates")
+    assert not window_aggregates.is_aggregates_topic("sensors/sensor0")
+    assert not window_aggregates.is_aggregates_topic("sensors/sensor0/log")
+
+
+def test_parse_window_aggregates():
+    sent = WindowAggregates(timestamp=1600000000, duration_s=120)
+    sent.lux.count = 12
+    sent.lux.min = 100.5
+    sent.lux.max = 2000.0
+    sent.lux.mean = 640.25
+    sent.lux.stddev = 80.0
+    sent.soil.count = 12
+    sent.soil.mean = 40.0
+
+    aggregates = window_aggregates.parse_window_aggregates(
+        sent.SerializeToString())
+    assert aggregates.timestamp == 1600000000
+    assert aggregates.duration_s == 120
+
+    values = window_aggregates.aggregates_to_dict(aggregates)
+    assert values["lux_min"] == 100.5
+    assert values["lux_max"] == 2000.0
+    assert values["lux_mean"] == 640.25
+    assert values["lux_stddev"] == 80.0
+    assert values["soil_mean"] == 40.0
+
+    # salt had no samples in the window
+    assert "salt_mean" not in values
+
+
+def test_parse_window_aggregates_invalid():
+    assert window_aggregates.parse_window_aggregates(b"\xff\xff\xff") is None
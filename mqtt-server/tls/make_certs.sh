@@ -0,0 +1,24 @@
+#!/bin/bash
+# Make the keys for the TLS listeners of mosquitto/mosquitto_tls.conf, in [directory] (default: this directory)
+#  - ca.key, ca.crt: the CA, paste ca.crt into src/tls_ca_cert.h for kTlsEcdsa
+#  - server.key, server.crt: the broker's P-256 key and certificate, for [hostname] (default: ttgo-server)
+#  - psk_file: a pre-shared key for identity "ttgo", build the firmware with it for kTlsPsk
+set -e
+
+DIRECTORY=${1:-$(dirname "$0")}
+HOSTNAME=${2:-ttgo-server}
+cd "$DIRECTORY"
+
+openssl ecparam -name prime256v1 -genkey -noout -out ca.key
+openssl req -new -x509 -key ca.key -out ca.crt -days 3650 -subj "/CN=ttgo-ca"
+
+openssl ecparam -name prime256v1 -genkey -noout -out server.key
+openssl req -new -key server.key -out server.csr -subj "/CN=$HOSTNAME"
+openssl x509 -req -in server.csr -CA ca.crt -CAkey ca.key -CAcreateserial -out server.crt -days 3650
+rm server.csr
+
+PSK=$(openssl rand -hex 16)
+echo "ttgo:$PSK" > psk_file
+
+echo "Add to build_flags in platformio.ini for kTlsPsk:"
+echo "    -D TTGO_TLS_PSK=\\\"$PSK\\\""
@@ -0,0 +1,107 @@
+import threading
+from datetime import datetime
+
+
+SLOT_SUBTOPIC = "slot"
+
+
+def is_slot_topic(topic: str) -> bool:
+    """
+    Returns true if [topic] carries a transmit slot assignment (sensors/<sensor_name>/slot)
+    """
+    return topic.split("/")[-1] == SLOT_SUBTOPIC
+
+
+def slot_topic(sensor_topic: str) -> str:
+    return sensor_topic + "/" + SLOT_SUBTOPIC
+
+
+class SensorSlot:
+    def __init__(self, slot: int, num_slots: int, batch_period_s: int, arrival_time: float) -> None:
+        self.slot = slot
+        self.num_slots = num_slots
+        self.batch_period_s = batch_period_s
+        self.arrival_time = arrival_time
+        self.assigned_slot = None
+
+    def observed_slot(self) -> int:
+        """
+        The slot the last transmission actually arrived in
+        """
+        slot_length_s = self.batch_period_s / self.num_slots
+        return int((self.arrival_time % self.batch_period_s) // slot_length_s)
+
+
+class SlotTracker:
+    """
+    Keeps track of the transmit slots of the sensors, both the slot each one reports and the slot its transmissions are
+    observed arriving in.  Optionally assigns slots, so that they are evenly occupied.
+    """
+
+    def __init__(self, assign_slots: bool = False) -> None:
+        self.__lock = threading.Lock()
+        self.__sensors = {}
+        self.__assign_slots = assign_slots
+
+    def observe(self, sensor_name: str, arrival_time: float, slot: int, num_slots: int, batch_period_s: int):
+        """
+        Record a transmission from [sensor_name], received at epoch [arrival_time], reporting its slot.
+        @returns the slot the sensor should be moved to, or None if it should stay where it is
+        """
+        if num_slots == 0 or batch_period_s == 0:
+            # older firmware, or slots are turned off on the device
+            return None
+
+        with self.__lock:
+            sensor = SensorSlot(slot, num_slots, batch_period_s, arrival_time)
+            previous = self.__sensors.get(sensor_name)
+            if previous is not None and previous.num_slots == num_slots and previous.batch_period_s == batch_period_s:
+                sensor.assigned_slot = previous.assigned_slot
+            self.__sensors[sensor_name] = sensor
+
+            if not self.__assign_slots:
+                return None
+            if sensor.assigned_slot is None:
+                sensor.assigned_slot = self.__least_occupied_slot(
+                    sensor_name, sensor)
+            return sensor.assigned_slot if sensor.assigned_slot != slot else None
+
+    def __least_occupied_slot(self, sensor_name: str, sensor: SensorSlot) -> int:
+        """
+        The slot with the fewest other sensors (of the same period) in it, preferring the slot the sensor already
+        reports so that a restarted server doesn't move everything.  The lock must be held.
+        """
+        counts = [0] * sensor.num_slots
+        for name, other in self.__sensors.items():
+            if name == sensor_name or other.num_slots != sensor.num_slots or other.batch_period_s != sensor.batch_period_s:
+                continue
+            other_slot = other.assigned_slot if other.assigned_slot is not None else other.slot
+            if other_slot < sensor.num_slots:
+                counts[other_slot] += 1
+
+        fewest = min(counts)
+        if sensor.slot < sensor.num_slots and counts[sensor.slot] == fewest:
+            return sensor.slot
+        return counts.index(fewest)
+
+    def occupancy(self) -> dict:
+        """
+        Returns the slot of each sensor, and the sensors observed in each slot (by number of slots)
+        """
+        with self.__lock:
+            sensors = {}
+            slots = {}
+            for name, sensor in sorted(self.__sensors.items()):
+                observed_slot = sensor.observed_slot()
+                sensors[name] = {
+                    "slot": sensor.slot,
+                    "assigned_slot": sensor.assigned_slot,
+                    "observed_slot": observed_slot,
+                    "num_slots": sensor.num_slots,
+                    "batch_period_s": sensor.batch_period_s,
+                    "last_seen": datetime.fromtimestamp(sensor.arrival_time).isoformat(),
+                }
+                occupancy = slots.setdefault(
+                    str(sensor.num_slots), [[] for _ in range(sensor.num_slots)])
+                occupancy[observed_slot].append(name)
+            return {"sensors": sensors, "slots": slots}
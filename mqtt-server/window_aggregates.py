@@ -0,0 +1,46 @@
+import logging
+from pyprotos.measurements_pb2 import WindowAggregates
+
+
+AGGREGATES_SUBTOPIC = "aggregates"
+
+# the channels sampled at a higher rate for aggregation, as named in WindowAggregates
+CHANNELS = ["lux", "soil", "salt"]
+
+# the statistics of each channel that are stored as series, as named in Aggregate
+STATISTICS = ["min", "max", "mean", "stddev"]
+
+
+def is_aggregates_topic(topic: str) -> bool:
+    """
+    Returns true if [topic] carries window aggregates (sensors/<sensor_name>/aggregates)
+    """
+    return topic.split("/")[-1] == AGGREGATES_SUBTOPIC
+
+
+def parse_window_aggregates(data: bytes) -> WindowAggregates:
+    try:
+        aggregates = WindowAggregates()
+        aggregates.ParseFromString(data)
+        return aggregates
+    except Exception as e:
+        logging.error("Error parsing window aggregates protobuf: {}".format(e))
+        return None
+
+
+def aggregates_to_dict(aggregates: WindowAggregates) -> dict:
+    """
+    Flatten the statistics of each channel into a dictionary of series name (e.g. lux_mean) to value.
+    Channels without any samples in the window are left out.
+    """
+    values = {}
+    for channel in CHANNELS:
+        if not aggregates.HasField(channel):
+            continue
+        aggregate = getattr(aggregates, channel)
+        if aggregate.count == 0:
+            continue
+        for statistic in STATISTICS:
+            values["{}_{}".format(channel, statistic)] = getattr(
+                aggregate, statistic)
+    return values
@@ -0,0 +1,133 @@
+#ifndef __SIM_ARDUINO__
+#define __SIM_ARDUINO__
+
+/// @brief Just enough of the Arduino core (and the parts of the IDF it pulls in) to build the firmware on the host,
+/// with time and power going through the simulator (see sim/sim.h)
+
+#include <algorithm>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+
+#define ARDUINO 10805
+
+// everything in RTC memory survives deep sleep, which the simulator does by carrying this section from one wake
+// (process) to the next
+#define RTC_DATA_ATTR __attribute__((section("rtc_sim_data")))
+#define RTC_IRAM_ATTR
+#define IRAM_ATTR
+
+typedef uint8_t byte;
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_TIMEOUT 0x107
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x02
+#define INPUT_PULLUP 0x05
+#define OUTPUT_OPEN_DRAIN 0x12
+#define ANALOG 0xC0
+#define SDA 21
+#define SCL 22
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+bool setCpuFrequencyMhz(uint32_t mhz);
+uint32_t getCpuFrequencyMhz();
+uint32_t esp_random();
+
+void configTime(long gmtOffset_s, int daylightOffset_s, const char *server1, const char *server2 = nullptr, const char *server3 = nullptr);
+bool getLocalTime(struct tm *info, uint32_t ms = 5000);
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) (void)(mux)
+#define portEXIT_CRITICAL(mux) (void)(mux)
+#define interrupts()
+#define noInterrupts()
+
+class String
+{
+public:
+    String(const char *value = "") : m_value(value) {}
+    const char *c_str() const { return m_value.c_str(); }
+    size_t length() const { return m_value.length(); }
+
+private:
+    std::string m_value;
+};
+
+class Print
+{
+public:
+    virtual ~Print() = default;
+    virtual size_t write(uint8_t) { return 1; }
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            write(buffer[i]);
+        }
+        return size;
+    }
+    size_t print(const char *value) { return write(reinterpret_cast<const uint8_t *>(value), strlen(value)); }
+    size_t print(const String &value) { return print(value.c_str()); }
+    size_t print(long value) { return print(std::to_string(value).c_str()); }
+    size_t println() { return print("\n"); }
+    template <typename T>
+    size_t println(const T &value) { return print(value) + println(); }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+};
+
+class HardwareSerial : public Stream
+{
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+};
+
+extern HardwareSerial Serial;
+
+class IPAddress
+{
+public:
+    IPAddress(uint32_t address = 0) : m_address(address) {}
+    operator uint32_t() const { return m_address; }
+    uint8_t operator[](int index) const { return static_cast<uint8_t>(m_address >> (8 * index)); }
+
+private:
+    uint32_t m_address;
+};
+
+// the core pulls these in for every sketch
+#include "esp_sleep.h"
+
+#endif
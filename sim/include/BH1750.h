@@ -0,0 +1,22 @@
+#ifndef __SIM_BH1750__
+#define __SIM_BH1750__
+
+#include "Arduino.h"
+
+class BH1750
+{
+public:
+    enum Mode
+    {
+        UNCONFIGURED = 0,
+        CONTINUOUS_HIGH_RES_MODE = 0x10,
+        ONE_TIME_HIGH_RES_MODE = 0x20,
+    };
+
+    BH1750(uint8_t address = 0x23) {}
+    bool begin(Mode mode = CONTINUOUS_HIGH_RES_MODE);
+    bool configure(Mode mode);
+    float readLightLevel();
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef __SIM_PUB_SUB_CLIENT__
+#define __SIM_PUB_SUB_CLIENT__
+
+#include <functional>
+#include "Arduino.h"
+#include "Client.h"
+
+#define MQTT_MAX_PACKET_SIZE 256
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+#define MQTT_CONNECT_UNAVAILABLE 3
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char *, uint8_t *, unsigned int)> callback
+
+/// @brief The broker, as seen through PubSubClient's interface.  It answers after a round trip, holds the retained
+/// messages the scenario sets up (see simRetain()), and names unnamed devices like the server's registry does.
+/// Refusals are injected at connect.
+class PubSubClient
+{
+public:
+    PubSubClient(Client &client) : m_client(&client) {}
+
+    PubSubClient &setServer(const char *domain, uint16_t port);
+    PubSubClient &setClient(Client &client);
+    PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE);
+    bool setBufferSize(uint16_t size);
+
+    bool connect(const char *id);
+    void disconnect();
+    bool connected();
+    int state() { return m_state; }
+
+    bool publish(const char *topic, const char *payload);
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length);
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained);
+    bool subscribe(const char *topic, uint8_t qos = 0);
+    bool unsubscribe(const char *topic);
+    bool loop();
+
+private:
+    Client *m_client;
+    MQTT_CALLBACK_SIGNATURE = nullptr;
+    const char *m_domain = nullptr;
+    uint16_t m_port = 0;
+    uint16_t m_bufferSize = MQTT_MAX_PACKET_SIZE;
+    int m_state = MQTT_DISCONNECTED;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef __SIM_WIFI__
+#define __SIM_WIFI__
+
+#include "Arduino.h"
+#include "Client.h"
+#include "esp_wifi.h"
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum
+{
+    WIFI_OFF = 0,
+    WIFI_STA = 1,
+} wifi_mode_t;
+
+/// @brief Joining the access point takes the model's association time, or never happens if it is down for the wake
+class WiFiClass
+{
+public:
+    void persistent(bool) {}
+    bool mode(wifi_mode_t mode);
+    wifi_mode_t getMode();
+    wl_status_t begin(const char *ssid, const char *passphrase);
+    wl_status_t status();
+    uint8_t waitForConnectResult();
+    bool disconnect(bool wifiOff = false);
+    bool setSleep(bool enabled);
+    IPAddress localIP();
+    uint8_t *macAddress(uint8_t *mac);
+    int32_t channel();
+    int hostByName(const char *host, IPAddress &result);
+    int16_t scanNetworks();
+    String SSID(uint8_t) { return String("sim"); }
+    int encryptionType(uint8_t) { return 3; }
+    bool beginSmartConfig() { return true; }
+    bool smartConfigDone() { return true; }
+    bool stopSmartConfig() { return true; }
+};
+
+extern WiFiClass WiFi;
+
+/// @brief A TCP connection, which costs a round trip to open
+class WiFiClient : public Client
+{
+public:
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char *host, uint16_t port) override;
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t *, size_t size) override { return size; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int read(uint8_t *, size_t) override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+    void stop() override { m_connected = false; }
+    uint8_t connected() override { return m_connected; }
+    operator bool() override { return m_connected; }
+
+private:
+    bool m_connected = false;
+};
+
+#endif
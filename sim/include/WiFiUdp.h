@@ -0,0 +1,26 @@
+#ifndef __SIM_WIFI_UDP__
+#define __SIM_WIFI_UDP__
+
+#include "WiFi.h"
+
+/// @brief A socket to the CoAP gateway, which acknowledges every confirmable message unless the ack is lost
+class WiFiUDP
+{
+public:
+    uint8_t begin(uint16_t port);
+    void stop();
+    int beginPacket(IPAddress ip, uint16_t port);
+    size_t write(const uint8_t *buffer, size_t size);
+    int endPacket();
+    int parsePacket();
+    int read(uint8_t *buffer, size_t length);
+
+private:
+    uint8_t m_datagram[1500];
+    size_t m_length = 0;
+    uint8_t m_response[16]; // the acknowledgement of the last datagram
+    size_t m_responseLength = 0;
+    uint64_t m_responseAt_us = 0;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef __SIM_WIRE__
+#define __SIM_WIRE__
+
+#include "Arduino.h"
+
+/// @brief The I2C bus, on which every device answers
+class TwoWire
+{
+public:
+    bool begin(int sda, int scl);
+    void setTimeOut(uint16_t) {}
+    void beginTransmission(uint8_t) {}
+    uint8_t endTransmission();
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef __SIM_DRIVER_ADC__
+#define __SIM_DRIVER_ADC__
+
+#include "Arduino.h"
+
+void adc_power_acquire();
+void adc_power_release();
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef __SIM_DRIVER_PCNT__
+#define __SIM_DRIVER_PCNT__
+
+#include "Arduino.h"
+
+#define PCNT_PIN_NOT_USED (-1)
+
+typedef enum
+{
+    PCNT_UNIT_0 = 0,
+} pcnt_unit_t;
+
+typedef enum
+{
+    PCNT_CHANNEL_0 = 0,
+} pcnt_channel_t;
+
+typedef enum
+{
+    PCNT_MODE_KEEP = 0,
+} pcnt_ctrl_mode_t;
+
+typedef enum
+{
+    PCNT_COUNT_DIS = 0,
+    PCNT_COUNT_INC = 1,
+} pcnt_count_mode_t;
+
+typedef enum
+{
+    PCNT_EVT_H_LIM = 1 << 4,
+} pcnt_evt_type_t;
+
+typedef struct
+{
+    int pulse_gpio_num;
+    int ctrl_gpio_num;
+    pcnt_ctrl_mode_t lctrl_mode;
+    pcnt_ctrl_mode_t hctrl_mode;
+    pcnt_count_mode_t pos_mode;
+    pcnt_count_mode_t neg_mode;
+    int16_t counter_h_lim;
+    int16_t counter_l_lim;
+    pcnt_unit_t unit;
+    pcnt_channel_t channel;
+} pcnt_config_t;
+
+/// @brief the soil oscillator isn't modelled, so the counter never counts
+esp_err_t pcnt_unit_config(const pcnt_config_t *config);
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t value);
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit);
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t event);
+esp_err_t pcnt_isr_service_install(int flags);
+void pcnt_isr_service_uninstall();
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*handler)(void *), void *arg);
+esp_err_t pcnt_isr_handler_remove(pcnt_unit_t unit);
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit);
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit);
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit);
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t *count);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef __SIM_DRIVER_TIMER__
+#define __SIM_DRIVER_TIMER__
+
+#include "Arduino.h"
+
+#endif
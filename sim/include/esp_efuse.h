@@ -0,0 +1,6 @@
+#ifndef __SIM_ESP_EFUSE__
+#define __SIM_ESP_EFUSE__
+
+#include "esp_system.h"
+
+#endif
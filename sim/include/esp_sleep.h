@@ -0,0 +1,11 @@
+#ifndef __SIM_ESP_SLEEP__
+#define __SIM_ESP_SLEEP__
+
+#include "Arduino.h"
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_us);
+
+/// @brief ends the wake, the simulator carries RTC memory over to the next one (see sim/sim.h)
+[[noreturn]] void esp_deep_sleep_start();
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef __SIM_ESP_SYSTEM__
+#define __SIM_ESP_SYSTEM__
+
+#include "Arduino.h"
+
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef __SIM_ESP_TIMER__
+#define __SIM_ESP_TIMER__
+
+#include "Arduino.h"
+
+int64_t esp_timer_get_time();
+
+#endif
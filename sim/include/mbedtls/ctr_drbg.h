@@ -0,0 +1,9 @@
+#ifndef __SIM_MBEDTLS_CTR_DRBG__
+#define __SIM_MBEDTLS_CTR_DRBG__
+
+typedef struct
+{
+    int unused;
+} mbedtls_ctr_drbg_context;
+
+#endif
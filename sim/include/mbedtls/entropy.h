@@ -0,0 +1,9 @@
+#ifndef __SIM_MBEDTLS_ENTROPY__
+#define __SIM_MBEDTLS_ENTROPY__
+
+typedef struct
+{
+    int unused;
+} mbedtls_entropy_context;
+
+#endif
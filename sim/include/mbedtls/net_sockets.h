@@ -0,0 +1,9 @@
+#ifndef __SIM_MBEDTLS_NET_SOCKETS__
+#define __SIM_MBEDTLS_NET_SOCKETS__
+
+typedef struct
+{
+    int unused;
+} mbedtls_net_context;
+
+#endif
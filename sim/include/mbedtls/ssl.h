@@ -0,0 +1,15 @@
+#ifndef __SIM_MBEDTLS_SSL__
+#define __SIM_MBEDTLS_SSL__
+
+// only the types, the simulator's TlsClient (sim/sim_tls_client.cpp) models the handshake rather than doing it
+typedef struct
+{
+    int unused;
+} mbedtls_ssl_context;
+
+typedef struct
+{
+    int unused;
+} mbedtls_ssl_config;
+
+#endif
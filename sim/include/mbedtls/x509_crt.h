@@ -0,0 +1,9 @@
+#ifndef __SIM_MBEDTLS_X509_CRT__
+#define __SIM_MBEDTLS_X509_CRT__
+
+typedef struct
+{
+    int unused;
+} mbedtls_x509_crt;
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef __SIM_NVS_FLASH__
+#define __SIM_NVS_FLASH__
+
+#include "nvs.h"
+
+#define ESP_ERROR_CHECK(x) (void)(x)
+
+esp_err_t nvs_flash_init();
+esp_err_t nvs_flash_erase();
+
+#endif
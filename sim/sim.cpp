@@ -0,0 +1,247 @@
+#include "sim.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include "esp_sleep.h"
+
+// the linker marks out the section that RTC_DATA_ATTR puts things in
+extern "C" char __start_rtc_sim_data[];
+extern "C" char __stop_rtc_sim_data[];
+
+namespace
+{
+    constexpr uint32_t kSimStartEpoch_s = 1735689600; // 2025-01-01
+    // far longer than any wake should take, so a wake that never sleeps doesn't hang the simulation
+    constexpr uint64_t kMaxWakeTime_us = 30ull * 60 * 1000 * 1000;
+
+    SimFaults g_faults;
+    SimModel g_model = {
+        20.0,     // cpuBase_mA
+        0.125,    // cpuPerMHz_mA, 30mA at 80MHz and 50mA at 240MHz
+        100.0,    // radioActive_mA
+        20.0,     // radioConnected_mA
+        3.0,      // sensors_mA
+        0.15,     // deepSleep_mA
+        15.0,     // stubWake_mA
+        250000,   // boot_us
+        5000,     // stubWake_us
+        1500000,  // association_us
+        20000,    // roundTrip_us
+        150000,   // ntp_us
+        1000,     // packet_us
+        5000,     // nvsWrite_us
+        30000,    // tlsPskHandshake_us
+        1500000,  // tlsEcdsaHandshake_us
+        2 * 3600, // tlsSessionLifetime_s, OpenSSL's default, which mosquitto keeps (see test_tls_broker.py)
+    };
+
+    SimState *g_state = nullptr;
+
+    size_t rtcSize()
+    {
+        return __stop_rtc_sim_data - __start_rtc_sim_data;
+    }
+
+    double radioCurrent_mA(const SimState &state, uint64_t time_us)
+    {
+        if (!state.radioOn)
+        {
+            return 0;
+        }
+        const bool active = time_us < state.radioBusy_us ||   //
+                            time_us < state.associated_us || // which is never for a radio that isn't associated
+                            !state.modemSleep;
+        return active ? g_model.radioActive_mA : g_model.radioConnected_mA;
+    }
+
+    double current_mA(const SimState &state, uint64_t time_us)
+    {
+        return g_model.cpuBase_mA + g_model.cpuPerMHz_mA * state.cpu_MHz + //
+               (state.sensorsPowered ? g_model.sensors_mA : 0) +           //
+               radioCurrent_mA(state, time_us);
+    }
+}
+
+SimState &simState()
+{
+    if (g_state == nullptr)
+    {
+        // shared, so the processes of the wakes write to the same state as the driver
+        void *memory = mmap(nullptr, sizeof(SimState), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            perror("mmap");
+            abort();
+        }
+        g_state = static_cast<SimState *>(memory);
+    }
+    return *g_state;
+}
+
+SimFaults &simFaults()
+{
+    return g_faults;
+}
+
+SimModel &simModel()
+{
+    return g_model;
+}
+
+void simReset(uint64_t seed)
+{
+    static uint8_t coldRtc[kSimMaxRtcSize];
+    static bool haveColdRtc = false;
+    if (rtcSize() > kSimMaxRtcSize)
+    {
+        fprintf(stderr, "RTC memory is %zu bytes, more than the simulator keeps\n", rtcSize());
+        abort();
+    }
+    if (!haveColdRtc)
+    {
+        // as loaded from the image on power up
+        memcpy(coldRtc, __start_rtc_sim_data, rtcSize());
+        haveColdRtc = true;
+    }
+
+    SimState &state = simState();
+    const bool verbose = state.verbose;
+    memset(&state, 0, sizeof(state));
+    state.verbose = verbose;
+    state.random = seed * 0x9E3779B97F4A7C15ull + 1;
+    memcpy(state.rtc, coldRtc, rtcSize());
+    simRestoreRtc();
+}
+
+void simAdvance_us(uint64_t us)
+{
+    SimState &state = simState();
+    const uint64_t end_us = state.now_us + us;
+    while (state.now_us < end_us)
+    {
+        // the current changes when the radio finishes joining or sending
+        uint64_t next_us = end_us;
+        if (state.radioBusy_us > state.now_us && state.radioBusy_us < next_us)
+        {
+            next_us = state.radioBusy_us;
+        }
+        if (state.associated_us > state.now_us && state.associated_us < next_us)
+        {
+            next_us = state.associated_us;
+        }
+        const uint64_t step_us = next_us - state.now_us;
+        state.totals.charge_mAs += current_mA(state, state.now_us) * step_us / 1e6;
+        state.totals.awake_us += step_us;
+        if (state.radioOn)
+        {
+            state.totals.radioOn_us += step_us;
+        }
+        state.now_us = next_us;
+    }
+
+    if (state.now_us - state.wakeStart_us > kMaxWakeTime_us)
+    {
+        fprintf(stderr, "the wake at %.0fs never went to sleep\n", state.wakeStart_us / 1e6);
+        _exit(2);
+    }
+}
+
+void simSleep_us(uint64_t us)
+{
+    SimState &state = simState();
+    state.totals.charge_mAs += g_model.deepSleep_mA * us / 1e6;
+    state.now_us += us;
+}
+
+void simStubWake()
+{
+    SimState &state = simState();
+    state.totals.charge_mAs += g_model.stubWake_mA * g_model.stubWake_us / 1e6;
+    state.totals.awake_us += g_model.stubWake_us;
+    state.now_us += g_model.stubWake_us;
+    ++state.totals.stubWakes;
+}
+
+bool simChance(double p)
+{
+    // 24 bits is plenty, and the same on every platform
+    return p > 0 && (simRandom() >> 8) < p * (1 << 24);
+}
+
+uint32_t simRandom()
+{
+    uint64_t &x = simState().random;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    return static_cast<uint32_t>((x * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+uint32_t simEpoch_s()
+{
+    return kSimStartEpoch_s + static_cast<uint32_t>(simState().now_us / 1000000);
+}
+
+bool simNetworkUp()
+{
+    const SimState &state = simState();
+    return state.radioOn && state.associated_us <= state.now_us;
+}
+
+void simTransmit(size_t length)
+{
+    SimState &state = simState();
+    // 1Mbps is the slowest rate, so this is generous for the payload, most of the time goes on the fixed overhead
+    const uint64_t airtime_us = g_model.packet_us + length * 8;
+    state.radioBusy_us = std::max(state.radioBusy_us, state.now_us) + airtime_us;
+}
+
+void simRoundTrip()
+{
+    SimState &state = simState();
+    // listening for the answer
+    state.radioBusy_us = std::max(state.radioBusy_us, state.now_us + g_model.roundTrip_us);
+    simAdvance_us(g_model.roundTrip_us);
+}
+
+void simBeginWake()
+{
+    SimState &state = simState();
+    state.cpu_MHz = 240;
+    state.sensorsPowered = false;
+    state.radioOn = false;
+    state.modemSleep = true;
+    state.associated_us = UINT64_MAX;
+    state.radioBusy_us = 0;
+    state.sleep_us = 0;
+    state.slept = false;
+    state.wakeStart_us = state.now_us;
+    ++state.totals.fullBoots;
+    simAdvance_us(g_model.boot_us);
+    state.wakeStart_us = state.now_us;
+}
+
+void simSaveRtc()
+{
+    memcpy(simState().rtc, __start_rtc_sim_data, rtcSize());
+}
+
+void simRestoreRtc()
+{
+    memcpy(__start_rtc_sim_data, simState().rtc, rtcSize());
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_us)
+{
+    simState().sleep_us = time_us;
+    return ESP_OK;
+}
+
+void esp_deep_sleep_start()
+{
+    SimState &state = simState();
+    simSaveRtc();
+    state.radioOn = false;
+    state.slept = true;
+    fflush(stderr);
+    _exit(0);
+}
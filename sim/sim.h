@@ -0,0 +1,150 @@
+#ifndef __SIM__
+#define __SIM__
+
+#include "Arduino.h"
+
+// A host simulator of the wake cycle.  The firmware (setup() and everything under src/, apart from the TLS client and
+// the wake stub) is built for Linux against the stubs in sim/include, which run on a virtual clock and charge the
+// battery for the time spent in each power state.  Every full boot runs in a process forked from the driver, so that
+// ordinary memory starts afresh as it does on the device, and only the RTC_DATA_ATTR section (and NVS) is carried over
+// to the next wake.
+
+/// @brief The failure rates, each the probability of the failure at every opportunity
+struct SimFaults
+{
+    double apDown;        // the access point doesn't answer, for a whole wake
+    double brokerRefuses; // the broker refuses an MQTT connection
+    double dhtNaN;        // a DHT12 read returns NaN
+    double ntpFails;      // an NTP request goes unanswered
+    double packetLoss;    // a CoAP datagram or an ESP-NOW frame isn't acknowledged
+};
+
+/// @brief The power and timing model of the board, roughly measured on a T-Higrow
+struct SimModel
+{
+    // current, in mA
+    double cpuBase_mA;        // the rest of the SoC while it is awake
+    double cpuPerMHz_mA;      // added for each MHz of CPU clock
+    double radioActive_mA;    // receiving or transmitting: scanning, associating, ESP-NOW, or with modem sleep off
+    double radioConnected_mA; // associated, in modem sleep between beacons
+    double sensors_mA;        // with POWER_CTRL on
+    double deepSleep_mA;      // the whole board, not just the ESP32
+    double stubWake_mA;
+
+    // time, in us
+    uint32_t boot_us;        // ROM bootloader, loading the app and starting the Arduino core (at 240MHz)
+    uint32_t stubWake_us;    // a wake handled by the wake stub
+    uint32_t association_us; // scan, authentication, association and DHCP
+    uint32_t roundTrip_us;   // to the broker or gateway
+    uint32_t ntp_us;         // from configTime() to the time being set
+    uint32_t packet_us;      // of airtime (and lwIP) per packet sent
+    uint32_t nvsWrite_us;
+    uint32_t tlsPskHandshake_us;   // of CPU at 80MHz, on top of the round trips
+    uint32_t tlsEcdsaHandshake_us; // of CPU at 80MHz, ECDHE and verifying the broker's certificate
+    uint32_t tlsSessionLifetime_s; // how long the broker keeps a session for resumption
+};
+
+/// @brief The totals the driver reports, kept per day
+struct SimStats
+{
+    uint64_t awake_us;
+    uint64_t radioOn_us;
+    double charge_mAs;
+    uint32_t fullBoots;
+    uint32_t stubWakes;
+    uint32_t messagesDelivered; // MQTT publishes, CoAP datagrams and ESP-NOW frames that reached the other end
+    uint32_t nvsWrites;
+};
+
+constexpr size_t kSimNvsEntries = 16;
+constexpr size_t kSimNvsValueSize = 1024;
+constexpr size_t kSimMaxRtcSize = 32 * 1024;
+
+struct SimNvsEntry
+{
+    bool used;
+    char space[16];
+    char key[16];
+    uint16_t length;
+    uint8_t value[kSimNvsValueSize];
+};
+
+/// @brief Everything that outlives a wake (so is shared between the driver and the process of each wake), and the
+/// state of the device that sets the current drawn
+struct SimState
+{
+    uint64_t now_us;       // since the start of the simulation
+    uint64_t wakeStart_us; // when the app started, millis() counts from here
+    uint64_t random;       // xorshift64* state
+    bool verbose;
+
+    // the device during a wake
+    uint32_t cpu_MHz;
+    bool sensorsPowered;
+    bool radioOn;
+    bool modemSleep;
+    uint64_t associated_us; // when the station joined the access point, UINT64_MAX if it isn't (going to be) associated
+    uint64_t radioBusy_us;  // the radio is transmitting or receiving until then
+    uint64_t sleep_us;      // set by esp_sleep_enable_timer_wakeup()
+    bool slept;             // the wake ended in deep sleep
+
+    // kept across deep sleep
+    bool timeSet; // by NTP, the RTC keeps it from then on
+    uint8_t rtc[kSimMaxRtcSize];
+    SimNvsEntry nvs[kSimNvsEntries];
+
+    SimStats totals;
+};
+
+/// @returns the state shared by every process of the simulation
+SimState &simState();
+
+/// @returns the failure rates and model of the simulation, set by the driver before the first wake
+SimFaults &simFaults();
+SimModel &simModel();
+
+/// @brief start the simulation afresh: a new battery, empty NVS and a cold boot
+void simReset(uint64_t seed);
+
+/// @brief the device is awake for \p us, drawing the current of the state it is in
+void simAdvance_us(uint64_t us);
+
+/// @brief the device is in deep sleep for \p us
+void simSleep_us(uint64_t us);
+
+/// @brief the device wakes up in the wake stub, which costs a little time
+void simStubWake();
+
+/// @returns true with probability \p p
+bool simChance(double p);
+
+uint32_t simRandom();
+
+/// @returns the real time, as NTP would set it
+uint32_t simEpoch_s();
+
+/// @returns true if the station is associated with the access point
+bool simNetworkUp();
+
+/// @brief send a packet of \p length bytes, the radio stays busy for its airtime
+void simTransmit(size_t length);
+
+/// @brief wait for an answer from the other end
+void simRoundTrip();
+
+/// @brief the start of a full boot: the app is loaded (which takes time), and the device starts from its reset state
+void simBeginWake();
+
+/// @brief copy the RTC memory of this process to or from the shared state (to carry it over to the next wake)
+void simSaveRtc();
+void simRestoreRtc();
+
+/// @brief run the wake stub, on the RTC memory restored by simRestoreRtc()
+/// @param outSleepTime_ms how long the stub put the device back to sleep for
+/// @returns false if the wake needs a full boot
+bool simWakeStubHandleWake(uint32_t *outSleepTime_ms);
+
+/// @brief set a retained message on the broker, delivered whenever the device subscribes to \p topic
+void simRetain(const char *topic, const uint8_t *payload, size_t length);
+
+#endif
@@ -0,0 +1,548 @@
+// the Arduino core, WiFi and the parts of the IDF the firmware uses, on the simulator's clock
+#include "sim.h"
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "coap.h"
+#include "esp_heap_caps.h"
+#include "esp_now.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "pins.h"
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+
+namespace
+{
+    constexpr uint8_t kMac[6] = {0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56};
+    constexpr uint32_t kLocalIP = 0x0a00a8c0; // 192.168.0.10
+    constexpr uint32_t kServerIP = 0x0200a8c0; // 192.168.0.2
+    constexpr uint8_t kChannel = 6;
+    constexpr uint32_t kAnalogRead_us = 10;
+    constexpr uint32_t kTimePoll_ms = 10; // getLocalTime() polls the clock this often
+
+    // this wake's (so not shared) state
+    bool g_apDown = false;
+    uint64_t g_timeSetAt_us = UINT64_MAX; // when the NTP answer arrives
+    esp_now_send_cb_t g_espNowSent = nullptr;
+    bool g_espNowStarted = false;
+    char g_nvsSpaces[8][16];
+    size_t g_numNvsSpaces = 0;
+
+    SimNvsEntry *findNvsEntry(nvs_handle_t handle, const char *key)
+    {
+        if (handle == 0 || handle > g_numNvsSpaces)
+        {
+            return nullptr;
+        }
+        for (SimNvsEntry &entry : simState().nvs)
+        {
+            if (entry.used && strcmp(entry.space, g_nvsSpaces[handle - 1]) == 0 && strcmp(entry.key, key) == 0)
+            {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    esp_err_t setNvsEntry(nvs_handle_t handle, const char *key, const void *value, size_t length)
+    {
+        if (handle == 0 || handle > g_numNvsSpaces || length > kSimNvsValueSize)
+        {
+            return ESP_FAIL;
+        }
+        SimNvsEntry *entry = findNvsEntry(handle, key);
+        for (size_t i = 0; entry == nullptr && i < kSimNvsEntries; ++i)
+        {
+            if (!simState().nvs[i].used)
+            {
+                entry = &simState().nvs[i];
+                entry->used = true;
+                strncpy(entry->space, g_nvsSpaces[handle - 1], sizeof(entry->space) - 1);
+                strncpy(entry->key, key, sizeof(entry->key) - 1);
+            }
+        }
+        if (entry == nullptr)
+        {
+            return ESP_ERR_NVS_NO_FREE_PAGES;
+        }
+        memcpy(entry->value, value, length);
+        entry->length = length;
+        ++simState().totals.nvsWrites;
+        simAdvance_us(simModel().nvsWrite_us);
+        return ESP_OK;
+    }
+}
+
+unsigned long millis()
+{
+    return (simState().now_us - simState().wakeStart_us) / 1000;
+}
+
+unsigned long micros()
+{
+    return simState().now_us - simState().wakeStart_us;
+}
+
+int64_t esp_timer_get_time()
+{
+    return micros();
+}
+
+void delay(uint32_t ms)
+{
+    simAdvance_us(static_cast<uint64_t>(ms) * 1000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    simAdvance_us(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    if (pin == POWER_CTRL)
+    {
+        simState().sensorsPowered = value == HIGH;
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    // the user button isn't pressed, and nothing holds the I2C bus
+    return HIGH;
+}
+
+uint16_t analogRead(uint8_t pin)
+{
+    simAdvance_us(kAnalogRead_us);
+    return 1800 + simRandom() % 64;
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+bool setCpuFrequencyMhz(uint32_t mhz)
+{
+    simState().cpu_MHz = mhz;
+    return true;
+}
+
+uint32_t getCpuFrequencyMhz()
+{
+    return simState().cpu_MHz;
+}
+
+uint32_t esp_random()
+{
+    return simRandom();
+}
+
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac)
+{
+    memcpy(mac, kMac, sizeof(kMac));
+    return ESP_OK;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    return 180 * 1024;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return 110 * 1024;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    if (simState().verbose)
+    {
+        fputc(c, stderr);
+    }
+    return 1;
+}
+
+void configTime(long gmtOffset_s, int daylightOffset_s, const char *server1, const char *server2, const char *server3)
+{
+    if (simNetworkUp())
+    {
+        simTransmit(48);
+        if (!simChance(simFaults().ntpFails))
+        {
+            g_timeSetAt_us = simState().now_us + simModel().ntp_us;
+        }
+    }
+}
+
+bool getLocalTime(struct tm *info, uint32_t ms)
+{
+    SimState &state = simState();
+    const uint64_t start_us = state.now_us;
+    while (true)
+    {
+        if (!state.timeSet && g_timeSetAt_us <= state.now_us)
+        {
+            state.timeSet = true;
+        }
+        if (state.timeSet)
+        {
+            const time_t now = simEpoch_s();
+            gmtime_r(&now, info);
+            return true;
+        }
+        if (state.now_us - start_us > static_cast<uint64_t>(ms) * 1000)
+        {
+            return false;
+        }
+        delay(kTimePoll_ms);
+    }
+}
+
+bool WiFiClass::mode(wifi_mode_t mode)
+{
+    SimState &state = simState();
+    state.radioOn = mode != WIFI_OFF;
+    if (!state.radioOn)
+    {
+        state.associated_us = UINT64_MAX;
+    }
+    return true;
+}
+
+wifi_mode_t WiFiClass::getMode()
+{
+    return simState().radioOn ? WIFI_STA : WIFI_OFF;
+}
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *passphrase)
+{
+    SimState &state = simState();
+    state.radioOn = true;
+    g_apDown = simChance(simFaults().apDown);
+    state.associated_us = g_apDown ? UINT64_MAX : state.now_us + simModel().association_us;
+    return WL_DISCONNECTED;
+}
+
+wl_status_t WiFiClass::status()
+{
+    if (simNetworkUp())
+    {
+        return WL_CONNECTED;
+    }
+    return g_apDown ? WL_NO_SSID_AVAIL : WL_DISCONNECTED;
+}
+
+uint8_t WiFiClass::waitForConnectResult()
+{
+    return status();
+}
+
+bool WiFiClass::disconnect(bool wifiOff)
+{
+    SimState &state = simState();
+    state.associated_us = UINT64_MAX;
+    if (wifiOff)
+    {
+        state.radioOn = false;
+    }
+    return true;
+}
+
+bool WiFiClass::setSleep(bool enabled)
+{
+    simState().modemSleep = enabled;
+    return true;
+}
+
+IPAddress WiFiClass::localIP()
+{
+    return simNetworkUp() ? kLocalIP : 0;
+}
+
+uint8_t *WiFiClass::macAddress(uint8_t *mac)
+{
+    memcpy(mac, kMac, sizeof(kMac));
+    return mac;
+}
+
+int32_t WiFiClass::channel()
+{
+    return kChannel;
+}
+
+int WiFiClass::hostByName(const char *host, IPAddress &result)
+{
+    if (!simNetworkUp())
+    {
+        return 0;
+    }
+    // mDNS or DNS, either way a round trip
+    simTransmit(64);
+    simRoundTrip();
+    result = kServerIP;
+    return 1;
+}
+
+int16_t WiFiClass::scanNetworks()
+{
+    simState().radioOn = true;
+    delay(2000);
+    return 0;
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port)
+{
+    if (!simNetworkUp())
+    {
+        return 0;
+    }
+    // SYN, SYN-ACK, and the ACK goes out with the first data
+    simTransmit(60);
+    simRoundTrip();
+    m_connected = true;
+    return 1;
+}
+
+int WiFiClient::connect(const char *host, uint16_t port)
+{
+    IPAddress ip;
+    return WiFi.hostByName(host, ip) == 1 && connect(ip, port);
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *config)
+{
+    memset(config, 0, sizeof(wifi_config_t));
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second)
+{
+    return simState().radioOn ? ESP_OK : ESP_FAIL;
+}
+
+uint8_t WiFiUDP::begin(uint16_t port)
+{
+    return simNetworkUp() ? 1 : 0;
+}
+
+void WiFiUDP::stop()
+{
+    m_length = 0;
+    m_responseLength = 0;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
+{
+    m_length = 0;
+    return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size)
+{
+    size = std::min(size, sizeof(m_datagram) - m_length);
+    memcpy(m_datagram + m_length, buffer, size);
+    m_length += size;
+    return size;
+}
+
+int WiFiUDP::endPacket()
+{
+    if (!simNetworkUp())
+    {
+        return 0;
+    }
+    simTransmit(m_length);
+    const size_t tokenLength = m_datagram[0] & 0x0F;
+    if (m_length < 4 + tokenLength || simChance(simFaults().packetLoss))
+    {
+        return 1;
+    }
+
+    // the gateway acknowledges it, with the same message ID and token
+    ++simState().totals.messagesDelivered;
+    m_response[0] = 0x60 | tokenLength; // version 1, acknowledgement
+    m_response[1] = kCoapCodeChanged;
+    memcpy(m_response + 2, m_datagram + 2, 2 + tokenLength);
+    m_responseLength = 4 + tokenLength;
+    m_responseAt_us = simState().now_us + simModel().roundTrip_us;
+    simState().radioBusy_us = std::max(simState().radioBusy_us, m_responseAt_us);
+    return 1;
+}
+
+int WiFiUDP::parsePacket()
+{
+    if (m_responseLength == 0 || simState().now_us < m_responseAt_us)
+    {
+        return 0;
+    }
+    return m_responseLength;
+}
+
+int WiFiUDP::read(uint8_t *buffer, size_t length)
+{
+    const size_t numRead = std::min(length, m_responseLength);
+    memcpy(buffer, m_response, numRead);
+    m_responseLength = 0;
+    return numRead;
+}
+
+esp_err_t esp_now_init()
+{
+    if (!simState().radioOn)
+    {
+        return ESP_FAIL;
+    }
+    g_espNowStarted = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_deinit()
+{
+    g_espNowStarted = false;
+    g_espNowSent = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t callback)
+{
+    g_espNowSent = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t callback)
+{
+    // the simulated devices are all nodes, nothing is ever received
+    return ESP_OK;
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t *peer)
+{
+    return g_espNowStarted ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_now_send(const uint8_t *peer, const uint8_t *data, size_t length)
+{
+    if (!g_espNowStarted)
+    {
+        return ESP_FAIL;
+    }
+    // the MAC layer acknowledgement
+    simTransmit(length);
+    simAdvance_us(simModel().packet_us);
+    const bool delivered = !simChance(simFaults().packetLoss);
+    if (delivered)
+    {
+        ++simState().totals.messagesDelivered;
+    }
+    if (g_espNowSent != nullptr)
+    {
+        g_espNowSent(peer, delivered ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_init()
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase()
+{
+    memset(simState().nvs, 0, sizeof(simState().nvs));
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode mode, nvs_handle_t *outHandle)
+{
+    for (size_t i = 0; i < g_numNvsSpaces; ++i)
+    {
+        if (strcmp(g_nvsSpaces[i], name) == 0)
+        {
+            *outHandle = i + 1;
+            return ESP_OK;
+        }
+    }
+    if (g_numNvsSpaces == sizeof(g_nvsSpaces) / sizeof(g_nvsSpaces[0]))
+    {
+        return ESP_FAIL;
+    }
+    strncpy(g_nvsSpaces[g_numNvsSpaces], name, sizeof(g_nvsSpaces[0]) - 1);
+    *outHandle = ++g_numNvsSpaces;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *outValue, size_t *length)
+{
+    const SimNvsEntry *entry = findNvsEntry(handle, key);
+    if (entry == nullptr)
+    {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (outValue == nullptr)
+    {
+        *length = entry->length;
+        return ESP_OK;
+    }
+    if (*length < entry->length)
+    {
+        *length = entry->length;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(outValue, entry->value, entry->length);
+    *length = entry->length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return setNvsEntry(handle, key, value, length);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *outValue, size_t *length)
+{
+    return nvs_get_blob(handle, key, outValue, length);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return setNvsEntry(handle, key, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *outValue)
+{
+    size_t length = sizeof(uint32_t);
+    return nvs_get_blob(handle, key, outValue, &length);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return setNvsEntry(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    SimNvsEntry *entry = findNvsEntry(handle, key);
+    if (entry == nullptr)
+    {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    entry->used = false;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
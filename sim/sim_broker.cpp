@@ -0,0 +1,210 @@
+// the broker, and the server behind it, as seen through PubSubClient
+#include "sim.h"
+#include <string>
+#include <vector>
+#include "PubSubClient.h"
+
+namespace
+{
+    constexpr size_t kMqttHeaderSize = 5 + 2; // fixed header and topic length, as PubSubClient counts them
+    constexpr char kRegistryTopicRoot[] = "registry/";
+    constexpr uint32_t kServerResponse_us = 50000; // for the server to name a device
+
+    struct Message
+    {
+        std::string topic;
+        std::vector<uint8_t> payload;
+        uint64_t at_us; // when it reaches the device
+    };
+
+    // set up by the driver, so the same in every wake
+    std::vector<Message> g_retained;
+
+    // this wake's session
+    std::vector<std::string> g_subscriptions;
+    std::vector<Message> g_inbound;
+
+    bool isSubscribed(const std::string &topic)
+    {
+        for (const std::string &subscription : g_subscriptions)
+        {
+            if (subscription == topic)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void send(const std::string &topic, const uint8_t *payload, size_t length, uint64_t delay_us)
+    {
+        g_inbound.push_back({topic, std::vector<uint8_t>(payload, payload + length), simState().now_us + delay_us});
+        simState().radioBusy_us = std::max(simState().radioBusy_us, simState().now_us + delay_us);
+    }
+}
+
+void simRetain(const char *topic, const uint8_t *payload, size_t length)
+{
+    g_retained.push_back({topic, std::vector<uint8_t>(payload, payload + length), 0});
+}
+
+PubSubClient &PubSubClient::setServer(const char *domain, uint16_t port)
+{
+    m_domain = domain;
+    m_port = port;
+    return *this;
+}
+
+PubSubClient &PubSubClient::setClient(Client &client)
+{
+    m_client = &client;
+    return *this;
+}
+
+PubSubClient &PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE)
+{
+    this->callback = callback;
+    return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size)
+{
+    m_bufferSize = size;
+    return true;
+}
+
+bool PubSubClient::connect(const char *id)
+{
+    if (!m_client->connect(m_domain, m_port))
+    {
+        m_state = MQTT_CONNECT_FAILED;
+        return false;
+    }
+
+    // CONNECT and CONNACK
+    simTransmit(kMqttHeaderSize + strlen(id));
+    simRoundTrip();
+    if (simChance(simFaults().brokerRefuses))
+    {
+        m_client->stop();
+        m_state = MQTT_CONNECT_UNAVAILABLE;
+        return false;
+    }
+    g_subscriptions.clear();
+    g_inbound.clear();
+    m_state = MQTT_CONNECTED;
+    return true;
+}
+
+void PubSubClient::disconnect()
+{
+    if (connected())
+    {
+        simTransmit(2);
+    }
+    m_client->stop();
+    m_state = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::connected()
+{
+    if (m_state == MQTT_CONNECTED && (!m_client->connected() || !simNetworkUp()))
+    {
+        m_state = MQTT_CONNECTION_LOST;
+    }
+    return m_state == MQTT_CONNECTED;
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload)
+{
+    return publish(topic, reinterpret_cast<const uint8_t *>(payload), strlen(payload));
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length)
+{
+    return publish(topic, payload, length, false);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained)
+{
+    // like PubSubClient, anything that doesn't fit in the buffer isn't sent at all
+    if (!connected() || kMqttHeaderSize + strlen(topic) + length > m_bufferSize)
+    {
+        return false;
+    }
+    simTransmit(kMqttHeaderSize + strlen(topic) + length);
+    ++simState().totals.messagesDelivered;
+
+    // the server names the device that asks on registry/<mac>
+    if (strncmp(topic, kRegistryTopicRoot, strlen(kRegistryTopicRoot)) == 0 && strchr(topic + strlen(kRegistryTopicRoot), '/') == nullptr)
+    {
+        static const char kName[] = "sensor0";
+        send(std::string(topic) + "/name", reinterpret_cast<const uint8_t *>(kName), strlen(kName), simModel().roundTrip_us + kServerResponse_us);
+    }
+    return true;
+}
+
+bool PubSubClient::subscribe(const char *topic, uint8_t qos)
+{
+    if (!connected())
+    {
+        return false;
+    }
+    // SUBSCRIBE, the SUBACK is left to arrive with anything retained
+    simTransmit(kMqttHeaderSize + strlen(topic) + 1);
+    g_subscriptions.push_back(topic);
+    for (const Message &message : g_retained)
+    {
+        if (message.topic == topic)
+        {
+            send(message.topic, message.payload.data(), message.payload.size(), simModel().roundTrip_us);
+        }
+    }
+    return true;
+}
+
+bool PubSubClient::unsubscribe(const char *topic)
+{
+    if (!connected())
+    {
+        return false;
+    }
+    simTransmit(kMqttHeaderSize + strlen(topic));
+    for (auto it = g_subscriptions.begin(); it != g_subscriptions.end(); ++it)
+    {
+        if (*it == topic)
+        {
+            g_subscriptions.erase(it);
+            break;
+        }
+    }
+    return true;
+}
+
+bool PubSubClient::loop()
+{
+    if (!connected())
+    {
+        return false;
+    }
+    for (auto it = g_inbound.begin(); it != g_inbound.end();)
+    {
+        if (it->at_us > simState().now_us)
+        {
+            ++it;
+            continue;
+        }
+        const Message message = *it;
+        it = g_inbound.erase(it);
+        if (callback && isSubscribed(message.topic))
+        {
+            std::vector<char> topic(message.topic.begin(), message.topic.end());
+            topic.push_back(0);
+            std::vector<uint8_t> payload = message.payload;
+            callback(topic.data(), payload.data(), payload.size());
+            // the callback may have changed what is waiting
+            it = g_inbound.begin();
+        }
+    }
+    return true;
+}
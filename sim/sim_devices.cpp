@@ -0,0 +1,134 @@
+// the sensors and the peripherals they are read through
+#include "sim.h"
+#include <BH1750.h>
+#include <Wire.h>
+#include "DHT12_sensor_library/DHT12.h"
+#include "driver/adc.h"
+#include "driver/pcnt.h"
+
+TwoWire Wire;
+
+namespace
+{
+    constexpr uint32_t kI2CTransaction_us = 200;
+    constexpr uint32_t kDHT12Read_us = 5000; // the start signal and 40 bits over the one wire interface
+
+    bool g_dht12ReadFailed = false;
+}
+
+bool TwoWire::begin(int sda, int scl)
+{
+    return true;
+}
+
+uint8_t TwoWire::endTransmission()
+{
+    simAdvance_us(kI2CTransaction_us);
+    return 0;
+}
+
+bool BH1750::begin(Mode mode)
+{
+    return configure(mode);
+}
+
+bool BH1750::configure(Mode mode)
+{
+    simAdvance_us(kI2CTransaction_us);
+    return true;
+}
+
+float BH1750::readLightLevel()
+{
+    simAdvance_us(kI2CTransaction_us);
+    return 250.0f + simRandom() % 100;
+}
+
+DHT12::DHT12(uint8_t addressORPin, bool oneWire) : _isOneWire(oneWire), _pin(addressORPin)
+{
+}
+
+void DHT12::begin()
+{
+}
+
+float DHT12::readTemperature(bool scale, bool force)
+{
+    // reads both, the humidity comes from the same read
+    simAdvance_us(kDHT12Read_us);
+    g_dht12ReadFailed = simChance(simFaults().dhtNaN);
+    return g_dht12ReadFailed ? NAN : 18.0f + (simRandom() % 50) / 10.0f;
+}
+
+float DHT12::readHumidity(bool force)
+{
+    return g_dht12ReadFailed ? NAN : 50.0f + (simRandom() % 100) / 10.0f;
+}
+
+void adc_power_acquire()
+{
+}
+
+void adc_power_release()
+{
+}
+
+esp_err_t pcnt_unit_config(const pcnt_config_t *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t value)
+{
+    return ESP_OK;
+}
+
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit)
+{
+    return ESP_OK;
+}
+
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t event)
+{
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_service_install(int flags)
+{
+    return ESP_OK;
+}
+
+void pcnt_isr_service_uninstall()
+{
+}
+
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*handler)(void *), void *arg)
+{
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_handler_remove(pcnt_unit_t unit)
+{
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit)
+{
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit)
+{
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit)
+{
+    return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t *count)
+{
+    *count = 0;
+    return ESP_OK;
+}
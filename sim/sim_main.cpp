@@ -0,0 +1,604 @@
+// the driver: runs the wakes of a scenario for a number of days, and reports what they cost
+#include "sim.h"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "device_config.h"
+#include "log.h"
+
+void setup();
+
+namespace
+{
+    constexpr uint64_t kDay_us = 24ull * 60 * 60 * 1000 * 1000;
+    constexpr char kSsid[] = "sim";
+    constexpr char kPsk[] = "password";
+    constexpr char kSensorName[] = "sensor0";
+    constexpr uint8_t kTlsPsk[16] = {0x5e, 0x1f, 0x0a, 0x9b, 0x33, 0x71, 0xc4, 0x08, 0xde, 0x62, 0x4a, 0xf0, 0x17, 0x85, 0xb9, 0x2c};
+    constexpr uint8_t kRelayPeer[6] = {0x24, 0x0a, 0xc4, 0x65, 0x43, 0x21};
+    constexpr uint8_t kRelayChannel = 6;
+    constexpr uint32_t kDefaultDays = 30;
+    constexpr uint64_t kDefaultSeed = 1;
+    constexpr double kDefaultCapacity_mAh = 2000; // an 18650 cell, derated for the cold and the cut off voltage
+    constexpr double kDefaultTolerance = 0.02;
+
+    struct Scenario
+    {
+        const char *name;
+        const char *description;
+        void (*configure)(DeviceConfig *config);
+        SimFaults faults;
+    };
+
+    void configureDefault(DeviceConfig *config)
+    {
+    }
+
+    void configureAggregation(DeviceConfig *config)
+    {
+        config->aggregateSamplesPerMeasurement = 4;
+    }
+
+    void configureCoAP(DeviceConfig *config)
+    {
+        config->transport = kTransportCoAP;
+    }
+
+    void configureTlsPsk(DeviceConfig *config)
+    {
+        setConfigTlsPsk("ttgo", kTlsPsk, sizeof(kTlsPsk));
+    }
+
+    void configureTlsEcdsa(DeviceConfig *config)
+    {
+        config->tlsMode = kTlsEcdsa;
+    }
+
+    void configureRelayNode(DeviceConfig *config)
+    {
+        config->relayRole = kRelayRoleNode;
+        memcpy(config->relayPeer, kRelayPeer, sizeof(kRelayPeer));
+        config->relayChannel = kRelayChannel;
+    }
+
+    // the faults are apDown, brokerRefuses, dhtNaN, ntpFails and packetLoss
+    const Scenario kScenarios[] = {
+        {"default", "a measurement every 2 minutes, sent in batches of 5 over MQTT", configureDefault, {0, 0, 0, 0, 0}},
+        {"aggregation", "light, soil and salt sampled 4 times per measurement", configureAggregation, {0, 0, 0, 0, 0}},
+        {"coap", "batches posted to the CoAP gateway", configureCoAP, {0, 0, 0, 0, 0}},
+        {"coap_loss_5pct", "batches posted to the CoAP gateway, losing 5% of datagrams", configureCoAP, {0, 0, 0, 0, 0.05}},
+        {"tls_psk", "MQTT over TLS with a pre-shared key", configureTlsPsk, {0, 0, 0, 0, 0}},
+        {"tls_ecdsa", "MQTT over TLS, verifying the broker's ECDSA certificate", configureTlsEcdsa, {0, 0, 0, 0, 0}},
+        {"relay_node", "batches sent to a relay over ESP-NOW", configureRelayNode, {0, 0, 0, 0, 0}},
+        {"ap_down_10pct", "the access point is down for 10% of wakes", configureDefault, {0.1, 0, 0, 0, 0}},
+        {"broker_refuses_10pct", "the broker refuses 10% of connections", configureDefault, {0, 0.1, 0, 0, 0}},
+        {"dht_nan_20pct", "20% of DHT12 reads return NaN", configureDefault, {0, 0, 0.2, 0, 0}},
+    };
+
+    struct Options
+    {
+        const char *scenario = "default";
+        uint32_t days = kDefaultDays;
+        uint64_t seed = kDefaultSeed;
+        double capacity_mAh = kDefaultCapacity_mAh;
+        bool daily = false;
+        const char *checkPath = nullptr;
+        const char *writeBaselinePath = nullptr;
+        double tolerance = kDefaultTolerance;
+
+        // overrides of the scenario, negative if not set
+        SimFaults faults = {-1, -1, -1, -1, -1};
+        long timeBetweenMeasurements_s = -1;
+        long numMeasurementsPerBatch = -1;
+        long aggregateSamplesPerMeasurement = -1;
+        long timeBetweenRTCUpdates_s = -1;
+        long numTransmitSlots = -1;
+    };
+
+    /// @brief prints the lines of logDump() after the first \p skip, for the entries a wake added
+    class LogTail : public Print
+    {
+    public:
+        explicit LogTail(size_t skip) : m_skip(skip) {}
+        size_t write(uint8_t c) override
+        {
+            if (m_line >= m_skip)
+            {
+                fputc(c, stderr);
+            }
+            if (c == '\n')
+            {
+                ++m_line;
+            }
+            return 1;
+        }
+
+    private:
+        size_t m_skip;
+        size_t m_line = 0;
+    };
+
+    struct Result
+    {
+        std::vector<SimStats> days;
+        SimStats total;
+    };
+
+    const Scenario *findScenario(const char *name)
+    {
+        for (const Scenario &scenario : kScenarios)
+        {
+            if (strcmp(scenario.name, name) == 0)
+            {
+                return &scenario;
+            }
+        }
+        return nullptr;
+    }
+
+    void override(double value, double *setting)
+    {
+        if (value >= 0)
+        {
+            *setting = value;
+        }
+    }
+
+    void applyOverrides(const Options &options, DeviceConfig *config)
+    {
+        if (options.timeBetweenMeasurements_s >= 0)
+        {
+            config->timeBetweenMeasurements_ms = options.timeBetweenMeasurements_s * 1000;
+        }
+        if (options.numMeasurementsPerBatch >= 0)
+        {
+            config->numMeasurementsToTakeBeforeSending = options.numMeasurementsPerBatch;
+        }
+        if (options.aggregateSamplesPerMeasurement >= 0)
+        {
+            config->aggregateSamplesPerMeasurement = options.aggregateSamplesPerMeasurement;
+        }
+        if (options.timeBetweenRTCUpdates_s >= 0)
+        {
+            config->timeBetweenRTCUpdates_ms = options.timeBetweenRTCUpdates_s * 1000;
+        }
+        if (options.numTransmitSlots >= 0)
+        {
+            config->numTransmitSlots = options.numTransmitSlots;
+        }
+    }
+
+    /// @brief run \p work in a process of its own, as the device runs a wake
+    /// @returns the exit status of the process
+    int runForked(void (*work)(const Scenario &, const Options &), const Scenario &scenario, const Options &options)
+    {
+        fflush(stdout);
+        fflush(stderr);
+        const pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("fork");
+            exit(1);
+        }
+        if (pid == 0)
+        {
+            work(scenario, options);
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+    /// @brief store the configuration of the scenario, as if the device had been set up through the button
+    void provision(const Scenario &scenario, const Options &options)
+    {
+        loadDeviceConfig();
+        setConfigWifiCredentials(kSsid, kPsk);
+        setConfigSensorName(kSensorName);
+        scenario.configure(&deviceConfig());
+        applyOverrides(options, &deviceConfig());
+        _exit(commitDeviceConfig() ? 0 : 1);
+    }
+
+    void wake(const Scenario &scenario, const Options &options)
+    {
+        simBeginWake();
+        setup();
+        fprintf(stderr, "setup() returned without going to sleep\n");
+        _exit(3);
+    }
+
+    SimStats difference(const SimStats &end, const SimStats &start)
+    {
+        SimStats stats;
+        stats.awake_us = end.awake_us - start.awake_us;
+        stats.radioOn_us = end.radioOn_us - start.radioOn_us;
+        stats.charge_mAs = end.charge_mAs - start.charge_mAs;
+        stats.fullBoots = end.fullBoots - start.fullBoots;
+        stats.stubWakes = end.stubWakes - start.stubWakes;
+        stats.messagesDelivered = end.messagesDelivered - start.messagesDelivered;
+        stats.nvsWrites = end.nvsWrites - start.nvsWrites;
+        return stats;
+    }
+
+    Result runScenario(const Scenario &scenario, const Options &options)
+    {
+        simReset(options.seed);
+        SimFaults &faults = simFaults();
+        faults = scenario.faults;
+        override(options.faults.apDown, &faults.apDown);
+        override(options.faults.brokerRefuses, &faults.brokerRefuses);
+        override(options.faults.dhtNaN, &faults.dhtNaN);
+        override(options.faults.ntpFails, &faults.ntpFails);
+        override(options.faults.packetLoss, &faults.packetLoss);
+
+        SimState &state = simState();
+        if (runForked(provision, scenario, options) != 0)
+        {
+            fprintf(stderr, "%s: couldn't store the configuration\n", scenario.name);
+            exit(1);
+        }
+        // setting up doesn't count
+        state.now_us = 0;
+        state.totals = SimStats();
+
+        Result result;
+        SimStats dayStart = SimStats();
+        uint64_t nextDay_us = kDay_us;
+        const uint64_t end_us = options.days * kDay_us;
+        auto sleep = [&](uint64_t sleep_us)
+        {
+            while (sleep_us > 0)
+            {
+                const uint64_t step_us = std::min(sleep_us, nextDay_us - state.now_us);
+                simSleep_us(step_us);
+                sleep_us -= step_us;
+                if (state.now_us >= nextDay_us)
+                {
+                    result.days.push_back(difference(state.totals, dayStart));
+                    dayStart = state.totals;
+                    nextDay_us += kDay_us;
+                }
+            }
+        };
+
+        while (state.now_us < end_us)
+        {
+            const uint64_t wakeStart_us = state.now_us;
+            const double wakeStart_mAs = state.totals.charge_mAs;
+            const size_t logEntriesBefore = logNumEntries();
+            if (runForked(wake, scenario, options) != 0 || !state.slept)
+            {
+                fprintf(stderr, "%s: the wake at %.0fs didn't end in deep sleep\n", scenario.name, wakeStart_us / 1e6);
+                exit(1);
+            }
+            simRestoreRtc();
+            if (state.verbose)
+            {
+                fprintf(stderr, "\n[%.1fs] awake for %.0fms, %.2fmAs, sleeping for %.0fs\n",
+                        wakeStart_us / 1e6, (state.now_us - wakeStart_us) / 1e3,
+                        state.totals.charge_mAs - wakeStart_mAs, state.sleep_us / 1e6);
+                // the log was cleared if it has fewer entries than before
+                LogTail tail(logNumEntries() >= logEntriesBefore ? logEntriesBefore : 0);
+                logDump(tail);
+            }
+
+            // the wakes the stub handles come straight back here
+            uint64_t sleep_us = state.sleep_us;
+            uint32_t stubSleep_ms;
+            while (true)
+            {
+                sleep(sleep_us);
+                if (state.now_us >= end_us || !simWakeStubHandleWake(&stubSleep_ms))
+                {
+                    break;
+                }
+                simStubWake();
+                sleep_us = stubSleep_ms * 1000ull;
+            }
+        }
+
+        result.days.resize(options.days);
+        result.total = SimStats();
+        for (const SimStats &day : result.days)
+        {
+            result.total.awake_us += day.awake_us;
+            result.total.radioOn_us += day.radioOn_us;
+            result.total.charge_mAs += day.charge_mAs;
+            result.total.fullBoots += day.fullBoots;
+            result.total.stubWakes += day.stubWakes;
+            result.total.messagesDelivered += day.messagesDelivered;
+            result.total.nvsWrites += day.nvsWrites;
+        }
+        return result;
+    }
+
+    double perDay_mAh(const Result &result)
+    {
+        return result.total.charge_mAs / 3600 / result.days.size();
+    }
+
+    double awakePerDay_s(const Result &result)
+    {
+        return result.total.awake_us / 1e6 / result.days.size();
+    }
+
+    void printHeader()
+    {
+        printf("%-22s %5s %11s %11s %8s %9s %9s %9s %10s %12s\n",
+               "scenario", "days", "awake s/day", "radio s/day", "mAh/day", "boots/day", "stub/day", "msgs/day", "nvs writes", "battery days");
+    }
+
+    void printStats(const char *name, uint32_t days, const SimStats &stats, double capacity_mAh)
+    {
+        const double mAhPerDay = stats.charge_mAs / 3600 / days;
+        printf("%-22s %5u %11.1f %11.1f %8.2f %9.1f %9.1f %9.1f %10u %12.0f\n",
+               name, days, stats.awake_us / 1e6 / days, stats.radioOn_us / 1e6 / days, mAhPerDay,
+               static_cast<double>(stats.fullBoots) / days, static_cast<double>(stats.stubWakes) / days,
+               static_cast<double>(stats.messagesDelivered) / days, stats.nvsWrites, capacity_mAh / mAhPerDay);
+    }
+
+    void printResult(const char *name, const Result &result, const Options &options)
+    {
+        if (options.daily)
+        {
+            for (size_t day = 0; day < result.days.size(); ++day)
+            {
+                char dayName[64];
+                snprintf(dayName, sizeof(dayName), "%s day %zu", name, day + 1);
+                printStats(dayName, 1, result.days[day], options.capacity_mAh);
+            }
+        }
+        printStats(name, result.days.size(), result.total, options.capacity_mAh);
+    }
+
+    /// @brief run every scenario, and store what they cost at \p path
+    bool writeBaseline(const char *path, const Options &options)
+    {
+        FILE *file = fopen(path, "w");
+        if (file == nullptr)
+        {
+            perror(path);
+            return false;
+        }
+        fprintf(file, "# written by the simulator with --write-baseline, checked with --check (see README)\n");
+        fprintf(file, "# scenario days seed mAh/day awake_s/day\n");
+        printHeader();
+        for (const Scenario &scenario : kScenarios)
+        {
+            const Result result = runScenario(scenario, options);
+            printResult(scenario.name, result, options);
+            fprintf(file, "%s %u %llu %.4f %.3f\n", scenario.name, options.days,
+                    static_cast<unsigned long long>(options.seed), perDay_mAh(result), awakePerDay_s(result));
+        }
+        fclose(file);
+        return true;
+    }
+
+    /// @brief run the scenarios in the baseline at \p path, as they were run for it
+    /// @returns false if any of them uses more charge, or is awake for longer, than the baseline allows
+    bool checkBaseline(const char *path, const Options &options)
+    {
+        FILE *file = fopen(path, "r");
+        if (file == nullptr)
+        {
+            perror(path);
+            return false;
+        }
+        bool passed = true;
+        char line[256];
+        while (fgets(line, sizeof(line), file) != nullptr)
+        {
+            char name[64];
+            unsigned int days;
+            unsigned long long seed;
+            double baseline_mAh;
+            double baselineAwake_s;
+            if (line[0] == '#' || sscanf(line, "%63s %u %llu %lf %lf", name, &days, &seed, &baseline_mAh, &baselineAwake_s) != 5)
+            {
+                continue;
+            }
+            const Scenario *scenario = findScenario(name);
+            if (scenario == nullptr)
+            {
+                printf("%-22s unknown scenario\n", name);
+                passed = false;
+                continue;
+            }
+
+            Options baselineOptions;
+            baselineOptions.days = days;
+            baselineOptions.seed = seed;
+            const Result result = runScenario(*scenario, baselineOptions);
+            const double change_mAh = perDay_mAh(result) / baseline_mAh - 1;
+            const double changeAwake = awakePerDay_s(result) / baselineAwake_s - 1;
+            const bool regressed = change_mAh > options.tolerance || changeAwake > options.tolerance;
+            const bool improved = change_mAh < -options.tolerance || changeAwake < -options.tolerance;
+            printf("%-22s %8.2f mAh/day (%+.1f%%) %8.1f awake s/day (%+.1f%%)  %s\n",
+                   name, perDay_mAh(result), change_mAh * 100, awakePerDay_s(result), changeAwake * 100,
+                   regressed ? "REGRESSED" : improved ? "improved, update the baseline" : "ok");
+            passed = passed && !regressed;
+        }
+        fclose(file);
+        return passed;
+    }
+
+    void printUsage(const char *program)
+    {
+        printf("usage: %s [options]\n"
+               "  --scenario <name>|all         what to simulate (default: default), see --list\n"
+               "  --list                        list the scenarios\n"
+               "  --days <n>                    how long to simulate (default: %u)\n"
+               "  --seed <n>                    for the failures and readings (default: %llu)\n"
+               "  --daily                       report every day, not just the average\n"
+               "  --capacity-mAh <mAh>          of the battery, for the battery life (default: %.0f)\n"
+               "  --verbose                     print the serial output, and a line per wake\n"
+               "failure rates, each a probability that overrides the scenario's:\n"
+               "  --ap-down <p>                 the access point is down for a wake\n"
+               "  --broker-refuses <p>          the broker refuses a connection\n"
+               "  --dht-nan <p>                 a DHT12 read returns NaN\n"
+               "  --ntp-fails <p>               an NTP request goes unanswered\n"
+               "  --packet-loss <p>             a CoAP datagram or ESP-NOW frame isn't acknowledged\n"
+               "configuration, overriding the scenario's:\n"
+               "  --measurement-interval-s <s>  time between measurements\n"
+               "  --batch-size <n>              measurements per batch\n"
+               "  --aggregate-samples <n>       samples of light, soil and salt per measurement\n"
+               "  --rtc-update-s <s>            time between NTP updates\n"
+               "  --transmit-slots <n>          0 to leave transmissions where they fall\n"
+               "regression checks:\n"
+               "  --write-baseline <path>       run every scenario and store what they cost\n"
+               "  --check <path>                fail if a scenario costs more than its baseline\n"
+               "  --tolerance <fraction>        allowed before --check fails (default: %.2f)\n",
+               program, kDefaultDays, static_cast<unsigned long long>(kDefaultSeed), kDefaultCapacity_mAh, kDefaultTolerance);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // getLocalTime() gives UTC, so mktime() has to take it as such
+    setenv("TZ", "UTC0", 1);
+    tzset();
+
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        const char *value = hasValue ? argv[i + 1] : "";
+        auto isOption = [&](const char *name)
+        {
+            if (strcmp(arg, name) != 0)
+            {
+                return false;
+            }
+            if (!hasValue)
+            {
+                fprintf(stderr, "%s needs a value\n", name);
+                exit(2);
+            }
+            ++i;
+            return true;
+        };
+
+        if (strcmp(arg, "--list") == 0)
+        {
+            for (const Scenario &scenario : kScenarios)
+            {
+                printf("%-22s %s\n", scenario.name, scenario.description);
+            }
+            return 0;
+        }
+        else if (strcmp(arg, "--daily") == 0)
+        {
+            options.daily = true;
+        }
+        else if (strcmp(arg, "--verbose") == 0)
+        {
+            simState().verbose = true;
+        }
+        else if (strcmp(arg, "--help") == 0)
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else if (isOption("--scenario"))
+        {
+            options.scenario = value;
+        }
+        else if (isOption("--days"))
+        {
+            options.days = std::max(atoi(value), 1);
+        }
+        else if (isOption("--seed"))
+        {
+            options.seed = strtoull(value, nullptr, 10);
+        }
+        else if (isOption("--capacity-mAh"))
+        {
+            options.capacity_mAh = atof(value);
+        }
+        else if (isOption("--ap-down"))
+        {
+            options.faults.apDown = atof(value);
+        }
+        else if (isOption("--broker-refuses"))
+        {
+            options.faults.brokerRefuses = atof(value);
+        }
+        else if (isOption("--dht-nan"))
+        {
+            options.faults.dhtNaN = atof(value);
+        }
+        else if (isOption("--ntp-fails"))
+        {
+            options.faults.ntpFails = atof(value);
+        }
+        else if (isOption("--packet-loss"))
+        {
+            options.faults.packetLoss = atof(value);
+        }
+        else if (isOption("--measurement-interval-s"))
+        {
+            options.timeBetweenMeasurements_s = atol(value);
+        }
+        else if (isOption("--batch-size"))
+        {
+            options.numMeasurementsPerBatch = atol(value);
+        }
+        else if (isOption("--aggregate-samples"))
+        {
+            options.aggregateSamplesPerMeasurement = atol(value);
+        }
+        else if (isOption("--rtc-update-s"))
+        {
+            options.timeBetweenRTCUpdates_s = atol(value);
+        }
+        else if (isOption("--transmit-slots"))
+        {
+            options.numTransmitSlots = atol(value);
+        }
+        else if (isOption("--write-baseline"))
+        {
+            options.writeBaselinePath = value;
+        }
+        else if (isOption("--check"))
+        {
+            options.checkPath = value;
+        }
+        else if (isOption("--tolerance"))
+        {
+            options.tolerance = atof(value);
+        }
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", arg);
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (options.writeBaselinePath != nullptr)
+    {
+        return writeBaseline(options.writeBaselinePath, options) ? 0 : 1;
+    }
+    if (options.checkPath != nullptr)
+    {
+        return checkBaseline(options.checkPath, options) ? 0 : 1;
+    }
+
+    printHeader();
+    for (const Scenario &scenario : kScenarios)
+    {
+        if (strcmp(options.scenario, "all") == 0 || strcmp(options.scenario, scenario.name) == 0)
+        {
+            printResult(scenario.name, runScenario(scenario, options), options);
+        }
+    }
+    if (strcmp(options.scenario, "all") != 0 && findScenario(options.scenario) == nullptr)
+    {
+        fprintf(stderr, "unknown scenario %s, see --list\n", options.scenario);
+        return 2;
+    }
+    return 0;
+}
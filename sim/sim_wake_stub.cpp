@@ -0,0 +1,35 @@
+// stands in for src/wake_stub.cpp, the driver runs the stub between wakes
+#include "sim.h"
+#include "wake_stub.h"
+
+namespace
+{
+    RTC_DATA_ATTR uint16_t g_wakesToSkip = 0;
+    RTC_DATA_ATTR uint16_t g_wakesSkipped = 0;
+    RTC_DATA_ATTR uint32_t g_sleepTime_ms = 0;
+}
+
+void wakeStubSkipWakes(uint16_t numWakes, uint32_t sleepTime_ms)
+{
+    g_wakesToSkip = numWakes;
+    g_sleepTime_ms = sleepTime_ms;
+}
+
+uint16_t wakeStubTakeSkippedWakes()
+{
+    const uint16_t skipped = g_wakesSkipped;
+    g_wakesSkipped = 0;
+    return skipped;
+}
+
+bool simWakeStubHandleWake(uint32_t *outSleepTime_ms)
+{
+    if (g_wakesToSkip == 0)
+    {
+        return false;
+    }
+    --g_wakesToSkip;
+    ++g_wakesSkipped;
+    *outSleepTime_ms = g_sleepTime_ms;
+    return true;
+}
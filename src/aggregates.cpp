@@ -0,0 +1,118 @@
+#include "aggregates.h"
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+    constexpr float kFixedPointScale = static_cast<float>(1 << kAggregateFractionBits);
+
+    int32_t toFixedPoint(float value)
+    {
+        if (value > kAggregateMaxMagnitude)
+        {
+            value = kAggregateMaxMagnitude;
+        }
+        else if (value < -kAggregateMaxMagnitude)
+        {
+            value = -kAggregateMaxMagnitude;
+        }
+        return static_cast<int32_t>(lroundf(value * kFixedPointScale));
+    }
+
+    float fromFixedPoint(int64_t value)
+    {
+        return static_cast<float>(value) / kFixedPointScale;
+    }
+
+    // integer division rounding to the nearest, rather than towards zero, so the mean doesn't creep
+    int64_t divideRounded(int64_t numerator, uint32_t denominator)
+    {
+        const int64_t half = denominator / 2;
+        return (numerator >= 0 ? numerator + half : numerator - half) / static_cast<int64_t>(denominator);
+    }
+}
+
+void aggregateAdd(ChannelAggregate *aggregate, float value)
+{
+    if (isnan(value))
+    {
+        return;
+    }
+
+    const int32_t x = toFixedPoint(value);
+    if (aggregate->count == 0)
+    {
+        aggregate->min = x;
+        aggregate->max = x;
+        aggregate->mean = 0;
+        aggregate->m2 = 0;
+    }
+    else
+    {
+        aggregate->min = x < aggregate->min ? x : aggregate->min;
+        aggregate->max = x > aggregate->max ? x : aggregate->max;
+    }
+
+    ++aggregate->count;
+    const int64_t delta = x - aggregate->mean;
+    aggregate->mean += divideRounded(delta, aggregate->count);
+    const int64_t delta2 = x - aggregate->mean;
+    aggregate->m2 += (delta * delta2) >> kAggregateFractionBits;
+}
+
+void aggregateFinish(const ChannelAggregate &aggregate, ttgo_proto_Aggregate *outAggregate)
+{
+    *outAggregate = ttgo_proto_Aggregate_init_default;
+    outAggregate->count = aggregate.count;
+    if (aggregate.count == 0)
+    {
+        return;
+    }
+
+    outAggregate->min = fromFixedPoint(aggregate.min);
+    outAggregate->max = fromFixedPoint(aggregate.max);
+    outAggregate->mean = fromFixedPoint(aggregate.mean);
+    if (aggregate.count > 1 && aggregate.m2 > 0)
+    {
+        // m2 has kAggregateFractionBits fractional bits, like the values, rather than twice as many
+        outAggregate->stddev = sqrtf(fromFixedPoint(aggregate.m2) / static_cast<float>(aggregate.count - 1));
+    }
+}
+
+void addAggregateSample(AggregateWindow *window, uint32_t time, float lux, float soil, float salt)
+{
+    if (window->numSamples == 0)
+    {
+        window->start = time;
+    }
+    window->end = time;
+    ++window->numSamples;
+
+    aggregateAdd(&window->channels[kAggregateLux], lux);
+    aggregateAdd(&window->channels[kAggregateSoil], soil);
+    aggregateAdd(&window->channels[kAggregateSalt], salt);
+}
+
+bool finishAggregateWindow(const AggregateWindow &window, ttgo_proto_WindowAggregates *outAggregates)
+{
+    if (window.numSamples == 0)
+    {
+        return false;
+    }
+
+    *outAggregates = ttgo_proto_WindowAggregates_init_default;
+    outAggregates->timestamp = window.end;
+    outAggregates->duration_s = window.end - window.start;
+    outAggregates->has_lux = true;
+    aggregateFinish(window.channels[kAggregateLux], &outAggregates->lux);
+    outAggregates->has_soil = true;
+    aggregateFinish(window.channels[kAggregateSoil], &outAggregates->soil);
+    outAggregates->has_salt = true;
+    aggregateFinish(window.channels[kAggregateSalt], &outAggregates->salt);
+    return true;
+}
+
+void resetAggregateWindow(AggregateWindow *window)
+{
+    memset(window, 0, sizeof(AggregateWindow));
+}
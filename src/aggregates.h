@@ -0,0 +1,60 @@
+#ifndef __AGGREGATES__
+#define __AGGREGATES__
+
+#include <stdint.h>
+#include "protos/measurements.pb.h"
+
+/// @brief The cheap channels that are sampled at a higher rate than the full measurements
+enum AggregateChannel : uint8_t
+{
+    kAggregateLux = 0,
+    kAggregateSoil,
+    kAggregateSalt,
+    kNumAggregateChannels
+};
+
+/// @brief number of fractional bits in the fixed-point values held by ChannelAggregate
+constexpr uint8_t kAggregateFractionBits = 8;
+
+/// @brief values are clamped to +/- this, which keeps them (and every difference between two of them) well within an
+/// int32_t once converted
+constexpr float kAggregateMaxMagnitude = static_cast<float>(1 << (30 - kAggregateFractionBits));
+
+/// @brief The running statistics of one channel, updated with Welford's algorithm.
+/// Everything is fixed-point with kAggregateFractionBits fractional bits, so that the updates are exact integer
+/// operations which don't drift over a long window (and don't need the FPU).
+struct ChannelAggregate
+{
+    uint32_t count;
+    int32_t min;
+    int32_t max;
+    int64_t mean;
+    int64_t m2; // sum of squared differences from the mean
+};
+
+/// @brief the statistics of all the channels over one window (the time between two full measurements)
+struct AggregateWindow
+{
+    ChannelAggregate channels[kNumAggregateChannels];
+    uint32_t start; // epoch time of the first sample in the window
+    uint32_t end;   // epoch time of the latest sample in the window
+    uint16_t numSamples;
+};
+
+/// @brief add \p value to the statistics of a channel.  NaN values are ignored.
+void aggregateAdd(ChannelAggregate *aggregate, float value);
+
+/// @brief convert the statistics of a channel into their transmitted form
+void aggregateFinish(const ChannelAggregate &aggregate, ttgo_proto_Aggregate *outAggregate);
+
+/// @brief add a sample of every channel, taken at epoch \p time, to the window
+void addAggregateSample(AggregateWindow *window, uint32_t time, float lux, float soil, float salt);
+
+/// @brief convert the statistics of the window into their transmitted form
+/// @returns false if there were no samples in the window
+bool finishAggregateWindow(const AggregateWindow &window, ttgo_proto_WindowAggregates *outAggregates);
+
+/// @brief forget all samples, to start a new window
+void resetAggregateWindow(AggregateWindow *window);
+
+#endif
@@ -0,0 +1,149 @@
+#include "coap.h"
+#include <string.h>
+
+namespace
+{
+    constexpr uint8_t kCoapVersion = 1;
+    constexpr uint8_t kCoapTypeConfirmable = 0;
+    constexpr uint8_t kCoapTypeAcknowledgement = 2;
+    constexpr uint8_t kCoapTypeReset = 3;
+    constexpr uint8_t kCoapOptionUriPath = 11;
+    constexpr uint8_t kCoapPayloadMarker = 0xFF;
+    constexpr size_t kCoapHeaderSize = 4;
+
+    /// @brief write an option header (the delta from the previous option and the length of the value)
+    /// @returns the number of bytes written, or 0 if it doesn't fit
+    size_t writeOptionHeader(uint8_t *buffer, size_t bufferSize, uint8_t delta, size_t length)
+    {
+        // a delta of up to 12 always fits in the first nibble, which is all that Uri-Path needs
+        if (length < 13 && bufferSize >= 1)
+        {
+            buffer[0] = static_cast<uint8_t>(delta << 4 | length);
+            return 1;
+        }
+        if (length < 269 && bufferSize >= 2)
+        {
+            buffer[0] = static_cast<uint8_t>(delta << 4 | 13);
+            buffer[1] = static_cast<uint8_t>(length - 13);
+            return 2;
+        }
+        return 0;
+    }
+}
+
+size_t coapEncodePost(uint8_t *buffer, size_t bufferSize, //
+                      uint16_t messageId, uint32_t token,  //
+                      const char *path,                    //
+                      const uint8_t *payload, size_t payloadLength)
+{
+    if (bufferSize < kCoapHeaderSize + kCoapTokenLength)
+    {
+        return 0;
+    }
+    buffer[0] = static_cast<uint8_t>(kCoapVersion << 6 | kCoapTypeConfirmable << 4 | kCoapTokenLength);
+    buffer[1] = kCoapCodePost;
+    buffer[2] = static_cast<uint8_t>(messageId >> 8);
+    buffer[3] = static_cast<uint8_t>(messageId);
+    for (uint8_t i = 0; i < kCoapTokenLength; ++i)
+    {
+        buffer[kCoapHeaderSize + i] = static_cast<uint8_t>(token >> (8 * (kCoapTokenLength - 1 - i)));
+    }
+    size_t used = kCoapHeaderSize + kCoapTokenLength;
+
+    // one Uri-Path option per segment, the first a delta of 11 from nothing and the rest repeats
+    uint8_t delta = kCoapOptionUriPath;
+    const char *segment = path;
+    while (*segment != 0)
+    {
+        const char *end = strchr(segment, '/');
+        const size_t length = end != nullptr ? static_cast<size_t>(end - segment) : strlen(segment);
+        if (length > 0)
+        {
+            const size_t optionHeader = writeOptionHeader(buffer + used, bufferSize - used, delta, length);
+            if (optionHeader == 0 || used + optionHeader + length > bufferSize)
+            {
+                return 0;
+            }
+            used += optionHeader;
+            memcpy(buffer + used, segment, length);
+            used += length;
+            delta = 0;
+        }
+        segment += end != nullptr ? length + 1 : length;
+    }
+
+    if (payloadLength > 0)
+    {
+        if (used + 1 + payloadLength > bufferSize)
+        {
+            return 0;
+        }
+        buffer[used++] = kCoapPayloadMarker;
+        memcpy(buffer + used, payload, payloadLength);
+        used += payloadLength;
+    }
+    return used;
+}
+
+bool coapParseAck(const uint8_t *datagram, size_t length, //
+                  uint16_t messageId, uint32_t token,     //
+                  uint8_t *outCode)
+{
+    if (length < kCoapHeaderSize || datagram[0] >> 6 != kCoapVersion)
+    {
+        return false;
+    }
+    const uint8_t type = (datagram[0] >> 4) & 0x03;
+    if ((type != kCoapTypeAcknowledgement && type != kCoapTypeReset) ||
+        static_cast<uint16_t>(datagram[2] << 8 | datagram[3]) != messageId)
+    {
+        return false;
+    }
+
+    // a reset carries no token, it just says the gateway couldn't make sense of the request
+    if (type == kCoapTypeReset)
+    {
+        *outCode = kCoapCodeEmpty;
+        return true;
+    }
+
+    const uint8_t tokenLength = datagram[0] & 0x0F;
+    if (tokenLength != kCoapTokenLength || length < kCoapHeaderSize + kCoapTokenLength)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < kCoapTokenLength; ++i)
+    {
+        if (datagram[kCoapHeaderSize + i] != static_cast<uint8_t>(token >> (8 * (kCoapTokenLength - 1 - i))))
+        {
+            return false;
+        }
+    }
+    *outCode = datagram[1];
+    return true;
+}
+
+size_t coapAppendRecord(uint8_t *buffer, size_t bufferSize, size_t used, const uint8_t *data, size_t length)
+{
+    uint8_t prefix[5];
+    size_t prefixLength = 0;
+    size_t remaining = length;
+    do
+    {
+        prefix[prefixLength] = static_cast<uint8_t>(remaining & 0x7F);
+        remaining >>= 7;
+        if (remaining != 0)
+        {
+            prefix[prefixLength] |= 0x80;
+        }
+        ++prefixLength;
+    } while (remaining != 0 && prefixLength < sizeof(prefix));
+
+    if (used + prefixLength + length > bufferSize)
+    {
+        return 0;
+    }
+    memcpy(buffer + used, prefix, prefixLength);
+    memcpy(buffer + used + prefixLength, data, length);
+    return used + prefixLength + length;
+}
@@ -0,0 +1,44 @@
+#ifndef __COAP__
+#define __COAP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief The small part of CoAP (RFC 7252) needed to send a batch to the gateway (mqtt-server/coap_gateway.py).
+/// A batch is a confirmable POST whose path is the MQTT topic the gateway republishes on, and whose payload is a
+/// sequence of records, each the message length as a varint followed by the message (like protobuf's
+/// length-delimited streams).  The gateway piggybacks its answer on the acknowledgement, so a POST is one round trip.
+
+constexpr uint16_t kCoapDefaultPort = 5683;
+constexpr uint8_t kCoapTokenLength = 4;
+
+/// @brief message codes, as class << 5 | detail
+constexpr uint8_t kCoapCodeEmpty = 0x00;   // 0.00, e.g. a reset
+constexpr uint8_t kCoapCodePost = 0x02;    // 0.02
+constexpr uint8_t kCoapCodeChanged = 0x44; // 2.04
+
+/// @returns true if \p code is a success (2.xx) response
+constexpr bool coapIsSuccess(uint8_t code)
+{
+    return (code >> 5) == 2;
+}
+
+/// @brief encode a confirmable POST of \p payload to \p path (segments separated by '/')
+/// @returns the length of the datagram, or 0 if it doesn't fit in \p bufferSize
+size_t coapEncodePost(uint8_t *buffer, size_t bufferSize, //
+                      uint16_t messageId, uint32_t token,  //
+                      const char *path,                    //
+                      const uint8_t *payload, size_t payloadLength);
+
+/// @brief check whether \p datagram answers the request with \p messageId and \p token
+/// @param outCode set to the code of the piggybacked response, or kCoapCodeEmpty if the request was reset
+/// @returns false if it is something else (e.g. a late answer to an earlier request)
+bool coapParseAck(const uint8_t *datagram, size_t length, //
+                  uint16_t messageId, uint32_t token,     //
+                  uint8_t *outCode);
+
+/// @brief append a record of \p data to the first \p used bytes of \p buffer
+/// @returns the new number of bytes used, or 0 if it doesn't fit
+size_t coapAppendRecord(uint8_t *buffer, size_t bufferSize, size_t used, const uint8_t *data, size_t length);
+
+#endif
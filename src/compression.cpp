@@ -0,0 +1,145 @@
+#include "compression.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+    // the fields of ttgo_proto_Measurements that are compressed, indexed by CompressedField
+    float ttgo_proto_Measurements::*const kFields[kNumCompressedFields] = {
+        &ttgo_proto_Measurements::lux,
+        &ttgo_proto_Measurements::humidity,
+        &ttgo_proto_Measurements::temperature_C,
+        &ttgo_proto_Measurements::soil,
+        &ttgo_proto_Measurements::salt,
+        &ttgo_proto_Measurements::battery_mV,
+    };
+
+    void openDoor(SwingingDoorState *state)
+    {
+        state->slopeLower = -INFINITY;
+        state->slopeUpper = INFINITY;
+    }
+
+    void startFrom(SwingingDoorState *state, uint32_t time, float value)
+    {
+        state->anchorTime = time;
+        state->anchorValue = value;
+        state->hasAnchor = true;
+        state->hasLast = false;
+        openDoor(state);
+    }
+}
+
+uint8_t swingingDoorUpdate(SwingingDoorState *state, uint32_t time, float value, float tolerance)
+{
+    if (!state->hasAnchor)
+    {
+        startFrom(state, time, value);
+        return kArchiveCurrent;
+    }
+
+    const uint32_t latestTime = state->hasLast ? state->lastTime : state->anchorTime;
+    if (time <= latestTime)
+    {
+        // time hasn't moved forward (e.g. the clock has just been set), so start again from this point
+        const uint8_t result = state->hasLast ? (kArchiveLast | kArchiveCurrent) : kArchiveCurrent;
+        startFrom(state, time, value);
+        return result;
+    }
+
+    if (!state->hasLast)
+    {
+        state->lastTime = time;
+        state->lastValue = value;
+        state->hasLast = true;
+        return 0;
+    }
+
+    // if this point becomes the end of the line from the anchor, the last point is in between
+    // and the line has to pass within tolerance of it as well
+    const float lastDt = static_cast<float>(state->lastTime - state->anchorTime);
+    const float slopeLower = std::max(state->slopeLower, (state->lastValue - tolerance - state->anchorValue) / lastDt);
+    const float slopeUpper = std::min(state->slopeUpper, (state->lastValue + tolerance - state->anchorValue) / lastDt);
+    const float slope = (value - state->anchorValue) / static_cast<float>(time - state->anchorTime);
+    if (slope >= slopeLower && slope <= slopeUpper)
+    {
+        state->slopeLower = slopeLower;
+        state->slopeUpper = slopeUpper;
+        state->lastTime = time;
+        state->lastValue = value;
+        return 0;
+    }
+
+    // the door has closed, so the last point is archived and becomes the new anchor
+    state->anchorTime = state->lastTime;
+    state->anchorValue = state->lastValue;
+    openDoor(state);
+    state->lastTime = time;
+    state->lastValue = value;
+    return kArchiveLast;
+}
+
+bool swingingDoorForceArchive(SwingingDoorState *state)
+{
+    if (!state->hasLast)
+    {
+        return false;
+    }
+    startFrom(state, state->lastTime, state->lastValue);
+    return true;
+}
+
+uint8_t compressSample(CompressionState *state,
+                       const CompressionSettings &settings,
+                       const ttgo_proto_Measurements &sample,
+                       ttgo_proto_Measurements *outMessages)
+{
+    const bool keyframe = settings.keyframeInterval > 0 && //
+                          state->samplesSinceKeyframe + 1 >= settings.keyframeInterval;
+
+    uint32_t lastMask = 0;
+    uint32_t currentMask = 0;
+    for (uint8_t field = 0; field < kNumCompressedFields; ++field)
+    {
+        SwingingDoorState *door = &state->fields[field];
+        uint8_t result = swingingDoorUpdate(door, sample.timestamp, sample.*kFields[field], settings.tolerance[field]);
+        if (keyframe && !(result & kArchiveCurrent))
+        {
+            swingingDoorForceArchive(door);
+            result |= kArchiveCurrent;
+        }
+
+        if (result & kArchiveLast)
+        {
+            lastMask |= 1u << field;
+        }
+        if (result & kArchiveCurrent)
+        {
+            currentMask |= 1u << field;
+        }
+    }
+
+    uint8_t numMessages = 0;
+    if (lastMask != 0)
+    {
+        outMessages[numMessages] = state->previous;
+        outMessages[numMessages].field_mask = lastMask;
+        ++numMessages;
+    }
+    if (currentMask != 0)
+    {
+        outMessages[numMessages] = sample;
+        outMessages[numMessages].field_mask = currentMask;
+        ++numMessages;
+    }
+
+    state->previous = sample;
+    state->samplesSinceKeyframe = keyframe ? 0 : state->samplesSinceKeyframe + 1;
+    return numMessages;
+}
+
+void resetCompression(CompressionState *state)
+{
+    memset(state, 0, sizeof(CompressionState));
+}
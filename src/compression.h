@@ -0,0 +1,78 @@
+#ifndef __COMPRESSION__
+#define __COMPRESSION__
+
+#include <stdint.h>
+#include "protos/measurements.pb.h"
+
+/// @brief The measurement fields that are compressed, in the order of their bits in ttgo_proto_Measurements::field_mask
+enum CompressedField : uint8_t
+{
+    kCompressedLux = 0,
+    kCompressedHumidity,
+    kCompressedTemperature,
+    kCompressedSoil,
+    kCompressedSalt,
+    kCompressedBattery,
+    kNumCompressedFields
+};
+
+/// @brief field_mask with every compressed field present (a keyframe)
+constexpr uint32_t kAllFieldsMask = (1u << kNumCompressedFields) - 1;
+
+/// @brief The maximum number of messages compressSample() can produce for one sample
+constexpr uint8_t kMaxCompressedMessagesPerSample = 2;
+
+struct CompressionSettings
+{
+    // the largest error allowed when the server linearly interpolates between transmitted values, per field
+    float tolerance[kNumCompressedFields];
+    // every this many samples all fields are transmitted regardless (0 disables keyframes)
+    uint8_t keyframeInterval;
+};
+
+/// @brief the swinging door for one field
+struct SwingingDoorState
+{
+    uint32_t anchorTime; // the last archived (transmitted) point
+    float anchorValue;
+    uint32_t lastTime; // the most recent point, which may become the next archived point
+    float lastValue;
+    float slopeLower; // the range of slopes from the anchor that stay within tolerance of every point since it
+    float slopeUpper;
+    bool hasAnchor;
+    bool hasLast;
+};
+
+struct CompressionState
+{
+    SwingingDoorState fields[kNumCompressedFields];
+    ttgo_proto_Measurements previous;
+    uint8_t samplesSinceKeyframe;
+};
+
+/// @brief result bits of swingingDoorUpdate
+constexpr uint8_t kArchiveLast = 1 << 0;
+constexpr uint8_t kArchiveCurrent = 1 << 1;
+
+/// @brief advance the swinging door of one field with the point (\p time, \p value).
+/// @returns a combination of kArchiveLast (the previous point must be transmitted) and kArchiveCurrent (this point must be transmitted)
+uint8_t swingingDoorUpdate(SwingingDoorState *state, uint32_t time, float value, float tolerance);
+
+/// @brief make the most recent point of a field the archived point, regardless of the door
+/// @returns true if there was a point to archive
+bool swingingDoorForceArchive(SwingingDoorState *state);
+
+/// @brief run a new \p sample through the per-field swinging door compression.
+/// Any values that must be transmitted are written as messages to \p outMessages (which must have room for
+/// kMaxCompressedMessagesPerSample), with field_mask saying which fields each message carries.  The server reconstructs
+/// the dropped values by linear interpolation between the transmitted ones, within the tolerance of each field.
+/// @returns the number of messages written to \p outMessages
+uint8_t compressSample(CompressionState *state,
+                       const CompressionSettings &settings,
+                       const ttgo_proto_Measurements &sample,
+                       ttgo_proto_Measurements *outMessages);
+
+/// @brief forget all compression history, so that the next sample is transmitted in full
+void resetCompression(CompressionState *state);
+
+#endif
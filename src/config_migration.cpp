@@ -0,0 +1,53 @@
+#include "config_migration.h"
+#include <string.h>
+
+size_t deviceConfigFieldsEnd(uint16_t version)
+{
+    switch (version)
+    {
+    case 1:
+        return offsetof(DeviceConfig, compression);
+    case 2:
+        return offsetof(DeviceConfig, aggregateSamplesPerMeasurement);
+    case 3:
+        return offsetof(DeviceConfig, soil);
+    case 4:
+        return offsetof(DeviceConfig, numTransmitSlots);
+    case 5:
+        return offsetof(DeviceConfig, transport);
+    case 6:
+        return offsetof(DeviceConfig, tlsMode);
+    case 7:
+        return offsetof(DeviceConfig, relayRole);
+    case 8:
+        return offsetof(DeviceConfig, remoteConfigVersion);
+    case 9:
+        return offsetof(DeviceConfig, crc);
+    default:
+        return 0;
+    }
+}
+
+bool migrateDeviceConfig(const uint8_t *stored, size_t length, DeviceConfig *config)
+{
+    constexpr size_t kCrcSize = sizeof(uint32_t);
+    uint16_t version;
+    uint16_t size;
+    if (length < offsetof(DeviceConfig, ssid) + kCrcSize)
+    {
+        return false;
+    }
+    memcpy(&version, stored + offsetof(DeviceConfig, version), sizeof(version));
+    memcpy(&size, stored + offsetof(DeviceConfig, size), sizeof(size));
+
+    const size_t fieldsEnd = deviceConfigFieldsEnd(version);
+    if (version >= DEVICE_CONFIG_VERSION || fieldsEnd == 0 || size != length || fieldsEnd > length - kCrcSize)
+    {
+        return false;
+    }
+
+    memcpy(config, stored, fieldsEnd);
+    config->version = DEVICE_CONFIG_VERSION;
+    config->size = sizeof(DeviceConfig);
+    return true;
+}
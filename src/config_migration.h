@@ -0,0 +1,23 @@
+#ifndef __CONFIG_MIGRATION__
+#define __CONFIG_MIGRATION__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "device_config.h"
+
+/// @brief Reading a DeviceConfig blob stored by older firmware.
+/// Each version only added fields at the end, so an older blob is the fields it had, padded to the struct's alignment,
+/// followed by its crc.  The padding is not part of any field, and new (single byte) fields can sit where it was, so
+/// only the fields of the stored version are copied.
+
+/// @returns the offset of the end of the fields of DeviceConfig \p version (the first field added after it), or 0
+/// if there is no such version
+size_t deviceConfigFieldsEnd(uint16_t version);
+
+/// @brief copy the fields of an older blob over \p config, which should hold the defaults, so that the fields added
+/// since keep their default values.  The crc of the blob must have been checked already.
+/// @param stored the blob as stored, \p length bytes including its crc
+/// @returns false if the blob isn't a config of an older version, in which case \p config is unchanged
+bool migrateDeviceConfig(const uint8_t *stored, size_t length, DeviceConfig *config);
+
+#endif
@@ -0,0 +1,381 @@
+#include "device_config.h"
+#include "config_migration.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "log.h"
+
+#define CONFIG_NAMESPACE "store"
+#define CONFIG_KEY "config"
+
+typedef uint32_t nvs_handle_t;
+
+namespace
+{
+    enum ConfigSource : int32_t
+    {
+        kConfigFromRTC = 0,
+        kConfigFromNVS = 1,
+        kConfigFromLegacyKeys = 2,
+        kConfigFromDefaults = 3,
+    };
+
+    RTC_DATA_ATTR DeviceConfig g_config;
+    RTC_DATA_ATTR uint32_t g_storedCrc = 0; // crc of the blob as it is in NVS
+
+    // the limits of the settings the server can change, so a bad config can't leave a device unable to report
+    constexpr uint32_t kMinRemoteTimeBetweenMeasurements_s = 10;
+    constexpr uint32_t kMaxRemoteTimeBetweenMeasurements_s = 24 * 60 * 60;
+    constexpr uint32_t kMaxRemoteNumMQTTAttempts = 20;
+    constexpr uint32_t kMinRemoteTimeBetweenRTCUpdates_s = 60;
+    constexpr uint32_t kMaxRemoteTimeBetweenRTCUpdates_s = 7 * 24 * 60 * 60;
+
+    /// @returns true if \p value is 0 (not set) or within [\p min, \p max]
+    bool isUnsetOrInRange(uint32_t value, uint32_t min, uint32_t max)
+    {
+        return value == 0 || (value >= min && value <= max);
+    }
+
+    uint32_t crc32(const uint8_t *data, size_t length)
+    {
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t i = 0; i < length; ++i)
+        {
+            crc ^= data[i];
+            for (uint8_t bit = 0; bit < 8; ++bit)
+            {
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+            }
+        }
+        return ~crc;
+    }
+
+    uint32_t configCrc(const DeviceConfig &config)
+    {
+        return crc32(reinterpret_cast<const uint8_t *>(&config), offsetof(DeviceConfig, crc));
+    }
+
+    bool isValid(const DeviceConfig &config)
+    {
+        return config.version == DEVICE_CONFIG_VERSION && //
+               config.size == sizeof(DeviceConfig) &&      //
+               config.crc == configCrc(config);
+    }
+
+#ifdef TTGO_TLS_PSK
+#ifndef TTGO_TLS_PSK_IDENTITY
+#define TTGO_TLS_PSK_IDENTITY "ttgo"
+#endif
+
+    /// @returns the number of bytes in \p hex, or 0 if it isn't valid hex or doesn't fit in \p outBytes
+    size_t parseHex(const char *hex, uint8_t *outBytes, size_t maxBytes)
+    {
+        const size_t length = strlen(hex);
+        if (length % 2 != 0 || length / 2 > maxBytes)
+        {
+            return 0;
+        }
+        for (size_t i = 0; i < length / 2; ++i)
+        {
+            char byteString[3] = {hex[2 * i], hex[2 * i + 1], 0};
+            char *end;
+            outBytes[i] = static_cast<uint8_t>(strtoul(byteString, &end, 16));
+            if (*end != 0)
+            {
+                return 0;
+            }
+        }
+        return length / 2;
+    }
+#endif
+
+#ifdef TTGO_RELAY_PEER
+#ifndef TTGO_RELAY_CHANNEL
+#define TTGO_RELAY_CHANNEL 1
+#endif
+
+    /// @returns false if \p mac isn't of the form aa:bb:cc:dd:ee:ff
+    bool parseMac(const char *mac, uint8_t *outBytes)
+    {
+        unsigned int bytes[6];
+        if (sscanf(mac, "%x:%x:%x:%x:%x:%x", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5]) != 6)
+        {
+            return false;
+        }
+        for (uint8_t i = 0; i < 6; ++i)
+        {
+            outBytes[i] = static_cast<uint8_t>(bytes[i]);
+        }
+        return true;
+    }
+#endif
+
+    void setDefaults(DeviceConfig *config)
+    {
+        memset(config, 0, sizeof(DeviceConfig));
+        config->version = DEVICE_CONFIG_VERSION;
+        config->size = sizeof(DeviceConfig);
+        config->timeBetweenMeasurements_ms = kDefaultTimeBetweenMeasurements_ms;
+        config->timeBetweenRTCUpdates_ms = kDefaultTimeBetweenRTCUpdates_ms;
+        config->numMeasurementsToTakeBeforeSending = kDefaultNumMeasurementsToTakeBeforeSending;
+        config->maxNumMQTTAttempts = kDefaultMaxNumMQTTAttempts;
+        config->compression = kDefaultCompressionSettings;
+        config->aggregateSamplesPerMeasurement = kDefaultAggregateSamplesPerMeasurement;
+        config->soil = kDefaultSoilSettings;
+        config->numTransmitSlots = kDefaultNumTransmitSlots;
+        config->transmitSlot = kTransmitSlotFromMac;
+        config->transport = kDefaultTransport;
+#ifdef TTGO_TLS_PSK
+        // provisioned at build time
+        const size_t pskLength = parseHex(TTGO_TLS_PSK, config->tlsPsk, sizeof(config->tlsPsk));
+        if (pskLength > 0)
+        {
+            config->tlsMode = kTlsPsk;
+            config->tlsPskLength = pskLength;
+            strncpy(config->tlsPskIdentity, TTGO_TLS_PSK_IDENTITY, kMaxTlsPskIdentityLength);
+        }
+#endif
+#if defined(TTGO_RELAY)
+        config->relayRole = kRelayRoleRelay;
+#elif defined(TTGO_RELAY_PEER)
+        if (parseMac(TTGO_RELAY_PEER, config->relayPeer))
+        {
+            config->relayRole = kRelayRoleNode;
+            config->relayChannel = TTGO_RELAY_CHANNEL;
+        }
+#endif
+        config->crc = configCrc(*config);
+    }
+
+    /// @param[out] outStoredCrc the crc of the blob as stored, which differs from the crc of \p config if it was migrated
+    bool tryReadConfigBlob(DeviceConfig *config, uint32_t *outStoredCrc)
+    {
+        nvs_handle_t storage;
+        esp_err_t err = nvs_open(CONFIG_NAMESPACE, NVS_READONLY, &storage);
+        if (err != ESP_OK)
+        {
+            LOG_WARN(LogEvent::NVSOpenFailed, err);
+            return false;
+        }
+
+        // an older (smaller) blob is read over the defaults, so the fields it doesn't have keep their default values
+        DeviceConfig stored;
+        setDefaults(&stored);
+        size_t length = sizeof(DeviceConfig);
+        err = nvs_get_blob(storage, CONFIG_KEY, &stored, &length);
+        nvs_close(storage);
+        if (err != ESP_OK)
+        {
+            LOG_WARN(LogEvent::NVSReadFailed, err);
+            return false;
+        }
+
+        if (length == sizeof(DeviceConfig))
+        {
+            *config = stored;
+            *outStoredCrc = config->crc;
+            return isValid(*config);
+        }
+
+        // migrate from an older version, where the crc is the last field of the smaller blob
+        constexpr size_t kCrcSize = sizeof(uint32_t);
+        const uint8_t *storedBytes = reinterpret_cast<const uint8_t *>(&stored);
+        if (length < 2 * kCrcSize ||                   //
+            stored.size != length ||                  //
+            stored.version >= DEVICE_CONFIG_VERSION || //
+            crc32(storedBytes, length - kCrcSize) != *reinterpret_cast<const uint32_t *>(storedBytes + length - kCrcSize))
+        {
+            return false;
+        }
+        // the padding after the older fields is left out, see config_migration.h
+        DeviceConfig migrated;
+        setDefaults(&migrated);
+        if (!migrateDeviceConfig(storedBytes, length, &migrated))
+        {
+            return false;
+        }
+        *outStoredCrc = *reinterpret_cast<const uint32_t *>(storedBytes + length - kCrcSize);
+        *config = migrated;
+        config->crc = configCrc(*config);
+        return true;
+    }
+}
+
+bool loadDeviceConfig()
+{
+    // a valid copy in RTC memory means we've woken from deep sleep and NVS has already been read
+    if (isValid(g_config))
+    {
+        LOG_DEBUG(LogEvent::ConfigLoaded, kConfigFromRTC);
+        return true;
+    }
+
+    if (!initNVS())
+    {
+        setDefaults(&g_config);
+        g_storedCrc = 0;
+        LOG_ERROR(LogEvent::ConfigLoaded, kConfigFromDefaults);
+        return false;
+    }
+
+    if (tryReadConfigBlob(&g_config, &g_storedCrc))
+    {
+        LOG_INFO(LogEvent::ConfigLoaded, kConfigFromNVS);
+
+        // stores a migrated blob in the current format, otherwise there is nothing to do
+        return commitDeviceConfig();
+    }
+
+    // no (valid) blob, so migrate any values stored by older firmware
+    setDefaults(&g_config);
+    g_storedCrc = 0;
+    ConfigSource source = kConfigFromDefaults;
+    if (tryReadSSIDPW(g_config.ssid, g_config.psk))
+    {
+        source = kConfigFromLegacyKeys;
+    }
+    else
+    {
+        g_config.ssid[0] = 0;
+        g_config.psk[0] = 0;
+    }
+    if (!tryReadSensorName(g_config.sensorName))
+    {
+        g_config.sensorName[0] = 0;
+    }
+    g_config.crc = configCrc(g_config);
+    LOG_INFO(LogEvent::ConfigLoaded, source);
+
+    // store it in the new format straight away so the legacy keys are only read once
+    return commitDeviceConfig();
+}
+
+void resetDeviceConfig()
+{
+    setDefaults(&g_config);
+    g_storedCrc = 0;
+}
+
+DeviceConfig &deviceConfig()
+{
+    return g_config;
+}
+
+bool commitDeviceConfig()
+{
+    g_config.version = DEVICE_CONFIG_VERSION;
+    g_config.size = sizeof(DeviceConfig);
+    g_config.crc = configCrc(g_config);
+    if (g_config.crc == g_storedCrc)
+    {
+        // nothing has changed
+        return true;
+    }
+
+    nvs_handle_t storage;
+    esp_err_t err = nvs_open(CONFIG_NAMESPACE, NVS_READWRITE, &storage);
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::NVSOpenFailed, err);
+        return false;
+    }
+
+    err = nvs_set_blob(storage, CONFIG_KEY, &g_config, sizeof(DeviceConfig));
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::NVSWriteFailed, err);
+        nvs_close(storage);
+        return false;
+    }
+
+    err = nvs_commit(storage);
+    nvs_close(storage);
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::NVSCommitFailed, err);
+        return false;
+    }
+
+    g_storedCrc = g_config.crc;
+    LOG_INFO(LogEvent::ConfigCommitted, g_config.crc);
+    return true;
+}
+
+void setConfigWifiCredentials(const char *ssid, const char *psk)
+{
+    strncpy(g_config.ssid, ssid, MAX_SSID_LENGTH);
+    g_config.ssid[MAX_SSID_LENGTH] = 0;
+    strncpy(g_config.psk, psk, MAX_PWD_LENGTH);
+    g_config.psk[MAX_PWD_LENGTH] = 0;
+}
+
+void setConfigSensorName(const char *name)
+{
+    strncpy(g_config.sensorName, name, MAX_SENSOR_NAME);
+    g_config.sensorName[MAX_SENSOR_NAME] = 0;
+}
+
+bool applyRemoteConfig(const ttgo_proto_RemoteConfig &remote)
+{
+    if (remote.version == 0 || remote.version == g_config.remoteConfigVersion)
+    {
+        // nothing new
+        return true;
+    }
+
+    // all or nothing, so the device never runs with half of a config
+    uint8_t badField = 0;
+    if (!isUnsetOrInRange(remote.time_between_measurements_s, kMinRemoteTimeBetweenMeasurements_s, kMaxRemoteTimeBetweenMeasurements_s))
+    {
+        badField = ttgo_proto_RemoteConfig_time_between_measurements_s_tag;
+    }
+    else if (!isUnsetOrInRange(remote.num_measurements_per_batch, 1, kMaxNumMeasurementsPerBatch))
+    {
+        badField = ttgo_proto_RemoteConfig_num_measurements_per_batch_tag;
+    }
+    else if (!isUnsetOrInRange(remote.max_num_mqtt_attempts, 1, kMaxRemoteNumMQTTAttempts))
+    {
+        badField = ttgo_proto_RemoteConfig_max_num_mqtt_attempts_tag;
+    }
+    else if (!isUnsetOrInRange(remote.time_between_rtc_updates_s, kMinRemoteTimeBetweenRTCUpdates_s, kMaxRemoteTimeBetweenRTCUpdates_s))
+    {
+        badField = ttgo_proto_RemoteConfig_time_between_rtc_updates_s_tag;
+    }
+    if (badField != 0)
+    {
+        LOG_ERROR(LogEvent::RemoteConfigRejected, remote.version, badField);
+        return false;
+    }
+
+    if (remote.time_between_measurements_s != 0)
+    {
+        g_config.timeBetweenMeasurements_ms = remote.time_between_measurements_s * 1000;
+    }
+    if (remote.num_measurements_per_batch != 0)
+    {
+        g_config.numMeasurementsToTakeBeforeSending = static_cast<uint8_t>(remote.num_measurements_per_batch);
+    }
+    if (remote.max_num_mqtt_attempts != 0)
+    {
+        g_config.maxNumMQTTAttempts = static_cast<uint8_t>(remote.max_num_mqtt_attempts);
+    }
+    if (remote.time_between_rtc_updates_s != 0)
+    {
+        g_config.timeBetweenRTCUpdates_ms = remote.time_between_rtc_updates_s * 1000;
+    }
+    g_config.remoteConfigVersion = remote.version;
+    LOG_INFO(LogEvent::RemoteConfigApplied, remote.version);
+    return true;
+}
+
+bool setConfigTlsPsk(const char *identity, const uint8_t *key, size_t keyLength)
+{
+    if (strlen(identity) > kMaxTlsPskIdentityLength || keyLength > kMaxTlsPskLength)
+    {
+        return false;
+    }
+    g_config.tlsMode = kTlsPsk;
+    strcpy(g_config.tlsPskIdentity, identity);
+    memcpy(g_config.tlsPsk, key, keyLength);
+    g_config.tlsPskLength = keyLength;
+    return true;
+}
@@ -0,0 +1,127 @@
+#ifndef __DEVICE_CONFIG__
+#define __DEVICE_CONFIG__
+
+#include "Arduino.h"
+#include "nvs_utils.h"
+#include "compression.h"
+#include "protos/measurements.pb.h"
+#include "soil_frequency.h"
+#include "transmit_slot.h"
+
+/// @brief Bump this whenever the layout of DeviceConfig changes.
+/// New fields must only be added at the end (before crc), so that a blob stored by older firmware can be migrated
+/// by keeping the fields it has and taking the defaults for the rest.  Add where each version's fields end to
+/// deviceConfigFieldsEnd() (config_migration.cpp).
+#define DEVICE_CONFIG_VERSION 9
+
+constexpr uint32_t kDefaultTimeBetweenMeasurements_ms = 2 * 60 * 1000;
+constexpr uint32_t kDefaultTimeBetweenRTCUpdates_ms = 1 * 60 * 60 * 1000; // how often is the real time clock updated using NTP server
+constexpr uint8_t kDefaultNumMeasurementsToTakeBeforeSending = 5;
+constexpr uint8_t kDefaultMaxNumMQTTAttempts = 5;
+constexpr uint8_t kMaxNumMeasurementsPerBatch = 10; // the size of the batch buffers in RTC memory
+constexpr CompressionSettings kDefaultCompressionSettings = {
+    {10.0f /* lux */, 1.0f /* humidity */, 0.2f /* temperature_C */, 1.0f /* soil */, 10.0f /* salt */, 20.0f /* battery_mV */},
+    30 /* keyframe every hour at the default measurement interval */};
+constexpr uint8_t kDefaultAggregateSamplesPerMeasurement = 0; // aggregation is off unless configured
+constexpr SoilSettings kDefaultSoilSettings = {
+    {0}, {0}, 10 * 1000 /* a 10ms gate resolves 100Hz */, 0 /* uncalibrated */, kSoilModeAnalog};
+constexpr uint8_t kDefaultNumTransmitSlots = 12;
+
+/// @brief How a batch is sent to the server
+enum Transport : uint8_t
+{
+    kTransportMQTT = 0, // published to the broker
+    kTransportCoAP = 1, // posted over UDP to the CoAP gateway, which publishes to the broker
+};
+constexpr uint8_t kDefaultTransport = kTransportMQTT;
+
+/// @brief How the connection to the broker is secured
+enum TlsMode : uint8_t
+{
+    kTlsOff = 0,   // plain TCP
+    kTlsPsk = 1,   // TLS_PSK_WITH_AES_128_GCM_SHA256, the pre-shared key authenticates both ends without any public key maths
+    kTlsEcdsa = 2, // TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256 on P-256, the broker is verified against kTlsCaCert
+};
+constexpr size_t kMaxTlsPskIdentityLength = 32;
+constexpr size_t kMaxTlsPskLength = 32;
+
+/// @brief Whether the batches go through a relay (see relay.h)
+enum RelayRole : uint8_t
+{
+    kRelayRoleNone = 0,  // sent to the server directly
+    kRelayRoleNode = 1,  // sent over ESP-NOW to the relay at relayPeer, on relayChannel
+    kRelayRoleRelay = 2, // mains powered, stays connected and forwards what the nodes send to the broker
+};
+
+/// @brief Everything the device needs to remember between cold boots, stored in NVS as a single blob.
+/// A copy is kept in RTC memory so that wakes from deep sleep don't need to touch flash at all.
+struct DeviceConfig
+{
+    uint16_t version;
+    uint16_t size;
+    char ssid[MAX_SSID_LENGTH + 1];
+    char psk[MAX_PWD_LENGTH + 1];
+    char sensorName[MAX_SENSOR_NAME + 1];
+    uint32_t timeBetweenMeasurements_ms;
+    uint32_t timeBetweenRTCUpdates_ms;
+    uint8_t numMeasurementsToTakeBeforeSending;
+    uint8_t maxNumMQTTAttempts;
+    // version 2
+    CompressionSettings compression;
+    // version 3
+    uint8_t aggregateSamplesPerMeasurement; // if more than 1, lux, soil and salt are sampled this many times per measurement
+    // version 4
+    SoilSettings soil;
+    // version 5
+    uint8_t numTransmitSlots; // the batch period is divided into this many slots, 0 leaves transmissions where they fall
+    uint8_t transmitSlot;     // the slot this device transmits in, or kTransmitSlotFromMac
+    // version 6
+    uint8_t transport; // a Transport
+    // version 7
+    uint8_t tlsMode; // a TlsMode
+    char tlsPskIdentity[kMaxTlsPskIdentityLength + 1];
+    uint8_t tlsPsk[kMaxTlsPskLength];
+    uint8_t tlsPskLength;
+    // version 8
+    uint8_t relayRole; // a RelayRole
+    uint8_t relayPeer[6]; // MAC address of the relay
+    uint8_t relayChannel; // WiFi channel of the relay (the channel of its access point)
+    // version 9
+    uint32_t remoteConfigVersion; // of the last RemoteConfig applied, 0 if there hasn't been one
+    uint32_t crc; // must be last, covers everything before it
+};
+
+/// @brief make sure the configuration is available.
+/// On a wake from deep sleep this is served from RTC memory.  Otherwise it is read from NVS once (migrating the
+/// legacy per-key values, or falling back to defaults, if no blob is stored).
+/// @returns false if the configuration could not be read, in which case the defaults are used
+bool loadDeviceConfig();
+
+/// @brief reset the configuration to the defaults, and forget what was stored (e.g. because NVS has been erased)
+void resetDeviceConfig();
+
+/// @returns the current configuration.  loadDeviceConfig() must have been called first.
+/// Changes made through this reference are only persisted by commitDeviceConfig().
+DeviceConfig &deviceConfig();
+
+/// @brief write the configuration back to NVS, with a single commit, if it has changed since it was loaded or last committed
+/// @returns true if the stored configuration is up to date
+bool commitDeviceConfig();
+
+/// @brief set the WiFi credentials in the configuration (not persisted until commitDeviceConfig())
+void setConfigWifiCredentials(const char *ssid, const char *psk);
+
+/// @brief set the sensor name in the configuration (not persisted until commitDeviceConfig())
+void setConfigSensorName(const char *name);
+
+/// @brief apply the settings of a RemoteConfig published by the server, if it is a new version and every setting in
+/// it is in range.  Settings left at 0 keep their current values.  Persisted by commitDeviceConfig() as usual, which
+/// only writes to NVS if something has actually changed.
+/// @returns false if the config was rejected, nothing is changed in that case
+bool applyRemoteConfig(const ttgo_proto_RemoteConfig &remote);
+
+/// @brief secure the connection to the broker with a pre-shared key (not persisted until commitDeviceConfig())
+/// @returns false if \p identity or \p key is too long
+bool setConfigTlsPsk(const char *identity, const uint8_t *key, size_t keyLength);
+
+#endif
@@ -0,0 +1,131 @@
+#include "espnow_transport.h"
+#include <WiFi.h>
+#include "esp_now.h"
+#include "esp_wifi.h"
+#include "log.h"
+
+namespace
+{
+    constexpr uint32_t kSendTimeout_ms = 100; // the MAC layer retries take a few ms at most
+    constexpr size_t kReceiveQueueSize = 16;
+
+    enum SendStatus : uint8_t
+    {
+        kSendPending,
+        kSendDelivered,
+        kSendFailed,
+    };
+
+    volatile SendStatus g_sendStatus = kSendPending;
+
+    // filled by the receive callback (on the WiFi task), emptied by receive()
+    portMUX_TYPE g_receiveMux = portMUX_INITIALIZER_UNLOCKED;
+    uint8_t g_receivedFrames[kReceiveQueueSize][kMaxRelayFrameSize];
+    uint8_t g_receivedLengths[kReceiveQueueSize];
+    size_t g_firstReceived = 0;
+    size_t g_numReceived = 0;
+
+    void onSent(const uint8_t *mac, esp_now_send_status_t status)
+    {
+        g_sendStatus = status == ESP_NOW_SEND_SUCCESS ? kSendDelivered : kSendFailed;
+    }
+
+    void onReceived(const uint8_t *mac, const uint8_t *data, int length)
+    {
+        if (length <= 0 || static_cast<size_t>(length) > kMaxRelayFrameSize)
+        {
+            return;
+        }
+        portENTER_CRITICAL(&g_receiveMux);
+        if (g_numReceived < kReceiveQueueSize)
+        {
+            const size_t index = (g_firstReceived + g_numReceived) % kReceiveQueueSize;
+            memcpy(g_receivedFrames[index], data, length);
+            g_receivedLengths[index] = static_cast<uint8_t>(length);
+            ++g_numReceived;
+        }
+        portEXIT_CRITICAL(&g_receiveMux);
+    }
+}
+
+bool EspNowTransport::begin(const uint8_t *peer, uint8_t channel)
+{
+    if (WiFi.getMode() == WIFI_OFF)
+    {
+        WiFi.mode(WIFI_STA);
+    }
+    if (peer != nullptr)
+    {
+        // not associated, so the radio can be tuned to the relay's channel
+        esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+    }
+
+    esp_err_t err = esp_now_init();
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::RelayTransportFailed, err);
+        return false;
+    }
+    esp_now_register_send_cb(onSent);
+    esp_now_register_recv_cb(onReceived);
+    if (peer == nullptr)
+    {
+        return true;
+    }
+
+    memcpy(m_peer, peer, sizeof(m_peer));
+    esp_now_peer_info_t peerInfo = {};
+    memcpy(peerInfo.peer_addr, peer, sizeof(m_peer));
+    peerInfo.channel = channel;
+    peerInfo.ifidx = WIFI_IF_STA;
+    peerInfo.encrypt = false;
+    err = esp_now_add_peer(&peerInfo);
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::RelayTransportFailed, err);
+        esp_now_deinit();
+        return false;
+    }
+    return true;
+}
+
+void EspNowTransport::end()
+{
+    esp_now_deinit();
+    portENTER_CRITICAL(&g_receiveMux);
+    g_numReceived = 0;
+    portEXIT_CRITICAL(&g_receiveMux);
+}
+
+bool EspNowTransport::send(const uint8_t *frame, size_t length)
+{
+    g_sendStatus = kSendPending;
+    const esp_err_t err = esp_now_send(m_peer, frame, length);
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::RelayTransportFailed, err);
+        return false;
+    }
+
+    const uint32_t start_ms = millis();
+    while (g_sendStatus == kSendPending && millis() - start_ms < kSendTimeout_ms)
+    {
+        delay(1);
+    }
+    return g_sendStatus == kSendDelivered;
+}
+
+size_t EspNowTransport::receive(uint8_t *buffer, size_t bufferSize)
+{
+    size_t length = 0;
+    portENTER_CRITICAL(&g_receiveMux);
+    if (g_numReceived > 0)
+    {
+        length = g_receivedLengths[g_firstReceived] < bufferSize ? g_receivedLengths[g_firstReceived] : bufferSize;
+        memcpy(buffer, g_receivedFrames[g_firstReceived], length);
+        g_firstReceived = (g_firstReceived + 1) % kReceiveQueueSize;
+        --g_numReceived;
+    }
+    portEXIT_CRITICAL(&g_receiveMux);
+    return length;
+}
@@ -0,0 +1,32 @@
+#ifndef __ESPNOW_TRANSPORT__
+#define __ESPNOW_TRANSPORT__
+
+#include "Arduino.h"
+#include "relay.h"
+
+/// @brief Relay frames carried by ESP-NOW, which sends a single 802.11 action frame with no association, and has the
+/// peer acknowledge it at the MAC layer.  The node and the relay must be on the same channel, which for the relay is
+/// the channel of the access point it is connected to.
+class EspNowTransport : public RelayTransport
+{
+public:
+    /// @brief start ESP-NOW, with WiFi started (in station mode) if it isn't already
+    /// @param peer MAC address of the relay to send to, or nullptr on the relay, which only receives
+    /// @param channel the WiFi channel of the relay, ignored if \p peer is nullptr
+    /// @returns false if ESP-NOW couldn't be started or the peer added
+    bool begin(const uint8_t *peer, uint8_t channel);
+
+    /// @brief stop ESP-NOW, dropping any frames not yet received
+    void end();
+
+    /// @brief send a frame to the peer, and wait for it to be acknowledged
+    bool send(const uint8_t *frame, size_t length) override;
+
+    /// @brief take the oldest frame received, kept by the receive callback until read
+    size_t receive(uint8_t *buffer, size_t bufferSize) override;
+
+private:
+    uint8_t m_peer[6] = {0};
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "heap_stats.h"
+#include "esp_heap_caps.h"
+
+namespace
+{
+    // updated from any task or core, so atomically
+    uint32_t g_allocations = 0;
+    uint32_t g_frees = 0;
+    uint32_t g_allocatedBytes = 0;
+
+#ifdef TTGO_HEAP_STATS
+    void countAllocation(size_t size)
+    {
+        __atomic_fetch_add(&g_allocations, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&g_allocatedBytes, size, __ATOMIC_RELAXED);
+    }
+#endif
+}
+
+#ifdef TTGO_HEAP_STATS
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t count, size_t size);
+    void *__real_realloc(void *pointer, size_t size);
+    void __real_free(void *pointer);
+
+    void *__wrap_malloc(size_t size)
+    {
+        countAllocation(size);
+        return __real_malloc(size);
+    }
+
+    void *__wrap_calloc(size_t count, size_t size)
+    {
+        countAllocation(count * size);
+        return __real_calloc(count, size);
+    }
+
+    void *__wrap_realloc(void *pointer, size_t size)
+    {
+        countAllocation(size);
+        return __real_realloc(pointer, size);
+    }
+
+    void __wrap_free(void *pointer)
+    {
+        if (pointer != nullptr)
+        {
+            __atomic_fetch_add(&g_frees, 1, __ATOMIC_RELAXED);
+        }
+        __real_free(pointer);
+    }
+}
+#endif
+
+HeapStats heapStats()
+{
+    HeapStats stats;
+    stats.allocations = __atomic_load_n(&g_allocations, __ATOMIC_RELAXED);
+    stats.frees = __atomic_load_n(&g_frees, __ATOMIC_RELAXED);
+    stats.allocatedBytes = __atomic_load_n(&g_allocatedBytes, __ATOMIC_RELAXED);
+    stats.minFreeBytes = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    stats.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    return stats;
+}
@@ -0,0 +1,24 @@
+#ifndef __HEAP_STATS__
+#define __HEAP_STATS__
+
+#include "Arduino.h"
+
+/// @brief Heap use since boot (and every wake from deep sleep is a boot), so the cost of the libraries is visible.
+/// The firmware's own code doesn't allocate, its buffers are static or in RTC memory, so what shows up here is
+/// the Arduino core, WiFi, PubSubClient, mbedTLS and so on.
+/// With TTGO_HEAP_STATS defined (see platformio.ini), malloc, calloc, realloc and free are wrapped at link time to
+/// count the calls.  Allocations made by the IDF straight from heap_caps_malloc() (e.g. by the WiFi driver and
+/// mbedTLS) aren't counted, but they are included in the low water mark.
+struct HeapStats
+{
+    uint32_t allocations;      // calls to malloc, calloc and realloc
+    uint32_t frees;            // calls to free
+    uint32_t allocatedBytes;   // total requested
+    uint32_t minFreeBytes;     // low water mark of the free heap
+    uint32_t largestFreeBlock; // at the time of the call, smaller than the free heap when it is fragmented
+};
+
+/// @returns the heap use since boot
+HeapStats heapStats();
+
+#endif
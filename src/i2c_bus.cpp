@@ -0,0 +1,114 @@
+#include "i2c_bus.h"
+#include <Wire.h>
+#include "log.h"
+#include "pins.h"
+
+namespace
+{
+    constexpr uint8_t kI2CAddresses[kNumI2CDevices] = {
+        0x23, // kI2CDeviceBH1750
+    };
+
+    // a device holding SDA low is part way through sending a byte, so at most 9 clocks finish it
+    constexpr uint8_t kMaxRecoveryClockPulses = 9;
+    constexpr uint32_t kHalfClockPeriod_us = 5; // 100kHz
+    constexpr uint32_t kReadyPollInterval_ms = 2;
+
+    RTC_DATA_ATTR I2CDeviceCounters g_deviceCounters[kNumI2CDevices];
+    RTC_DATA_ATTR uint16_t g_busRecoveries = 0;
+
+    /// @brief clock SCL by hand until the device holding SDA low lets go, then send a STOP
+    /// @returns false if SDA is still held low
+    bool recoverBus()
+    {
+        pinMode(I2C_SDA, INPUT_PULLUP);
+        if (digitalRead(I2C_SDA) == HIGH)
+        {
+            return true;
+        }
+
+        pinMode(I2C_SCL, OUTPUT_OPEN_DRAIN);
+        digitalWrite(I2C_SCL, HIGH);
+        uint8_t pulses = 0;
+        while (digitalRead(I2C_SDA) == LOW && pulses < kMaxRecoveryClockPulses)
+        {
+            digitalWrite(I2C_SCL, LOW);
+            delayMicroseconds(kHalfClockPeriod_us);
+            digitalWrite(I2C_SCL, HIGH);
+            delayMicroseconds(kHalfClockPeriod_us);
+            ++pulses;
+        }
+
+        if (digitalRead(I2C_SDA) == LOW)
+        {
+            LOG_ERROR(LogEvent::I2CBusStuck, pulses);
+            return false;
+        }
+
+        // STOP: SDA rises while SCL is high
+        pinMode(I2C_SDA, OUTPUT_OPEN_DRAIN);
+        digitalWrite(I2C_SCL, LOW);
+        digitalWrite(I2C_SDA, LOW);
+        delayMicroseconds(kHalfClockPeriod_us);
+        digitalWrite(I2C_SCL, HIGH);
+        delayMicroseconds(kHalfClockPeriod_us);
+        digitalWrite(I2C_SDA, HIGH);
+        delayMicroseconds(kHalfClockPeriod_us);
+
+        ++g_busRecoveries;
+        LOG_WARN(LogEvent::I2CBusRecovered, pulses);
+        return true;
+    }
+}
+
+bool i2cBusBegin()
+{
+    if (!recoverBus())
+    {
+        return false;
+    }
+
+    if (!Wire.begin(I2C_SDA, I2C_SCL))
+    {
+        return false;
+    }
+    Wire.setTimeOut(kI2CTransactionTimeout_ms);
+    return true;
+}
+
+bool i2cWaitForDevice(I2CDevice device, uint32_t timeout_ms)
+{
+    const uint32_t start_ms = millis();
+    while (true)
+    {
+        Wire.beginTransmission(kI2CAddresses[device]);
+        if (Wire.endTransmission() == 0)
+        {
+            LOG_DEBUG(LogEvent::I2CDeviceReady, device, millis() - start_ms);
+            return true;
+        }
+
+        if (millis() - start_ms >= timeout_ms)
+        {
+            ++g_deviceCounters[device].notReady;
+            LOG_ERROR(LogEvent::I2CDeviceNotReady, device, timeout_ms);
+            return false;
+        }
+        delay(kReadyPollInterval_ms);
+    }
+}
+
+void i2cRecordError(I2CDevice device)
+{
+    ++g_deviceCounters[device].errors;
+}
+
+uint32_t i2cDeviceErrors(I2CDevice device)
+{
+    return g_deviceCounters[device].notReady + g_deviceCounters[device].errors;
+}
+
+uint32_t i2cBusRecoveries()
+{
+    return g_busRecoveries;
+}
@@ -0,0 +1,41 @@
+#ifndef __I2C_BUS__
+#define __I2C_BUS__
+
+#include "Arduino.h"
+
+/// @brief The devices on the I2C bus
+enum I2CDevice : uint8_t
+{
+    kI2CDeviceBH1750 = 0,
+    kNumI2CDevices
+};
+
+/// @brief how long any single I2C transaction may take before it is abandoned
+constexpr uint16_t kI2CTransactionTimeout_ms = 50;
+
+/// @brief Error counters of a device, kept in RTC memory since the last cold boot
+struct I2CDeviceCounters
+{
+    uint16_t notReady; // didn't acknowledge its address in time after power up
+    uint16_t errors;   // transactions that failed
+};
+
+/// @brief start the I2C bus, first freeing SDA if a device is holding it low (e.g. after losing power mid-transaction).
+/// Every transaction on the bus is bounded by kI2CTransactionTimeout_ms.
+/// @returns false if the bus is stuck and couldn't be recovered
+bool i2cBusBegin();
+
+/// @brief wait for a device to come out of power up, by polling until it acknowledges its address
+/// @returns false if it didn't acknowledge within \p timeout_ms
+bool i2cWaitForDevice(I2CDevice device, uint32_t timeout_ms);
+
+/// @brief count a failed transaction with \p device
+void i2cRecordError(I2CDevice device);
+
+/// @returns the total number of errors (of any kind) of \p device
+uint32_t i2cDeviceErrors(I2CDevice device);
+
+/// @returns the number of times a stuck bus has been recovered
+uint32_t i2cBusRecoveries();
+
+#endif
@@ -0,0 +1,87 @@
+#include "log.h"
+
+#if TTGO_LOG_LEVEL > TTGO_LOG_LEVEL_NONE
+
+namespace
+{
+    const char *const kEventNames[] = {
+#define TTGO_LOG_EVENT_NAME(name) #name,
+        TTGO_LOG_EVENTS(TTGO_LOG_EVENT_NAME)
+#undef TTGO_LOG_EVENT_NAME
+    };
+    constexpr size_t kNumEventNames = sizeof(kEventNames) / sizeof(kEventNames[0]);
+
+    const char kLevelNames[] = {'-', 'E', 'W', 'I', 'D'};
+
+    // the ring buffer lives in RTC memory so it survives deep sleep and can be shipped with the next upload
+    RTC_DATA_ATTR LogEntry g_logRing[kLogRingSize];
+    RTC_DATA_ATTR uint32_t g_logNumWritten = 0; // total entries ever written since the last clear
+    RTC_DATA_ATTR uint16_t g_logWake = 0;
+
+    size_t oldestIndex()
+    {
+        return g_logNumWritten > kLogRingSize ? g_logNumWritten % kLogRingSize : 0;
+    }
+}
+
+void logBeginWake()
+{
+    ++g_logWake;
+}
+
+void logRecord(uint8_t level, LogEvent event, int32_t arg0, int32_t arg1)
+{
+    LogEntry &entry = g_logRing[g_logNumWritten % kLogRingSize];
+    entry.time_ms = millis();
+    entry.wake = g_logWake;
+    entry.level = level;
+    entry.event = static_cast<uint8_t>(event);
+    entry.arg0 = arg0;
+    entry.arg1 = arg1;
+    ++g_logNumWritten;
+}
+
+size_t logNumEntries()
+{
+    return g_logNumWritten < kLogRingSize ? g_logNumWritten : kLogRingSize;
+}
+
+size_t logSerialise(uint8_t *buffer, size_t bufferSize, size_t firstEntry)
+{
+    const size_t numHeld = logNumEntries();
+    if (firstEntry >= numHeld)
+    {
+        return 0;
+    }
+    const size_t numEntries = std::min(numHeld - firstEntry, bufferSize / sizeof(LogEntry));
+    const size_t start = oldestIndex() + firstEntry;
+    for (size_t i = 0; i < numEntries; ++i)
+    {
+        memcpy(buffer + i * sizeof(LogEntry), &g_logRing[(start + i) % kLogRingSize], sizeof(LogEntry));
+    }
+    return numEntries * sizeof(LogEntry);
+}
+
+void logDump(Print &printer)
+{
+    const size_t numEntries = logNumEntries();
+    const size_t start = oldestIndex();
+    char buffer[100];
+    for (size_t i = 0; i < numEntries; ++i)
+    {
+        const LogEntry &entry = g_logRing[(start + i) % kLogRingSize];
+        const char *name = entry.event < kNumEventNames ? kEventNames[entry.event] : "?";
+        const char level = entry.level < sizeof(kLevelNames) ? kLevelNames[entry.level] : '?';
+        snprintf(buffer, sizeof(buffer), "[%u.%u] %c %s %d %d",
+                 static_cast<unsigned>(entry.wake), static_cast<unsigned>(entry.time_ms), level, name,
+                 static_cast<int>(entry.arg0), static_cast<int>(entry.arg1));
+        printer.println(buffer);
+    }
+}
+
+void logClear()
+{
+    g_logNumWritten = 0;
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef __LOG__
+#define __LOG__
+
+#include "Arduino.h"
+#include "log_events.h"
+
+// Logging is levelled at compile time using TTGO_LOG_LEVEL (see platformio.ini).
+// Events at a level above TTGO_LOG_LEVEL compile to nothing, and with TTGO_LOG_LEVEL_NONE the
+// ring buffer itself is not compiled in.
+#define TTGO_LOG_LEVEL_NONE 0
+#define TTGO_LOG_LEVEL_ERROR 1
+#define TTGO_LOG_LEVEL_WARN 2
+#define TTGO_LOG_LEVEL_INFO 3
+#define TTGO_LOG_LEVEL_DEBUG 4
+
+#ifndef TTGO_LOG_LEVEL
+#define TTGO_LOG_LEVEL TTGO_LOG_LEVEL_INFO
+#endif
+
+enum class LogEvent : uint8_t
+{
+#define TTGO_LOG_EVENT_ENUM(name) name,
+    TTGO_LOG_EVENTS(TTGO_LOG_EVENT_ENUM)
+#undef TTGO_LOG_EVENT_ENUM
+};
+
+/// @brief A single log record, as stored in RTC memory and shipped to the server (little endian, 16 bytes)
+struct LogEntry
+{
+    uint32_t time_ms; // millis() at the time of recording
+    uint16_t wake;    // the wake (boot) count at the time of recording
+    uint8_t level;
+    uint8_t event;
+    int32_t arg0;
+    int32_t arg1;
+};
+static_assert(sizeof(LogEntry) == 16, "LogEntry is shipped to the server and must stay 16 bytes");
+
+/// @brief The number of entries kept in the RTC ring buffer.  When full, the oldest are overwritten.
+constexpr size_t kLogRingSize = 64;
+
+/// @brief Send this character over serial during boot to have the log dumped
+constexpr char kLogDumpRequest = 'L';
+
+#if TTGO_LOG_LEVEL > TTGO_LOG_LEVEL_NONE
+
+/// @brief mark the start of a new wake, should be called once at boot
+void logBeginWake();
+
+/// @brief record an \p event with raw arguments into the RTC ring buffer.  Use the LOG_* macros rather than calling this directly.
+void logRecord(uint8_t level, LogEvent event, int32_t arg0 = 0, int32_t arg1 = 0);
+
+/// @returns the number of entries currently held in the ring buffer
+size_t logNumEntries();
+
+/// @brief copy the held entries, oldest first and starting from entry \p firstEntry, into \p buffer
+/// @returns the number of bytes written into \p buffer (a whole number of entries)
+size_t logSerialise(uint8_t *buffer, size_t bufferSize, size_t firstEntry = 0);
+
+/// @brief print the held entries, oldest first, in human readable form to \p printer
+void logDump(Print &printer);
+
+/// @brief discard all the held entries (e.g. once they have been shipped to the server)
+void logClear();
+
+#else
+
+inline void logBeginWake() {}
+inline size_t logNumEntries() { return 0; }
+inline size_t logSerialise(uint8_t *, size_t, size_t = 0) { return 0; }
+inline void logDump(Print &) {}
+inline void logClear() {}
+
+#endif
+
+#if TTGO_LOG_LEVEL >= TTGO_LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logRecord(TTGO_LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) \
+    do                 \
+    {                  \
+    } while (0)
+#endif
+
+#if TTGO_LOG_LEVEL >= TTGO_LOG_LEVEL_WARN
+#define LOG_WARN(...) logRecord(TTGO_LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) \
+    do                \
+    {                 \
+    } while (0)
+#endif
+
+#if TTGO_LOG_LEVEL >= TTGO_LOG_LEVEL_INFO
+#define LOG_INFO(...) logRecord(TTGO_LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) \
+    do                \
+    {                 \
+    } while (0)
+#endif
+
+#if TTGO_LOG_LEVEL >= TTGO_LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logRecord(TTGO_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) \
+    do                 \
+    {                  \
+    } while (0)
+#endif
+
+#endif
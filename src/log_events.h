@@ -0,0 +1,72 @@
+#ifndef __LOG_EVENTS__
+#define __LOG_EVENTS__
+
+/// @brief The list of all events that can be recorded in the log.
+/// Each entry is X(name).  New events must be appended to the end of the list, as the numeric id
+/// of each event is shipped to the server (see mqtt-server/device_log.py, which must be kept in step).
+/// The comment after each entry describes the meaning of its two arguments.
+#define TTGO_LOG_EVENTS(X)         \
+    X(Boot)                        /* firmware version (major * 10000 + minor * 100 + patch), build time */ \
+    X(CpuFrequency)                /* MHz */ \
+    X(I2CInitStart)                \
+    X(I2CInitFailed)               \
+    X(BH1750InitFailed)            \
+    X(I2CInitDone)                 \
+    X(WifiNoCredentials)           \
+    X(WifiConnecting)              \
+    X(WifiConnectTimeout)          /* ms waited */ \
+    X(WifiConnectFailed)           /* wl_status_t */ \
+    X(WifiConnected)               /* IPv4 address, ms taken */ \
+    X(RTCUpdated)                  /* epoch time */ \
+    X(RTCUpdateFailed)             \
+    X(MeasurementStart)            /* measurement index */ \
+    X(MeasurementFailed)           \
+    X(MeasurementProgress)         /* samples taken, messages waiting to be sent */ \
+    X(DHTReadRetry)                /* attempt */ \
+    X(DHTReadFailed)               /* attempts */ \
+    X(SensorNameRetrieved)         \
+    X(SensorNameFailed)            \
+    X(SensorNameSaveFailed)        \
+    X(MQTTConnected)               /* attempts */ \
+    X(MQTTConnectFailed)           /* client state, attempts */ \
+    X(EncodeFailed)                /* measurement index */ \
+    X(MeasurementSent)             /* measurement index, bytes */ \
+    X(DeepSleep)                   /* seconds, ms awake */ \
+    X(NVSInit)                     /* esp_err_t */ \
+    X(NVSError)                    /* esp_err_t */ \
+    X(NVSOpenFailed)               /* esp_err_t */ \
+    X(NVSReadFailed)               /* esp_err_t */ \
+    X(NVSWriteFailed)              /* esp_err_t */ \
+    X(NVSCommitFailed)             /* esp_err_t */ \
+    X(HTTPConnectFailed)           /* error */ \
+    X(HTTPStatus)                  /* status code */ \
+    X(HTTPShortRead)               /* bytes remaining */ \
+    X(MDNSLookupFailed)            \
+    X(MDNSResolved)                /* IPv4 address */ \
+    X(ConfigLoaded)                /* source (0 RTC, 1 NVS, 2 legacy keys, 3 defaults) */ \
+    X(ConfigCommitted)             /* crc */ \
+    X(SoilCounterFailed)           /* esp_err_t */ \
+    X(I2CBusRecovered)             /* clock pulses */ \
+    X(I2CBusStuck)                 /* clock pulses */ \
+    X(I2CDeviceReady)              /* I2CDevice, ms waited */ \
+    X(I2CDeviceNotReady)           /* I2CDevice, ms waited */ \
+    X(WakesSkipped)                /* wakes handled by the wake stub */ \
+    X(TransmitBackoff)             /* failed transmissions, wakes to skip */ \
+    X(TransmitSlotAlign)           /* slot, ms the next transmission is moved by */ \
+    X(CoapGatewayNotFound)         \
+    X(CoapRetransmit)              /* message id, attempt */ \
+    X(CoapRejected)                /* message id, response code */ \
+    X(CoapSendFailed)              /* message id, payload bytes */ \
+    X(TlsConnectFailed)            /* mbedTLS error */ \
+    X(TlsHandshake)                /* ms, 1 if the session was resumed */ \
+    X(TlsHandshakeFailed)          /* mbedTLS error, ms */ \
+    X(TlsSessionNotSaved)          /* bytes */ \
+    X(HeapUse)                     /* allocations since boot, lowest free heap bytes */ \
+    X(RelayTransportFailed)        /* esp_err_t */ \
+    X(RelaySendFailed)             /* sequence number of the next frame */ \
+    X(RelayStarted)                /* WiFi channel */ \
+    X(RelayForwarded)              /* records published, duplicate frames since start */ \
+    X(RemoteConfigApplied)         /* version */ \
+    X(RemoteConfigRejected)        /* version, field out of range */
+
+#endif
@@ -5,75 +5,130 @@
 #include <Wire.h>
 #include <BH1750.h>
 #include "DHT12_sensor_library/DHT12.h"
+#include "aggregates.h"
+#include "compression.h"
+#include "device_config.h"
+#include "espnow_transport.h"
 #include "esp_wifi.h"
 #include "esp_system.h"
+#include "esp_efuse.h"
+#include "heap_stats.h"
+#include "i2c_bus.h"
+#include "log.h"
 #include "measurements.h"
 #include "pb_encode.h"
 #include "nvs_utils.h"
 #include "PubSubClient.h"
+#include "relay.h"
 #include "server_helpers.h"
 #include "time_helpers.h"
+#include "tls_ca_cert.h"
+#include "tls_client.h"
+#include "transmit_slot.h"
+#include "udp_transport.h"
+#include "wake_stub.h"
 #include "pins.h"
 
-//#define TTGO_DEBUG_PRINT
-
 BH1750 lightMeter(0x23); //0x23
 DHT12 dht12(DHT12_PIN, true);
 WiFiClient g_wifiClient;
+TlsClient g_tlsClient;
 PubSubClient mqttClient(g_wifiClient);
 
 constexpr char kMQTTBroker[] = "ttgo-server";
 constexpr uint16_t kMQTTBrokerPort = 1883;
+constexpr uint16_t kMQTTBrokerPskPort = 8883; // see mqtt-server/mosquitto/mosquitto_tls.conf
+constexpr uint16_t kMQTTBrokerEcdsaPort = 8884;
 char g_mqttTopicRoot[1024] = "sensors";
+bool g_useCoAP = false;         // this wake's batch goes to the CoAP gateway rather than the broker
+bool g_allCoAPDelivered = true; // every datagram sent this wake has been acknowledged
+bool g_useRelay = false;        // this wake's batch goes to the relay over ESP-NOW
+EspNowTransport g_espNowTransport;
+RelaySender g_relaySender;
+constexpr uint32_t kRelayPublishInterval_ms = 1000; // how long the relay collects frames before publishing them
+constexpr uint32_t kSensorNameTimeout_ms = 5 * 1000;
+#ifdef TTGO_ENABLE_HTTP_NAMING
 constexpr char kServerAddress[] = "ttgo-server";
 constexpr uint16_t kServerPort = 1234;
 constexpr bool kServerIsLocal = true;
 constexpr char kNextSensorNameAPI[] = "/sensors/next/";
+#endif
 
 // working data stored in RTC memory
-constexpr uint32_t kTimeBetweenMeasurements_ms = 2 * 60 * 1000;
-constexpr uint8_t kMaxNumMQTTAttempts = 5;
-constexpr uint8_t kNumMeasurementsToTakeBeforeSending = 5;
-RTC_DATA_ATTR ttgo_proto_Measurements g_measurements[kNumMeasurementsToTakeBeforeSending];
-RTC_DATA_ATTR uint8_t g_numMeasurementsRecorded = 0;
-constexpr uint32_t kTimeBetweenRTCUpdates_ms = 1 * 60 * 60 * 1000;          // how often is the real time clock updated using NTC server
-RTC_DATA_ATTR uint32_t g_timeSinceRTCUpdate_ms = kTimeBetweenRTCUpdates_ms; // set to time limit to update once at the start
-
-#define PRINT(x)         \
-    if (Serial)          \
-    {                    \
-        Serial.print(x); \
-    }
-#define PRINTLN(x)         \
-    if (Serial)            \
-    {                      \
-        Serial.println(x); \
-    }
-
-bool tryInitI2CAndDevices()
+// (the timings and batch size are tunable, see DeviceConfig)
+constexpr uint8_t kTransmitBufferSize = kMaxNumMeasurementsPerBatch * kMaxCompressedMessagesPerSample;
+RTC_DATA_ATTR ttgo_proto_Measurements g_measurements[kTransmitBufferSize]; // compressed messages waiting to be sent
+RTC_DATA_ATTR uint8_t g_numMeasurementsRecorded = 0;                       // number of messages in g_measurements
+RTC_DATA_ATTR uint8_t g_numSamplesTaken = 0;                               // samples taken since the last transmission
+RTC_DATA_ATTR CompressionState g_compressionState;
+// aggregation of the fast channels between measurements
+RTC_DATA_ATTR AggregateWindow g_aggregateWindow;
+RTC_DATA_ATTR uint8_t g_numAggregateWakes = 0; // wakes that only sampled the fast channels since the last measurement
+RTC_DATA_ATTR ttgo_proto_WindowAggregates g_aggregates[kMaxNumMeasurementsPerBatch];
+RTC_DATA_ATTR uint8_t g_numAggregatesRecorded = 0;
+RTC_DATA_ATTR uint32_t g_timeSinceRTCUpdate_ms = UINT32_MAX / 2; // larger than any update period, to update once at the start
+RTC_DATA_ATTR uint8_t g_numFailedTransmissions = 0;              // in a row, for backing off
+RTC_DATA_ATTR int32_t g_pendingSleepAdjustment_ms = 0;           // moves the transmit wakes into this device's slot
+RTC_DATA_ATTR uint8_t g_numTransmitsSinceSlotCheck = 0;
+RTC_DATA_ATTR uint16_t g_relaySequence = 0; // of the frames sent to the relay, seeded randomly on a cold boot
+// numbering of the samples, which carries on across power losses (see nextSampleSequence())
+RTC_DATA_ATTR uint32_t g_nextSampleSequence = 0;          // 0 until it has been read from NVS after a cold boot
+RTC_DATA_ATTR uint32_t g_sampleSequenceReservedUntil = 0; // the numbers up to this are stored as used in NVS
+RTC_DATA_ATTR uint32_t g_lastRecordedSequence = 0;        // of the last message recorded, 0 if unknown
+constexpr size_t kLogEntriesPerMessage = 8; // keeps each log message within PubSubClient's default packet size
+constexpr uint32_t kBH1750PowerUpTimeout_ms = 100;
+constexpr uint32_t kDHT12PowerUpTime_ms = 3500; // DHT12 takes a long time after power is applied
+constexpr uint8_t kMaxNumI2CInitAttempts = 3;
+constexpr uint8_t kMaxTransmitBackoffExponent = 4; // back off to trying every 16th wake
+constexpr uint8_t kTransmitsBetweenSlotChecks = 12; // how often to look for a slot assigned by the server
+constexpr uint32_t kSlotCheckTimeout_ms = 300;
+constexpr uint32_t kRemoteConfigTimeout_ms = 300; // from subscribing, which is before the batch is sent
+constexpr uint32_t kSampleSequenceReservation = 256; // sample numbers reserved per NVS write, to spare the flash
+
+bool initI2CAndDevices()
 {
-    PRINTLN("tryInitI2CAndDevices");
-    if (!Wire.begin(I2C_SDA, I2C_SCL))
+    LOG_DEBUG(LogEvent::I2CInitStart);
+    if (!i2cBusBegin())
     {
-        PRINTLN("Failed to start I2C");
+        LOG_ERROR(LogEvent::I2CInitFailed);
         return false;
     }
 
+    // the DHT12 is used over its one wire interface, so isn't on the bus
     dht12.begin();
 
-    if (lightMeter.begin(BH1750::CONTINUOUS_HIGH_RES_MODE))
+    // rather than a fixed delay after power up, the BH1750 is ready as soon as it acknowledges its address
+    if (!i2cWaitForDevice(kI2CDeviceBH1750, kBH1750PowerUpTimeout_ms))
     {
-        PRINTLN(F("BH1750 Advanced begin"));
+        LOG_ERROR(LogEvent::BH1750InitFailed);
+        return false;
     }
-    else
+    if (!lightMeter.begin(BH1750::CONTINUOUS_HIGH_RES_MODE))
     {
-        PRINTLN(F("Error initialising BH1750"));
+        i2cRecordError(kI2CDeviceBH1750);
+        LOG_ERROR(LogEvent::BH1750InitFailed);
+        return false;
     }
 
-    PRINTLN("tryInitI2CAndDevices: done");
+    LOG_DEBUG(LogEvent::I2CInitDone);
     return true;
 }
 
+/// @brief power the sensors and bring up the I2C bus, giving up after a few attempts (e.g. if a cable is loose)
+/// @returns false if the devices on the bus can't be used, in which case their readings will fail
+bool powerUpSensors()
+{
+    digitalWrite(POWER_CTRL, HIGH);
+    for (uint8_t attempt = 0; attempt < kMaxNumI2CInitAttempts; ++attempt)
+    {
+        if (initI2CAndDevices())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 void scanNetworks()
 {
     // scan for nearby networks:
@@ -94,13 +149,74 @@ void scanNetworks()
     }
 }
 
+uint8_t numMeasurementsPerBatch()
+{
+    return std::min(deviceConfig().numMeasurementsToTakeBeforeSending, kMaxNumMeasurementsPerBatch);
+}
+
+/// @returns the number of times the fast channels are sampled per measurement (1 if aggregation is off)
+uint8_t numAggregateSamplesPerMeasurement()
+{
+    return std::max(deviceConfig().aggregateSamplesPerMeasurement, static_cast<uint8_t>(1));
+}
+
+/// @brief the sequence number for a new sample.  The numbers are reserved in NVS a block at a time, so that after
+/// losing power the device carries on from the end of the block rather than reusing numbers it has already sent.
+/// @returns 0 (no number) if the next block couldn't be reserved
+uint32_t nextSampleSequence()
+{
+    if (g_nextSampleSequence == 0)
+    {
+        uint32_t storedSequence = 0;
+        if (!tryReadSampleSequence(&storedSequence) || storedSequence == 0)
+        {
+            storedSequence = 1;
+        }
+        g_nextSampleSequence = storedSequence;
+        g_sampleSequenceReservedUntil = storedSequence;
+    }
+
+    if (g_nextSampleSequence >= g_sampleSequenceReservedUntil)
+    {
+        if (!writeSampleSequence(g_nextSampleSequence + kSampleSequenceReservation))
+        {
+            // a number past the reserved block could be used again after losing power, so this sample goes without
+            // one (0, as from older firmware) and the next sample tries to reserve the block again
+            return 0;
+        }
+        g_sampleSequenceReservedUntil = g_nextSampleSequence + kSampleSequenceReservation;
+    }
+    return g_nextSampleSequence++;
+}
+
+/// @brief sample only the fast channels into the current aggregate window
+void takeAggregateSample()
+{
+    // the soil filter capacitor charges through 10k, so it has settled by the time the light has been measured
+    const bool lightMeterReady = powerUpSensors();
+
+    ttgo_proto_Measurements sample;
+    if (takeFastMeasurements(&lightMeter, &sample))
+    {
+        // a failed light reading is left out of the window, rather than counted as a negative level
+        const float lux = lightMeterReady && sample.lux >= 0 ? sample.lux : NAN;
+        addAggregateSample(&g_aggregateWindow, sample.timestamp, lux, sample.soil, sample.salt);
+    }
+    else
+    {
+        LOG_ERROR(LogEvent::MeasurementFailed);
+    }
+    digitalWrite(POWER_CTRL, LOW);
+}
+
 void configStart()
 {
     clearNVS();
     initNVS();
+    resetDeviceConfig();
 
     scanNetworks();
-    PRINTLN("Starting config...");
+    Serial.println("Starting config...");
 
     WiFi.disconnect();
     WiFi.beginSmartConfig();
@@ -170,19 +286,29 @@ void configStart()
 
     WiFi.stopSmartConfig();
 
+    // read straight from the driver, the Strings from WiFi.SSID() and WiFi.psk() would be gone before they were used
+    wifi_config_t wifiConfig;
+    memset(&wifiConfig, 0, sizeof(wifiConfig));
+    esp_wifi_get_config(WIFI_IF_STA, &wifiConfig);
+    char ssidFromSmartConfig[sizeof(wifiConfig.sta.ssid) + 1] = {0};
+    char pskFromSmartConfig[sizeof(wifiConfig.sta.password) + 1] = {0};
+    memcpy(ssidFromSmartConfig, wifiConfig.sta.ssid, sizeof(wifiConfig.sta.ssid));
+    memcpy(pskFromSmartConfig, wifiConfig.sta.password, sizeof(wifiConfig.sta.password));
+
     const bool useSerialResults = gotSSIDFromSerial && gotPSKFromSerial;
-    const char *ssid = useSerialResults ? ssidFromSerial : WiFi.SSID().c_str();
-    const char *psk = useSerialResults ? pskFromSerial : WiFi.psk().c_str();
+    const char *ssid = useSerialResults ? ssidFromSerial : ssidFromSmartConfig;
+    const char *psk = useSerialResults ? pskFromSerial : pskFromSmartConfig;
 
-    PRINTLN();
-    PRINT("Got SSID: ");
-    PRINTLN(ssid);
-    PRINT("Got PSK: ");
-    PRINTLN(psk);
+    Serial.println();
+    Serial.print("Got SSID: ");
+    Serial.println(ssid);
+    Serial.print("Got PSK: ");
+    Serial.println(psk);
 
-    if (!writeSSIDPW(ssid, psk))
+    setConfigWifiCredentials(ssid, psk);
+    if (!commitDeviceConfig())
     {
-        PRINTLN("Failed to save SSID and Password");
+        Serial.println("Failed to save SSID and Password");
     }
 }
 
@@ -198,6 +324,16 @@ void publishMessage(const char *subTopic, uint8_t *data, uint32_t numBytes)
 {
     static char topicBuffer[100];
     sprintf(topicBuffer, "%s/%s", g_mqttTopicRoot, subTopic);
+    if (g_useRelay)
+    {
+        relaySenderAdd(&g_relaySender, relayRecordKind(subTopic), data, numBytes);
+        return;
+    }
+    if (g_useCoAP)
+    {
+        g_allCoAPDelivered = udpTransportPublish(topicBuffer, data, numBytes) && g_allCoAPDelivered;
+        return;
+    }
     mqttClient.publish(topicBuffer, data, numBytes);
 }
 
@@ -208,9 +344,6 @@ void publishMessage(const char *subTopic, const char *valueFormat, T value)
     static char valueBuffer[100];
     sprintf(topicBuffer, "%s/%s", g_mqttTopicRoot, subTopic);
     sprintf(valueBuffer, valueFormat, value);
-    PRINT(topicBuffer);
-    PRINT(" ");
-    PRINTLN(valueBuffer);
     mqttClient.publish(topicBuffer, valueBuffer);
 }
 
@@ -220,72 +353,323 @@ void publishMessage(const char *subTopic, const char *dataTypeString, const T *d
     static char topicBuffer[100];
     sprintf(topicBuffer, "%s/%s", g_mqttTopicRoot, subTopic);
     const uint8_t *dataStart = (uint8_t *)data;
-    PRINT(topicBuffer);
-    PRINT(" ");
-    PRINTLN(*data);
     mqttClient.publish(topicBuffer, dataStart, sizeof(T));
 }
 
+/// @brief connect PubSubClient through TLS if it is configured
+/// @returns the port of the broker
+uint16_t configureBrokerClient()
+{
+    const DeviceConfig &config = deviceConfig();
+    switch (config.tlsMode)
+    {
+    case kTlsPsk:
+        g_tlsClient.setPsk(config.tlsPskIdentity, config.tlsPsk, config.tlsPskLength);
+        mqttClient.setClient(g_tlsClient);
+        return kMQTTBrokerPskPort;
+    case kTlsEcdsa:
+        g_tlsClient.setCaCert(kTlsCaCert);
+        mqttClient.setClient(g_tlsClient);
+        return kMQTTBrokerEcdsaPort;
+    default:
+        mqttClient.setClient(g_wifiClient);
+        return kMQTTBrokerPort;
+    }
+}
+
+uint32_t batchPeriod_ms()
+{
+    return deviceConfig().timeBetweenMeasurements_ms * numMeasurementsPerBatch();
+}
+
+uint8_t transmitSlot()
+{
+    const DeviceConfig &config = deviceConfig();
+    if (config.transmitSlot < config.numTransmitSlots)
+    {
+        return config.transmitSlot;
+    }
+    uint8_t mac[6];
+    esp_efuse_mac_get_default(mac);
+    return transmitSlotFromMac(mac, config.numTransmitSlots);
+}
+
+/// @brief work out how to adjust the coming sleeps, so that the next transmit wake falls at the start of this device's slot
+void alignToTransmitSlot()
+{
+    const uint8_t numSlots = deviceConfig().numTransmitSlots;
+    const uint32_t now_s = getEpochTime();
+    if (numSlots == 0 || now_s == 0)
+    {
+        // nothing to align to
+        return;
+    }
+
+    // this wake started a little before now, and the next transmit wake is a batch period after it
+    const uint64_t nextTransmit_ms = static_cast<uint64_t>(now_s) * 1000 - millis() + batchPeriod_ms();
+    g_pendingSleepAdjustment_ms = -transmitPhaseError_ms(nextTransmit_ms, batchPeriod_ms(), transmitSlot(), numSlots);
+    LOG_DEBUG(LogEvent::TransmitSlotAlign, transmitSlot(), g_pendingSleepAdjustment_ms);
+}
+
+uint32_t timeBetweenWakes_ms()
+{
+    // in aggregation mode the fast channels are sampled several times between measurements
+    return deviceConfig().timeBetweenMeasurements_ms / numAggregateSamplesPerMeasurement();
+}
+
+/// @brief after a failed transmission, leave exponentially more wakes (handled by the wake stub) before trying again
+void backOffTransmission()
+{
+    if (g_numFailedTransmissions < kMaxTransmitBackoffExponent)
+    {
+        ++g_numFailedTransmissions;
+    }
+    const uint16_t wakesToSkip = (1u << g_numFailedTransmissions) - 1;
+    LOG_WARN(LogEvent::TransmitBackoff, g_numFailedTransmissions, wakesToSkip);
+    wakeStubSkipWakes(wakesToSkip, timeBetweenWakes_ms());
+}
+
 void enterDeepSleep()
 {
     //inspired by https://www.reddit.com/r/esp32/comments/exgi32/esp32_ultralow_power_mode/
-    PRINT("Powering down for ");
-    PRINT(kTimeBetweenMeasurements_ms / 1000);
-    PRINTLN(" seconds...");
+    const uint32_t timeBetweenWakes = timeBetweenWakes_ms();
+    const uint32_t sleepTime_ms = timeBetweenWakes + takeSleepAdjustment_ms(&g_pendingSleepAdjustment_ms, timeBetweenWakes);
+    LOG_INFO(LogEvent::DeepSleep, sleepTime_ms / 1000, millis());
+#if TTGO_LOG_LEVEL >= TTGO_LOG_LEVEL_DEBUG
+    const HeapStats heap = heapStats();
+    LOG_DEBUG(LogEvent::HeapUse, heap.allocations, heap.minFreeBytes);
+#endif
     digitalWrite(POWER_CTRL, LOW);
     WiFi.disconnect(true); // Keeps WiFi APs happy
     WiFi.mode(WIFI_OFF);   // Switch WiFi off
-    esp_sleep_enable_timer_wakeup(kTimeBetweenMeasurements_ms * 1000);
+    esp_sleep_enable_timer_wakeup(static_cast<uint64_t>(sleepTime_ms) * 1000);
     esp_deep_sleep_start();
 }
 
+/// @brief publish the batch of measurements, the aggregate windows and the log, over whichever transport this wake uses
+void sendBatch(const char *sensorName)
+{
+    const DeviceConfig &config = deviceConfig();
+    for (size_t i = 0; i < g_numMeasurementsRecorded; ++i)
+    {
+        ttgo_proto_Measurements &measurements = g_measurements[i];
+
+        // fill in version info
+        measurements.fw_version_major = FW_VERSION_MAJOR;
+        measurements.fw_version_minor = FW_VERSION_MINOR;
+        measurements.fw_version_patch = FW_VERSION_PATCH;
+        measurements.transmit_slot = transmitSlot();
+        measurements.num_transmit_slots = config.numTransmitSlots;
+        measurements.batch_period_s = batchPeriod_ms() / 1000;
+        if (!g_useCoAP && !g_useRelay && config.tlsMode != kTlsOff)
+        {
+            measurements.tls_handshake_ms = g_tlsClient.handshakeTime_ms();
+            measurements.tls_resumed = g_tlsClient.resumedSession();
+        }
+        const HeapStats heap = heapStats();
+        measurements.heap_allocations = heap.allocations;
+        measurements.heap_min_free_bytes = heap.minFreeBytes;
+        measurements.heap_largest_free_block = heap.largestFreeBlock;
+        measurements.config_version = config.remoteConfigVersion;
+
+        // encode protobuf
+        uint8_t protoBuffer[ttgo_proto_Measurements_size];
+        pb_ostream_t stream = pb_ostream_from_buffer(protoBuffer, sizeof(protoBuffer));
+        const bool encodeSuccess = pb_encode(&stream, ttgo_proto_Measurements_fields, &measurements);
+        if (!encodeSuccess)
+        {
+            LOG_ERROR(LogEvent::EncodeFailed, i);
+            continue;
+        }
+
+        // send
+        const size_t message_length = stream.bytes_written;
+        publishMessage(sensorName, protoBuffer, message_length);
+        LOG_DEBUG(LogEvent::MeasurementSent, i, message_length);
+    }
+
+    // and the aggregate windows
+    char aggregatesTopic[MAX_SENSOR_NAME + 12];
+    snprintf(aggregatesTopic, sizeof(aggregatesTopic), "%s/aggregates", sensorName);
+    for (size_t i = 0; i < g_numAggregatesRecorded; ++i)
+    {
+        uint8_t protoBuffer[ttgo_proto_WindowAggregates_size];
+        pb_ostream_t stream = pb_ostream_from_buffer(protoBuffer, sizeof(protoBuffer));
+        if (!pb_encode(&stream, ttgo_proto_WindowAggregates_fields, &g_aggregates[i]))
+        {
+            LOG_ERROR(LogEvent::EncodeFailed, i);
+            continue;
+        }
+        publishMessage(aggregatesTopic, protoBuffer, stream.bytes_written);
+    }
+
+    // ship the log along with the measurements, a few entries per message
+    char logTopic[MAX_SENSOR_NAME + 5];
+    snprintf(logTopic, sizeof(logTopic), "%s/log", sensorName);
+    const size_t numLogEntries = logNumEntries();
+    for (size_t firstEntry = 0; firstEntry < numLogEntries; firstEntry += kLogEntriesPerMessage)
+    {
+        uint8_t logBuffer[kLogEntriesPerMessage * sizeof(LogEntry)];
+        const size_t logLength = logSerialise(logBuffer, sizeof(logBuffer), firstEntry);
+        publishMessage(logTopic, logBuffer, logLength);
+    }
+}
+
+/// @brief mark all as sent so we'll measure a new batch
+void markBatchSent()
+{
+    g_numMeasurementsRecorded = 0;
+    g_numSamplesTaken = 0;
+    g_numAggregatesRecorded = 0;
+    g_numFailedTransmissions = 0;
+}
+
+/// @brief send the batch to the relay over ESP-NOW, without associating with the access point
+/// @returns false if any of it wasn't delivered, in which case it should be sent to the server directly
+bool sendBatchThroughRelay()
+{
+    const DeviceConfig &config = deviceConfig();
+    if (!g_espNowTransport.begin(config.relayPeer, config.relayChannel))
+    {
+        return false;
+    }
+    if (g_relaySequence == 0)
+    {
+        // a cold boot, so start somewhere the relay won't have seen from this device recently
+        g_relaySequence = static_cast<uint16_t>(esp_random());
+    }
+
+    g_useRelay = true;
+    relaySenderBegin(&g_relaySender, &g_espNowTransport, config.sensorName, &g_relaySequence);
+    sendBatch(config.sensorName);
+    const bool delivered = relaySenderFlush(&g_relaySender);
+    g_useRelay = false;
+    g_espNowTransport.end();
+    if (!delivered)
+    {
+        LOG_WARN(LogEvent::RelaySendFailed, g_relaySequence);
+    }
+    return delivered;
+}
+
+void publishRelayed(const char *topic, const uint8_t *data, size_t length, void *context)
+{
+    mqttClient.publish(topic, data, length);
+}
+
 bool connectToWifi()
 {
-    char ssid[24];
-    memset(ssid, 0, sizeof(ssid));
-    char password[24];
-    memset(password, 0, sizeof(password));
-    initNVS();
-    const bool hasDetails = tryReadSSIDPW(ssid, password);
+    const DeviceConfig &config = deviceConfig();
+    const bool hasDetails = config.ssid[0] != 0;
+    if (!hasDetails)
+    {
+        LOG_WARN(LogEvent::WifiNoCredentials);
+    }
+    const uint32_t start_ms = millis();
     if (hasDetails)
     {
-        PRINT("MAC Address: ");
-        PRINTLN(WiFi.macAddress());
-
-        PRINT("Connecting to ");
-        PRINTLN(ssid);
+        LOG_INFO(LogEvent::WifiConnecting);
 
         WiFi.mode(WIFI_STA);
         // seems to be important to have the (const char*) cast to ensure we call the correct overload of begin
-        WiFi.begin((const char *)ssid, (const char *)password);
-        const uint32_t start_ms = millis();
+        WiFi.begin((const char *)config.ssid, (const char *)config.psk);
         constexpr uint32_t kWifiConnectTimeout_ms = 20 * 1000;
         while (WiFi.status() != WL_CONNECTED)
         {
             delay(500);
-            PRINT(".");
             if (millis() - start_ms > kWifiConnectTimeout_ms)
             {
-                PRINTLN("\nFailed to connect to WiFi");
+                LOG_ERROR(LogEvent::WifiConnectTimeout, millis() - start_ms);
                 return false;
             }
         }
-        PRINTLN("");
     }
-    if (WiFi.waitForConnectResult() != WL_CONNECTED)
+    const uint8_t connectResult = WiFi.waitForConnectResult();
+    if (connectResult != WL_CONNECTED)
     {
-        PRINTLN("Failed to connect to WiFi");
+        LOG_ERROR(LogEvent::WifiConnectFailed, connectResult);
         return false;
     }
     else if (WiFi.status() == WL_CONNECTED)
     {
-        PRINT("IP Address: ");
-        PRINTLN(WiFi.localIP());
+        LOG_INFO(LogEvent::WifiConnected, static_cast<uint32_t>(WiFi.localIP()), millis() - start_ms);
         return true;
     }
     return false;
 }
 
+/// @brief be a relay: stay connected to WiFi and the broker, and publish what the nodes send over ESP-NOW.
+/// The relay is mains powered and only forwards, it doesn't take measurements of its own.  Never returns.
+void runRelay()
+{
+    static RelayAggregator aggregator;
+    relayAggregatorReset(&aggregator);
+
+    // the largest frame plus its topic, more than PubSubClient's default
+    mqttClient.setBufferSize(kMaxRelayFrameSize + 64);
+    char macAddress[MAC_STRING_LENGTH];
+    formatMacAddress(macAddress);
+    bool receiving = false;
+    uint32_t lastPublish_ms = millis();
+    while (true)
+    {
+        if (WiFi.status() != WL_CONNECTED)
+        {
+            if (receiving)
+            {
+                g_espNowTransport.end();
+                receiving = false;
+            }
+            if (!connectToWifi())
+            {
+                delay(5000);
+                continue;
+            }
+            // ESP-NOW frames are missed while the radio sleeps between beacons
+            WiFi.setSleep(false);
+        }
+        if (!receiving)
+        {
+            receiving = g_espNowTransport.begin(nullptr, 0);
+            LOG_INFO(LogEvent::RelayStarted, WiFi.channel());
+        }
+        if (!mqttClient.connected())
+        {
+            mqttClient.setServer(kMQTTBroker, configureBrokerClient());
+            if (mqttClient.connect(macAddress))
+            {
+                LOG_INFO(LogEvent::MQTTConnected, 1);
+            }
+            else
+            {
+                LOG_WARN(LogEvent::MQTTConnectFailed, mqttClient.state(), 1);
+                delay(5000);
+                continue;
+            }
+        }
+
+        uint8_t frame[kMaxRelayFrameSize];
+        size_t length;
+        while ((length = g_espNowTransport.receive(frame, sizeof(frame))) > 0)
+        {
+            relayAggregatorAccept(&aggregator, frame, length);
+        }
+
+        // publishing a second's worth at a time lets a burst of frames from a node go out back to back
+        if (millis() - lastPublish_ms >= kRelayPublishInterval_ms)
+        {
+            lastPublish_ms = millis();
+            const uint16_t numPublished = relayAggregatorPublish(&aggregator, publishRelayed, nullptr);
+            if (numPublished > 0)
+            {
+                LOG_DEBUG(LogEvent::RelayForwarded, numPublished, aggregator.numDuplicates);
+            }
+        }
+        mqttClient.loop();
+        delay(10);
+    }
+}
+
 void setup()
 {
     // setup GPIOs
@@ -298,6 +682,12 @@ void setup()
     Serial.begin(115200);
     delay(100);
 
+    logBeginWake();
+    if (Serial.available() > 0 && Serial.read() == kLogDumpRequest)
+    {
+        logDump(Serial);
+    }
+
     // disable saving wifi details into Flash as it wears it down and is anyway unreliable
     // so we store details in NVS instead by ourselves
     WiFi.persistent(false);
@@ -308,86 +698,134 @@ void setup()
         configStart();
     }
 
-    PRINTLN("Firmware version ");
-    PRINT(FW_VERSION_MAJOR);
-    PRINT(".");
-    PRINT(FW_VERSION_MINOR);
-    PRINT(".");
-    PRINT(FW_VERSION_PATCH);
-    PRINT(" Build time ");
-    PRINTLN(BUILD_TIME);
+    // after the first boot this comes straight from RTC memory
+    loadDeviceConfig();
+    const DeviceConfig &config = deviceConfig();
+
+    LOG_INFO(LogEvent::Boot, FW_VERSION_MAJOR * 10000 + FW_VERSION_MINOR * 100 + FW_VERSION_PATCH, BUILD_TIME);
+
+    if (config.relayRole == kRelayRoleRelay)
+    {
+        runRelay();
+    }
+
+    // the time slept through the wakes the stub handled still counts
+    const uint16_t skippedWakes = wakeStubTakeSkippedWakes();
+    if (skippedWakes > 0)
+    {
+        LOG_INFO(LogEvent::WakesSkipped, skippedWakes);
+        g_timeSinceRTCUpdate_ms += skippedWakes * timeBetweenWakes_ms();
+    }
 
     // set CPU to low frequency
     setCpuFrequencyMhz(80);
-    PRINT("CPU frequency set to ");
-    PRINT(getCpuFrequencyMhz());
-    PRINTLN(" MHz");
+    LOG_DEBUG(LogEvent::CpuFrequency, getCpuFrequencyMhz());
+
+    // most wakes in aggregation mode only sample the fast channels, and go straight back to sleep
+    if (g_numSamplesTaken < numMeasurementsPerBatch() && //
+        g_numAggregateWakes + 1 < numAggregateSamplesPerMeasurement())
+    {
+        takeAggregateSample();
+        ++g_numAggregateWakes;
+        enterDeepSleep();
+    }
 
     // update RTC if necessesary
     bool wifiConnected = false;
-    if (g_timeSinceRTCUpdate_ms >= kTimeBetweenRTCUpdates_ms)
+    if (g_timeSinceRTCUpdate_ms >= config.timeBetweenRTCUpdates_ms)
     {
         wifiConnected = connectToWifi();
         if (wifiConnected && tryToUpdateAbsoluteTime())
         {
             g_timeSinceRTCUpdate_ms = 0;
-            char timeString[100];
-            getLocalTimeString(timeString, 100);
-            PRINT("Updated RTC: ");
-            PRINTLN(timeString);
+            LOG_INFO(LogEvent::RTCUpdated, getEpochTime());
         }
         else
         {
-            PRINTLN("Failed to update RTC.");
+            LOG_WARN(LogEvent::RTCUpdateFailed);
         }
     }
 
     // if we need to, take a measurment
-    if (g_numMeasurementsRecorded < kNumMeasurementsToTakeBeforeSending)
+    if (g_numSamplesTaken < numMeasurementsPerBatch())
     {
-        PRINTLN("Powering on to take measurement");
-        digitalWrite(POWER_CTRL, HIGH);
-        delay(1000);
+        LOG_DEBUG(LogEvent::MeasurementStart, g_numSamplesTaken);
+        const uint32_t powerOn_ms = millis();
 
-        // initialise I2C devices
-        bool connected = tryInitI2CAndDevices();
-        while (!connected)
-        {
-            delay(200);
-            connected = tryInitI2CAndDevices();
-        }
+        // a missing light sensor shows up as a failed lux reading, rather than stopping the other measurements
+        powerUpSensors();
 
         // DHT12 takes a long time, delay till it's ready
-        delay(2500);
+        const uint32_t sincePowerOn_ms = millis() - powerOn_ms;
+        if (sincePowerOn_ms < kDHT12PowerUpTime_ms)
+        {
+            delay(kDHT12PowerUpTime_ms - sincePowerOn_ms);
+        }
 
-        // take measurements
-        ttgo_proto_Measurements *nextMeasurement = &g_measurements[g_numMeasurementsRecorded];
-        if (takeMeasurements(&lightMeter, &dht12, nextMeasurement))
+        // take measurements, and keep only what the compression says must be sent
+        ttgo_proto_Measurements sample;
+        if (takeMeasurements(&lightMeter, &dht12, &sample))
         {
-#ifdef TTGO_DEBUG_PRINT
-            PRINTLN(nextMeasurement->lux);
-            PRINTLN(nextMeasurement->humidity);
-            PRINTLN(nextMeasurement->salt);
-            PRINTLN(nextMeasurement->soil);
-            PRINTLN(nextMeasurement->temperature_C);
-#endif
-            ++g_numMeasurementsRecorded;
+            ++g_numSamplesTaken;
+            sample.sequence = nextSampleSequence();
+            const uint8_t numRecorded = compressSample(&g_compressionState,
+                                                       config.compression,
+                                                       sample,
+                                                       &g_measurements[g_numMeasurementsRecorded]);
+
+            // chain the messages, so the server can tell samples compressed away from ones that went missing
+            for (uint8_t i = 0; i < numRecorded; ++i)
+            {
+                ttgo_proto_Measurements &recorded = g_measurements[g_numMeasurementsRecorded + i];
+                recorded.previous_sequence = g_lastRecordedSequence;
+                g_lastRecordedSequence = recorded.sequence;
+            }
+            g_numMeasurementsRecorded += numRecorded;
+
+            // the measurement closes the aggregate window
+            if (numAggregateSamplesPerMeasurement() > 1)
+            {
+                addAggregateSample(&g_aggregateWindow, sample.timestamp, sample.lux, sample.soil, sample.salt);
+                if (finishAggregateWindow(g_aggregateWindow, &g_aggregates[g_numAggregatesRecorded]))
+                {
+                    ++g_numAggregatesRecorded;
+                }
+                resetAggregateWindow(&g_aggregateWindow);
+                g_numAggregateWakes = 0;
+            }
         }
         else
         {
-            PRINTLN("Failed measurement");
+            LOG_ERROR(LogEvent::MeasurementFailed);
         }
         digitalWrite(POWER_CTRL, LOW);
     }
 
-    PRINT("Taken measurements ");
-    PRINT(g_numMeasurementsRecorded);
-    PRINT("/");
-    PRINTLN(kNumMeasurementsToTakeBeforeSending);
+    LOG_INFO(LogEvent::MeasurementProgress, g_numSamplesTaken, g_numMeasurementsRecorded);
 
     // if we still have more measurements to take, then go back to sleep
-    if (g_numMeasurementsRecorded < kNumMeasurementsToTakeBeforeSending)
+    if (g_numSamplesTaken < numMeasurementsPerBatch())
+    {
+        enterDeepSleep();
+    }
+
+    // if everything in this batch was compressed away (and there are no aggregates), there's nothing to send
+    if (g_numMeasurementsRecorded == 0 && g_numAggregatesRecorded == 0)
     {
+        g_numSamplesTaken = 0;
+        g_timeSinceRTCUpdate_ms += (config.timeBetweenMeasurements_ms * numMeasurementsPerBatch());
+        alignToTransmitSlot();
+        enterDeepSleep();
+    }
+
+    // a node of a relay hands the batch over without joining the network at all (unless it already has, to update the
+    // RTC).  Anything the relay doesn't acknowledge goes to the server directly instead.
+    if (config.relayRole == kRelayRoleNode && !wifiConnected && config.sensorName[0] != 0 && sendBatchThroughRelay())
+    {
+        logClear();
+        markBatchSent();
+        alignToTransmitSlot();
+        g_timeSinceRTCUpdate_ms += (config.timeBetweenMeasurements_ms * numMeasurementsPerBatch());
         enterDeepSleep();
     }
 
@@ -403,112 +841,136 @@ void setup()
     if (wifiConnected)
     {
         // get absolute time if necessary
-        if (g_timeSinceRTCUpdate_ms >= kTimeBetweenRTCUpdates_ms)
+        if (g_timeSinceRTCUpdate_ms >= config.timeBetweenRTCUpdates_ms)
         {
             if (tryToUpdateAbsoluteTime())
             {
                 g_timeSinceRTCUpdate_ms = 0;
-                char timeString[100];
-                getLocalTimeString(timeString, 100);
-                PRINT("Updated RTC: ");
-                PRINTLN(timeString);
+                LOG_INFO(LogEvent::RTCUpdated, getEpochTime());
             }
             else
             {
-                PRINTLN("Failed to update RTC.");
+                LOG_WARN(LogEvent::RTCUpdateFailed);
             }
         }
 
-        // determine our name
+        // until we have a name, identify ourselves to the broker by MAC address
         char sensorName[MAX_SENSOR_NAME + 1];
-        if (!tryReadSensorName(sensorName))
+        strcpy(sensorName, config.sensorName);
+        char macAddress[MAC_STRING_LENGTH];
+        formatMacAddress(macAddress);
+        const bool needsName = sensorName[0] == 0;
+
+        // the gateway can't name a device, so a device without a name always starts over MQTT
+        g_useCoAP = config.transport == kTransportCoAP && !needsName;
+        if (g_useCoAP && !udpTransportBegin(kMQTTBroker, kCoapGatewayPort))
         {
-            // get a name from the server
-            if (!getNextSensorName(&g_wifiClient, kServerAddress, kServerPort, kNextSensorNameAPI, sensorName, MAX_SENSOR_NAME + 1, kServerIsLocal))
-            {
-                Serial.println("Failed to get sensor name.  Using DEFAULT");
-                strcpy(sensorName, "DEFAULT");
-            }
-            else
-            {
-                Serial.print("Retrieved new sensor name: ");
-                Serial.println(sensorName);
-                if (!writeSensorName(sensorName))
-                {
-                    Serial.println("Failed to save sensor name");
-                }
-            }
+            backOffTransmission();
+            enterDeepSleep();
         }
 
         // now send them all
-        mqttClient.setServer(kMQTTBroker, kMQTTBrokerPort);
-        PRINTLN("Connecting MQTT client...");
+        mqttClient.setServer(kMQTTBroker, configureBrokerClient());
         uint8_t mqttConnectionAttempts = 0;
-        while (!mqttClient.connected())
+        while (!g_useCoAP && !mqttClient.connected())
         {
             ++mqttConnectionAttempts;
-            if (mqttClient.connect(sensorName))
+            if (mqttClient.connect(needsName ? macAddress : sensorName))
             {
-                PRINT("MQTT client connected as '");
-                PRINT(sensorName);
-                PRINTLN("'");
+                LOG_INFO(LogEvent::MQTTConnected, mqttConnectionAttempts);
                 break;
             }
 
-            PRINT("Failed to connect MQTT client.  State = ");
-            PRINT(mqttClient.state());
-            PRINT(".");
+            LOG_WARN(LogEvent::MQTTConnectFailed, mqttClient.state(), mqttConnectionAttempts);
 
             // if we've tried too many times, bottle out
-            if (mqttConnectionAttempts >= kMaxNumMQTTAttempts)
+            if (mqttConnectionAttempts >= config.maxNumMQTTAttempts)
             {
+                backOffTransmission();
                 enterDeepSleep();
             }
-            PRINTLN(" Retrying in 5s...");
             delay(5000);
         }
 
-        // we're connected, now send!
-        for (size_t i = 0; i < g_numMeasurementsRecorded; ++i)
+        // the config the server has for this device is retained, so it arrives while the batch is being sent
+        const bool configSubscribed = !g_useCoAP && !needsName && subscribeRemoteConfig(&mqttClient, sensorName);
+
+        // get a name from the server over the session we already have
+        if (needsName)
         {
-            PRINT("Sending measurement ");
-            PRINT(i + 1);
-            PRINT("/");
-            PRINTLN(g_numMeasurementsRecorded);
-
-            ttgo_proto_Measurements &measurements = g_measurements[i];
-
-            // fill in version info
-            measurements.fw_version_major = FW_VERSION_MAJOR;
-            measurements.fw_version_minor = FW_VERSION_MINOR;
-            measurements.fw_version_patch = FW_VERSION_PATCH;
-
-            // encode protobuf
-            uint8_t protoBuffer[ttgo_proto_Measurements_size];
-            pb_ostream_t stream = pb_ostream_from_buffer(protoBuffer, sizeof(protoBuffer));
-            const bool encodeSuccess = pb_encode(&stream, ttgo_proto_Measurements_fields, &measurements);
-            if (!encodeSuccess)
+            bool gotName = requestSensorName(&mqttClient, macAddress, sensorName, sizeof(sensorName), kSensorNameTimeout_ms);
+#ifdef TTGO_ENABLE_HTTP_NAMING
+            if (!gotName)
             {
-                PRINTLN("Failed to encode.  Skipping.");
-                continue;
+                WiFiClient httpWifiClient;
+                gotName = getNextSensorName(&httpWifiClient, kServerAddress, kServerPort, kNextSensorNameAPI, sensorName, MAX_SENSOR_NAME + 1, kServerIsLocal);
             }
+#endif
+            if (!gotName)
+            {
+                LOG_ERROR(LogEvent::SensorNameFailed);
+                strcpy(sensorName, "DEFAULT");
+            }
+            else
+            {
+                LOG_INFO(LogEvent::SensorNameRetrieved);
+                setConfigSensorName(sensorName);
+                if (!commitDeviceConfig())
+                {
+                    LOG_ERROR(LogEvent::SensorNameSaveFailed);
+                }
+            }
+        }
+
+        sendBatch(sensorName);
 
-            // send
-            const size_t message_length = stream.bytes_written;
-            publishMessage(sensorName, protoBuffer, message_length);
+        // keep the batch (and log) for the next transmission if the gateway didn't take all of it
+        if (g_useCoAP)
+        {
+            g_allCoAPDelivered = udpTransportFlush() && g_allCoAPDelivered;
+            udpTransportEnd();
+            if (!g_allCoAPDelivered)
+            {
+                backOffTransmission();
+                enterDeepSleep();
+            }
+        }
+        logClear();
 
-            // print out for debug
-            printMeasurements(Serial, measurements);
+        // apply any new config at once (it is only written to NVS if something has changed)
+        ttgo_proto_RemoteConfig remoteConfig;
+        if (configSubscribed &&                                                    //
+            takeRemoteConfig(&mqttClient, &remoteConfig, kRemoteConfigTimeout_ms) && //
+            applyRemoteConfig(remoteConfig))
+        {
+            commitDeviceConfig();
         }
 
-        // mark all as sent so we'll measure a new batch
-        g_numMeasurementsRecorded = 0;
+        // every so often, pick up a slot assigned by the server (only stored if it has changed).
+        // slot assignments are retained MQTT messages, so devices sending over CoAP keep their configured slot
+        if (!g_useCoAP && g_numTransmitsSinceSlotCheck == 0)
+        {
+            uint8_t assignedSlot;
+            if (requestTransmitSlot(&mqttClient, sensorName, &assignedSlot, kSlotCheckTimeout_ms) && //
+                assignedSlot != deviceConfig().transmitSlot)
+            {
+                deviceConfig().transmitSlot = assignedSlot;
+                commitDeviceConfig();
+            }
+        }
+        g_numTransmitsSinceSlotCheck = (g_numTransmitsSinceSlotCheck + 1) % kTransmitsBetweenSlotChecks;
 
+        markBatchSent();
         mqttClient.disconnect();
+        alignToTransmitSlot();
+    }
+    else
+    {
+        backOffTransmission();
     }
 
     // finally, go back to sleep
-    g_timeSinceRTCUpdate_ms += (kTimeBetweenMeasurements_ms * kNumMeasurementsToTakeBeforeSending);
+    g_timeSinceRTCUpdate_ms += (config.timeBetweenMeasurements_ms * numMeasurementsPerBatch());
     enterDeepSleep();
 }
 
@@ -1,7 +1,27 @@
 #include "measurements.h"
 #include "pins.h"
 #include "time_helpers.h"
+#include "device_config.h"
 #include "driver/adc.h"
+#include "driver/pcnt.h"
+#include "esp_timer.h"
+#include "i2c_bus.h"
+#include "log.h"
+#include "soil_frequency.h"
+
+namespace
+{
+    constexpr pcnt_unit_t kSoilCounterUnit = PCNT_UNIT_0;
+    constexpr int16_t kSoilCounterHighLimit = 30000;
+    constexpr uint16_t kSoilCounterFilter = 8; // ignore glitches shorter than 8 APB cycles (100ns)
+    volatile uint32_t g_soilCounterOverflows = 0;
+
+    void IRAM_ATTR onSoilCounterHighLimit(void *)
+    {
+        // the counter is reset to 0 when it reaches the high limit
+        ++g_soilCounterOverflows;
+    }
+}
 
 uint32_t readSalt()
 {
@@ -25,12 +45,88 @@ uint32_t readSalt()
     return humi;
 }
 
-uint16_t readSoil()
+/// @brief count the pulses of the soil probe oscillator on SOIL_FREQUENCY_PIN for \p gate_us
+bool readSoilFrequency_Hz(uint32_t gate_us, float *outFrequency_Hz)
 {
+    pcnt_config_t counterConfig = {};
+    counterConfig.pulse_gpio_num = SOIL_FREQUENCY_PIN;
+    counterConfig.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    counterConfig.lctrl_mode = PCNT_MODE_KEEP;
+    counterConfig.hctrl_mode = PCNT_MODE_KEEP;
+    counterConfig.pos_mode = PCNT_COUNT_INC;
+    counterConfig.neg_mode = PCNT_COUNT_DIS;
+    counterConfig.counter_h_lim = kSoilCounterHighLimit;
+    counterConfig.counter_l_lim = 0;
+    counterConfig.unit = kSoilCounterUnit;
+    counterConfig.channel = PCNT_CHANNEL_0;
+    esp_err_t err = pcnt_unit_config(&counterConfig);
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::SoilCounterFailed, err);
+        return false;
+    }
+    pcnt_set_filter_value(kSoilCounterUnit, kSoilCounterFilter);
+    pcnt_filter_enable(kSoilCounterUnit);
+
+    // count overflows at the high limit, so the gate isn't limited by the 16 bit counter
+    pcnt_event_enable(kSoilCounterUnit, PCNT_EVT_H_LIM);
+    err = pcnt_isr_service_install(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) // already installed is fine
+    {
+        LOG_ERROR(LogEvent::SoilCounterFailed, err);
+        return false;
+    }
+    pcnt_isr_handler_add(kSoilCounterUnit, onSoilCounterHighLimit, nullptr);
+
+    pcnt_counter_pause(kSoilCounterUnit);
+    pcnt_counter_clear(kSoilCounterUnit);
+    g_soilCounterOverflows = 0;
+
+    // the gate is timed from the counter being started to it being stopped, rather than trusting the delay
+    const int64_t start_us = esp_timer_get_time();
+    pcnt_counter_resume(kSoilCounterUnit);
+    delayMicroseconds(gate_us);
+    pcnt_counter_pause(kSoilCounterUnit);
+    const int64_t end_us = esp_timer_get_time();
+
+    int16_t counterValue = 0;
+    pcnt_get_counter_value(kSoilCounterUnit, &counterValue);
+    pcnt_isr_handler_remove(kSoilCounterUnit);
+    pcnt_isr_service_uninstall();
+
+    const uint32_t pulseCount = soilPulseCount(g_soilCounterOverflows, counterValue, kSoilCounterHighLimit);
+    *outFrequency_Hz = soilPulseFrequency_Hz(pulseCount, static_cast<uint32_t>(end_us - start_us));
+    return true;
+}
+
+float readSoil()
+{
+    const SoilSettings &settings = deviceConfig().soil;
+    if (settings.mode == kSoilModeFrequency)
+    {
+        float frequency_Hz;
+        if (readSoilFrequency_Hz(settings.gate_us, &frequency_Hz))
+        {
+            return soilMoistureFromFrequency(settings, frequency_Hz);
+        }
+        // otherwise fall back to the DC level
+    }
+
     uint16_t soil = analogRead(SOIL_PIN);
     return map(soil, 0, 4095, 100, 0);
 }
 
+float readLux(BH1750 *lightMeter)
+{
+    // the library reports a failed read as a negative level
+    const float lux = lightMeter->readLightLevel();
+    if (lux < 0)
+    {
+        i2cRecordError(kI2CDeviceBH1750);
+    }
+    return lux;
+}
+
 float readBattery()
 {
     int vref = 1100;
@@ -68,18 +164,17 @@ bool takeMeasurements(BH1750 *lightMeter, DHT12 *dht12, ttgo_proto_Measurements
         ++outMeasurements->num_dht_failed_reads;
         if (outMeasurements->num_dht_failed_reads >= kMaxNumAttempts)
         {
-            Serial.println("Measurements failed.");
+            LOG_ERROR(LogEvent::DHTReadFailed, outMeasurements->num_dht_failed_reads);
             return false;
         }
 
-        Serial.println("DHT12 measurements failed, retrying...");
+        LOG_WARN(LogEvent::DHTReadRetry, outMeasurements->num_dht_failed_reads);
         delay(kTimeBetweenAttempts_ms);
     }
 
-    // we have to read twice as the first is always 0
-    outMeasurements->lux = lightMeter->readLightLevel();
-    delay(1000);
-    outMeasurements->lux = lightMeter->readLightLevel();
+    // the light meter was started in continuous mode at power up, and has long since finished its first conversion
+    // while waiting for the DHT12, so there's no need to read twice (the first read used to always be 0)
+    outMeasurements->lux = readLux(lightMeter);
 
     // turn the ADC on to take other measurements
     adc_power_acquire();
@@ -88,6 +183,38 @@ bool takeMeasurements(BH1750 *lightMeter, DHT12 *dht12, ttgo_proto_Measurements
     outMeasurements->battery_mV = readBattery();
     adc_power_release();
 
+    outMeasurements->timestamp = getEpochTime();
+    outMeasurements->bh1750_i2c_errors = i2cDeviceErrors(kI2CDeviceBH1750);
+    outMeasurements->i2c_bus_recoveries = i2cBusRecoveries();
+
+    return true;
+}
+
+bool takeFastMeasurements(BH1750 *lightMeter, ttgo_proto_Measurements *outMeasurements)
+{
+    if (lightMeter == nullptr ||   //
+        outMeasurements == nullptr //
+    )
+    {
+        return false;
+    }
+
+    *outMeasurements = ttgo_proto_Measurements_init_default;
+
+    // a single high resolution conversion takes at most 180ms, rather than waiting for a second reading
+    constexpr uint32_t kLightConversionTime_ms = 180;
+    if (!lightMeter->configure(BH1750::ONE_TIME_HIGH_RES_MODE))
+    {
+        i2cRecordError(kI2CDeviceBH1750);
+    }
+    delay(kLightConversionTime_ms);
+    outMeasurements->lux = readLux(lightMeter);
+
+    adc_power_acquire();
+    outMeasurements->soil = readSoil();
+    outMeasurements->salt = readSalt();
+    adc_power_release();
+
     outMeasurements->timestamp = getEpochTime();
 
     return true;
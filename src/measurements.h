@@ -10,6 +10,10 @@
 
 bool takeMeasurements(BH1750 *lightMeter, DHT12 *dht12, ttgo_proto_Measurements *outMeasurements);
 
+/// @brief read only the channels that are quick to sample (lux, soil and salt), for the windowed aggregates.
+/// The other fields of \p outMeasurements are left as the defaults.
+bool takeFastMeasurements(BH1750 *lightMeter, ttgo_proto_Measurements *outMeasurements);
+
 void printMeasurements(Print &printer, const ttgo_proto_Measurements &measurements);
 
 #endif
\ No newline at end of file
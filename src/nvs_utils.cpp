@@ -1,8 +1,10 @@
 #include "nvs_utils.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "log.h"
 
 #define SENSOR_NAME_KEY "sname"
+#define SAMPLE_SEQUENCE_KEY "sseq"
 
 typedef uint32_t nvs_handle_t;
 
@@ -10,14 +12,16 @@ void clearNVS()
 {
     int err;
     err = nvs_flash_init();
-    Serial.println("nvs_flash_init: " + err);
+    LOG_INFO(LogEvent::NVSInit, err);
     err = nvs_flash_erase();
-    Serial.println("nvs_flash_erase: " + err);
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::NVSError, err);
+    }
 }
 
 bool initNVS()
 {
-    Serial.println("initNVS");
     esp_err_t err = nvs_flash_init();
     if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND)
     {
@@ -28,26 +32,23 @@ bool initNVS()
     }
     if (err != ESP_OK)
     {
-        Serial.println("NVS error: ");
-        Serial.println(err);
+        LOG_ERROR(LogEvent::NVSError, err);
         return false;
     }
     else
     {
-        Serial.println("NVS OK");
+        LOG_DEBUG(LogEvent::NVSInit, err);
         return true;
     }
 }
 
 bool tryReadSSIDPW(char *ssid, char *pwd)
 {
-    Serial.println("tryReadSSIDPW");
     nvs_handle_t storage;
     esp_err_t err = nvs_open("store", NVS_READWRITE, &storage);
     if (err != ESP_OK)
     {
-        Serial.print("nvs_open: ");
-        Serial.println(esp_err_to_name(err));
+        LOG_ERROR(LogEvent::NVSOpenFailed, err);
         return false;
     }
     else
@@ -58,19 +59,16 @@ bool tryReadSSIDPW(char *ssid, char *pwd)
         switch (err)
         {
         case ESP_OK:
-            Serial.print("SSID was: ");
-            Serial.println(ssid);
             break;
         default:
-            Serial.print("nvs_get_str(ssid): ");
-            Serial.println(esp_err_to_name(err));
+            LOG_WARN(LogEvent::NVSReadFailed, err);
             nvs_close(storage);
             return false;
         }
 
         if (length > MAX_SSID_LENGTH)
         {
-            Serial.println("Stored SSID too long");
+            LOG_ERROR(LogEvent::NVSReadFailed, ESP_ERR_NVS_INVALID_LENGTH);
             nvs_close(storage);
             return false;
         }
@@ -81,36 +79,32 @@ bool tryReadSSIDPW(char *ssid, char *pwd)
         switch (err)
         {
         case ESP_OK:
-            Serial.print("pwd was: ");
-            Serial.println(pwd);
             break;
         default:
-            Serial.print("nvs_get_str(pwd): ");
-            Serial.println(esp_err_to_name(err));
+            LOG_WARN(LogEvent::NVSReadFailed, err);
             nvs_close(storage);
             return false;
         }
 
         if (length > MAX_PWD_LENGTH)
         {
-            Serial.println("Stored PWD too long");
+            LOG_ERROR(LogEvent::NVSReadFailed, ESP_ERR_NVS_INVALID_LENGTH);
             nvs_close(storage);
             return false;
         }
 
+        nvs_close(storage);
         return true;
     }
 }
 
 bool writeSSIDPW(const char *ssid, const char *pwd)
 {
-    Serial.println("writeSSIDPW");
     nvs_handle_t storage;
     esp_err_t err = nvs_open("store", NVS_READWRITE, &storage);
     if (err != ESP_OK)
     {
-        Serial.print("nvs_open: ");
-        Serial.println(esp_err_to_name(err));
+        LOG_ERROR(LogEvent::NVSOpenFailed, err);
         return false;
     }
     else
@@ -121,8 +115,7 @@ bool writeSSIDPW(const char *ssid, const char *pwd)
             err = nvs_erase_key(storage, "ssid");
             if (err != ESP_OK)
             {
-                Serial.print("nvs_erase_key(ssid): ");
-                Serial.println(esp_err_to_name(err));
+                LOG_ERROR(LogEvent::NVSWriteFailed, err);
                 nvs_close(storage);
                 return false;
             }
@@ -132,8 +125,7 @@ bool writeSSIDPW(const char *ssid, const char *pwd)
             err = nvs_set_str(storage, "ssid", ssid);
             if (err != ESP_OK)
             {
-                Serial.print("nvs_set_str(ssid): ");
-                Serial.println(esp_err_to_name(err));
+                LOG_ERROR(LogEvent::NVSWriteFailed, err);
                 nvs_close(storage);
                 return false;
             }
@@ -145,8 +137,7 @@ bool writeSSIDPW(const char *ssid, const char *pwd)
             err = nvs_erase_key(storage, "pwd");
             if (err != ESP_OK)
             {
-                Serial.print("nvs_erase_key(pwd): ");
-                Serial.println(esp_err_to_name(err));
+                LOG_ERROR(LogEvent::NVSWriteFailed, err);
                 nvs_close(storage);
                 return false;
             }
@@ -156,8 +147,7 @@ bool writeSSIDPW(const char *ssid, const char *pwd)
             err = nvs_set_str(storage, "pwd", pwd);
             if (err != ESP_OK)
             {
-                Serial.print("nvs_set_str(pwd): ");
-                Serial.println(esp_err_to_name(err));
+                LOG_ERROR(LogEvent::NVSWriteFailed, err);
                 nvs_close(storage);
                 return false;
             }
@@ -167,8 +157,7 @@ bool writeSSIDPW(const char *ssid, const char *pwd)
         err = nvs_commit(storage);
         if (err != ESP_OK)
         {
-            Serial.print("nvs_commit: ");
-            Serial.println(esp_err_to_name(err));
+            LOG_ERROR(LogEvent::NVSCommitFailed, err);
             nvs_close(storage);
             return false;
         }
@@ -180,13 +169,11 @@ bool writeSSIDPW(const char *ssid, const char *pwd)
 
 bool writeSensorName(const char *name)
 {
-    Serial.println("writeSensorName");
     nvs_handle_t storage;
     esp_err_t err = nvs_open("store", NVS_READWRITE, &storage);
     if (err != ESP_OK)
     {
-        Serial.print("nvs_open: ");
-        Serial.println(esp_err_to_name(err));
+        LOG_ERROR(LogEvent::NVSOpenFailed, err);
         return false;
     }
 
@@ -196,8 +183,7 @@ bool writeSensorName(const char *name)
         err = nvs_erase_key(storage, SENSOR_NAME_KEY);
         if (err != ESP_OK)
         {
-            Serial.print("nvs_erase_key(" SENSOR_NAME_KEY "): ");
-            Serial.println(esp_err_to_name(err));
+            LOG_ERROR(LogEvent::NVSWriteFailed, err);
             nvs_close(storage);
             return false;
         }
@@ -207,24 +193,32 @@ bool writeSensorName(const char *name)
         err = nvs_set_str(storage, SENSOR_NAME_KEY, name);
         if (err != ESP_OK)
         {
-            Serial.print("nvs_set_str(" SENSOR_NAME_KEY "): ");
-            Serial.println(esp_err_to_name(err));
+            LOG_ERROR(LogEvent::NVSWriteFailed, err);
             nvs_close(storage);
             return false;
         }
     }
+
+    // commit
+    err = nvs_commit(storage);
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::NVSCommitFailed, err);
+        nvs_close(storage);
+        return false;
+    }
+
+    nvs_close(storage);
     return true;
 }
 
 bool tryReadSensorName(char *name)
 {
-    Serial.println("tryReadSensorName");
     nvs_handle_t storage;
     esp_err_t err = nvs_open("store", NVS_READWRITE, &storage);
     if (err != ESP_OK)
     {
-        Serial.print("nvs_open: ");
-        Serial.println(esp_err_to_name(err));
+        LOG_ERROR(LogEvent::NVSOpenFailed, err);
         return false;
     }
 
@@ -234,22 +228,77 @@ bool tryReadSensorName(char *name)
     switch (err)
     {
     case ESP_OK:
-        Serial.print("Sensor name was: ");
-        Serial.println(name);
         break;
     default:
-        Serial.print("nvs_get_str(" SENSOR_NAME_KEY "): ");
-        Serial.println(esp_err_to_name(err));
+        LOG_WARN(LogEvent::NVSReadFailed, err);
         nvs_close(storage);
         return false;
     }
 
     if (length > MAX_SENSOR_NAME)
     {
-        Serial.println("Stored sensor name too long");
+        LOG_ERROR(LogEvent::NVSReadFailed, ESP_ERR_NVS_INVALID_LENGTH);
+        nvs_close(storage);
+        return false;
+    }
+
+    nvs_close(storage);
+    return true;
+}
+
+bool writeSampleSequence(uint32_t sequence)
+{
+    nvs_handle_t storage;
+    esp_err_t err = nvs_open("store", NVS_READWRITE, &storage);
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::NVSOpenFailed, err);
+        return false;
+    }
+
+    err = nvs_set_u32(storage, SAMPLE_SEQUENCE_KEY, sequence);
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::NVSWriteFailed, err);
+        nvs_close(storage);
+        return false;
+    }
+
+    // commit
+    err = nvs_commit(storage);
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::NVSCommitFailed, err);
         nvs_close(storage);
         return false;
     }
 
+    nvs_close(storage);
     return true;
-}
\ No newline at end of file
+}
+
+bool tryReadSampleSequence(uint32_t *sequence)
+{
+    nvs_handle_t storage;
+    esp_err_t err = nvs_open("store", NVS_READWRITE, &storage);
+    if (err != ESP_OK)
+    {
+        LOG_ERROR(LogEvent::NVSOpenFailed, err);
+        return false;
+    }
+
+    err = nvs_get_u32(storage, SAMPLE_SEQUENCE_KEY, sequence);
+    if (err != ESP_OK)
+    {
+        // not found on a device that has never stored one
+        if (err != ESP_ERR_NVS_NOT_FOUND)
+        {
+            LOG_WARN(LogEvent::NVSReadFailed, err);
+        }
+        nvs_close(storage);
+        return false;
+    }
+
+    nvs_close(storage);
+    return true;
+}
@@ -1,3 +1,6 @@
+#ifndef __NVS_UTILS__
+#define __NVS_UTILS__
+
 #include "Arduino.h"
 
 #define MAX_SSID_LENGTH 20
@@ -27,4 +30,17 @@ bool writeSensorName(const char *name);
 /// @brief Try to read the sensor name from non volatile storage (previously saved using writeSensorName)
 /// @param name pointer to a buffer that is filled with the sensor name if successfull
 /// @returns true if the read was successfull, in which case the buffer \p name is filled with the read name
-bool tryReadSensorName(char *name);
\ No newline at end of file
+bool tryReadSensorName(char *name);
+
+/// @brief Try to write the sequence number of the next sample into non volatile storage
+/// @param[in] sequence The sequence number to store
+/// @returns true if the save was successfull
+bool writeSampleSequence(uint32_t sequence);
+
+/// @brief Try to read the sequence number of the next sample from non volatile storage (previously saved using
+/// writeSampleSequence)
+/// @param[out] sequence filled with the read sequence number if successfull
+/// @returns true if the read was successfull
+bool tryReadSampleSequence(uint32_t *sequence);
+
+#endif
@@ -4,6 +4,7 @@
 #define BAT_ADC 33
 #define SALT_PIN 34
 #define SOIL_PIN 32
+#define SOIL_FREQUENCY_PIN 27 // not connected on a stock board, see "Soil" in the README
 #define BOOT_PIN 0
 #define POWER_CTRL 4 // GPIO4 - PWR_EN
 #define USER_BUTTON 35
\ No newline at end of file
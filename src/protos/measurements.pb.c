@@ -9,4 +9,13 @@
 PB_BIND(ttgo_proto_Measurements, ttgo_proto_Measurements, AUTO)
 
 
+PB_BIND(ttgo_proto_Aggregate, ttgo_proto_Aggregate, AUTO)
+
+
+PB_BIND(ttgo_proto_WindowAggregates, ttgo_proto_WindowAggregates, AUTO)
+
+
+PB_BIND(ttgo_proto_RemoteConfig, ttgo_proto_RemoteConfig, AUTO)
+
+
 
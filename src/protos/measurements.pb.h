@@ -23,16 +23,63 @@ typedef struct _ttgo_proto_Measurements {
     uint32_t fw_version_minor;
     uint32_t fw_version_patch;
     uint32_t num_dht_failed_reads;
+    uint32_t field_mask;
+    uint32_t bh1750_i2c_errors;
+    uint32_t i2c_bus_recoveries;
+    uint32_t transmit_slot;
+    uint32_t num_transmit_slots;
+    uint32_t batch_period_s;
+    uint32_t tls_handshake_ms;
+    bool tls_resumed;
+    uint32_t heap_allocations;
+    uint32_t heap_min_free_bytes;
+    uint32_t heap_largest_free_block;
+    uint32_t config_version;
+    uint32_t sequence;
+    uint32_t previous_sequence;
 } ttgo_proto_Measurements;
 
+typedef struct _ttgo_proto_Aggregate {
+    uint32_t count;
+    float min;
+    float max;
+    float mean;
+    float stddev;
+} ttgo_proto_Aggregate;
+
+typedef struct _ttgo_proto_WindowAggregates {
+    uint32_t timestamp;
+    uint32_t duration_s;
+    bool has_lux;
+    ttgo_proto_Aggregate lux;
+    bool has_soil;
+    ttgo_proto_Aggregate soil;
+    bool has_salt;
+    ttgo_proto_Aggregate salt;
+} ttgo_proto_WindowAggregates;
+
+typedef struct _ttgo_proto_RemoteConfig {
+    uint32_t version;
+    uint32_t time_between_measurements_s;
+    uint32_t num_measurements_per_batch;
+    uint32_t max_num_mqtt_attempts;
+    uint32_t time_between_rtc_updates_s;
+} ttgo_proto_RemoteConfig;
+
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /* Initializer values for message structs */
-#define ttgo_proto_Measurements_init_default     {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
-#define ttgo_proto_Measurements_init_zero        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
+#define ttgo_proto_Measurements_init_default     {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
+#define ttgo_proto_Aggregate_init_default        {0, 0, 0, 0, 0}
+#define ttgo_proto_WindowAggregates_init_default {0, 0, false, ttgo_proto_Aggregate_init_default, false, ttgo_proto_Aggregate_init_default, false, ttgo_proto_Aggregate_init_default}
+#define ttgo_proto_RemoteConfig_init_default     {0, 0, 0, 0, 0}
+#define ttgo_proto_Measurements_init_zero        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
+#define ttgo_proto_Aggregate_init_zero           {0, 0, 0, 0, 0}
+#define ttgo_proto_WindowAggregates_init_zero    {0, 0, false, ttgo_proto_Aggregate_init_zero, false, ttgo_proto_Aggregate_init_zero, false, ttgo_proto_Aggregate_init_zero}
+#define ttgo_proto_RemoteConfig_init_zero        {0, 0, 0, 0, 0}
 
 /* Field tags (for use in manual encoding/decoding) */
 #define ttgo_proto_Measurements_error_code_tag   1
@@ -47,6 +94,35 @@ extern "C" {
 #define ttgo_proto_Measurements_fw_version_minor_tag 10
 #define ttgo_proto_Measurements_fw_version_patch_tag 11
 #define ttgo_proto_Measurements_num_dht_failed_reads_tag 12
+#define ttgo_proto_Measurements_field_mask_tag   13
+#define ttgo_proto_Measurements_bh1750_i2c_errors_tag 14
+#define ttgo_proto_Measurements_i2c_bus_recoveries_tag 15
+#define ttgo_proto_Measurements_transmit_slot_tag 16
+#define ttgo_proto_Measurements_num_transmit_slots_tag 17
+#define ttgo_proto_Measurements_batch_period_s_tag 18
+#define ttgo_proto_Measurements_tls_handshake_ms_tag 19
+#define ttgo_proto_Measurements_tls_resumed_tag  20
+#define ttgo_proto_Measurements_heap_allocations_tag 21
+#define ttgo_proto_Measurements_heap_min_free_bytes_tag 22
+#define ttgo_proto_Measurements_heap_largest_free_block_tag 23
+#define ttgo_proto_Measurements_config_version_tag 24
+#define ttgo_proto_Measurements_sequence_tag     25
+#define ttgo_proto_Measurements_previous_sequence_tag 26
+#define ttgo_proto_Aggregate_count_tag           1
+#define ttgo_proto_Aggregate_min_tag             2
+#define ttgo_proto_Aggregate_max_tag             3
+#define ttgo_proto_Aggregate_mean_tag            4
+#define ttgo_proto_Aggregate_stddev_tag          5
+#define ttgo_proto_WindowAggregates_timestamp_tag 1
+#define ttgo_proto_WindowAggregates_duration_s_tag 2
+#define ttgo_proto_WindowAggregates_lux_tag      3
+#define ttgo_proto_WindowAggregates_soil_tag     4
+#define ttgo_proto_WindowAggregates_salt_tag     5
+#define ttgo_proto_RemoteConfig_version_tag      1
+#define ttgo_proto_RemoteConfig_time_between_measurements_s_tag 2
+#define ttgo_proto_RemoteConfig_num_measurements_per_batch_tag 3
+#define ttgo_proto_RemoteConfig_max_num_mqtt_attempts_tag 4
+#define ttgo_proto_RemoteConfig_time_between_rtc_updates_s_tag 5
 
 /* Struct field encoding specification for nanopb */
 #define ttgo_proto_Measurements_FIELDLIST(X, a) \
@@ -61,17 +137,70 @@ X(a, STATIC,   SINGULAR, UINT32,   timestamp,         8) \
 X(a, STATIC,   SINGULAR, UINT32,   fw_version_major,   9) \
 X(a, STATIC,   SINGULAR, UINT32,   fw_version_minor,  10) \
 X(a, STATIC,   SINGULAR, UINT32,   fw_version_patch,  11) \
-X(a, STATIC,   SINGULAR, UINT32,   num_dht_failed_reads,  12)
+X(a, STATIC,   SINGULAR, UINT32,   num_dht_failed_reads,  12) \
+X(a, STATIC,   SINGULAR, UINT32,   field_mask,       13) \
+X(a, STATIC,   SINGULAR, UINT32,   bh1750_i2c_errors,  14) \
+X(a, STATIC,   SINGULAR, UINT32,   i2c_bus_recoveries,  15) \
+X(a, STATIC,   SINGULAR, UINT32,   transmit_slot,    16) \
+X(a, STATIC,   SINGULAR, UINT32,   num_transmit_slots,  17) \
+X(a, STATIC,   SINGULAR, UINT32,   batch_period_s,   18) \
+X(a, STATIC,   SINGULAR, UINT32,   tls_handshake_ms,  19) \
+X(a, STATIC,   SINGULAR, BOOL,     tls_resumed,      20) \
+X(a, STATIC,   SINGULAR, UINT32,   heap_allocations,  21) \
+X(a, STATIC,   SINGULAR, UINT32,   heap_min_free_bytes,  22) \
+X(a, STATIC,   SINGULAR, UINT32,   heap_largest_free_block,  23) \
+X(a, STATIC,   SINGULAR, UINT32,   config_version,   24) \
+X(a, STATIC,   SINGULAR, UINT32,   sequence,         25) \
+X(a, STATIC,   SINGULAR, UINT32,   previous_sequence,  26)
 #define ttgo_proto_Measurements_CALLBACK NULL
 #define ttgo_proto_Measurements_DEFAULT NULL
 
+#define ttgo_proto_Aggregate_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, UINT32,   count,             1) \
+X(a, STATIC,   SINGULAR, FLOAT,    min,               2) \
+X(a, STATIC,   SINGULAR, FLOAT,    max,               3) \
+X(a, STATIC,   SINGULAR, FLOAT,    mean,              4) \
+X(a, STATIC,   SINGULAR, FLOAT,    stddev,            5)
+#define ttgo_proto_Aggregate_CALLBACK NULL
+#define ttgo_proto_Aggregate_DEFAULT NULL
+
+#define ttgo_proto_WindowAggregates_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, UINT32,   timestamp,         1) \
+X(a, STATIC,   SINGULAR, UINT32,   duration_s,        2) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  lux,               3) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  soil,              4) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  salt,              5)
+#define ttgo_proto_WindowAggregates_CALLBACK NULL
+#define ttgo_proto_WindowAggregates_DEFAULT NULL
+#define ttgo_proto_WindowAggregates_lux_MSGTYPE ttgo_proto_Aggregate
+#define ttgo_proto_WindowAggregates_soil_MSGTYPE ttgo_proto_Aggregate
+#define ttgo_proto_WindowAggregates_salt_MSGTYPE ttgo_proto_Aggregate
+
+#define ttgo_proto_RemoteConfig_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, UINT32,   version,           1) \
+X(a, STATIC,   SINGULAR, UINT32,   time_between_measurements_s,   2) \
+X(a, STATIC,   SINGULAR, UINT32,   num_measurements_per_batch,   3) \
+X(a, STATIC,   SINGULAR, UINT32,   max_num_mqtt_attempts,   4) \
+X(a, STATIC,   SINGULAR, UINT32,   time_between_rtc_updates_s,   5)
+#define ttgo_proto_RemoteConfig_CALLBACK NULL
+#define ttgo_proto_RemoteConfig_DEFAULT NULL
+
 extern const pb_msgdesc_t ttgo_proto_Measurements_msg;
+extern const pb_msgdesc_t ttgo_proto_Aggregate_msg;
+extern const pb_msgdesc_t ttgo_proto_WindowAggregates_msg;
+extern const pb_msgdesc_t ttgo_proto_RemoteConfig_msg;
 
 /* Defines for backwards compatibility with code written before nanopb-0.4.0 */
 #define ttgo_proto_Measurements_fields &ttgo_proto_Measurements_msg
+#define ttgo_proto_Aggregate_fields &ttgo_proto_Aggregate_msg
+#define ttgo_proto_WindowAggregates_fields &ttgo_proto_WindowAggregates_msg
+#define ttgo_proto_RemoteConfig_fields &ttgo_proto_RemoteConfig_msg
 
 /* Maximum encoded size of messages (where known) */
-#define ttgo_proto_Measurements_size             66
+#define ttgo_proto_Measurements_size             157
+#define ttgo_proto_Aggregate_size                26
+#define ttgo_proto_WindowAggregates_size         96
+#define ttgo_proto_RemoteConfig_size             30
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -0,0 +1,337 @@
+#include "relay.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+    const char *const kRelaySubTopics[kNumRelayRecordKinds] = {"", "aggregates", "log"};
+
+    // the sequence numbers further behind the latest than this are taken as a node that has restarted
+    constexpr uint16_t kSequenceWindow = 32;
+    constexpr size_t kQueuedRecordHeaderSize = 4;
+
+    size_t writeVarint(uint8_t *buffer, size_t value)
+    {
+        size_t length = 0;
+        do
+        {
+            buffer[length] = static_cast<uint8_t>(value & 0x7F);
+            value >>= 7;
+            if (value != 0)
+            {
+                buffer[length] |= 0x80;
+            }
+            ++length;
+        } while (value != 0);
+        return length;
+    }
+
+    /// @returns the number of bytes read, or 0 if it runs past \p end
+    size_t readVarint(const uint8_t *data, const uint8_t *end, size_t *outValue)
+    {
+        size_t value = 0;
+        for (size_t i = 0; data + i < end && i < 3; ++i)
+        {
+            value |= static_cast<size_t>(data[i] & 0x7F) << (7 * i);
+            if ((data[i] & 0x80) == 0)
+            {
+                *outValue = value;
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    /// @returns false if \p sequence has already been seen from \p origin
+    bool takeSequence(RelayOrigin *origin, uint16_t sequence)
+    {
+        const int16_t ahead = static_cast<int16_t>(sequence - origin->lastSequence);
+        if (ahead > 0)
+        {
+            origin->seen = ahead >= 32 ? 1 : (origin->seen << ahead) | 1;
+            origin->lastSequence = sequence;
+            return true;
+        }
+
+        const uint16_t behind = static_cast<uint16_t>(-ahead);
+        if (behind >= kSequenceWindow)
+        {
+            // a node that lost its RTC memory starts again from a random sequence number
+            origin->lastSequence = sequence;
+            origin->seen = 1;
+            return true;
+        }
+        const uint32_t bit = 1u << behind;
+        if ((origin->seen & bit) != 0)
+        {
+            return false;
+        }
+        origin->seen |= bit;
+        return true;
+    }
+
+    /// @returns nullptr if the node is new and there is no room for it
+    RelayOrigin *findOrAddOrigin(RelayAggregator *aggregator, const char *name, size_t nameLength, uint16_t sequence, bool *outIsNew)
+    {
+        *outIsNew = false;
+        for (uint8_t i = 0; i < aggregator->numOrigins; ++i)
+        {
+            RelayOrigin &origin = aggregator->origins[i];
+            if (strlen(origin.name) == nameLength && memcmp(origin.name, name, nameLength) == 0)
+            {
+                return &origin;
+            }
+        }
+
+        // a new node, replacing the one heard from least recently if the table is full.
+        // a node with records still queued keeps its place, or they would be published under the new node's name
+        RelayOrigin *origin = nullptr;
+        if (aggregator->numOrigins < kMaxRelayOrigins)
+        {
+            origin = &aggregator->origins[aggregator->numOrigins++];
+        }
+        else
+        {
+            for (uint8_t i = 0; i < kMaxRelayOrigins; ++i)
+            {
+                RelayOrigin *candidate = &aggregator->origins[i];
+                if (candidate->numQueued == 0 && (origin == nullptr || candidate->lastUsed < origin->lastUsed))
+                {
+                    origin = candidate;
+                }
+            }
+            if (origin == nullptr)
+            {
+                return nullptr;
+            }
+        }
+        memcpy(origin->name, name, nameLength);
+        origin->name[nameLength] = 0;
+        origin->lastSequence = sequence;
+        origin->seen = 1;
+        *outIsNew = true;
+        return origin;
+    }
+}
+
+RelayRecordKind relayRecordKind(const char *subTopic)
+{
+    const char *slash = strchr(subTopic, '/');
+    const char *suffix = slash != nullptr ? slash + 1 : "";
+    for (uint8_t kind = 0; kind < kNumRelayRecordKinds; ++kind)
+    {
+        if (strcmp(suffix, kRelaySubTopics[kind]) == 0)
+        {
+            return static_cast<RelayRecordKind>(kind);
+        }
+    }
+    return kNumRelayRecordKinds;
+}
+
+bool relayTopic(char *buffer, size_t bufferSize, const char *origin, RelayRecordKind kind)
+{
+    if (kind >= kNumRelayRecordKinds)
+    {
+        return false;
+    }
+    const int length = kind == kRelayMeasurements //
+                           ? snprintf(buffer, bufferSize, "sensors/%s", origin)
+                           : snprintf(buffer, bufferSize, "sensors/%s/%s", origin, kRelaySubTopics[kind]);
+    return length > 0 && static_cast<size_t>(length) < bufferSize;
+}
+
+bool LoopbackTransport::send(const uint8_t *frame, size_t length)
+{
+    if (framesToDrop > 0)
+    {
+        --framesToDrop;
+        return false;
+    }
+    if (!push(frame, length))
+    {
+        return false;
+    }
+    return !duplicateFrames || push(frame, length);
+}
+
+size_t LoopbackTransport::receive(uint8_t *buffer, size_t bufferSize)
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+    const size_t length = m_lengths[m_first];
+    const size_t copied = length < bufferSize ? length : bufferSize;
+    memcpy(buffer, m_frames[m_first], copied);
+    m_first = (m_first + 1) % kCapacity;
+    --m_count;
+    return copied;
+}
+
+bool LoopbackTransport::push(const uint8_t *frame, size_t length)
+{
+    if (m_count == kCapacity || length > kMaxRelayFrameSize)
+    {
+        return false;
+    }
+    const size_t index = (m_first + m_count) % kCapacity;
+    memcpy(m_frames[index], frame, length);
+    m_lengths[index] = length;
+    ++m_count;
+    return true;
+}
+
+void relaySenderBegin(RelaySender *sender, RelayTransport *transport, const char *origin, uint16_t *sequence)
+{
+    sender->transport = transport;
+    sender->sequence = sequence;
+    sender->allDelivered = true;
+
+    size_t originLength = strlen(origin);
+    if (originLength > kMaxRelayOriginLength)
+    {
+        originLength = kMaxRelayOriginLength;
+    }
+    sender->frame[0] = kRelayFrameVersion;
+    sender->frame[3] = static_cast<uint8_t>(originLength);
+    memcpy(sender->frame + 4, origin, originLength);
+    sender->headerLength = 4 + originLength;
+    sender->length = sender->headerLength;
+}
+
+bool relaySenderAdd(RelaySender *sender, RelayRecordKind kind, const uint8_t *data, size_t length)
+{
+    uint8_t recordHeader[4];
+    recordHeader[0] = kind;
+    const size_t recordHeaderLength = 1 + writeVarint(recordHeader + 1, length);
+    const size_t recordLength = recordHeaderLength + length;
+    if (kind >= kNumRelayRecordKinds || sender->headerLength + recordLength > kMaxRelayFrameSize)
+    {
+        sender->allDelivered = false;
+        return false;
+    }
+
+    if (sender->length + recordLength > kMaxRelayFrameSize)
+    {
+        relaySenderFlush(sender);
+    }
+    memcpy(sender->frame + sender->length, recordHeader, recordHeaderLength);
+    memcpy(sender->frame + sender->length + recordHeaderLength, data, length);
+    sender->length += recordLength;
+    return sender->allDelivered;
+}
+
+bool relaySenderFlush(RelaySender *sender)
+{
+    if (sender->length == sender->headerLength)
+    {
+        return sender->allDelivered;
+    }
+    const uint16_t sequence = (*sender->sequence)++;
+    sender->frame[1] = static_cast<uint8_t>(sequence);
+    sender->frame[2] = static_cast<uint8_t>(sequence >> 8);
+    if (!sender->transport->send(sender->frame, sender->length))
+    {
+        sender->allDelivered = false;
+    }
+    sender->length = sender->headerLength;
+    return sender->allDelivered;
+}
+
+void relayAggregatorReset(RelayAggregator *aggregator)
+{
+    memset(aggregator, 0, sizeof(RelayAggregator));
+}
+
+uint8_t relayAggregatorAccept(RelayAggregator *aggregator, const uint8_t *frame, size_t length)
+{
+    if (length < 4 || frame[0] != kRelayFrameVersion || frame[3] == 0 || frame[3] > kMaxRelayOriginLength || //
+        length < 4u + frame[3])
+    {
+        ++aggregator->numDropped;
+        return 0;
+    }
+    const uint16_t sequence = static_cast<uint16_t>(frame[1] | frame[2] << 8);
+    const char *name = reinterpret_cast<const char *>(frame + 4);
+    const size_t nameLength = frame[3];
+
+    // check the whole frame before taking any of it
+    const uint8_t *const end = frame + length;
+    size_t queuedSize = 0;
+    uint8_t numRecords = 0;
+    for (const uint8_t *record = frame + 4 + nameLength; record < end; ++numRecords)
+    {
+        size_t messageLength;
+        const size_t varintLength = readVarint(record + 1, end, &messageLength);
+        if (record[0] >= kNumRelayRecordKinds || varintLength == 0 || record + 1 + varintLength + messageLength > end)
+        {
+            ++aggregator->numDropped;
+            return 0;
+        }
+        queuedSize += kQueuedRecordHeaderSize + messageLength;
+        record += 1 + varintLength + messageLength;
+    }
+    if (aggregator->queueLength + queuedSize > kRelayQueueSize)
+    {
+        // not marked as seen, so a retransmission can still be taken once the queue has been published
+        ++aggregator->numDropped;
+        return 0;
+    }
+
+    bool isNewOrigin;
+    RelayOrigin *origin = findOrAddOrigin(aggregator, name, nameLength, sequence, &isNewOrigin);
+    if (origin == nullptr)
+    {
+        // as for a full queue
+        ++aggregator->numDropped;
+        return 0;
+    }
+    if (!isNewOrigin && !takeSequence(origin, sequence))
+    {
+        ++aggregator->numDuplicates;
+        return 0;
+    }
+    origin->lastUsed = ++aggregator->numFramesAccepted;
+    const uint8_t originIndex = static_cast<uint8_t>(origin - aggregator->origins);
+
+    for (const uint8_t *record = frame + 4 + nameLength; record < end;)
+    {
+        size_t messageLength;
+        const size_t varintLength = readVarint(record + 1, end, &messageLength);
+        uint8_t *queued = aggregator->queue + aggregator->queueLength;
+        queued[0] = originIndex;
+        queued[1] = record[0];
+        queued[2] = static_cast<uint8_t>(messageLength);
+        queued[3] = static_cast<uint8_t>(messageLength >> 8);
+        memcpy(queued + kQueuedRecordHeaderSize, record + 1 + varintLength, messageLength);
+        aggregator->queueLength += kQueuedRecordHeaderSize + messageLength;
+        ++aggregator->numQueued;
+        record += 1 + varintLength + messageLength;
+    }
+    origin->numQueued += numRecords;
+    return numRecords;
+}
+
+uint16_t relayAggregatorPublish(RelayAggregator *aggregator, RelayPublish publish, void *context)
+{
+    char topic[kMaxRelayOriginLength + 20];
+    size_t offset = 0;
+    while (offset < aggregator->queueLength)
+    {
+        const uint8_t *queued = aggregator->queue + offset;
+        const size_t messageLength = static_cast<size_t>(queued[2] | queued[3] << 8);
+        if (relayTopic(topic, sizeof(topic), aggregator->origins[queued[0]].name, static_cast<RelayRecordKind>(queued[1])))
+        {
+            publish(topic, queued + kQueuedRecordHeaderSize, messageLength, context);
+        }
+        offset += kQueuedRecordHeaderSize + messageLength;
+    }
+    const uint16_t numPublished = aggregator->numQueued;
+    aggregator->queueLength = 0;
+    aggregator->numQueued = 0;
+    for (uint8_t i = 0; i < aggregator->numOrigins; ++i)
+    {
+        aggregator->origins[i].numQueued = 0;
+    }
+    return numPublished;
+}
@@ -0,0 +1,142 @@
+#ifndef __RELAY__
+#define __RELAY__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Forwarding batches through an always-on relay node.
+/// Battery nodes send their messages over a connectionless link (ESP-NOW) to a mains powered relay, which keeps its
+/// WiFi and MQTT session open and republishes them under each node's topics.  The nodes never associate with the
+/// access point or connect to the broker.
+///
+/// A frame is at most kMaxRelayFrameSize bytes:
+///   byte 0       kRelayFrameVersion
+///   bytes 1, 2   sequence number (little endian), one per frame sent by the node
+///   byte 3       length of the node's name, followed by the name
+///   then         records, each the kind (a RelayRecordKind), the message length as a varint, and the message
+/// Everything here is independent of the link (see RelayTransport), so it can be tested on the host through a
+/// LoopbackTransport.
+
+constexpr uint8_t kRelayFrameVersion = 1;
+constexpr size_t kMaxRelayFrameSize = 250; // the most ESP-NOW carries
+constexpr size_t kMaxRelayOriginLength = 20; // MAX_SENSOR_NAME
+
+/// @brief What a relayed record is, which decides the topic it is republished on
+enum RelayRecordKind : uint8_t
+{
+    kRelayMeasurements = 0, // sensors/<name>
+    kRelayAggregates = 1,   // sensors/<name>/aggregates
+    kRelayLog = 2,          // sensors/<name>/log
+    kNumRelayRecordKinds
+};
+
+/// @returns the kind of the messages published on \p subTopic ("<name>", "<name>/aggregates" or "<name>/log"),
+/// or kNumRelayRecordKinds if they can't be relayed
+RelayRecordKind relayRecordKind(const char *subTopic);
+
+/// @brief write the topic that a record of \p kind from \p origin is republished on into \p buffer
+/// @returns false if it doesn't fit
+bool relayTopic(char *buffer, size_t bufferSize, const char *origin, RelayRecordKind kind);
+
+/// @brief The link between the nodes and the relay
+class RelayTransport
+{
+public:
+    virtual ~RelayTransport() = default;
+
+    /// @brief send \p frame to the relay
+    /// @returns false if it wasn't delivered
+    virtual bool send(const uint8_t *frame, size_t length) = 0;
+
+    /// @brief take the oldest frame received, if there is one
+    /// @returns its length, or 0 if there isn't one
+    virtual size_t receive(uint8_t *buffer, size_t bufferSize) = 0;
+};
+
+/// @brief A transport where the frames sent are received by the same object, for testing on the host.
+/// It can drop or duplicate frames, as the radio might.
+class LoopbackTransport : public RelayTransport
+{
+public:
+    static constexpr size_t kCapacity = 16;
+
+    bool send(const uint8_t *frame, size_t length) override;
+    size_t receive(uint8_t *buffer, size_t bufferSize) override;
+
+    uint8_t framesToDrop = 0;   // the next this many frames are lost (and reported as not delivered)
+    bool duplicateFrames = false; // every frame is received twice
+
+private:
+    bool push(const uint8_t *frame, size_t length);
+
+    uint8_t m_frames[kCapacity][kMaxRelayFrameSize];
+    size_t m_lengths[kCapacity];
+    size_t m_first = 0;
+    size_t m_count = 0;
+};
+
+/// @brief Packs the messages of a batch into as few frames as possible, on a node
+struct RelaySender
+{
+    RelayTransport *transport;
+    uint16_t *sequence; // kept in RTC memory by the caller
+    uint8_t frame[kMaxRelayFrameSize];
+    size_t headerLength;
+    size_t length;
+    bool allDelivered;
+};
+
+/// @brief start sending frames from \p origin, numbered from \p sequence (which is advanced for each frame)
+void relaySenderBegin(RelaySender *sender, RelayTransport *transport, const char *origin, uint16_t *sequence);
+
+/// @brief add a message to the frame, sending the frame first if the message doesn't fit
+/// @returns false if a frame that had to be sent wasn't delivered, or the message is too big for any frame or of
+/// no kind that can be relayed
+bool relaySenderAdd(RelaySender *sender, RelayRecordKind kind, const uint8_t *data, size_t length);
+
+/// @brief send the frame if it has anything in it
+/// @returns false if it wasn't delivered
+bool relaySenderFlush(RelaySender *sender);
+
+/// @brief A node heard by the relay, and the sequence numbers of its frames that have been seen
+struct RelayOrigin
+{
+    char name[kMaxRelayOriginLength + 1];
+    uint16_t lastSequence;
+    uint32_t seen;     // bit i is set if lastSequence - i has been seen
+    uint32_t lastUsed; // for replacing the least recently heard node when the table is full
+    uint16_t numQueued; // its records waiting to be published, which keep it from being replaced
+};
+
+constexpr uint8_t kMaxRelayOrigins = 32;
+constexpr size_t kRelayQueueSize = 4096;
+
+/// @brief Collects the records of the frames heard by the relay, dropping duplicates, until they are published
+struct RelayAggregator
+{
+    RelayOrigin origins[kMaxRelayOrigins];
+    uint8_t numOrigins;
+    uint32_t numFramesAccepted;
+    uint32_t numDuplicates;
+    uint32_t numDropped; // malformed, or no room in the queue or the table of nodes
+    // queued records: origin index, kind, length (2 bytes, little endian) and the message
+    uint8_t queue[kRelayQueueSize];
+    size_t queueLength;
+    uint16_t numQueued;
+};
+
+/// @brief forget every node and queued record
+void relayAggregatorReset(RelayAggregator *aggregator);
+
+/// @brief queue the records of \p frame, unless it has been seen before.  A frame from a new node when every node in
+/// the table has records queued can't be taken until they have been published.
+/// @returns the number of records queued, 0 for a duplicate or a frame that couldn't be taken
+uint8_t relayAggregatorAccept(RelayAggregator *aggregator, const uint8_t *frame, size_t length);
+
+typedef void (*RelayPublish)(const char *topic, const uint8_t *data, size_t length, void *context);
+
+/// @brief hand every queued record, oldest first, to \p publish and empty the queue
+/// @returns the number of records published
+uint16_t relayAggregatorPublish(RelayAggregator *aggregator, RelayPublish publish, void *context);
+
+#endif
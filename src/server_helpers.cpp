@@ -1,31 +1,192 @@
 #include "server_helpers.h"
+#include "log.h"
+#include "nvs_utils.h"
+#include "pb_decode.h"
+#include "transmit_slot.h"
+#ifdef TTGO_ENABLE_HTTP_NAMING
 #include "HttpClient.h"
 #include <ESPmDNS.h>
+#endif
 
 #define xstr(s) str(s)
 #define str(s) #s
 
 #define USER_AGENT "TTGO-Sensor (" str(FW_VERSION_MAJOR) "." str(FW_VERSION_MINOR) "." str(FW_VERSION_PATCH) ")"
 
+namespace
+{
+    constexpr char kRegistryTopicRoot[] = "registry";
+
+    // filled in by the MQTT callback when the server answers a name request
+    char g_assignedName[MAX_SENSOR_NAME + 1];
+    bool g_nameAssigned = false;
+
+    void onRegistryMessage(char *topic, uint8_t *payload, unsigned int length)
+    {
+        const size_t nameLength = std::min<size_t>(length, MAX_SENSOR_NAME);
+        memcpy(g_assignedName, payload, nameLength);
+        g_assignedName[nameLength] = 0;
+        g_nameAssigned = nameLength > 0;
+    }
+
+    // filled in by the MQTT callback when a slot assignment arrives
+    int g_assignedSlot = -1;
+
+    void onSlotMessage(char *topic, uint8_t *payload, unsigned int length)
+    {
+        char slot[4] = {0};
+        memcpy(slot, payload, std::min<size_t>(length, sizeof(slot) - 1));
+        g_assignedSlot = length > 0 && length < sizeof(slot) ? atoi(slot) : -1;
+    }
+
+    // filled in by the MQTT callback when the retained config arrives
+    char g_configTopic[MAX_SENSOR_NAME + 16];
+    ttgo_proto_RemoteConfig g_remoteConfig;
+    bool g_remoteConfigReceived = false;
+    bool g_remoteConfigValid = false;
+    uint32_t g_configSubscribed_ms = 0;
+
+    void onConfigMessage(char *topic, uint8_t *payload, unsigned int length)
+    {
+        // an empty message (the retained config cleared) decodes to version 0, which changes nothing
+        g_remoteConfig = ttgo_proto_RemoteConfig_init_zero;
+        pb_istream_t stream = pb_istream_from_buffer(payload, length);
+        g_remoteConfigValid = pb_decode(&stream, ttgo_proto_RemoteConfig_fields, &g_remoteConfig);
+        g_remoteConfigReceived = true;
+    }
+}
+
+void formatMacAddress(char *outMac)
+{
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    snprintf(outMac, MAC_STRING_LENGTH, "%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+bool requestSensorName(PubSubClient *mqttClient, //
+                       const char *mac,          //
+                       char *outSensorName,      //
+                       uint8_t bufferLength,     //
+                       uint32_t timeout_ms)
+{
+    char requestTopic[sizeof(kRegistryTopicRoot) + MAC_STRING_LENGTH];
+    char responseTopic[sizeof(requestTopic) + 5];
+    snprintf(requestTopic, sizeof(requestTopic), "%s/%s", kRegistryTopicRoot, mac);
+    snprintf(responseTopic, sizeof(responseTopic), "%s/name", requestTopic);
+
+    g_nameAssigned = false;
+    mqttClient->setCallback(onRegistryMessage);
+    if (!mqttClient->subscribe(responseTopic, 1))
+    {
+        LOG_ERROR(LogEvent::SensorNameFailed);
+        return false;
+    }
+    mqttClient->publish(requestTopic, "");
+
+    const uint32_t start_ms = millis();
+    while (!g_nameAssigned && (millis() - start_ms) < timeout_ms && mqttClient->connected())
+    {
+        mqttClient->loop();
+        delay(10);
+    }
+    mqttClient->unsubscribe(responseTopic);
+    mqttClient->setCallback(nullptr);
+
+    if (!g_nameAssigned || strlen(g_assignedName) >= bufferLength)
+    {
+        return false;
+    }
+    strcpy(outSensorName, g_assignedName);
+    return true;
+}
+
+bool requestTransmitSlot(PubSubClient *mqttClient, //
+                         const char *sensorName,   //
+                         uint8_t *outSlot,         //
+                         uint32_t timeout_ms)
+{
+    char slotTopic[MAX_SENSOR_NAME + 16];
+    snprintf(slotTopic, sizeof(slotTopic), "sensors/%s/slot", sensorName);
+
+    g_assignedSlot = -1;
+    mqttClient->setCallback(onSlotMessage);
+    if (!mqttClient->subscribe(slotTopic, 1))
+    {
+        mqttClient->setCallback(nullptr);
+        return false;
+    }
+
+    const uint32_t start_ms = millis();
+    while (g_assignedSlot < 0 && (millis() - start_ms) < timeout_ms && mqttClient->connected())
+    {
+        mqttClient->loop();
+        delay(10);
+    }
+    mqttClient->unsubscribe(slotTopic);
+    mqttClient->setCallback(nullptr);
+
+    if (g_assignedSlot < 0 || g_assignedSlot >= kTransmitSlotFromMac)
+    {
+        return false;
+    }
+    *outSlot = static_cast<uint8_t>(g_assignedSlot);
+    return true;
+}
+
+bool subscribeRemoteConfig(PubSubClient *mqttClient, const char *sensorName)
+{
+    snprintf(g_configTopic, sizeof(g_configTopic), "sensors/%s/config", sensorName);
+    g_remoteConfigReceived = false;
+    g_configSubscribed_ms = millis();
+    mqttClient->setCallback(onConfigMessage);
+    if (!mqttClient->subscribe(g_configTopic, 1))
+    {
+        mqttClient->setCallback(nullptr);
+        return false;
+    }
+    return true;
+}
+
+bool takeRemoteConfig(PubSubClient *mqttClient, ttgo_proto_RemoteConfig *outConfig, uint32_t timeout_ms)
+{
+    while (!g_remoteConfigReceived && (millis() - g_configSubscribed_ms) < timeout_ms && mqttClient->connected())
+    {
+        mqttClient->loop();
+        delay(10);
+    }
+    mqttClient->unsubscribe(g_configTopic);
+    mqttClient->setCallback(nullptr);
+
+    if (!g_remoteConfigReceived)
+    {
+        return false;
+    }
+    if (!g_remoteConfigValid)
+    {
+        LOG_ERROR(LogEvent::RemoteConfigRejected, 0, 0);
+        return false;
+    }
+    *outConfig = g_remoteConfig;
+    return true;
+}
+
+#ifdef TTGO_ENABLE_HTTP_NAMING
+
 namespace
 {
     bool getNextSensorName(HttpClient *httpClient, const char *serverAddress, uint16_t serverPort, const char *apiPath, char *outSensorName, uint8_t bufferLength)
     {
         int error = 0;
 
-        Serial.print("Performing GET request to: ");
-        Serial.print(serverAddress);
-        Serial.println(apiPath);
         error = httpClient->get(serverAddress, serverPort, apiPath, USER_AGENT);
         if (error != 0)
         {
-            Serial.println("HTTP connection failed");
+            LOG_ERROR(LogEvent::HTTPConnectFailed, error);
             return false;
         }
 
         const int httpResponseCode = httpClient->responseStatusCode();
-        Serial.print("HTTP Code: ");
-        Serial.println(httpResponseCode);
+        LOG_INFO(LogEvent::HTTPStatus, httpResponseCode);
 
         if (httpResponseCode != 200)
         {
@@ -46,33 +207,32 @@ namespace
         uint32_t bufferPos = 0;
         uint32_t timeout_ms = millis();
         while (remaining > 0                                           //
+               && bufferPos < bufferLength - 1u                        //
                && (httpClient->connected() || httpClient->available()) //
                && ((millis() - timeout_ms) < kTimeout_ms))             //
         {
-            if (httpClient->available())
+            const int available = httpClient->available();
+            if (available > 0)
             {
-                outSensorName[bufferPos] = httpClient->read();
-                ++bufferPos;
-                --remaining;
-
-                if (bufferPos == bufferLength)
+                // read as much as is ready in one go
+                const size_t toRead = std::min<size_t>(std::min(available, remaining), bufferLength - 1u - bufferPos);
+                const int numRead = httpClient->read(reinterpret_cast<uint8_t *>(outSensorName) + bufferPos, toRead);
+                if (numRead > 0)
                 {
-                    Serial.println("Buffer filled");
-                    break;
+                    bufferPos += numRead;
+                    remaining -= numRead;
                 }
             }
             else
             {
                 // delay a little until we get data
-                delay(1000);
+                delay(10);
             }
         }
 
         if (remaining > 0)
         {
-            Serial.print("Expected ");
-            Serial.print(remaining);
-            Serial.println(" more characters");
+            LOG_WARN(LogEvent::HTTPShortRead, remaining);
         }
 
         // response is json, so strip the " from the start and end
@@ -102,16 +262,17 @@ bool getNextSensorName(WiFiClient *wifiClient,    //
         if (hostAddress == IPAddress())
         {
             httpClient.stop();
-            Serial.println("MDNS lookup failed");
+            LOG_ERROR(LogEvent::MDNSLookupFailed);
             return false;
         }
-        Serial.print("Obtained host address: ");
-        Serial.println(hostAddress);
-        success = getNextSensorName(&httpClient,                    //
-                                    hostAddress.toString().c_str(), //
-                                    serverPort,                     //
-                                    apiPath,                        //
-                                    outSensorName,                  //
+        LOG_DEBUG(LogEvent::MDNSResolved, static_cast<uint32_t>(hostAddress));
+        char hostString[16]; // rather than a String from hostAddress.toString()
+        snprintf(hostString, sizeof(hostString), "%u.%u.%u.%u", hostAddress[0], hostAddress[1], hostAddress[2], hostAddress[3]);
+        success = getNextSensorName(&httpClient,   //
+                                    hostString,    //
+                                    serverPort,    //
+                                    apiPath,       //
+                                    outSensorName, //
                                     bufferLength);
     }
     else
@@ -125,4 +286,6 @@ bool getNextSensorName(WiFiClient *wifiClient,    //
     }
     httpClient.stop();
     return success;
-}
\ No newline at end of file
+}
+
+#endif
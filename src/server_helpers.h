@@ -2,8 +2,54 @@
 #define __SERVER_HELPERS__
 
 #include <WiFi.h>
+#include "PubSubClient.h"
+#include "protos/measurements.pb.h"
 
-/// @brief try to get a valid sensor name from the server
+/// @brief the length of the string written by formatMacAddress (12 hex digits and a terminator)
+#define MAC_STRING_LENGTH 13
+
+/// @brief fill \p outMac with the station MAC address as lower case hex without separators (e.g. "a1b2c3d4e5f6")
+void formatMacAddress(char *outMac);
+
+/// @brief ask the server for a sensor name over an already connected MQTT session.
+/// Publishes to registry/<mac> and waits for the server to answer on registry/<mac>/name.
+/// @param mqttClient a connected MQTT client
+/// @param mac this device's MAC address as formatted by formatMacAddress
+/// @param outSensorName preassigned buffer where the sensor name is put
+/// @param bufferLength the size of the buffer \p outSensorName
+/// @param timeout_ms how long to wait for the server to answer
+/// @returns true if a name was assigned
+bool requestSensorName(PubSubClient *mqttClient, //
+                       const char *mac,          //
+                       char *outSensorName,      //
+                       uint8_t bufferLength,     //
+                       uint32_t timeout_ms);
+
+/// @brief check whether the server has assigned this device a transmit slot, over an already connected MQTT session.
+/// The server publishes assignments as retained messages on sensors/<sensor_name>/slot, so any assignment arrives
+/// straight after subscribing.
+/// @param outSlot set to the assigned slot, if there is one
+/// @param timeout_ms how long to wait for an assignment
+/// @returns true if the server has assigned a slot
+bool requestTransmitSlot(PubSubClient *mqttClient, //
+                         const char *sensorName,   //
+                         uint8_t *outSlot,         //
+                         uint32_t timeout_ms);
+
+/// @brief subscribe to the config the server has for this device, over an already connected MQTT session.
+/// The config is a retained message on sensors/<sensor_name>/config, so it arrives straight after subscribing, and is
+/// picked up by takeRemoteConfig().  In between, the session can be used to publish (but not to subscribe to anything
+/// else).
+/// @returns false if the subscription couldn't be sent
+bool subscribeRemoteConfig(PubSubClient *mqttClient, const char *sensorName);
+
+/// @brief wait for the config subscribed to by subscribeRemoteConfig(), then unsubscribe
+/// @param timeout_ms how long after subscribing to wait for it
+/// @returns true if a config arrived and could be decoded
+bool takeRemoteConfig(PubSubClient *mqttClient, ttgo_proto_RemoteConfig *outConfig, uint32_t timeout_ms);
+
+#ifdef TTGO_ENABLE_HTTP_NAMING
+/// @brief try to get a valid sensor name from the server over HTTP (only built with TTGO_ENABLE_HTTP_NAMING)
 /// @param serverAddress The server address
 /// @param serverPort The port to connect to on the server
 /// @param apiPath the path that is GET queried to retrieve the sensor name (GET serverAddress/apiPath)
@@ -17,5 +63,6 @@ bool getNextSensorName(WiFiClient *wifiClient,    //
                        char *outSensorName,       //
                        uint8_t bufferLength,      //
                        bool mdnsLookup);
+#endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "soil_frequency.h"
+
+uint32_t soilPulseCount(uint32_t overflows, int16_t counterValue, int16_t highLimit)
+{
+    // the counter only counts up, so a negative value can only be noise around a clear
+    const uint32_t remainder = counterValue > 0 ? static_cast<uint32_t>(counterValue) : 0;
+    return overflows * static_cast<uint32_t>(highLimit) + remainder;
+}
+
+float soilPulseFrequency_Hz(uint32_t pulseCount, uint32_t gate_us)
+{
+    if (gate_us == 0)
+    {
+        return 0;
+    }
+    return static_cast<float>(static_cast<double>(pulseCount) * 1000000.0 / gate_us);
+}
+
+float soilMoistureFromFrequency(const SoilSettings &settings, float frequency_Hz)
+{
+    const uint8_t numPoints = settings.numCalibrationPoints < kMaxSoilCalibrationPoints //
+                                  ? settings.numCalibrationPoints
+                                  : kMaxSoilCalibrationPoints;
+    if (numPoints == 0)
+    {
+        return frequency_Hz / 1000.0f;
+    }
+    if (numPoints == 1 || frequency_Hz <= settings.frequency_Hz[0])
+    {
+        return settings.moisture[0];
+    }
+
+    for (uint8_t i = 1; i < numPoints; ++i)
+    {
+        const float f0 = settings.frequency_Hz[i - 1];
+        const float f1 = settings.frequency_Hz[i];
+        if (frequency_Hz <= f1)
+        {
+            if (f1 <= f0)
+            {
+                return settings.moisture[i];
+            }
+            const float t = (frequency_Hz - f0) / (f1 - f0);
+            return settings.moisture[i - 1] + t * (settings.moisture[i] - settings.moisture[i - 1]);
+        }
+    }
+    return settings.moisture[numPoints - 1];
+}
@@ -0,0 +1,40 @@
+#ifndef __SOIL_FREQUENCY__
+#define __SOIL_FREQUENCY__
+
+#include <stdint.h>
+
+/// @brief The hardware independent part of measuring the soil probe by its frequency (see readSoil()).
+/// The pulses of the probe oscillator are counted by the PCNT peripheral over a short gate, and the frequency
+/// is converted to a moisture value with a per-sensor calibration curve.
+
+constexpr uint8_t kMaxSoilCalibrationPoints = 4;
+
+enum SoilMode : uint8_t
+{
+    kSoilModeAnalog = 0,    // the RC filtered DC level of the probe, on SOIL_PIN
+    kSoilModeFrequency = 1, // the frequency of the probe oscillator, on SOIL_FREQUENCY_PIN
+};
+
+struct SoilSettings
+{
+    // the calibration curve, a frequency and the moisture it corresponds to at each point, in order of frequency.
+    // Moisture is linearly interpolated between the points, and clamped outside them.
+    float frequency_Hz[kMaxSoilCalibrationPoints];
+    float moisture[kMaxSoilCalibrationPoints];
+    uint32_t gate_us; // how long pulses are counted for
+    uint8_t numCalibrationPoints; // 0 if uncalibrated, in which case the frequency (in kHz) is reported
+    uint8_t mode;                 // SoilMode
+};
+
+/// @brief the total number of pulses counted during a gate
+/// @param overflows the number of times the counter reached \p highLimit, and was reset to 0
+/// @param counterValue the value of the counter at the end of the gate
+uint32_t soilPulseCount(uint32_t overflows, int16_t counterValue, int16_t highLimit);
+
+/// @returns the frequency of \p pulseCount pulses counted over \p gate_us, or 0 if the gate is empty
+float soilPulseFrequency_Hz(uint32_t pulseCount, uint32_t gate_us);
+
+/// @returns the soil moisture corresponding to \p frequency_Hz, according to the calibration curve of \p settings
+float soilMoistureFromFrequency(const SoilSettings &settings, float frequency_Hz);
+
+#endif
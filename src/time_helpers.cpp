@@ -14,7 +14,6 @@ bool tryToUpdateAbsoluteTime()
     tm timeinfo;
     if (!getLocalTime(&timeinfo))
     {
-        Serial.println("Failed to get local time");
         return false;
     }
     return true;
@@ -0,0 +1,9 @@
+#ifndef __TLS_CA_CERT__
+#define __TLS_CA_CERT__
+
+/// @brief The certificate (PEM) of the CA that signed the broker's ECDSA certificate, used with kTlsEcdsa.
+/// Paste in the ca.crt made by mqtt-server/tls/make_certs.sh.  Left empty, kTlsEcdsa connections fail.
+constexpr char kTlsCaCert[] = R"(
+)";
+
+#endif
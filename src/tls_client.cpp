@@ -0,0 +1,361 @@
+#include "tls_client.h"
+#include "log.h"
+#include "mbedtls/platform.h"
+#include "mbedtls/version.h"
+
+// the session is kept across deep sleep with mbedtls_ssl_session_save() and mbedtls_ssl_session_load()
+#if MBEDTLS_VERSION_NUMBER < 0x02130000
+#error "TlsClient needs mbedTLS 2.19 or later"
+#endif
+
+// mbedTLS 3 hides the fields of its structs behind MBEDTLS_PRIVATE(), which 2.x doesn't have
+#ifndef MBEDTLS_PRIVATE
+#define MBEDTLS_PRIVATE(member) member
+#endif
+
+namespace
+{
+    constexpr uint32_t kHandshakeTimeout_ms = 10 * 1000;
+    constexpr uint32_t kWriteTimeout_ms = 5 * 1000;
+
+    // one suite per mode, so the broker can't pick anything more expensive
+    const int kPskCiphersuites[] = {MBEDTLS_TLS_PSK_WITH_AES_128_GCM_SHA256, 0};
+    const int kEcdsaCiphersuites[] = {MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256, 0};
+    const mbedtls_ecp_group_id kEcdsaCurves[] = {MBEDTLS_ECP_DP_SECP256R1, MBEDTLS_ECP_DP_NONE};
+
+    // the session of the last connection, serialised by mbedtls_ssl_session_save()
+    RTC_DATA_ATTR uint8_t g_session[kMaxTlsSessionSize];
+    RTC_DATA_ATTR uint16_t g_sessionLength = 0;
+    RTC_DATA_ATTR uint8_t g_sessionMode = kTlsOff; // the TlsMode the session was made with
+
+    bool waitingForIO(int result)
+    {
+        return result == MBEDTLS_ERR_SSL_WANT_READ || result == MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+}
+
+TlsClient::TlsClient()
+{
+    mbedtls_net_init(&m_net);
+    mbedtls_ssl_init(&m_ssl);
+    mbedtls_ssl_config_init(&m_config);
+    mbedtls_entropy_init(&m_entropy);
+    mbedtls_ctr_drbg_init(&m_ctrDrbg);
+    mbedtls_x509_crt_init(&m_caCert);
+}
+
+TlsClient::~TlsClient()
+{
+    stop();
+    mbedtls_ssl_free(&m_ssl);
+    mbedtls_ssl_config_free(&m_config);
+    mbedtls_x509_crt_free(&m_caCert);
+    mbedtls_ctr_drbg_free(&m_ctrDrbg);
+    mbedtls_entropy_free(&m_entropy);
+}
+
+void TlsClient::setPsk(const char *identity, const uint8_t *key, size_t keyLength)
+{
+    m_mode = kTlsPsk;
+    m_pskIdentity = identity;
+    m_psk = key;
+    m_pskLength = keyLength;
+}
+
+void TlsClient::setCaCert(const char *pem)
+{
+    m_mode = kTlsEcdsa;
+    m_caCertPem = pem;
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port)
+{
+    char host[16]; // rather than a String from ip.toString()
+    snprintf(host, sizeof(host), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    return connect(host, port);
+}
+
+int TlsClient::connect(const char *host, uint16_t port)
+{
+    stop();
+    if (m_mode == kTlsOff)
+    {
+        return 0;
+    }
+
+    char portString[6];
+    snprintf(portString, sizeof(portString), "%u", port);
+    int result = mbedtls_net_connect(&m_net, host, portString, MBEDTLS_NET_PROTO_TCP);
+    if (result != 0)
+    {
+        LOG_ERROR(LogEvent::TlsConnectFailed, result);
+        return 0;
+    }
+
+    result = mbedtls_ctr_drbg_seed(&m_ctrDrbg, mbedtls_entropy_func, &m_entropy, nullptr, 0);
+    if (result == 0)
+    {
+        result = mbedtls_ssl_config_defaults(&m_config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+    if (result != 0)
+    {
+        LOG_ERROR(LogEvent::TlsConnectFailed, result);
+        stop();
+        return 0;
+    }
+    mbedtls_ssl_conf_rng(&m_config, mbedtls_ctr_drbg_random, &m_ctrDrbg);
+    mbedtls_ssl_conf_session_tickets(&m_config, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    mbedtls_ssl_conf_min_version(&m_config, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3); // TLS 1.2
+    if (m_mode == kTlsPsk)
+    {
+        mbedtls_ssl_conf_ciphersuites(&m_config, kPskCiphersuites);
+        result = mbedtls_ssl_conf_psk(&m_config, m_psk, m_pskLength, //
+                                      reinterpret_cast<const unsigned char *>(m_pskIdentity), strlen(m_pskIdentity));
+    }
+    else
+    {
+        mbedtls_ssl_conf_ciphersuites(&m_config, kEcdsaCiphersuites);
+        mbedtls_ssl_conf_curves(&m_config, kEcdsaCurves);
+        mbedtls_ssl_conf_authmode(&m_config, MBEDTLS_SSL_VERIFY_REQUIRED);
+        result = mbedtls_x509_crt_parse(&m_caCert, reinterpret_cast<const unsigned char *>(m_caCertPem), strlen(m_caCertPem) + 1);
+        mbedtls_ssl_conf_ca_chain(&m_config, &m_caCert, nullptr);
+    }
+    if (result == 0)
+    {
+        result = mbedtls_ssl_setup(&m_ssl, &m_config);
+    }
+    if (result == 0)
+    {
+        result = mbedtls_ssl_set_hostname(&m_ssl, host);
+    }
+    if (result != 0)
+    {
+        LOG_ERROR(LogEvent::TlsConnectFailed, result);
+        stop();
+        return 0;
+    }
+    mbedtls_net_set_nonblock(&m_net);
+    mbedtls_ssl_set_bio(&m_ssl, &m_net, mbedtls_net_send, mbedtls_net_recv, nullptr);
+
+    if (!handshake())
+    {
+        stop();
+        return 0;
+    }
+    m_connected = true;
+    return 1;
+}
+
+bool TlsClient::handshake()
+{
+    // offer the session of the last wake, if it was made the same way
+    bool offeredSession = false;
+    if (g_sessionLength > 0 && g_sessionMode == m_mode)
+    {
+        mbedtls_ssl_session session;
+        mbedtls_ssl_session_init(&session);
+        offeredSession = mbedtls_ssl_session_load(&session, g_session, g_sessionLength) == 0 && //
+                         mbedtls_ssl_set_session(&m_ssl, &session) == 0;
+        mbedtls_ssl_session_free(&session);
+    }
+
+    // stepped through rather than run by mbedtls_ssl_handshake(), to see which messages the broker sends.  Comparing
+    // session IDs doesn't work for tickets, as mbedTLS offers a ticket under a fresh random ID (RFC 5077 section 3.4)
+    // and the broker echoes that.
+    const uint32_t start_ms = millis();
+    bool sawCertificate = false;
+    int result = 0;
+    while (m_ssl.MBEDTLS_PRIVATE(state) != MBEDTLS_SSL_HANDSHAKE_OVER)
+    {
+        result = mbedtls_ssl_handshake_step(&m_ssl);
+        sawCertificate = sawCertificate || m_ssl.MBEDTLS_PRIVATE(state) == MBEDTLS_SSL_SERVER_CERTIFICATE;
+        if (result == 0)
+        {
+            continue;
+        }
+        if (!waitingForIO(result) || millis() - start_ms > kHandshakeTimeout_ms)
+        {
+            break;
+        }
+        delay(1);
+    }
+    m_handshakeTime_ms = millis() - start_ms;
+    if (result != 0)
+    {
+        // don't offer a session that might be what the broker is objecting to
+        g_sessionLength = 0;
+        LOG_ERROR(LogEvent::TlsHandshakeFailed, result, m_handshakeTime_ms);
+        return false;
+    }
+
+    // a full handshake goes on from the ServerHello to the broker's certificate (a state mbedTLS passes through for
+    // PSK too, without a message), a resumed one straight to its ChangeCipherSpec (or NewSessionTicket)
+    m_resumedSession = offeredSession && !sawCertificate;
+    LOG_INFO(LogEvent::TlsHandshake, m_handshakeTime_ms, m_resumedSession);
+
+    // saved even when resumed, as the broker may have issued a new ticket
+    saveSession();
+    return true;
+}
+
+void TlsClient::saveSession()
+{
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    size_t length = 0;
+    const bool gotSession = mbedtls_ssl_get_session(&m_ssl, &session) == 0;
+#if defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
+    // the broker was verified when the session was made, and resuming doesn't look at its certificate again,
+    // so it is left out to keep the session small enough for RTC memory
+    if (session.MBEDTLS_PRIVATE(peer_cert) != nullptr)
+    {
+        mbedtls_x509_crt_free(session.MBEDTLS_PRIVATE(peer_cert));
+        mbedtls_free(session.MBEDTLS_PRIVATE(peer_cert));
+        session.MBEDTLS_PRIVATE(peer_cert) = nullptr;
+    }
+#endif
+    if (gotSession && //
+        mbedtls_ssl_session_save(&session, g_session, sizeof(g_session), &length) == 0)
+    {
+        g_sessionLength = length;
+        g_sessionMode = m_mode;
+    }
+    else
+    {
+        // e.g. too big, because the broker's certificate is kept in the session
+        g_sessionLength = 0;
+        LOG_WARN(LogEvent::TlsSessionNotSaved, length);
+    }
+    mbedtls_ssl_session_free(&session);
+}
+
+size_t TlsClient::write(uint8_t b)
+{
+    return write(&b, 1);
+}
+
+size_t TlsClient::write(const uint8_t *buf, size_t size)
+{
+    if (!m_connected)
+    {
+        return 0;
+    }
+    size_t written = 0;
+    const uint32_t start_ms = millis();
+    while (written < size)
+    {
+        const int result = mbedtls_ssl_write(&m_ssl, buf + written, size - written);
+        if (result > 0)
+        {
+            written += result;
+        }
+        else if (!waitingForIO(result) || millis() - start_ms > kWriteTimeout_ms)
+        {
+            stop();
+            break;
+        }
+    }
+    return written;
+}
+
+int TlsClient::available()
+{
+    if (!m_connected)
+    {
+        return 0;
+    }
+    if (m_peeked >= 0)
+    {
+        return 1 + mbedtls_ssl_get_bytes_avail(&m_ssl);
+    }
+
+    // reading nothing processes whatever record has arrived, without blocking
+    const int result = mbedtls_ssl_read(&m_ssl, nullptr, 0);
+    if (result < 0 && !waitingForIO(result))
+    {
+        stop();
+        return 0;
+    }
+    return mbedtls_ssl_get_bytes_avail(&m_ssl);
+}
+
+int TlsClient::read()
+{
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsClient::read(uint8_t *buf, size_t size)
+{
+    if (!m_connected || size == 0)
+    {
+        return -1;
+    }
+    size_t offset = 0;
+    if (m_peeked >= 0)
+    {
+        buf[offset++] = static_cast<uint8_t>(m_peeked);
+        m_peeked = -1;
+        if (offset == size || mbedtls_ssl_get_bytes_avail(&m_ssl) == 0)
+        {
+            return offset;
+        }
+    }
+
+    const int result = mbedtls_ssl_read(&m_ssl, buf + offset, size - offset);
+    if (result > 0)
+    {
+        return offset + result;
+    }
+    if (result == 0 || !waitingForIO(result))
+    {
+        // closed by the broker
+        stop();
+    }
+    return offset > 0 ? static_cast<int>(offset) : -1;
+}
+
+int TlsClient::peek()
+{
+    if (m_peeked < 0)
+    {
+        m_peeked = read();
+    }
+    return m_peeked;
+}
+
+void TlsClient::flush()
+{
+}
+
+void TlsClient::stop()
+{
+    if (m_connected)
+    {
+        mbedtls_ssl_close_notify(&m_ssl);
+    }
+    m_connected = false;
+    m_peeked = -1;
+    mbedtls_net_free(&m_net);
+    mbedtls_ssl_free(&m_ssl);
+    mbedtls_ssl_config_free(&m_config);
+    mbedtls_x509_crt_free(&m_caCert);
+    mbedtls_ctr_drbg_free(&m_ctrDrbg);
+    mbedtls_entropy_free(&m_entropy);
+    // so they can be used again by the next connect()
+    mbedtls_ssl_init(&m_ssl);
+    mbedtls_ssl_config_init(&m_config);
+    mbedtls_x509_crt_init(&m_caCert);
+    mbedtls_entropy_init(&m_entropy);
+    mbedtls_ctr_drbg_init(&m_ctrDrbg);
+}
+
+uint8_t TlsClient::connected()
+{
+    return m_connected;
+}
+
+TlsClient::operator bool()
+{
+    return m_connected;
+}
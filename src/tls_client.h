@@ -0,0 +1,72 @@
+#ifndef __TLS_CLIENT__
+#define __TLS_CLIENT__
+
+#include "Arduino.h"
+#include <Client.h>
+#include "device_config.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+
+/// @brief the largest serialised session kept in RTC memory for resumption
+constexpr size_t kMaxTlsSessionSize = 512;
+
+/// @brief A TLS client for PubSubClient, built directly on mbedTLS rather than WiFiClientSecure so that the session can
+/// be kept in RTC memory.  A full handshake costs seconds of CPU (and radio) time at 80MHz, where resuming the
+/// session from the last wake (by session ticket, or session ID if the broker doesn't issue tickets) only costs a
+/// round trip and some symmetric crypto.
+class TlsClient : public Client
+{
+public:
+    TlsClient();
+    ~TlsClient();
+
+    /// @brief secure the connection with a pre-shared key (kTlsPsk)
+    void setPsk(const char *identity, const uint8_t *key, size_t keyLength);
+
+    /// @brief verify the broker's ECDSA certificate against \p pem (kTlsEcdsa)
+    void setCaCert(const char *pem);
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char *host, uint16_t port) override;
+    size_t write(uint8_t b) override;
+    size_t write(const uint8_t *buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t *buf, size_t size) override;
+    int peek() override;
+    void flush() override;
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override;
+
+    /// @returns how long the last handshake took, in ms
+    uint32_t handshakeTime_ms() const { return m_handshakeTime_ms; }
+
+    /// @returns true if the last handshake resumed the session of an earlier wake
+    bool resumedSession() const { return m_resumedSession; }
+
+private:
+    bool handshake();
+    void saveSession();
+
+    mbedtls_net_context m_net;
+    mbedtls_ssl_context m_ssl;
+    mbedtls_ssl_config m_config;
+    mbedtls_entropy_context m_entropy;
+    mbedtls_ctr_drbg_context m_ctrDrbg;
+    mbedtls_x509_crt m_caCert;
+    TlsMode m_mode = kTlsOff;
+    const char *m_pskIdentity = nullptr;
+    const uint8_t *m_psk = nullptr;
+    size_t m_pskLength = 0;
+    const char *m_caCertPem = nullptr;
+    bool m_connected = false;
+    int m_peeked = -1;
+    uint32_t m_handshakeTime_ms = 0;
+    bool m_resumedSession = false;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include "transmit_slot.h"
+
+uint8_t transmitSlotFromMac(const uint8_t *mac, uint8_t numSlots)
+{
+    if (numSlots == 0)
+    {
+        return 0;
+    }
+
+    // FNV-1a, which mixes the low (device specific) bytes of the MAC into every bit
+    uint32_t hash = 2166136261u;
+    for (uint8_t i = 0; i < 6; ++i)
+    {
+        hash ^= mac[i];
+        hash *= 16777619u;
+    }
+    return static_cast<uint8_t>(hash % numSlots);
+}
+
+int32_t transmitPhaseError_ms(uint64_t transmitTime_ms, uint32_t period_ms, uint8_t slot, uint8_t numSlots)
+{
+    if (period_ms == 0 || numSlots == 0)
+    {
+        return 0;
+    }
+
+    const uint32_t slotStart_ms = static_cast<uint32_t>(static_cast<uint64_t>(period_ms) * (slot % numSlots) / numSlots);
+    const uint32_t phase_ms = static_cast<uint32_t>(transmitTime_ms % period_ms);
+    int64_t error_ms = static_cast<int64_t>(phase_ms) - slotStart_ms;
+
+    // wrap into (-period/2, period/2], so the shortest way round is taken
+    if (error_ms > static_cast<int64_t>(period_ms / 2))
+    {
+        error_ms -= period_ms;
+    }
+    else if (error_ms <= -static_cast<int64_t>(period_ms / 2))
+    {
+        error_ms += period_ms;
+    }
+    return static_cast<int32_t>(error_ms);
+}
+
+int32_t takeSleepAdjustment_ms(int32_t *pending_ms, uint32_t sleepTime_ms)
+{
+    const int32_t limit_ms = static_cast<int32_t>(sleepTime_ms / 2);
+    int32_t adjustment_ms = *pending_ms;
+    if (adjustment_ms > limit_ms)
+    {
+        adjustment_ms = limit_ms;
+    }
+    else if (adjustment_ms < -limit_ms)
+    {
+        adjustment_ms = -limit_ms;
+    }
+    *pending_ms -= adjustment_ms;
+    return adjustment_ms;
+}
@@ -0,0 +1,27 @@
+#ifndef __TRANSMIT_SLOT__
+#define __TRANSMIT_SLOT__
+
+#include <stdint.h>
+
+/// @brief Spreading the transmissions of a fleet of devices over the batch period.
+/// Every device has the same period, so devices that boot together (e.g. after a power cut) stay in phase and all
+/// transmit at once.  Instead, each device has a slot, and its transmit wakes are nudged (by adjusting its sleeps)
+/// until they fall at the start of its slot, measured against absolute (NTP) time so that clock drift is corrected.
+
+/// @brief DeviceConfig::transmitSlot value meaning the slot is derived from the MAC address
+constexpr uint8_t kTransmitSlotFromMac = 0xFF;
+
+/// @returns a slot in [0, \p numSlots) derived from a hash of the 6 byte \p mac, so it is stable across boots
+uint8_t transmitSlotFromMac(const uint8_t *mac, uint8_t numSlots);
+
+/// @returns how far (in ms, in the range (-period/2, period/2]) a transmission at epoch time \p transmitTime_ms is
+/// after the start of \p slot of \p numSlots slots dividing \p period_ms
+int32_t transmitPhaseError_ms(uint64_t transmitTime_ms, uint32_t period_ms, uint8_t slot, uint8_t numSlots);
+
+/// @brief take as much of the outstanding adjustment \p pending_ms as can be applied to a sleep of \p sleepTime_ms.
+/// A single sleep is changed by at most half its length, so the time between samples stays reasonable while a
+/// large adjustment is spread over several sleeps.
+/// @returns the adjustment to apply to this sleep, which is removed from \p pending_ms
+int32_t takeSleepAdjustment_ms(int32_t *pending_ms, uint32_t sleepTime_ms);
+
+#endif
@@ -0,0 +1,134 @@
+#include "udp_transport.h"
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "coap.h"
+#include "log.h"
+
+namespace
+{
+    // RFC 7252 suggests datagrams of at most 1152 bytes, to stay clear of IP fragmentation
+    constexpr size_t kMaxDatagramSize = 1152;
+    constexpr size_t kMaxPayloadSize = 1024;
+    constexpr size_t kMaxTopicLength = 64;
+    // a short first timeout, as the gateway is on the local network, doubled for each retransmission
+    constexpr uint32_t kAckTimeout_ms = 500;
+    constexpr uint8_t kMaxRetransmissions = 3;
+
+    WiFiUDP g_udp;
+    IPAddress g_gatewayAddress;
+    uint16_t g_gatewayPort = 0;
+    char g_queuedTopic[kMaxTopicLength + 1] = {0};
+    uint8_t g_queuedPayload[kMaxPayloadSize];
+    size_t g_queuedPayloadLength = 0;
+    RTC_DATA_ATTR uint16_t g_messageId = 0; // carried across wakes, so the gateway doesn't take a new request as a retransmission
+
+    /// @brief send a POST and wait for it to be acknowledged, retransmitting with exponential back off
+    bool sendConfirmable(const char *topic, const uint8_t *payload, size_t payloadLength)
+    {
+        static uint8_t datagram[kMaxDatagramSize];
+        ++g_messageId;
+        const uint32_t token = esp_random();
+        const size_t datagramLength = coapEncodePost(datagram, sizeof(datagram), g_messageId, token, topic, payload, payloadLength);
+        if (datagramLength == 0)
+        {
+            LOG_ERROR(LogEvent::CoapSendFailed, g_messageId, payloadLength);
+            return false;
+        }
+
+        uint32_t timeout_ms = kAckTimeout_ms;
+        for (uint8_t attempt = 0; attempt <= kMaxRetransmissions; ++attempt)
+        {
+            if (attempt > 0)
+            {
+                LOG_WARN(LogEvent::CoapRetransmit, g_messageId, attempt);
+            }
+            g_udp.beginPacket(g_gatewayAddress, g_gatewayPort);
+            g_udp.write(datagram, datagramLength);
+            g_udp.endPacket();
+
+            const uint32_t start_ms = millis();
+            while (millis() - start_ms < timeout_ms)
+            {
+                const int received = g_udp.parsePacket();
+                if (received <= 0)
+                {
+                    delay(1);
+                    continue;
+                }
+
+                uint8_t response[32]; // only the header and token are needed
+                const int length = g_udp.read(response, sizeof(response));
+                uint8_t code;
+                if (length > 0 && coapParseAck(response, length, g_messageId, token, &code))
+                {
+                    if (!coapIsSuccess(code))
+                    {
+                        LOG_ERROR(LogEvent::CoapRejected, g_messageId, code);
+                        return false;
+                    }
+                    return true;
+                }
+            }
+            timeout_ms *= 2;
+        }
+
+        LOG_ERROR(LogEvent::CoapSendFailed, g_messageId, payloadLength);
+        return false;
+    }
+}
+
+bool udpTransportBegin(const char *host, uint16_t port)
+{
+    if (WiFi.hostByName(host, g_gatewayAddress) != 1)
+    {
+        LOG_ERROR(LogEvent::CoapGatewayNotFound);
+        return false;
+    }
+    g_gatewayPort = port;
+    g_queuedTopic[0] = 0;
+    g_queuedPayloadLength = 0;
+    return g_udp.begin(kCoapDefaultPort) == 1;
+}
+
+bool udpTransportPublish(const char *topic, const uint8_t *data, size_t length)
+{
+    bool success = true;
+    if (strcmp(topic, g_queuedTopic) != 0)
+    {
+        success = udpTransportFlush();
+        strncpy(g_queuedTopic, topic, kMaxTopicLength);
+        g_queuedTopic[kMaxTopicLength] = 0;
+    }
+
+    size_t used = coapAppendRecord(g_queuedPayload, sizeof(g_queuedPayload), g_queuedPayloadLength, data, length);
+    if (used == 0)
+    {
+        // full, so send what is there and start a new datagram
+        success = udpTransportFlush() && success;
+        used = coapAppendRecord(g_queuedPayload, sizeof(g_queuedPayload), 0, data, length);
+        if (used == 0)
+        {
+            LOG_ERROR(LogEvent::CoapSendFailed, g_messageId, length);
+            return false;
+        }
+    }
+    g_queuedPayloadLength = used;
+    return success;
+}
+
+bool udpTransportFlush()
+{
+    if (g_queuedPayloadLength == 0)
+    {
+        return true;
+    }
+    const bool success = sendConfirmable(g_queuedTopic, g_queuedPayload, g_queuedPayloadLength);
+    g_queuedPayloadLength = 0;
+    return success;
+}
+
+void udpTransportEnd()
+{
+    g_queuedPayloadLength = 0;
+    g_udp.stop();
+}
@@ -0,0 +1,30 @@
+#ifndef __UDP_TRANSPORT__
+#define __UDP_TRANSPORT__
+
+#include "Arduino.h"
+
+/// @brief Sending messages to the CoAP gateway (mqtt-server/coap_gateway.py) over UDP, instead of to the broker over
+/// MQTT.  There is no connection to set up, and messages published to the same topic one after another are packed
+/// into as few datagrams as possible, so a whole batch of measurements usually takes a single round trip.
+/// Each datagram is a confirmable CoAP POST (see coap.h), retransmitted until the gateway acknowledges it.
+
+/// @brief UDP port of the gateway
+constexpr uint16_t kCoapGatewayPort = 5683;
+
+/// @brief look up the gateway and open the socket.  WiFi must be connected.
+/// @returns false if the gateway's address couldn't be resolved
+bool udpTransportBegin(const char *host, uint16_t port);
+
+/// @brief queue \p data to be published on \p topic.  What is already queued is sent first if it is for another
+/// topic or if \p data doesn't fit in the same datagram.
+/// @returns false if a datagram that had to be sent wasn't acknowledged
+bool udpTransportPublish(const char *topic, const uint8_t *data, size_t length);
+
+/// @brief send whatever is queued
+/// @returns false if it wasn't acknowledged
+bool udpTransportFlush();
+
+/// @brief close the socket, dropping anything still queued
+void udpTransportEnd();
+
+#endif
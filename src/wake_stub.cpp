@@ -0,0 +1,67 @@
+#include "wake_stub.h"
+#include "esp_clk.h"
+#include "esp_sleep.h"
+#include "rom/ets_sys.h"
+#include "soc/rtc.h"
+#include "soc/rtc_cntl_reg.h"
+
+namespace
+{
+    // everything the stub touches has to be in RTC memory, and it can only call functions in ROM
+    RTC_DATA_ATTR uint16_t g_wakesToSkip = 0;
+    RTC_DATA_ATTR uint16_t g_wakesSkipped = 0;
+    RTC_DATA_ATTR uint64_t g_sleepTime_ticks = 0; // in RTC slow clock ticks, as the stub can't do the conversion
+
+    // the same as rtc_time_get(), which isn't in RTC memory
+    uint64_t RTC_IRAM_ATTR stubRtcTime()
+    {
+        SET_PERI_REG_MASK(RTC_CNTL_TIME_UPDATE_REG, RTC_CNTL_TIME_UPDATE);
+        while (GET_PERI_REG_MASK(RTC_CNTL_TIME_UPDATE_REG, RTC_CNTL_TIME_VALID) == 0)
+        {
+            ets_delay_us(1);
+        }
+        SET_PERI_REG_MASK(RTC_CNTL_INT_CLR_REG, RTC_CNTL_TIME_VALID_INT_CLR);
+        uint64_t time = READ_PERI_REG(RTC_CNTL_TIME0_REG);
+        time |= static_cast<uint64_t>(READ_PERI_REG(RTC_CNTL_TIME1_REG)) << 32;
+        return time;
+    }
+
+    void RTC_IRAM_ATTR wakeStub()
+    {
+        esp_default_wake_deep_sleep();
+        if (g_wakesToSkip == 0)
+        {
+            // real work to do, so carry on with the full boot
+            return;
+        }
+        --g_wakesToSkip;
+        ++g_wakesSkipped;
+
+        // the same as rtc_sleep_set_wakeup_time(), the timer wake is still enabled from when the app went to sleep
+        const uint64_t wakeTime = stubRtcTime() + g_sleepTime_ticks;
+        WRITE_PERI_REG(RTC_CNTL_SLP_TIMER0_REG, static_cast<uint32_t>(wakeTime));
+        WRITE_PERI_REG(RTC_CNTL_SLP_TIMER1_REG, static_cast<uint32_t>(wakeTime >> 32));
+
+        // back to sleep, waking into this stub again
+        REG_WRITE(RTC_ENTRY_ADDR_REG, reinterpret_cast<uint32_t>(&wakeStub));
+        CLEAR_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_SLEEP_EN);
+        SET_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_SLEEP_EN);
+        while (true)
+        {
+        }
+    }
+}
+
+void wakeStubSkipWakes(uint16_t numWakes, uint32_t sleepTime_ms)
+{
+    g_wakesToSkip = numWakes;
+    g_sleepTime_ticks = rtc_time_us_to_slowclk(static_cast<uint64_t>(sleepTime_ms) * 1000, esp_clk_slowclk_cal_get());
+    esp_set_deep_sleep_wake_stub(&wakeStub);
+}
+
+uint16_t wakeStubTakeSkippedWakes()
+{
+    const uint16_t skipped = g_wakesSkipped;
+    g_wakesSkipped = 0;
+    return skipped;
+}
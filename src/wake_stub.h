@@ -0,0 +1,15 @@
+#ifndef __WAKE_STUB__
+#define __WAKE_STUB__
+
+#include "Arduino.h"
+
+/// @brief Have the deep sleep wake stub handle the next \p numWakes timer wakes by itself.
+/// The stub runs from RTC memory straight out of the ROM bootloader, before the app (the Arduino core, WiFi, Serial)
+/// is loaded, so a skipped wake costs a fraction of a full boot.  It just puts the device back to sleep for another
+/// \p sleepTime_ms.  Must be called before esp_deep_sleep_start().
+void wakeStubSkipWakes(uint16_t numWakes, uint32_t sleepTime_ms);
+
+/// @returns the number of wakes the stub has handled since this was last called
+uint16_t wakeStubTakeSkippedWakes();
+
+#endif
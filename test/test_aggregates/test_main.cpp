@@ -0,0 +1,195 @@
+#include <unity.h>
+#include <math.h>
+#include <vector>
+#include "aggregates.h"
+
+namespace
+{
+    // the step of the fixed-point values
+    constexpr double kResolution = 1.0 / (1 << kAggregateFractionBits);
+
+    struct Reference
+    {
+        uint32_t count;
+        double min;
+        double max;
+        double mean;
+        double stddev;
+    };
+
+    /// @brief the statistics of the values that aren't NaN, in double precision
+    Reference reference(const std::vector<float> &values)
+    {
+        Reference result = {0, INFINITY, -INFINITY, 0.0, 0.0};
+        double sum = 0.0;
+        for (float value : values)
+        {
+            if (!isnan(value))
+            {
+                ++result.count;
+                sum += value;
+                result.min = fmin(result.min, value);
+                result.max = fmax(result.max, value);
+            }
+        }
+        result.mean = sum / result.count;
+        double squares = 0.0;
+        for (float value : values)
+        {
+            if (!isnan(value))
+            {
+                squares += (value - result.mean) * (value - result.mean);
+            }
+        }
+        result.stddev = result.count > 1 ? sqrt(squares / (result.count - 1)) : 0.0;
+        return result;
+    }
+
+    ttgo_proto_Aggregate aggregateOf(const std::vector<float> &values)
+    {
+        ChannelAggregate aggregate = {};
+        for (float value : values)
+        {
+            aggregateAdd(&aggregate, value);
+        }
+        ttgo_proto_Aggregate out;
+        aggregateFinish(aggregate, &out);
+        return out;
+    }
+
+    /// @brief check the aggregate of \p values against the reference, with \p relative error allowed on top of the
+    /// fixed-point resolution
+    void checkAgainstReference(const std::vector<float> &values, double relative)
+    {
+        const Reference expected = reference(values);
+        const ttgo_proto_Aggregate actual = aggregateOf(values);
+        TEST_ASSERT_EQUAL_UINT32(expected.count, actual.count);
+        TEST_ASSERT_FLOAT_WITHIN(kResolution + relative * fabs(expected.min), expected.min, actual.min);
+        TEST_ASSERT_FLOAT_WITHIN(kResolution + relative * fabs(expected.max), expected.max, actual.max);
+        TEST_ASSERT_FLOAT_WITHIN(2 * kResolution + relative * expected.stddev, expected.mean, actual.mean);
+        TEST_ASSERT_FLOAT_WITHIN(2 * kResolution + relative * expected.stddev, expected.stddev, actual.stddev);
+    }
+
+    std::vector<float> randomValues(uint32_t count, float low, float high, uint32_t seed)
+    {
+        std::vector<float> values;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            seed = seed * 1103515245u + 12345u;
+            values.push_back(low + (high - low) * static_cast<float>((seed >> 8) & 0xffff) / 65535.0f);
+        }
+        return values;
+    }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_lux_matches_reference()
+{
+    checkAgainstReference(randomValues(255, 0.0f, 20000.0f, 1), 1e-5);
+}
+
+void test_narrow_spread_matches_reference()
+{
+    // soil that hardly moves, where the rounding of the fixed point matters most
+    checkAgainstReference(randomValues(255, 41.0f, 41.5f, 2), 1e-5);
+}
+
+void test_negative_values_match_reference()
+{
+    checkAgainstReference(randomValues(100, -300.0f, 50.0f, 3), 1e-5);
+}
+
+void test_values_near_max_magnitude()
+{
+    checkAgainstReference(randomValues(255, -kAggregateMaxMagnitude, kAggregateMaxMagnitude, 4), 1e-5);
+
+    // the widest spread there can be, for as many samples as a window can have
+    std::vector<float> values;
+    for (uint32_t i = 0; i < 255; ++i)
+    {
+        values.push_back(i % 2 == 0 ? kAggregateMaxMagnitude : -kAggregateMaxMagnitude);
+    }
+    checkAgainstReference(values, 1e-5);
+}
+
+void test_values_past_max_magnitude_are_clamped()
+{
+    const ttgo_proto_Aggregate aggregate = aggregateOf({1e9f, 5.0f, -1e9f});
+    TEST_ASSERT_EQUAL_UINT32(3, aggregate.count);
+    TEST_ASSERT_EQUAL_FLOAT(kAggregateMaxMagnitude, aggregate.max);
+    TEST_ASSERT_EQUAL_FLOAT(-kAggregateMaxMagnitude, aggregate.min);
+    TEST_ASSERT_FLOAT_WITHIN(kResolution, 5.0f / 3.0f, aggregate.mean);
+}
+
+void test_single_value()
+{
+    const ttgo_proto_Aggregate aggregate = aggregateOf({12.5f});
+    TEST_ASSERT_EQUAL_UINT32(1, aggregate.count);
+    TEST_ASSERT_EQUAL_FLOAT(12.5f, aggregate.min);
+    TEST_ASSERT_EQUAL_FLOAT(12.5f, aggregate.max);
+    TEST_ASSERT_EQUAL_FLOAT(12.5f, aggregate.mean);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, aggregate.stddev);
+}
+
+void test_nan_lux_is_skipped()
+{
+    // a missing light sensor reads NaN, which leaves out only the lux of those samples
+    std::vector<float> lux = randomValues(50, 0.0f, 1000.0f, 5);
+    for (uint32_t i = 0; i < lux.size(); i += 3)
+    {
+        lux[i] = NAN;
+    }
+    checkAgainstReference(lux, 1e-5);
+
+    AggregateWindow window;
+    resetAggregateWindow(&window);
+    for (uint32_t i = 0; i < lux.size(); ++i)
+    {
+        addAggregateSample(&window, 1000 + 12 * i, lux[i], 40.0f, 300.0f);
+    }
+    ttgo_proto_WindowAggregates aggregates;
+    TEST_ASSERT_TRUE(finishAggregateWindow(window, &aggregates));
+    TEST_ASSERT_EQUAL_UINT32(reference(lux).count, aggregates.lux.count);
+    TEST_ASSERT_EQUAL_UINT32(lux.size(), aggregates.soil.count);
+    TEST_ASSERT_EQUAL_UINT32(lux.size(), aggregates.salt.count);
+    TEST_ASSERT_EQUAL_UINT32(1000 + 12 * (lux.size() - 1), aggregates.timestamp);
+    TEST_ASSERT_EQUAL_UINT32(12 * (lux.size() - 1), aggregates.duration_s);
+}
+
+void test_all_nan_channel_is_empty()
+{
+    const ttgo_proto_Aggregate aggregate = aggregateOf({NAN, NAN});
+    TEST_ASSERT_EQUAL_UINT32(0, aggregate.count);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, aggregate.mean);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, aggregate.stddev);
+}
+
+void test_empty_window()
+{
+    AggregateWindow window;
+    resetAggregateWindow(&window);
+    ttgo_proto_WindowAggregates aggregates;
+    TEST_ASSERT_FALSE(finishAggregateWindow(window, &aggregates));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lux_matches_reference);
+    RUN_TEST(test_narrow_spread_matches_reference);
+    RUN_TEST(test_negative_values_match_reference);
+    RUN_TEST(test_values_near_max_magnitude);
+    RUN_TEST(test_values_past_max_magnitude_are_clamped);
+    RUN_TEST(test_single_value);
+    RUN_TEST(test_nan_lux_is_skipped);
+    RUN_TEST(test_all_nan_channel_is_empty);
+    RUN_TEST(test_empty_window);
+    return UNITY_END();
+}
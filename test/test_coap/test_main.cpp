@@ -0,0 +1,96 @@
+#include <unity.h>
+#include <string.h>
+#include "coap.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// the same datagram is checked by mqtt-server/test_coap_gateway.py
+const uint8_t kExamplePost[] = {
+    0x44, 0x02, 0x12, 0x34,                        // CON POST, message id 0x1234, 4 byte token
+    0x01, 0x02, 0x03, 0x04,                        // token
+    0xB7, 's', 'e', 'n', 's', 'o', 'r', 's',       // Uri-Path "sensors"
+    0x02, 's', '0',                                // Uri-Path "s0"
+    0xFF, 0x02, 0x08, 0x01};                       // payload, one record of 2 bytes
+
+void test_encode_post()
+{
+    const uint8_t message[] = {0x08, 0x01};
+    uint8_t payload[8];
+    const size_t payloadLength = coapAppendRecord(payload, sizeof(payload), 0, message, sizeof(message));
+    TEST_ASSERT_EQUAL(3, payloadLength);
+
+    uint8_t datagram[64];
+    const size_t length = coapEncodePost(datagram, sizeof(datagram), 0x1234, 0x01020304, "sensors/s0", payload, payloadLength);
+    TEST_ASSERT_EQUAL(sizeof(kExamplePost), length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(kExamplePost, datagram, length);
+}
+
+void test_encode_long_segment_and_overflow()
+{
+    char path[40] = "sensors/";
+    memset(path + 8, 'a', 20); // a 20 character segment needs an extended length
+    uint8_t datagram[64];
+    const size_t length = coapEncodePost(datagram, sizeof(datagram), 1, 2, path, nullptr, 0);
+    TEST_ASSERT_EQUAL(8 + 8 + 2 + 20, length);
+    TEST_ASSERT_EQUAL_HEX8(0x0D, datagram[16]);
+    TEST_ASSERT_EQUAL_UINT8(20 - 13, datagram[17]);
+
+    TEST_ASSERT_EQUAL(0, coapEncodePost(datagram, 20, 1, 2, path, nullptr, 0));
+}
+
+void test_append_records_until_full()
+{
+    uint8_t message[200];
+    memset(message, 0x55, sizeof(message));
+    uint8_t payload[410];
+    size_t used = coapAppendRecord(payload, sizeof(payload), 0, message, sizeof(message));
+    // 200 needs a 2 byte varint
+    TEST_ASSERT_EQUAL(202, used);
+    TEST_ASSERT_EQUAL_HEX8(0xC8, payload[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, payload[1]);
+    used = coapAppendRecord(payload, sizeof(payload), used, message, sizeof(message));
+    TEST_ASSERT_EQUAL(404, used);
+    TEST_ASSERT_EQUAL(0, coapAppendRecord(payload, sizeof(payload), used, message, sizeof(message)));
+}
+
+void test_parse_ack()
+{
+    const uint8_t ack[] = {0x64, 0x44, 0x12, 0x34, 0x01, 0x02, 0x03, 0x04};
+    uint8_t code = 0;
+    TEST_ASSERT_TRUE(coapParseAck(ack, sizeof(ack), 0x1234, 0x01020304, &code));
+    TEST_ASSERT_EQUAL_HEX8(kCoapCodeChanged, code);
+    TEST_ASSERT_TRUE(coapIsSuccess(code));
+
+    // answers to something else
+    TEST_ASSERT_FALSE(coapParseAck(ack, sizeof(ack), 0x1235, 0x01020304, &code));
+    TEST_ASSERT_FALSE(coapParseAck(ack, sizeof(ack), 0x1234, 0x01020305, &code));
+    TEST_ASSERT_FALSE(coapParseAck(ack, 3, 0x1234, 0x01020304, &code));
+    // a request, not an acknowledgement
+    TEST_ASSERT_FALSE(coapParseAck(kExamplePost, sizeof(kExamplePost), 0x1234, 0x01020304, &code));
+}
+
+void test_parse_reset()
+{
+    const uint8_t reset[] = {0x70, 0x00, 0x12, 0x34};
+    uint8_t code = 0xFF;
+    TEST_ASSERT_TRUE(coapParseAck(reset, sizeof(reset), 0x1234, 0x01020304, &code));
+    TEST_ASSERT_EQUAL_HEX8(kCoapCodeEmpty, code);
+    TEST_ASSERT_FALSE(coapIsSuccess(code));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_encode_post);
+    RUN_TEST(test_encode_long_segment_and_overflow);
+    RUN_TEST(test_append_records_until_full);
+    RUN_TEST(test_parse_ack);
+    RUN_TEST(test_parse_reset);
+    return UNITY_END();
+}
@@ -0,0 +1,277 @@
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include "compression.h"
+
+namespace
+{
+    float ttgo_proto_Measurements::*const kFields[kNumCompressedFields] = {
+        &ttgo_proto_Measurements::lux,
+        &ttgo_proto_Measurements::humidity,
+        &ttgo_proto_Measurements::temperature_C,
+        &ttgo_proto_Measurements::soil,
+        &ttgo_proto_Measurements::salt,
+        &ttgo_proto_Measurements::battery_mV,
+    };
+
+    constexpr uint32_t kStartTime = 1600000000;
+    constexpr uint32_t kSamplePeriod_s = 120;
+
+    struct Point
+    {
+        uint32_t time;
+        float value;
+    };
+
+    CompressionState g_state;
+
+    CompressionSettings defaultSettings()
+    {
+        return {{10.0f, 1.0f, 0.2f, 1.0f, 10.0f, 20.0f}, 30};
+    }
+
+    ttgo_proto_Measurements sampleAt(uint32_t index, float value)
+    {
+        ttgo_proto_Measurements sample = {};
+        sample.timestamp = kStartTime + index * kSamplePeriod_s;
+        for (uint8_t field = 0; field < kNumCompressedFields; ++field)
+        {
+            sample.*kFields[field] = value;
+        }
+        return sample;
+    }
+
+    /// @brief compress \p samples, and collect the points transmitted of each field
+    /// @returns the number of messages sent for each sample
+    std::vector<uint8_t> compressAll(const std::vector<ttgo_proto_Measurements> &samples,
+                                     const CompressionSettings &settings,
+                                     std::vector<Point> *transmitted)
+    {
+        std::vector<uint8_t> numMessages;
+        for (const ttgo_proto_Measurements &sample : samples)
+        {
+            ttgo_proto_Measurements messages[kMaxCompressedMessagesPerSample];
+            const uint8_t count = compressSample(&g_state, settings, sample, messages);
+            for (uint8_t i = 0; i < count; ++i)
+            {
+                for (uint8_t field = 0; field < kNumCompressedFields; ++field)
+                {
+                    if (messages[i].field_mask & (1u << field))
+                    {
+                        transmitted[field].push_back({messages[i].timestamp, messages[i].*kFields[field]});
+                    }
+                }
+            }
+            numMessages.push_back(count);
+        }
+        return numMessages;
+    }
+
+    /// @brief the value the server reconstructs at \p time from the transmitted \p points
+    /// @returns false if \p time is after the last of them (its value is still held back by the door)
+    bool interpolate(const std::vector<Point> &points, uint32_t time, float *value)
+    {
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            if (points[i].time == time)
+            {
+                *value = points[i].value;
+                return true;
+            }
+            if (points[i].time > time && i > 0)
+            {
+                const Point &before = points[i - 1];
+                const double fraction = static_cast<double>(time - before.time) / (points[i].time - before.time);
+                *value = before.value + fraction * (points[i].value - before.value);
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+void setUp()
+{
+    resetCompression(&g_state);
+}
+
+void tearDown()
+{
+}
+
+void test_first_sample_is_sent_in_full()
+{
+    ttgo_proto_Measurements messages[kMaxCompressedMessagesPerSample];
+    TEST_ASSERT_EQUAL_UINT8(1, compressSample(&g_state, defaultSettings(), sampleAt(0, 5.0f), messages));
+    TEST_ASSERT_EQUAL_UINT32(kAllFieldsMask, messages[0].field_mask);
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, messages[0].lux);
+}
+
+void test_reconstruction_within_tolerance()
+{
+    // a slow wave of a different size for each field, with noise
+    const CompressionSettings settings = defaultSettings();
+    uint32_t noise = 1;
+    std::vector<ttgo_proto_Measurements> samples;
+    for (uint32_t i = 0; i < 2000; ++i)
+    {
+        ttgo_proto_Measurements sample = sampleAt(i, 0.0f);
+        for (uint8_t field = 0; field < kNumCompressedFields; ++field)
+        {
+            noise = noise * 1103515245u + 12345u;
+            const float jitter = static_cast<float>((noise >> 16) % 1000) / 1000.0f - 0.5f;
+            sample.*kFields[field] = settings.tolerance[field] * (20.0f * sinf(i / (40.0f + 7.0f * field)) + jitter);
+        }
+        samples.push_back(sample);
+    }
+
+    std::vector<Point> transmitted[kNumCompressedFields];
+    compressAll(samples, settings, transmitted);
+
+    for (uint8_t field = 0; field < kNumCompressedFields; ++field)
+    {
+        // the wave is compressed at all
+        TEST_ASSERT_TRUE(transmitted[field].size() < samples.size() / 2);
+        // and the line between what is sent passes within tolerance of every sample
+        uint32_t numChecked = 0;
+        for (const ttgo_proto_Measurements &sample : samples)
+        {
+            float value;
+            if (!interpolate(transmitted[field], sample.timestamp, &value))
+            {
+                break;
+            }
+            TEST_ASSERT_FLOAT_WITHIN(settings.tolerance[field] * 1.001f, sample.*kFields[field], value);
+            ++numChecked;
+        }
+        // all but the samples still held back
+        TEST_ASSERT_TRUE(numChecked + settings.keyframeInterval >= samples.size());
+    }
+}
+
+void test_keyframe_spacing()
+{
+    // a value that never changes is only sent in keyframes, every keyframeInterval samples
+    const CompressionSettings settings = defaultSettings();
+    std::vector<ttgo_proto_Measurements> samples;
+    for (uint32_t i = 0; i < 200; ++i)
+    {
+        samples.push_back(sampleAt(i, 21.0f));
+    }
+    std::vector<Point> transmitted[kNumCompressedFields];
+    const std::vector<uint8_t> numMessages = compressAll(samples, settings, transmitted);
+
+    for (uint32_t i = 0; i < samples.size(); ++i)
+    {
+        const bool keyframe = i == 0 || (i + 1) % settings.keyframeInterval == 0;
+        TEST_ASSERT_EQUAL_UINT8(keyframe ? 1 : 0, numMessages[i]);
+    }
+    for (uint8_t field = 0; field < kNumCompressedFields; ++field)
+    {
+        TEST_ASSERT_EQUAL(1 + samples.size() / settings.keyframeInterval, transmitted[field].size());
+        for (size_t i = 1; i < transmitted[field].size(); ++i)
+        {
+            TEST_ASSERT_TRUE(transmitted[field][i].time - transmitted[field][i - 1].time <=
+                             settings.keyframeInterval * kSamplePeriod_s);
+        }
+    }
+}
+
+void test_no_keyframes()
+{
+    CompressionSettings settings = defaultSettings();
+    settings.keyframeInterval = 0;
+    std::vector<ttgo_proto_Measurements> samples;
+    for (uint32_t i = 0; i < 200; ++i)
+    {
+        samples.push_back(sampleAt(i, 21.0f));
+    }
+    std::vector<Point> transmitted[kNumCompressedFields];
+    compressAll(samples, settings, transmitted);
+    TEST_ASSERT_EQUAL(1, transmitted[kCompressedLux].size());
+}
+
+void test_events_are_preserved()
+{
+    // a short spike in an otherwise flat series is sent exactly, with the samples either side of it
+    std::vector<ttgo_proto_Measurements> samples;
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        samples.push_back(sampleAt(i, i == 50 || i == 51 ? 1000.0f : 0.0f));
+    }
+    std::vector<Point> transmitted[kNumCompressedFields];
+    compressAll(samples, defaultSettings(), transmitted);
+
+    const std::vector<Point> &lux = transmitted[kCompressedLux];
+    for (uint32_t i = 49; i <= 52; ++i)
+    {
+        bool found = false;
+        for (const Point &point : lux)
+        {
+            if (point.time == samples[i].timestamp)
+            {
+                TEST_ASSERT_EQUAL_FLOAT(samples[i].lux, point.value);
+                found = true;
+            }
+        }
+        TEST_ASSERT_TRUE(found);
+    }
+}
+
+void test_held_point_and_current_in_one_sample()
+{
+    // the door of lux closes on the keyframe, so the held sample and the keyframe are both sent
+    const CompressionSettings settings = defaultSettings();
+    std::vector<ttgo_proto_Measurements> samples;
+    for (uint32_t i = 0; i < settings.keyframeInterval; ++i)
+    {
+        samples.push_back(sampleAt(i, 0.0f));
+    }
+    samples.back().lux = 500.0f;
+    std::vector<Point> transmitted[kNumCompressedFields];
+    const std::vector<uint8_t> numMessages = compressAll(samples, settings, transmitted);
+
+    TEST_ASSERT_EQUAL_UINT8(2, numMessages.back());
+    const std::vector<Point> &lux = transmitted[kCompressedLux];
+    TEST_ASSERT_EQUAL(3, lux.size());
+    TEST_ASSERT_EQUAL_UINT32(samples[samples.size() - 2].timestamp, lux[1].time);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, lux[1].value);
+    TEST_ASSERT_EQUAL_FLOAT(500.0f, lux[2].value);
+    // the other fields didn't need the held sample
+    TEST_ASSERT_EQUAL(2, transmitted[kCompressedHumidity].size());
+}
+
+void test_time_going_backwards_starts_again()
+{
+    SwingingDoorState door = {};
+    TEST_ASSERT_EQUAL_UINT8(kArchiveCurrent, swingingDoorUpdate(&door, 1000, 1.0f, 0.5f));
+    TEST_ASSERT_EQUAL_UINT8(0, swingingDoorUpdate(&door, 1120, 1.0f, 0.5f));
+    TEST_ASSERT_EQUAL_UINT8(kArchiveLast | kArchiveCurrent, swingingDoorUpdate(&door, 500, 1.0f, 0.5f));
+    TEST_ASSERT_EQUAL_UINT32(500, door.anchorTime);
+    TEST_ASSERT_FALSE(door.hasLast);
+}
+
+void test_reset_sends_the_next_sample_in_full()
+{
+    ttgo_proto_Measurements messages[kMaxCompressedMessagesPerSample];
+    compressSample(&g_state, defaultSettings(), sampleAt(0, 5.0f), messages);
+    TEST_ASSERT_EQUAL_UINT8(0, compressSample(&g_state, defaultSettings(), sampleAt(1, 5.0f), messages));
+    resetCompression(&g_state);
+    TEST_ASSERT_EQUAL_UINT8(1, compressSample(&g_state, defaultSettings(), sampleAt(2, 5.0f), messages));
+    TEST_ASSERT_EQUAL_UINT32(kAllFieldsMask, messages[0].field_mask);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_sample_is_sent_in_full);
+    RUN_TEST(test_reconstruction_within_tolerance);
+    RUN_TEST(test_keyframe_spacing);
+    RUN_TEST(test_no_keyframes);
+    RUN_TEST(test_events_are_preserved);
+    RUN_TEST(test_held_point_and_current_in_one_sample);
+    RUN_TEST(test_time_going_backwards_starts_again);
+    RUN_TEST(test_reset_sends_the_next_sample_in_full);
+    return UNITY_END();
+}
@@ -0,0 +1,125 @@
+#include <unity.h>
+#include <string.h>
+#include "config_migration.h"
+
+namespace
+{
+    constexpr size_t kCrcSize = sizeof(uint32_t);
+    constexpr uint8_t kPaddingByte = 0xA5;
+
+    DeviceConfig g_current;  // what an older device had stored, in the current layout
+    DeviceConfig g_defaults; // what the new firmware would default to
+    uint8_t g_blob[sizeof(DeviceConfig)];
+
+    /// @brief lay out \p source the way the firmware of \p version stored it: its fields, then padding to the
+    /// alignment of the struct, then the crc
+    /// @returns the length of the blob
+    size_t makeBlob(uint16_t version, const DeviceConfig &source)
+    {
+        const size_t fieldsEnd = deviceConfigFieldsEnd(version);
+        const size_t crcOffset = (fieldsEnd + alignof(DeviceConfig) - 1) / alignof(DeviceConfig) * alignof(DeviceConfig);
+        const size_t length = crcOffset + kCrcSize;
+        memset(g_blob, kPaddingByte, sizeof(g_blob));
+        memcpy(g_blob, &source, fieldsEnd);
+        const uint16_t size = length;
+        memcpy(g_blob + offsetof(DeviceConfig, version), &version, sizeof(version));
+        memcpy(g_blob + offsetof(DeviceConfig, size), &size, sizeof(size));
+        memset(g_blob + crcOffset, 0x12, kCrcSize);
+        return length;
+    }
+}
+
+void setUp()
+{
+    memset(&g_current, 0x5A, sizeof(g_current));
+    memset(&g_defaults, 0, sizeof(g_defaults));
+    g_defaults.version = DEVICE_CONFIG_VERSION;
+    g_defaults.size = sizeof(DeviceConfig);
+    g_defaults.timeBetweenMeasurements_ms = 120000;
+    g_defaults.numTransmitSlots = 12;
+    g_defaults.transmitSlot = 0xFF;
+    g_defaults.tlsMode = kTlsPsk;
+    g_defaults.tlsPskLength = 16;
+    g_defaults.relayRole = kRelayRoleNode;
+    g_defaults.relayPeer[0] = 0x24;
+    g_defaults.relayChannel = 6;
+}
+
+void tearDown()
+{
+}
+
+void test_fields_end_in_order()
+{
+    TEST_ASSERT_EQUAL(0, deviceConfigFieldsEnd(0));
+    TEST_ASSERT_EQUAL(0, deviceConfigFieldsEnd(DEVICE_CONFIG_VERSION + 1));
+    TEST_ASSERT_EQUAL(offsetof(DeviceConfig, crc), deviceConfigFieldsEnd(DEVICE_CONFIG_VERSION));
+    for (uint16_t version = 2; version <= DEVICE_CONFIG_VERSION; ++version)
+    {
+        TEST_ASSERT_TRUE(deviceConfigFieldsEnd(version) > deviceConfigFieldsEnd(version - 1));
+    }
+}
+
+void test_migrates_every_older_version()
+{
+    const uint8_t *current = reinterpret_cast<const uint8_t *>(&g_current);
+    const uint8_t *defaults = reinterpret_cast<const uint8_t *>(&g_defaults);
+    for (uint16_t version = 1; version < DEVICE_CONFIG_VERSION; ++version)
+    {
+        const size_t length = makeBlob(version, g_current);
+        DeviceConfig migrated = g_defaults;
+        TEST_ASSERT_TRUE(migrateDeviceConfig(g_blob, length, &migrated));
+        TEST_ASSERT_EQUAL(DEVICE_CONFIG_VERSION, migrated.version);
+        TEST_ASSERT_EQUAL(sizeof(DeviceConfig), migrated.size);
+
+        // the stored fields are kept, and the rest (including where the padding of the blob was) are the defaults
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&migrated);
+        const size_t fieldsEnd = deviceConfigFieldsEnd(version);
+        const size_t storedStart = offsetof(DeviceConfig, ssid);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(current + storedStart, bytes + storedStart, fieldsEnd - storedStart);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(defaults + fieldsEnd, bytes + fieldsEnd, offsetof(DeviceConfig, crc) - fieldsEnd);
+    }
+}
+
+void test_padding_isnt_taken_for_new_fields()
+{
+    // the single byte fields added by versions 7 and 8 start in the padding of the blobs of versions 6 and 7
+    DeviceConfig migrated = g_defaults;
+    TEST_ASSERT_TRUE(migrateDeviceConfig(g_blob, makeBlob(6, g_current), &migrated));
+    TEST_ASSERT_EQUAL(kTlsPsk, migrated.tlsMode);
+
+    migrated = g_defaults;
+    TEST_ASSERT_TRUE(migrateDeviceConfig(g_blob, makeBlob(7, g_current), &migrated));
+    TEST_ASSERT_EQUAL(kRelayRoleNode, migrated.relayRole);
+    TEST_ASSERT_EQUAL(0x24, migrated.relayPeer[0]);
+    TEST_ASSERT_EQUAL(6, migrated.relayChannel);
+}
+
+void test_rejects_what_isnt_an_older_config()
+{
+    DeviceConfig migrated = g_defaults;
+
+    // the current version, a version that never existed, and a size that doesn't match
+    size_t length = makeBlob(DEVICE_CONFIG_VERSION, g_current);
+    TEST_ASSERT_FALSE(migrateDeviceConfig(g_blob, length, &migrated));
+    length = makeBlob(5, g_current);
+    const uint16_t unknownVersion = 0;
+    memcpy(g_blob + offsetof(DeviceConfig, version), &unknownVersion, sizeof(unknownVersion));
+    TEST_ASSERT_FALSE(migrateDeviceConfig(g_blob, length, &migrated));
+    length = makeBlob(5, g_current);
+    TEST_ASSERT_FALSE(migrateDeviceConfig(g_blob, length - 4, &migrated));
+    TEST_ASSERT_FALSE(migrateDeviceConfig(g_blob, 6, &migrated));
+
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(reinterpret_cast<const uint8_t *>(&g_defaults),
+                                  reinterpret_cast<const uint8_t *>(&migrated), sizeof(DeviceConfig));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fields_end_in_order);
+    RUN_TEST(test_migrates_every_older_version);
+    RUN_TEST(test_padding_isnt_taken_for_new_fields);
+    RUN_TEST(test_rejects_what_isnt_an_older_config);
+    return UNITY_END();
+}
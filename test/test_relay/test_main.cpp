@@ -0,0 +1,256 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "relay.h"
+
+namespace
+{
+    struct Published
+    {
+        char topics[16][48];
+        uint8_t data[16][64];
+        size_t lengths[16];
+        uint8_t count;
+    };
+
+    void collect(const char *topic, const uint8_t *data, size_t length, void *context)
+    {
+        Published *published = static_cast<Published *>(context);
+        strcpy(published->topics[published->count], topic);
+        memcpy(published->data[published->count], data, length);
+        published->lengths[published->count] = length;
+        ++published->count;
+    }
+
+    LoopbackTransport g_transport;
+    RelayAggregator g_aggregator;
+    Published g_published;
+
+    /// @brief accept frame \p sequence from node "n<number>", carrying one measurements record of just \p number
+    uint8_t acceptFromNode(uint8_t number, uint8_t sequence = 0)
+    {
+        char name[8];
+        const int nameLength = snprintf(name, sizeof(name), "n%u", number);
+        uint8_t frame[16] = {kRelayFrameVersion, sequence, 0, static_cast<uint8_t>(nameLength)};
+        memcpy(frame + 4, name, nameLength);
+        const uint8_t record[] = {kRelayMeasurements, 1, number};
+        memcpy(frame + 4 + nameLength, record, sizeof(record));
+        return relayAggregatorAccept(&g_aggregator, frame, 4 + nameLength + sizeof(record));
+    }
+
+    /// @brief count the records published under a different node than the one that sent them
+    void checkNode(const char *topic, const uint8_t *data, size_t length, void *context)
+    {
+        char expected[16];
+        snprintf(expected, sizeof(expected), "sensors/n%u", data[0]);
+        if (strcmp(topic, expected) != 0)
+        {
+            ++*static_cast<uint8_t *>(context);
+        }
+    }
+
+    /// @brief pass every frame in the loopback to the aggregator
+    void pump()
+    {
+        uint8_t frame[kMaxRelayFrameSize];
+        size_t length;
+        while ((length = g_transport.receive(frame, sizeof(frame))) > 0)
+        {
+            relayAggregatorAccept(&g_aggregator, frame, length);
+        }
+    }
+}
+
+void setUp()
+{
+    g_transport = LoopbackTransport();
+    relayAggregatorReset(&g_aggregator);
+    memset(&g_published, 0, sizeof(g_published));
+}
+
+void tearDown()
+{
+}
+
+void test_record_kinds_and_topics()
+{
+    TEST_ASSERT_EQUAL(kRelayMeasurements, relayRecordKind("s0"));
+    TEST_ASSERT_EQUAL(kRelayAggregates, relayRecordKind("s0/aggregates"));
+    TEST_ASSERT_EQUAL(kRelayLog, relayRecordKind("s0/log"));
+    TEST_ASSERT_EQUAL(kNumRelayRecordKinds, relayRecordKind("s0/slot"));
+
+    char topic[32];
+    TEST_ASSERT_TRUE(relayTopic(topic, sizeof(topic), "s0", kRelayMeasurements));
+    TEST_ASSERT_EQUAL_STRING("sensors/s0", topic);
+    TEST_ASSERT_TRUE(relayTopic(topic, sizeof(topic), "s0", kRelayLog));
+    TEST_ASSERT_EQUAL_STRING("sensors/s0/log", topic);
+    TEST_ASSERT_FALSE(relayTopic(topic, 8, "s0", kRelayAggregates));
+}
+
+void test_round_trip()
+{
+    uint16_t sequence = 7;
+    RelaySender sender;
+    relaySenderBegin(&sender, &g_transport, "s0", &sequence);
+    const uint8_t measurements[] = {0x08, 0x01};
+    const uint8_t log[] = {0x01, 0x02, 0x03};
+    TEST_ASSERT_TRUE(relaySenderAdd(&sender, kRelayMeasurements, measurements, sizeof(measurements)));
+    TEST_ASSERT_TRUE(relaySenderAdd(&sender, kRelayLog, log, sizeof(log)));
+    TEST_ASSERT_TRUE(relaySenderFlush(&sender));
+    TEST_ASSERT_EQUAL(8, sequence); // both in one frame
+
+    pump();
+    TEST_ASSERT_EQUAL(2, relayAggregatorPublish(&g_aggregator, collect, &g_published));
+    TEST_ASSERT_EQUAL(2, g_published.count);
+    TEST_ASSERT_EQUAL_STRING("sensors/s0", g_published.topics[0]);
+    TEST_ASSERT_EQUAL(sizeof(measurements), g_published.lengths[0]);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(measurements, g_published.data[0], sizeof(measurements));
+    TEST_ASSERT_EQUAL_STRING("sensors/s0/log", g_published.topics[1]);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(log, g_published.data[1], sizeof(log));
+
+    // the queue is empty once published
+    TEST_ASSERT_EQUAL(0, relayAggregatorPublish(&g_aggregator, collect, &g_published));
+}
+
+void test_split_across_frames()
+{
+    uint16_t sequence = 0;
+    RelaySender sender;
+    relaySenderBegin(&sender, &g_transport, "s1", &sequence);
+    uint8_t message[60];
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        memset(message, i, sizeof(message));
+        TEST_ASSERT_TRUE(relaySenderAdd(&sender, kRelayMeasurements, message, sizeof(message)));
+    }
+    TEST_ASSERT_TRUE(relaySenderFlush(&sender));
+    TEST_ASSERT_EQUAL(3, sequence); // 3 records of 62 bytes fit in a frame after the header
+
+    pump();
+    TEST_ASSERT_EQUAL(8, relayAggregatorPublish(&g_aggregator, collect, &g_published));
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        TEST_ASSERT_EQUAL(i, g_published.data[i][0]);
+    }
+
+    // nothing fits a message bigger than a frame
+    uint8_t tooBig[kMaxRelayFrameSize];
+    TEST_ASSERT_FALSE(relaySenderAdd(&sender, kRelayMeasurements, tooBig, sizeof(tooBig)));
+}
+
+void test_duplicates_dropped()
+{
+    g_transport.duplicateFrames = true;
+    uint16_t sequence = 100;
+    RelaySender sender;
+    relaySenderBegin(&sender, &g_transport, "s0", &sequence);
+    const uint8_t message[] = {0x08, 0x01};
+    relaySenderAdd(&sender, kRelayMeasurements, message, sizeof(message));
+    TEST_ASSERT_TRUE(relaySenderFlush(&sender));
+
+    pump();
+    TEST_ASSERT_EQUAL(1, relayAggregatorPublish(&g_aggregator, collect, &g_published));
+    TEST_ASSERT_EQUAL(1, g_aggregator.numDuplicates);
+}
+
+void test_reordered_within_window()
+{
+    uint8_t frames[3][kMaxRelayFrameSize];
+    size_t lengths[3];
+    uint16_t sequence = 65534; // wraps
+    RelaySender sender;
+    relaySenderBegin(&sender, &g_transport, "s0", &sequence);
+    for (uint8_t i = 0; i < 3; ++i)
+    {
+        relaySenderAdd(&sender, kRelayMeasurements, &i, 1);
+        relaySenderFlush(&sender);
+        lengths[i] = g_transport.receive(frames[i], sizeof(frames[i]));
+    }
+
+    TEST_ASSERT_EQUAL(1, relayAggregatorAccept(&g_aggregator, frames[2], lengths[2]));
+    TEST_ASSERT_EQUAL(1, relayAggregatorAccept(&g_aggregator, frames[0], lengths[0]));
+    TEST_ASSERT_EQUAL(1, relayAggregatorAccept(&g_aggregator, frames[1], lengths[1]));
+    TEST_ASSERT_EQUAL(0, relayAggregatorAccept(&g_aggregator, frames[0], lengths[0]));
+    TEST_ASSERT_EQUAL(3, relayAggregatorPublish(&g_aggregator, collect, &g_published));
+}
+
+void test_restarted_node_accepted()
+{
+    uint16_t sequence = 1000;
+    RelaySender sender;
+    relaySenderBegin(&sender, &g_transport, "s0", &sequence);
+    const uint8_t message[] = {0x08, 0x01};
+    relaySenderAdd(&sender, kRelayMeasurements, message, sizeof(message));
+    relaySenderFlush(&sender);
+
+    // a node that lost its RTC memory starts from somewhere else
+    sequence = 10;
+    relaySenderAdd(&sender, kRelayMeasurements, message, sizeof(message));
+    relaySenderFlush(&sender);
+
+    pump();
+    TEST_ASSERT_EQUAL(2, relayAggregatorPublish(&g_aggregator, collect, &g_published));
+}
+
+void test_lost_frame_reported()
+{
+    g_transport.framesToDrop = 1;
+    uint16_t sequence = 0;
+    RelaySender sender;
+    relaySenderBegin(&sender, &g_transport, "s0", &sequence);
+    const uint8_t message[] = {0x08, 0x01};
+    relaySenderAdd(&sender, kRelayMeasurements, message, sizeof(message));
+    TEST_ASSERT_FALSE(relaySenderFlush(&sender));
+}
+
+void test_malformed_frames_dropped()
+{
+    const uint8_t badVersion[] = {9, 0, 0, 2, 's', '0', 0, 1, 0x08};
+    const uint8_t truncated[] = {kRelayFrameVersion, 0, 0, 2, 's', '0', 0, 5, 0x08};
+    const uint8_t badKind[] = {kRelayFrameVersion, 0, 0, 2, 's', '0', 7, 1, 0x08};
+    const uint8_t noName[] = {kRelayFrameVersion, 0, 0, 0};
+    TEST_ASSERT_EQUAL(0, relayAggregatorAccept(&g_aggregator, badVersion, sizeof(badVersion)));
+    TEST_ASSERT_EQUAL(0, relayAggregatorAccept(&g_aggregator, truncated, sizeof(truncated)));
+    TEST_ASSERT_EQUAL(0, relayAggregatorAccept(&g_aggregator, badKind, sizeof(badKind)));
+    TEST_ASSERT_EQUAL(0, relayAggregatorAccept(&g_aggregator, noName, sizeof(noName)));
+    TEST_ASSERT_EQUAL(4, g_aggregator.numDropped);
+    TEST_ASSERT_EQUAL(0, g_aggregator.numOrigins);
+}
+
+void test_nodes_with_queued_records_not_replaced()
+{
+    // every node in the table has a record waiting
+    for (uint8_t i = 0; i < kMaxRelayOrigins; ++i)
+    {
+        TEST_ASSERT_EQUAL(1, acceptFromNode(i));
+    }
+    // so a new node can't take the place of the least recent one, whose record would go out under its name
+    TEST_ASSERT_EQUAL(0, acceptFromNode(kMaxRelayOrigins));
+    TEST_ASSERT_EQUAL(1, g_aggregator.numDropped);
+
+    uint8_t numMisnamed = 0;
+    TEST_ASSERT_EQUAL(kMaxRelayOrigins, relayAggregatorPublish(&g_aggregator, checkNode, &numMisnamed));
+    TEST_ASSERT_EQUAL(0, numMisnamed);
+
+    // once they're published, the new node replaces the least recent, as the frame is sent again
+    TEST_ASSERT_EQUAL(1, acceptFromNode(kMaxRelayOrigins));
+    TEST_ASSERT_EQUAL(1, acceptFromNode(5, 1));
+    TEST_ASSERT_EQUAL_STRING("n32", g_aggregator.origins[0].name);
+    TEST_ASSERT_EQUAL(2, relayAggregatorPublish(&g_aggregator, checkNode, &numMisnamed));
+    TEST_ASSERT_EQUAL(0, numMisnamed);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_record_kinds_and_topics);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_split_across_frames);
+    RUN_TEST(test_duplicates_dropped);
+    RUN_TEST(test_reordered_within_window);
+    RUN_TEST(test_restarted_node_accepted);
+    RUN_TEST(test_lost_frame_reported);
+    RUN_TEST(test_malformed_frames_dropped);
+    RUN_TEST(test_nodes_with_queued_records_not_replaced);
+    return UNITY_END();
+}
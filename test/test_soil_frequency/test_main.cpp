@@ -0,0 +1,99 @@
+#include <unity.h>
+#include "soil_frequency.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+SoilSettings calibratedSettings()
+{
+    SoilSettings settings = {};
+    settings.frequency_Hz[0] = 100000;
+    settings.moisture[0] = 100;
+    settings.frequency_Hz[1] = 400000;
+    settings.moisture[1] = 40;
+    settings.frequency_Hz[2] = 700000;
+    settings.moisture[2] = 0;
+    settings.numCalibrationPoints = 3;
+    settings.gate_us = 10000;
+    settings.mode = kSoilModeFrequency;
+    return settings;
+}
+
+void test_pulse_count_without_overflow()
+{
+    TEST_ASSERT_EQUAL_UINT32(7600, soilPulseCount(0, 7600, 30000));
+}
+
+void test_pulse_count_with_overflows()
+{
+    // 760kHz over a 100ms gate is 76000 pulses, past the 16 bit counter twice
+    TEST_ASSERT_EQUAL_UINT32(76000, soilPulseCount(2, 16000, 30000));
+}
+
+void test_pulse_count_ignores_negative_counter()
+{
+    TEST_ASSERT_EQUAL_UINT32(30000, soilPulseCount(1, -1, 30000));
+}
+
+void test_frequency_from_gate()
+{
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 760000.0f, soilPulseFrequency_Hz(7600, 10000));
+    // the measured gate is used, not the requested one
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 759924.0f, soilPulseFrequency_Hz(7600, 10001));
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 760000.0f, soilPulseFrequency_Hz(soilPulseCount(2, 16000, 30000), 100000));
+}
+
+void test_frequency_of_empty_gate()
+{
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, soilPulseFrequency_Hz(100, 0));
+}
+
+void test_uncalibrated_reports_kHz()
+{
+    SoilSettings settings = calibratedSettings();
+    settings.numCalibrationPoints = 0;
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 760.0f, soilMoistureFromFrequency(settings, 760000));
+}
+
+void test_calibration_interpolates()
+{
+    const SoilSettings settings = calibratedSettings();
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 100.0f, soilMoistureFromFrequency(settings, 100000));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 70.0f, soilMoistureFromFrequency(settings, 250000));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 40.0f, soilMoistureFromFrequency(settings, 400000));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 20.0f, soilMoistureFromFrequency(settings, 550000));
+}
+
+void test_calibration_clamps()
+{
+    const SoilSettings settings = calibratedSettings();
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 100.0f, soilMoistureFromFrequency(settings, 50000));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.0f, soilMoistureFromFrequency(settings, 900000));
+}
+
+void test_single_point_calibration()
+{
+    SoilSettings settings = calibratedSettings();
+    settings.numCalibrationPoints = 1;
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 100.0f, soilMoistureFromFrequency(settings, 900000));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_pulse_count_without_overflow);
+    RUN_TEST(test_pulse_count_with_overflows);
+    RUN_TEST(test_pulse_count_ignores_negative_counter);
+    RUN_TEST(test_frequency_from_gate);
+    RUN_TEST(test_frequency_of_empty_gate);
+    RUN_TEST(test_uncalibrated_reports_kHz);
+    RUN_TEST(test_calibration_interpolates);
+    RUN_TEST(test_calibration_clamps);
+    RUN_TEST(test_single_point_calibration);
+    return UNITY_END();
+}
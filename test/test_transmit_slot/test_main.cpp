@@ -0,0 +1,82 @@
+#include <unity.h>
+#include "transmit_slot.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+constexpr uint32_t kPeriod_ms = 10 * 60 * 1000;
+
+void test_slot_from_mac_is_in_range_and_stable()
+{
+    const uint8_t mac[6] = {0x24, 0x6f, 0x28, 0x01, 0x02, 0x03};
+    const uint8_t slot = transmitSlotFromMac(mac, 12);
+    TEST_ASSERT_TRUE(slot < 12);
+    TEST_ASSERT_EQUAL_UINT8(slot, transmitSlotFromMac(mac, 12));
+    TEST_ASSERT_EQUAL_UINT8(0, transmitSlotFromMac(mac, 0));
+}
+
+void test_slots_from_consecutive_macs_spread()
+{
+    // devices from the same batch differ only in the last bytes of their MAC
+    uint8_t counts[12] = {0};
+    for (uint16_t i = 0; i < 120; ++i)
+    {
+        const uint8_t mac[6] = {0x24, 0x6f, 0x28, 0x01, static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i)};
+        ++counts[transmitSlotFromMac(mac, 12)];
+    }
+    for (uint8_t slot = 0; slot < 12; ++slot)
+    {
+        TEST_ASSERT_TRUE(counts[slot] > 0);
+    }
+}
+
+void test_phase_error_on_slot()
+{
+    // slot 3 of 12 starts 150s into the period
+    TEST_ASSERT_EQUAL_INT(0, transmitPhaseError_ms(5 * kPeriod_ms + 150000, kPeriod_ms, 3, 12));
+}
+
+void test_phase_error_late_and_early()
+{
+    TEST_ASSERT_EQUAL_INT(20000, transmitPhaseError_ms(5 * kPeriod_ms + 170000, kPeriod_ms, 3, 12));
+    TEST_ASSERT_EQUAL_INT(-20000, transmitPhaseError_ms(5 * kPeriod_ms + 130000, kPeriod_ms, 3, 12));
+}
+
+void test_phase_error_wraps_the_short_way()
+{
+    // slot 0, just before the end of the period is slightly early rather than nearly a whole period late
+    TEST_ASSERT_EQUAL_INT(-1000, transmitPhaseError_ms(6 * kPeriod_ms - 1000, kPeriod_ms, 0, 12));
+    // slot 11 (550s), just after the start of the period is slightly late
+    TEST_ASSERT_EQUAL_INT(51000, transmitPhaseError_ms(6 * kPeriod_ms + 1000, kPeriod_ms, 11, 12));
+}
+
+void test_sleep_adjustment_is_spread()
+{
+    int32_t pending_ms = -150000;
+    TEST_ASSERT_EQUAL_INT(-60000, takeSleepAdjustment_ms(&pending_ms, 120000));
+    TEST_ASSERT_EQUAL_INT(-60000, takeSleepAdjustment_ms(&pending_ms, 120000));
+    TEST_ASSERT_EQUAL_INT(-30000, takeSleepAdjustment_ms(&pending_ms, 120000));
+    TEST_ASSERT_EQUAL_INT(0, pending_ms);
+    TEST_ASSERT_EQUAL_INT(0, takeSleepAdjustment_ms(&pending_ms, 120000));
+
+    pending_ms = 1000;
+    TEST_ASSERT_EQUAL_INT(1000, takeSleepAdjustment_ms(&pending_ms, 120000));
+    TEST_ASSERT_EQUAL_INT(0, pending_ms);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_slot_from_mac_is_in_range_and_stable);
+    RUN_TEST(test_slots_from_consecutive_macs_spread);
+    RUN_TEST(test_phase_error_on_slot);
+    RUN_TEST(test_phase_error_late_and_early);
+    RUN_TEST(test_phase_error_wraps_the_short_way);
+    RUN_TEST(test_sleep_adjustment_is_spread);
+    return UNITY_END();
+}